@@ -0,0 +1,248 @@
+// Copyright 2022 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <gtest/gtest.h>
+
+#include "tangent/protostruct/advise.h"
+#include "tangent/protostruct/test/test_messages.h"
+#include "tangent/protostruct/test/test_messages.pb.h"
+
+namespace gpb = google::protobuf;
+
+static void add_file(const gpb::FileDescriptor* file,
+                     std::set<std::string>* visited,
+                     gpb::FileDescriptorSet* fdset) {
+  if (!visited->insert(file->name()).second) {
+    return;
+  }
+  for (int idx = 0; idx < file->dependency_count(); idx++) {
+    add_file(file->dependency(idx), visited, fdset);
+  }
+  file->CopyTo(fdset->add_file());
+}
+
+// Return the descriptor set for test_messages.proto
+static const gpb::FileDescriptorSet& get_test_fdset() {
+  static const gpb::FileDescriptorSet fdset = [] {
+    gpb::FileDescriptorSet out;
+    std::set<std::string> visited;
+    add_file(tangent::test::MyMessageC::descriptor()->file(), &visited, &out);
+    return out;
+  }();
+  return fdset;
+}
+
+TEST(AdviseTest, HistogramQuantile) {
+  advise::Histogram hist;
+  EXPECT_EQ(0, hist.quantile(0.5));
+  EXPECT_EQ(0, hist.quantile(1.0));
+  EXPECT_EQ(0, hist.max());
+  EXPECT_EQ(0, hist.count_above(0));
+
+  hist.add(7);
+  EXPECT_EQ(7, hist.quantile(0.0));
+  EXPECT_EQ(7, hist.quantile(0.5));
+  EXPECT_EQ(7, hist.quantile(1.0));
+  EXPECT_EQ(7, hist.max());
+  EXPECT_EQ(0, hist.count_above(7));
+  EXPECT_EQ(1, hist.count_above(6));
+
+  // 1 x 90, 10 x 9, 100 x 1
+  advise::Histogram other;
+  other.add(1, 90);
+  other.add(10, 9);
+  other.add(100);
+  EXPECT_EQ(1, other.quantile(0.0));
+  EXPECT_EQ(1, other.quantile(0.9));
+  EXPECT_EQ(10, other.quantile(0.91));
+  EXPECT_EQ(10, other.quantile(0.99));
+  EXPECT_EQ(100, other.quantile(0.995));
+  EXPECT_EQ(100, other.quantile(1.0));
+  EXPECT_EQ(10, other.count_above(1));
+  EXPECT_EQ(1, other.count_above(10));
+
+  hist.merge(other);
+  EXPECT_EQ(101, hist.total);
+  EXPECT_EQ(100, hist.max());
+  EXPECT_EQ(11, hist.count_above(1));
+}
+
+#define EXPECT_LAYOUT(type)                                                 \
+  do {                                                                      \
+    advise::Layout layout = advise::get_struct_layout(                      \
+        index, ".tangent.test." #type, advise::CapacityMap{}, &offsets);    \
+    EXPECT_EQ(sizeof(type), layout.size) << #type;                          \
+    EXPECT_EQ(alignof(type), layout.align) << #type;                        \
+  } while (0)
+
+#define EXPECT_OFFSET(type, field) \
+  EXPECT_EQ(offsetof(type, field), offsets.at(#field)) << #type "." #field
+
+TEST(AdviseTest, LayoutMatchesGeneratedStructs) {
+  advise::TypeIndex index{get_test_fdset()};
+  std::map<std::string, uint64_t> offsets;
+
+  EXPECT_LAYOUT(MyMessageA);
+  EXPECT_OFFSET(MyMessageA, fieldA);
+  EXPECT_OFFSET(MyMessageA, fieldB);
+  EXPECT_OFFSET(MyMessageA, fieldC);
+  EXPECT_OFFSET(MyMessageA, fieldD);
+
+  offsets.clear();
+  EXPECT_LAYOUT(MyMessageC);
+  EXPECT_OFFSET(MyMessageC, fieldA);
+  EXPECT_OFFSET(MyMessageC, fieldACount);
+  EXPECT_OFFSET(MyMessageC, fieldB);
+  EXPECT_OFFSET(MyMessageC, fieldBCount);
+  EXPECT_OFFSET(MyMessageC, fieldC);
+  EXPECT_OFFSET(MyMessageC, fieldCCount);
+  EXPECT_EQ(6, offsets.size());
+
+  // A fixed-size array has no count member
+  offsets.clear();
+  EXPECT_LAYOUT(TestFixedArray);
+  EXPECT_OFFSET(TestFixedArray, fixedSizedArray);
+  EXPECT_EQ(1, offsets.size());
+
+  offsets.clear();
+  EXPECT_LAYOUT(TestAlignas);
+  EXPECT_OFFSET(TestAlignas, array);
+
+  // Padding between members of decreasing and increasing size
+  offsets.clear();
+  EXPECT_LAYOUT(TestPrimitives);
+  EXPECT_OFFSET(TestPrimitives, fieldA);
+  EXPECT_OFFSET(TestPrimitives, fieldB);
+  EXPECT_OFFSET(TestPrimitives, fieldC);
+  EXPECT_OFFSET(TestPrimitives, fieldD);
+  EXPECT_OFFSET(TestPrimitives, fieldE);
+  EXPECT_OFFSET(TestPrimitives, fieldF);
+  EXPECT_OFFSET(TestPrimitives, fieldG);
+  EXPECT_OFFSET(TestPrimitives, fieldH);
+  EXPECT_OFFSET(TestPrimitives, fieldI);
+  EXPECT_OFFSET(TestPrimitives, fieldJ);
+  EXPECT_OFFSET(TestPrimitives, fieldK);
+}
+
+TEST(AdviseTest, LayoutWithOverrides) {
+  advise::TypeIndex index{get_test_fdset()};
+  const advise::TypeIndex::MessageInfo* info =
+      index.find(".tangent.test.MyMessageC");
+  ASSERT_NE(nullptr, info);
+
+  // Shrink fieldA from 10 to 2 elements of MyMessageA
+  advise::CapacityMap overrides{{info->fields.at(1), 2}};
+  EXPECT_EQ(sizeof(MyMessageC),
+            advise::get_struct_size(index, ".tangent.test.MyMessageC",
+                                    advise::CapacityMap{}));
+  EXPECT_EQ(sizeof(MyMessageC) - 8 * sizeof(MyMessageA),
+            advise::get_struct_size(index, ".tangent.test.MyMessageC",
+                                    overrides));
+}
+
+// Encode a MyMessageC with two elements in fieldA, three in (packed) fieldB
+// and one in fieldC
+static std::string make_fixture() {
+  tangent::test::MyMessageC msg;
+  msg.add_fielda()->set_fielda(1);
+  msg.add_fielda()->set_fieldc(2);
+  msg.add_fieldb(3);
+  msg.add_fieldb(4);
+  msg.add_fieldb(5);
+  msg.add_fieldc(6);
+  return msg.SerializeAsString();
+}
+
+TEST(AdviseTest, ScanMessage) {
+  advise::TypeIndex index{get_test_fdset()};
+  advise::CorpusStats stats;
+
+  std::string encoded = make_fixture();
+  for (int idx = 0; idx < 2; idx++) {
+    gpb::io::CodedInputStream in{
+        reinterpret_cast<const uint8_t*>(encoded.data()),
+        static_cast<int>(encoded.size())};
+    ASSERT_TRUE(advise::scan_message(index, ".tangent.test.MyMessageC", &in,
+                                     &stats));
+  }
+
+  ASSERT_EQ(1, stats.types.count(".tangent.test.MyMessageC"));
+  const advise::TypeStats& msg_stats = stats.types[".tangent.test.MyMessageC"];
+  EXPECT_EQ(2, msg_stats.instances);
+  ASSERT_EQ(3, msg_stats.repeated.size());
+  EXPECT_EQ(2, msg_stats.repeated.at(1).total);
+  EXPECT_EQ(2, msg_stats.repeated.at(1).max());
+  EXPECT_EQ(3, msg_stats.repeated.at(2).max());
+  EXPECT_EQ(1, msg_stats.repeated.at(5).max());
+  EXPECT_TRUE(msg_stats.strings.empty());
+
+  // Nested messages are recorded under their own type
+  ASSERT_EQ(1, stats.types.count(".tangent.test.MyMessageA"));
+  EXPECT_EQ(4, stats.types[".tangent.test.MyMessageA"].instances);
+
+  // A message truncated within a length-delimited field is rejected
+  for (size_t size : {encoded.size() - 1, size_t{3}}) {
+    gpb::io::CodedInputStream in{
+        reinterpret_cast<const uint8_t*>(encoded.data()),
+        static_cast<int>(size)};
+    advise::CorpusStats bad_stats;
+    EXPECT_FALSE(advise::scan_message(index, ".tangent.test.MyMessageC", &in,
+                                      &bad_stats))
+        << size;
+  }
+}
+
+TEST(AdviseTest, ReportShape) {
+  advise::TypeIndex index{get_test_fdset()};
+  advise::CorpusStats stats;
+  std::string encoded = make_fixture();
+  gpb::io::CodedInputStream in{
+      reinterpret_cast<const uint8_t*>(encoded.data()),
+      static_cast<int>(encoded.size())};
+  ASSERT_TRUE(
+      advise::scan_message(index, ".tangent.test.MyMessageC", &in, &stats));
+  stats.files = 1;
+  stats.messages = 1;
+  stats.bytes = encoded.size();
+
+  ProgramOptions::AdviseOptions opts{};
+  opts.quantile = 1.0;
+
+  std::stringstream strm;
+  {
+    tjson::OStream out{&strm, tjson_DefaultOpts};
+    advise::write_report(&out, index, opts, ".tangent.test.MyMessageC", stats);
+  }
+  std::string report = strm.str();
+
+  // fieldA shrinks from 10 to 2, fieldB from 12 to 3, fieldC from 10 to 1
+  uint64_t suggested_size = sizeof(MyMessageC) - 8 * sizeof(MyMessageA) -
+                            9 * sizeof(int32_t) - 9 * sizeof(int32_t);
+  for (const std::string& needle : {
+           std::string{"\"message\": \"tangent.test.MyMessageC\""},
+           std::string{"\"corpus\": {"},
+           std::string{"\"messages\": 1"},
+           std::string{"\"errors\": 0"},
+           "\"current_size\": " + std::to_string(sizeof(MyMessageC)),
+           "\"suggested_size\": " + std::to_string(suggested_size),
+           std::string{"\"types\": ["},
+           std::string{"\"name\": \"tangent.test.MyMessageA\""},
+           std::string{"\"fields\": ["},
+           std::string{"\"name\": \"fieldB\""},
+           std::string{"\"capname\": \"FIELD_B_CAPACITY\""},
+           std::string{"\"current_capacity\": 12"},
+           std::string{"\"suggested_capacity\": 3"},
+           std::string{"\"overflow_suggested\": 0"},
+       }) {
+    EXPECT_NE(std::string::npos, report.find(needle))
+        << "missing " << needle << " in:\n"
+        << report;
+  }
+}
@@ -0,0 +1,507 @@
+// Copyright 2022 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Implements `protostruct advise`: scan a corpus of encoded messages and
+// recommend capacities for the fixed-size arrays in the generated structs.
+
+#include "tangent/protostruct/advise.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/wire_format_lite.h>
+
+#include "tangent/util/exception.h"
+
+namespace advise {
+namespace {
+
+using google::protobuf::DescriptorProto;
+using google::protobuf::FieldDescriptorProto;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+bool is_repeated(const FieldDescriptorProto& field) {
+  return field.label() == FieldDescriptorProto::LABEL_REPEATED;
+}
+
+// Return true if the `length` bytes following a length prefix are available.
+// A limit pushed past the end of an array input is silently clamped to the
+// end of the array, so a truncated payload would otherwise look like a short
+// (but valid) one.
+bool has_all_bytes(CodedInputStream* in, uint32_t length) {
+  int available = in->BytesUntilLimit();
+  return available < 0 || static_cast<uint32_t>(available) == length;
+}
+
+// Return the number of elements in a packed repeated field of `length` bytes
+// and advance past them
+bool count_packed(const FieldDescriptorProto& field, uint32_t length,
+                  CodedInputStream* in, uint64_t* count) {
+  switch (field.type()) {
+    case FieldDescriptorProto::TYPE_FIXED32:
+    case FieldDescriptorProto::TYPE_SFIXED32:
+    case FieldDescriptorProto::TYPE_FLOAT:
+      *count += length / 4;
+      return in->Skip(length);
+    case FieldDescriptorProto::TYPE_FIXED64:
+    case FieldDescriptorProto::TYPE_SFIXED64:
+    case FieldDescriptorProto::TYPE_DOUBLE:
+      *count += length / 8;
+      return in->Skip(length);
+    default:
+      break;
+  }
+
+  auto limit = in->PushLimit(length);
+  if (!has_all_bytes(in, length)) {
+    return false;
+  }
+  while (in->BytesUntilLimit() > 0) {
+    uint64_t dummy = 0;
+    if (!in->ReadVarint64(&dummy)) {
+      return false;
+    }
+    (*count)++;
+  }
+  in->PopLimit(limit);
+  return true;
+}
+
+}  // namespace
+
+bool scan_message(const TypeIndex& index, const std::string& name,
+                  CodedInputStream* in, CorpusStats* stats) {
+  const TypeIndex::MessageInfo* info = index.find(name);
+  TANGENT_ASSERT(info) << "Unknown message type " << name;
+
+  std::map<int, uint64_t> counts;
+  while (true) {
+    uint32_t tag = in->ReadTag();
+    if (tag == 0) {
+      // Either end of the message or a malformed tag
+      if (in->BytesUntilLimit() != 0) {
+        return false;
+      }
+      break;
+    }
+
+    int number = WireFormatLite::GetTagFieldNumber(tag);
+    auto iter = info->fields.find(number);
+    if (iter == info->fields.end()) {
+      if (!WireFormatLite::SkipField(in, tag)) {
+        return false;
+      }
+      continue;
+    }
+
+    const FieldDescriptorProto& field = *iter->second;
+    if (WireFormatLite::GetTagWireType(tag) !=
+        WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      if (!WireFormatLite::SkipField(in, tag)) {
+        return false;
+      }
+      counts[number]++;
+      continue;
+    }
+
+    uint32_t length = 0;
+    if (!in->ReadVarint32(&length)) {
+      return false;
+    }
+    switch (field.type()) {
+      case FieldDescriptorProto::TYPE_MESSAGE: {
+        auto limit = in->PushLimit(length);
+        if (!has_all_bytes(in, length) ||
+            !scan_message(index, field.type_name(), in, stats)) {
+          return false;
+        }
+        in->PopLimit(limit);
+        counts[number]++;
+        break;
+      }
+      case FieldDescriptorProto::TYPE_STRING:
+      case FieldDescriptorProto::TYPE_BYTES: {
+        if (!in->Skip(length)) {
+          return false;
+        }
+        stats->types[name].strings[number].add(length);
+        counts[number]++;
+        break;
+      }
+      default: {
+        // packed repeated primitive
+        if (!count_packed(field, length, in, &counts[number])) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+
+  TypeStats& type_stats = stats->types[name];
+  type_stats.instances++;
+  for (const auto& field : info->descr->field()) {
+    if (is_repeated(field)) {
+      type_stats.repeated[field.number()].add(counts[field.number()]);
+    }
+  }
+  return true;
+}
+
+namespace {
+
+bool read_file(const std::string& path, std::string* content) {
+  std::ifstream infile{path, std::ios::binary};
+  if (!infile.good()) {
+    return false;
+  }
+  std::stringstream strm{};
+  strm << infile.rdbuf();
+  *content = strm.str();
+  return true;
+}
+
+// Scan one corpus file containing either a single message, or a stream of
+// varint length-prefixed messages
+void scan_file(const TypeIndex& index, const ProgramOptions::AdviseOptions& opts,
+               const std::string& root_name, const std::string& path,
+               CorpusStats* stats) {
+  std::string content;
+  if (!read_file(path, &content)) {
+    std::cerr << "Failed to read " << path << "\n";
+    stats->errors++;
+    return;
+  }
+  stats->files++;
+  stats->bytes += content.size();
+
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(content.data());
+  const uint8_t* end = ptr + content.size();
+  while (ptr < end) {
+    uint32_t length = end - ptr;
+    if (opts.delimited) {
+      CodedInputStream prefix{ptr, static_cast<int>(end - ptr)};
+      if (!prefix.ReadVarint32(&length) ||
+          length > static_cast<uint32_t>(prefix.BytesUntilLimit())) {
+        std::cerr << path << ": malformed length prefix at offset "
+                  << (ptr - reinterpret_cast<const uint8_t*>(content.data()))
+                  << "\n";
+        stats->errors++;
+        return;
+      }
+      ptr += prefix.CurrentPosition();
+    }
+
+    CodedInputStream in{ptr, static_cast<int>(length)};
+    in.PushLimit(length);
+    if (scan_message(index, root_name, &in, stats)) {
+      stats->messages++;
+    } else {
+      stats->errors++;
+    }
+    ptr += length;
+  }
+}
+
+// Scan all corpus files, splitting them across `num_threads` workers
+CorpusStats scan_corpus(const TypeIndex& index,
+                        const ProgramOptions::AdviseOptions& opts,
+                        const std::string& root_name) {
+  size_t num_threads = opts.num_threads;
+  if (num_threads < 1) {
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, opts.corpus_paths.size());
+
+  CorpusStats total{};
+  std::mutex total_mutex;
+  std::atomic<size_t> next_file{0};
+  auto worker = [&]() {
+    CorpusStats local{};
+    for (size_t idx = next_file++; idx < opts.corpus_paths.size();
+         idx = next_file++) {
+      scan_file(index, opts, root_name, opts.corpus_paths[idx], &local);
+    }
+    std::lock_guard<std::mutex> lock{total_mutex};
+    total.merge(local);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t idx = 1; idx < num_threads; idx++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return total;
+}
+
+Layout get_scalar_layout(const FieldDescriptorProto& field) {
+  static const std::map<std::string, Layout> kFieldTypes = {
+      {"bool", {1, 1}},     {"char", {1, 1}},     {"int8_t", {1, 1}},
+      {"uint8_t", {1, 1}},  {"int16_t", {2, 2}},  {"uint16_t", {2, 2}},
+      {"int32_t", {4, 4}},  {"uint32_t", {4, 4}}, {"int64_t", {8, 8}},
+      {"uint64_t", {8, 8}}, {"float", {4, 4}},    {"double", {8, 8}},
+  };
+
+  const auto& opts = field.options().GetExtension(protostruct::fieldopts);
+  if (opts.has_fieldtype()) {
+    auto iter = kFieldTypes.find(opts.fieldtype());
+    if (iter != kFieldTypes.end()) {
+      return iter->second;
+    }
+  }
+
+  switch (field.type()) {
+    case FieldDescriptorProto::TYPE_BOOL:
+    case FieldDescriptorProto::TYPE_STRING:
+    case FieldDescriptorProto::TYPE_BYTES:
+      return {1, 1};
+    case FieldDescriptorProto::TYPE_DOUBLE:
+    case FieldDescriptorProto::TYPE_FIXED64:
+    case FieldDescriptorProto::TYPE_SFIXED64:
+    case FieldDescriptorProto::TYPE_INT64:
+    case FieldDescriptorProto::TYPE_SINT64:
+    case FieldDescriptorProto::TYPE_UINT64:
+      return {8, 8};
+    default:
+      return {4, 4};
+  }
+}
+
+// Compute the layout of the C struct generated for message `name`, while
+// tracking the types currently being laid out so that recursion terminates.
+Layout get_struct_layout(const TypeIndex& index, const std::string& name,
+                         const CapacityMap& overrides,
+                         std::set<std::string>* visiting,
+                         std::map<std::string, uint64_t>* offsets) {
+  const TypeIndex::MessageInfo* info = index.find(name);
+  if (!info || visiting->count(name)) {
+    // unknown or recursive type
+    return {0, 1};
+  }
+  visiting->insert(name);
+
+  uint64_t offset = 0;
+  uint64_t align = 1;
+  auto append = [&offset, &align, offsets](const std::string& member_name,
+                                           Layout member) {
+    offset = (offset + member.align - 1) / member.align * member.align;
+    if (offsets) {
+      (*offsets)[member_name] = offset;
+    }
+    offset += member.size;
+    align = std::max(align, member.align);
+  };
+
+  for (const auto& field : info->descr->field()) {
+    Layout elem{};
+    if (field.type() == FieldDescriptorProto::TYPE_MESSAGE) {
+      elem = get_struct_layout(index, field.type_name(), overrides, visiting,
+                               nullptr);
+    } else {
+      elem = get_scalar_layout(field);
+    }
+
+    // An alignment specifier can only strengthen the natural alignment
+    const auto& opts = field.options().GetExtension(protostruct::fieldopts);
+    uint64_t member_align =
+        std::max<uint64_t>(elem.align, opts.has_alignment() ? opts.alignment()
+                                                            : 1);
+
+    bool is_string = field.type() == FieldDescriptorProto::TYPE_STRING ||
+                     field.type() == FieldDescriptorProto::TYPE_BYTES;
+    if (!is_repeated(field) && !is_string) {
+      append(field.name(), {elem.size, member_align});
+      continue;
+    }
+
+    uint64_t capacity = index.get_capacity(field);
+    auto iter = overrides.find(&field);
+    if (iter != overrides.end()) {
+      capacity = iter->second;
+    }
+    append(field.name(), {elem.size * capacity, member_align});
+
+    if (opts.has_lenfield()) {
+      append(opts.lenfield(), {sizeof(uint32_t), alignof(uint32_t)});
+    }
+  }
+  visiting->erase(name);
+
+  offset = (offset + align - 1) / align * align;
+  return {offset, align};
+}
+
+}  // namespace
+
+Layout get_struct_layout(const TypeIndex& index, const std::string& name,
+                         const CapacityMap& overrides,
+                         std::map<std::string, uint64_t>* offsets) {
+  std::set<std::string> visiting;
+  return get_struct_layout(index, name, overrides, &visiting, offsets);
+}
+
+uint64_t get_struct_size(const TypeIndex& index, const std::string& name,
+                         const CapacityMap& overrides) {
+  return get_struct_layout(index, name, overrides).size;
+}
+
+namespace {
+
+void write_distribution(tjson::OStream* out, const Histogram& hist,
+                        uint64_t current, uint64_t suggested) {
+  (*out) << "p50" << hist.quantile(0.5);
+  (*out) << "p99" << hist.quantile(0.99);
+  (*out) << "max" << hist.max();
+  (*out) << "current_capacity" << current;
+  (*out) << "suggested_capacity" << suggested;
+  if (current) {
+    (*out) << "overflow_current" << hist.count_above(current);
+  }
+  (*out) << "overflow_suggested" << hist.count_above(suggested);
+}
+
+}  // namespace
+
+void write_report(tjson::OStream* out, const TypeIndex& index,
+                  const ProgramOptions::AdviseOptions& opts,
+                  const std::string& root_name, const CorpusStats& stats) {
+  // Suggested capacity for each field which was observed in the corpus
+  CapacityMap suggested;
+  for (const auto& type_pair : stats.types) {
+    const TypeIndex::MessageInfo* info = index.find(type_pair.first);
+    for (const auto& pair : type_pair.second.repeated) {
+      suggested[info->fields.at(pair.first)] =
+          std::max<uint64_t>(1, pair.second.quantile(opts.quantile));
+    }
+    for (const auto& pair : type_pair.second.strings) {
+      const FieldDescriptorProto* field = info->fields.at(pair.first);
+      if (is_repeated(*field)) {
+        // The repeated count takes precedence, the string capacity is not
+        // something we can size from the descriptor.
+        continue;
+      }
+      // leave room for a null terminator in strings
+      uint64_t extra = field->type() == FieldDescriptorProto::TYPE_STRING;
+      suggested[field] = pair.second.quantile(opts.quantile) + extra;
+    }
+  }
+
+  tjson::Guard root_guard{out, tjson::OBJECT};
+  (*out) << "message" << root_name.substr(1);
+  (*out) << "quantile" << opts.quantile;
+  {
+    (*out) << "corpus";
+    tjson::Guard guard{out, tjson::OBJECT};
+    (*out) << "files" << stats.files;
+    (*out) << "messages" << stats.messages;
+    (*out) << "bytes" << stats.bytes;
+    (*out) << "errors" << stats.errors;
+  }
+
+  uint64_t current_size = get_struct_size(index, root_name, CapacityMap{});
+  uint64_t suggested_size = get_struct_size(index, root_name, suggested);
+  (*out) << "current_size" << current_size;
+  (*out) << "suggested_size" << suggested_size;
+
+  (*out) << "types";
+  tjson::Guard types_guard{out, tjson::LIST};
+  for (const auto& type_pair : stats.types) {
+    const TypeIndex::MessageInfo* info = index.find(type_pair.first);
+    const TypeStats& type_stats = type_pair.second;
+
+    tjson::Guard type_guard{out, tjson::OBJECT};
+    (*out) << "name" << type_pair.first.substr(1);
+    (*out) << "instances" << type_stats.instances;
+    (*out) << "current_size"
+           << get_struct_size(index, type_pair.first, CapacityMap{});
+    (*out) << "suggested_size"
+           << get_struct_size(index, type_pair.first, suggested);
+
+    (*out) << "fields";
+    tjson::Guard fields_guard{out, tjson::LIST};
+    for (const auto& field : info->descr->field()) {
+      auto repeated = type_stats.repeated.find(field.number());
+      auto strings = type_stats.strings.find(field.number());
+      if (repeated == type_stats.repeated.end() &&
+          strings == type_stats.strings.end()) {
+        continue;
+      }
+
+      tjson::Guard field_guard{out, tjson::OBJECT};
+      (*out) << "name" << field.name();
+      (*out) << "number" << field.number();
+      const auto& fieldopts =
+          field.options().GetExtension(protostruct::fieldopts);
+      if (fieldopts.has_capname()) {
+        (*out) << "capname" << fieldopts.capname();
+      }
+
+      uint64_t current = index.get_capacity(field);
+      if (repeated != type_stats.repeated.end()) {
+        (*out) << "count";
+        tjson::Guard guard{out, tjson::OBJECT};
+        write_distribution(out, repeated->second, current,
+                           suggested.at(&field));
+      }
+      if (strings != type_stats.strings.end()) {
+        (*out) << "length";
+        tjson::Guard guard{out, tjson::OBJECT};
+        uint64_t suggested_length = is_repeated(field)
+                                        ? strings->second.max()
+                                        : suggested.at(&field);
+        write_distribution(out, strings->second,
+                           is_repeated(field) ? 0 : current, suggested_length);
+      }
+    }
+  }
+}
+
+}  // namespace advise
+
+int advise_main(const ProgramOptions& popts) {
+  auto& aopts = popts.advise_opts;
+  ARGUE_ASSERT(INPUT_ERROR, !popts.descriptor_set_inpath.empty())
+      << "advise requires --descriptor-set-in";
+  ARGUE_ASSERT(INPUT_ERROR, !aopts.message_name.empty())
+      << "advise requires --message";
+  ARGUE_ASSERT(INPUT_ERROR, !aopts.corpus_paths.empty())
+      << "advise requires at least one corpus file";
+  ARGUE_ASSERT(INPUT_ERROR, 0 < aopts.quantile && aopts.quantile <= 1)
+      << "--quantile must be in (0, 1]";
+
+  std::string fileset_bytes;
+  TANGENT_ASSERT(advise::read_file(popts.descriptor_set_inpath, &fileset_bytes))
+      << "Failed to read " << popts.descriptor_set_inpath;
+  google::protobuf::FileDescriptorSet fileset{};
+  TANGENT_ASSERT(fileset.ParseFromString(fileset_bytes))
+      << "Failed to parse " << popts.descriptor_set_inpath;
+
+  advise::TypeIndex index{fileset};
+  std::string root_name = aopts.message_name;
+  if (root_name.empty() || root_name[0] != '.') {
+    root_name = "." + root_name;
+  }
+  ARGUE_ASSERT(INPUT_ERROR, index.find(root_name))
+      << "No message named " << aopts.message_name << " in "
+      << popts.descriptor_set_inpath;
+
+  advise::CorpusStats stats = advise::scan_corpus(index, aopts, root_name);
+
+  if (aopts.report_outpath.empty() || aopts.report_outpath == "-") {
+    tjson::OStream out{&std::cout, tjson_DefaultOpts};
+    advise::write_report(&out, index, aopts, root_name, stats);
+  } else {
+    tjson::OFStream out{aopts.report_outpath};
+    TANGENT_ASSERT(out.good())
+        << "Failed to open " << aopts.report_outpath << " for write";
+    advise::write_report(&out, index, aopts, root_name, stats);
+  }
+  return stats.errors ? 1 : 0;
+}
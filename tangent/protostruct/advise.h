@@ -0,0 +1,217 @@
+#pragma once
+// Copyright 2022 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Building blocks of `protostruct advise`, which scans a corpus of encoded
+// messages and recommends capacities for the fixed-size arrays in the
+// generated structs. See advise_main() in protostruct.h.
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/io/coded_stream.h>
+
+#include "tangent/protostruct/descriptor_extensions.pb.h"
+#include "tangent/protostruct/protostruct.h"
+#include "tangent/tjson/ostream.h"
+
+namespace advise {
+
+// Exact distribution of a non-negative integer quantity (e.g. the number of
+// elements in a repeated field). Values are stored as a value -> frequency
+// map which stays small for the kinds of things we measure.
+struct Histogram {
+  std::map<uint64_t, uint64_t> counts;
+  uint64_t total = 0;
+
+  void add(uint64_t value, uint64_t frequency = 1) {
+    counts[value] += frequency;
+    total += frequency;
+  }
+
+  void merge(const Histogram& other) {
+    for (const auto& pair : other.counts) {
+      add(pair.first, pair.second);
+    }
+  }
+
+  // Return the smallest value which is greater than or equal to at least
+  // `fraction` of the samples
+  uint64_t quantile(double fraction) const {
+    uint64_t threshold = std::ceil(fraction * total);
+    uint64_t accum = 0;
+    for (const auto& pair : counts) {
+      accum += pair.second;
+      if (accum >= threshold) {
+        return pair.first;
+      }
+    }
+    return max();
+  }
+
+  uint64_t max() const {
+    return counts.empty() ? 0 : counts.rbegin()->first;
+  }
+
+  // Return the number of samples strictly larger than `value`
+  uint64_t count_above(uint64_t value) const {
+    uint64_t accum = 0;
+    for (auto iter = counts.upper_bound(value); iter != counts.end(); ++iter) {
+      accum += iter->second;
+    }
+    return accum;
+  }
+};
+
+// Observations for all instances of one message type
+struct TypeStats {
+  uint64_t instances = 0;
+
+  // field number -> number of elements per message instance
+  std::map<int, Histogram> repeated;
+
+  // field number -> length of each string or bytes value
+  std::map<int, Histogram> strings;
+
+  void merge(const TypeStats& other) {
+    instances += other.instances;
+    for (const auto& pair : other.repeated) {
+      repeated[pair.first].merge(pair.second);
+    }
+    for (const auto& pair : other.strings) {
+      strings[pair.first].merge(pair.second);
+    }
+  }
+};
+
+struct CorpusStats {
+  uint64_t files = 0;
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  uint64_t errors = 0;
+
+  // fully qualified type name -> observations
+  std::map<std::string, TypeStats> types;
+
+  void merge(const CorpusStats& other) {
+    files += other.files;
+    messages += other.messages;
+    bytes += other.bytes;
+    errors += other.errors;
+    for (const auto& pair : other.types) {
+      types[pair.first].merge(pair.second);
+    }
+  }
+};
+
+// Index of all message types in a FileDescriptorSet by their fully qualified
+// name (with a leading dot, as they appear in `type_name`)
+class TypeIndex {
+ public:
+  struct MessageInfo {
+    const google::protobuf::DescriptorProto* descr;
+    std::map<int, const google::protobuf::FieldDescriptorProto*> fields;
+  };
+
+  explicit TypeIndex(const google::protobuf::FileDescriptorSet& fileset) {
+    for (const auto& file : fileset.file()) {
+      std::string prefix = file.package().empty() ? "" : "." + file.package();
+      for (const auto& descr : file.message_type()) {
+        add_message(prefix, &descr);
+      }
+
+      const auto& fileopts = file.options().GetExtension(protostruct::fileopts);
+      for (const auto& macro : fileopts.capacity_macros()) {
+        std::stringstream strm{macro};
+        std::string name;
+        uint64_t value = 0;
+        if (strm >> name >> value) {
+          macros_[name] = value;
+        }
+      }
+    }
+  }
+
+  const MessageInfo* find(const std::string& name) const {
+    auto iter = messages_.find(name);
+    if (iter == messages_.end()) {
+      return nullptr;
+    }
+    return &iter->second;
+  }
+
+  // Return the capacity of the fixed-size array generated for a field, or
+  // zero if it has no capacity
+  uint64_t get_capacity(
+      const google::protobuf::FieldDescriptorProto& field) const {
+    const auto& opts = field.options().GetExtension(protostruct::fieldopts);
+    if (opts.has_capacity()) {
+      return opts.capacity();
+    }
+    if (opts.has_capname()) {
+      auto iter = macros_.find(opts.capname());
+      if (iter != macros_.end()) {
+        return iter->second;
+      }
+    }
+    return 0;
+  }
+
+ private:
+  void add_message(const std::string& prefix,
+                   const google::protobuf::DescriptorProto* descr) {
+    std::string name = prefix + "." + descr->name();
+    MessageInfo& info = messages_[name];
+    info.descr = descr;
+    for (const auto& field : descr->field()) {
+      info.fields[field.number()] = &field;
+    }
+    for (const auto& nested : descr->nested_type()) {
+      add_message(name, &nested);
+    }
+  }
+
+  std::map<std::string, MessageInfo> messages_;
+  std::map<std::string, uint64_t> macros_;
+};
+
+// Walk one encoded message of type `name` and record the number of elements
+// in each repeated field and the length of each string. Nested messages are
+// recorded under their own type. Return false if the message is malformed.
+bool scan_message(const TypeIndex& index, const std::string& name,
+                  google::protobuf::io::CodedInputStream* in,
+                  CorpusStats* stats);
+
+// Size and alignment of a C type
+struct Layout {
+  uint64_t size;
+  uint64_t align;
+};
+
+// field -> capacity, overriding the capacities recorded in the descriptors
+typedef std::map<const google::protobuf::FieldDescriptorProto*, uint64_t>
+    CapacityMap;
+
+// Compute the layout of the C struct generated for message `name`, using the
+// capacities in `overrides` where available. This mirrors the natural layout
+// rules of the C compiler, along with the `alignment` option of fields which
+// had an alignment specifier in the original header. If `offsets` is not
+// null, it is filled with the offset of each member of the struct by name,
+// including the count member (`lenfield`) of repeated fields.
+Layout get_struct_layout(const TypeIndex& index, const std::string& name,
+                         const CapacityMap& overrides,
+                         std::map<std::string, uint64_t>* offsets = nullptr);
+
+uint64_t get_struct_size(const TypeIndex& index, const std::string& name,
+                         const CapacityMap& overrides);
+
+// Write the JSON report of the statistics gathered for message `root_name`
+// (fully qualified, with a leading dot) and the capacities suggested by them.
+void write_report(tjson::OStream* out, const TypeIndex& index,
+                  const ProgramOptions::AdviseOptions& opts,
+                  const std::string& root_name, const CorpusStats& stats);
+
+}  // namespace advise
@@ -84,9 +84,11 @@ TEMPLATES = {
     "proto": [".proto"],
     "cereal": [".cereal.h"],
     "pbwire": [".pbwire.h", ".pbwire.c"],
+    "pbrpc": [".pbrpc.h", ".pbrpc.c"],
     "pb2c": [".pb2c.h", ".pb2c.cc"],
     "cpp-simple": ["-simple.h", "-simple.cc"],
-    "recon": ["-recon.h"]
+    "recon": ["-recon.h"],
+    "tjson": [".tjson.h", ".tjson.c"],
 }
 
 
@@ -167,6 +169,7 @@ def main():
       template = jenv.get_template(template_name)
       content = template.render(
           filedescr=filedescr,
+          basename=basename,
           include_base=include_base)
       if outpath == "-":
         outpath = os.dup(1)
@@ -5,6 +5,10 @@
 #include <cstring>
 #include <type_traits>
 
+#include "tangent/protostruct/pbwire_internal.h"
+#ifdef PBWIRE_WITH_STATS
+#include "tangent/protostruct/pbwire_stats.h"
+#endif
 #include "tangent/util/fixed_string_stream.h"
 
 typedef enum pbwire_WireType {
@@ -16,6 +20,40 @@ typedef enum pbwire_WireType {
   PBWIRE_WIRETYPE_FIXED32 = 5
 } pbwire_WireType;
 
+const char* pbwire_ErrorCode_tostring(enum pbwire_ErrorCode value) {
+  switch (value) {
+    case PBWIRE_NOERROR:
+      return "PBWIRE_NOERROR";
+    case PBWIRE_INTERNAL_ERROR:
+      return "PBWIRE_INTERNAL_ERROR";
+    case PBWIRE_NOTIMPLEMENTED:
+      return "PBWIRE_NOTIMPLEMENTED";
+    case PBWIRE_VARINT_OVERFLOW:
+      return "PBWIRE_VARINT_OVERFLOW";
+    case PBWIRE_VARINT_UNDERFLOW:
+      return "PBWIRE_VARINT_UNDERFLOW";
+    case PBWIRE_DELIMIT_OVERFLOW:
+      return "PBWIRE_DELIMIT_OVERFLOW";
+    case PBWIRE_VALUE_OVERFLOW:
+      return "PBWIRE_VALUE_OVERFLOW";
+    case PBWIRE_SYSTEM_ERROR:
+      return "PBWIRE_SYSTEM_ERROR";
+    case PBWIRE_SHM_WOULDBLOCK:
+      return "PBWIRE_SHM_WOULDBLOCK";
+    case PBWIRE_SHM_BADSEGMENT:
+      return "PBWIRE_SHM_BADSEGMENT";
+    case PBWIRE_SHM_TOOLARGE:
+      return "PBWIRE_SHM_TOOLARGE";
+    case PBWIRE_RPC_PROTOCOL:
+      return "PBWIRE_RPC_PROTOCOL";
+    case PBWIRE_RPC_CLOSED:
+      return "PBWIRE_RPC_CLOSED";
+    case PBWIRE_BAD_DESCRIPTOR:
+      return "PBWIRE_BAD_DESCRIPTOR";
+  }
+  return "<invalid>";
+}
+
 util::FixedCharStream pbwire_error(pbwire_Error* err, pbwire_ErrorCode code) {
   if (!err) {
     return util::FixedCharStream(0, static_cast<size_t>(0));
@@ -67,7 +105,8 @@ int _parse_uvarint(pbwire_ParseContext* ctx, T* value_out) {
 #pragma GCC unroll 10
 #endif
   for (byte_idx = 0; byte_idx < itercount; byte_idx++) {
-    (value) |= (ctx->buffer.ptr[byte_idx] & mask) << (7 * byte_idx);
+    value |= static_cast<T>(ctx->buffer.ptr[byte_idx] & mask)
+             << (7 * byte_idx);
 
     // If the most significant bit is zero, then this is the last byte in
     // the encoding, so just return the number of bytes read.
@@ -148,7 +187,11 @@ int _parse_delimited(pbwire_ParseContext* ctx, T* value_out,
     if (length < *value_len) {
       *value_len = length;
     }
-    // TODO(josh): warn overflow?
+#ifdef PBWIRE_WITH_STATS
+    if (length > *value_len) {
+      pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_STRINGS, 1);
+    }
+#endif
 
     memcpy(value_out, ctx->buffer.ptr, *value_len);
   }
@@ -194,6 +237,9 @@ int pbwire_parse_message(pbwire_ParseContext* ctx,
     pbwire_ParseContext sub_ctx{};
     sub_ctx.buffer = ctx->buffer;
     sub_ctx.error = ctx->error;
+#ifdef PBWIRE_WITH_STATS
+    sub_ctx.stats = ctx->stats;
+#endif
 
     uint32_t wire_type = (tag & 0x7);
     if (wire_type == PBWIRE_WIRETYPE_LENGTH_DELIMITED) {
@@ -254,10 +300,19 @@ int pbwire_parse_packed_repeated(pbwire_ParseContext* ctx,
       write_ptr += object_size;
     }
   }
+#ifdef PBWIRE_WITH_STATS
+  // The array filled up before the packed data was exhausted
+  if (ctx->buffer.ptr < ctx->buffer.end) {
+    pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+  }
+#endif
   return bytes_packed;
 }
 
 int pbparse_sink_unknown(uint32_t tag, pbwire_ParseContext* ctx) {
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_count(ctx->stats, PBWIRE_STAT_UNKNOWN_FIELDS, 1);
+#endif
   switch (tag & 0x7) {
     // wire-type
     case PBWIRE_WIRETYPE_VARINT: {
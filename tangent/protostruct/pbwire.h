@@ -45,6 +45,15 @@ typedef enum pbwire_ErrorCode {
   PBWIRE_DELIMIT_OVERFLOW,  //< a length-delmited field indicated a size which
                             //< was larger than the available number of bytes
   PBWIRE_VALUE_OVERFLOW,  //< ran out of bytes while parsing a fixed sized value
+  PBWIRE_SYSTEM_ERROR,    //< a system call failed, see errno
+  PBWIRE_SHM_WOULDBLOCK,  //< the shared memory ring is full (producer) or
+                          //  empty (consumer) and the timeout expired
+  PBWIRE_SHM_BADSEGMENT,  //< the shared memory segment is not a valid ring
+  PBWIRE_SHM_TOOLARGE,    //< message is larger than the ring slot size
+  PBWIRE_RPC_PROTOCOL,    //< received a malformed or oversized rpc frame
+  PBWIRE_RPC_CLOSED,      //< the rpc peer closed the connection
+  PBWIRE_BAD_DESCRIPTOR,  //< a descriptor could not be compiled into a
+                          //  dynamic codec plan
 } pbwire_ErrorCode;
 
 const char* pbwire_ErrorCode_tostring(enum pbwire_ErrorCode value);
@@ -58,6 +67,11 @@ typedef struct pbwire_Error {
   char msg[512];
 } pbwire_Error;
 
+#ifdef PBWIRE_WITH_STATS
+// Per-thread runtime counters, see pbwire_stats.h
+typedef struct pbwire_StatsSlot pbwire_StatsSlot;
+#endif
+
 inline uint32_t pbwire_zigzag32(int32_t value) {
   // NOTE(josh): in python we could do this:
   // return (value << 1) ^ (value >> 31);
@@ -117,6 +131,10 @@ typedef struct pbwire_ParseContext {
   pbwire_ReadBuffer buffer;
   pbwire_Error* error;
   void* userdata;
+#ifdef PBWIRE_WITH_STATS
+  // If not NULL, parse counters are accumulated here
+  pbwire_StatsSlot* stats;
+#endif
 } pbwire_ParseContext;
 
 int pbwire_parse_varint32(pbwire_ParseContext* ctx, uint32_t* value);
@@ -170,6 +188,10 @@ typedef struct pbwire_EmitContext {
   pbwire_WriteBuffer buffer;
   pbwire_Error* error;
   void* userdata;
+#ifdef PBWIRE_WITH_STATS
+  // If not NULL, emit counters are accumulated here
+  pbwire_StatsSlot* stats;
+#endif
 } pbwire_EmitContext;
 
 int pbwire_emit_varint32(pbwire_EmitContext* ctx, uint32_t value);
@@ -0,0 +1,157 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Compare the throughput of the descriptor-driven dynamic codec against the
+// generated pbparse_XXX()/pbemit_XXX() functions for the same message.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <string>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+
+#include "tangent/protostruct/pbwire_dynamic.h"
+#include "tangent/protostruct/test/test_messages.pb.h"
+#include "tangent/protostruct/test/test_messages.pbwire.h"
+
+namespace gpb = google::protobuf;
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void check(int result, const pbwire_Error& error) {
+  if (result < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+}
+
+static void add_file(const gpb::FileDescriptor* file,
+                     std::set<std::string>* visited,
+                     gpb::FileDescriptorSet* fdset) {
+  if (!visited->insert(file->name()).second) {
+    return;
+  }
+  for (int idx = 0; idx < file->dependency_count(); idx++) {
+    add_file(file->dependency(idx), visited, fdset);
+  }
+  file->CopyTo(fdset->add_file());
+}
+
+static void report(const char* name, uint32_t count, size_t nbytes,
+                   const std::function<void()>& fn) {
+  uint64_t begin = now_ns();
+  for (uint32_t idx = 0; idx < count; idx++) {
+    fn();
+  }
+  double elapsed = (now_ns() - begin) * 1e-9;
+  printf("%-16s %9.1f ns/msg %8.1f MB/s\n", name, elapsed * 1e9 / count,
+         nbytes * count / elapsed / 1e6);
+}
+
+int main(int argc, char** argv) {
+  uint32_t count = 1000000;
+  if (argc > 1) {
+    count = strtoul(argv[1], nullptr, 10);
+  }
+
+  gpb::FileDescriptorSet fdset;
+  std::set<std::string> visited;
+  add_file(tangent::test::MyMessageC::descriptor()->file(), &visited, &fdset);
+  std::string fdset_bytes = fdset.SerializeAsString();
+
+  pbwire_Error error{};
+  const pbwire_DynamicPlan* plan_a = pbwire_dynamic_get_plan(
+      fdset_bytes.data(), fdset_bytes.size(), "tangent.test.MyMessageA",
+      &error);
+  check(plan_a ? 0 : -1, error);
+  const pbwire_DynamicPlan* plan_c = pbwire_dynamic_get_plan(
+      fdset_bytes.data(), fdset_bytes.size(), "tangent.test.MyMessageC",
+      &error);
+  check(plan_c ? 0 : -1, error);
+
+  MyMessageA message_a{};
+  message_a.fieldA = -12345;
+  message_a.fieldB = 3.25;
+  message_a.fieldC = 1ull << 50;
+  message_a.fieldD = MyEnumA_VALUE2;
+
+  MyMessageC message_c{};
+  message_c.fieldACount = 4;
+  for (uint32_t idx = 0; idx < message_c.fieldACount; idx++) {
+    message_c.fieldA[idx] = message_a;
+  }
+  message_c.fieldBCount = FIELD_B_CAPACITY;
+  for (uint32_t idx = 0; idx < message_c.fieldBCount; idx++) {
+    message_c.fieldB[idx] = idx * 1000;
+  }
+  message_c.fieldCCount = FIELD_C_CAPACITY;
+  for (uint32_t idx = 0; idx < message_c.fieldCCount; idx++) {
+    message_c.fieldC[idx] = idx;
+  }
+
+  char buffer[4096];
+  uint32_t lengths[64];
+  pbwire_EmitContext ectx{};
+  ectx.error = &error;
+
+  auto reset_emit = [&]() {
+    pbwire_writebuffer_init(&ectx.buffer, buffer, buffer + sizeof(buffer));
+    pbwire_lengthcache_init(&ectx.length_cache, lengths, lengths + 64);
+  };
+
+  reset_emit();
+  int nbytes_a = pbwire_dynamic_emit(&ectx, plan_a, &message_a);
+  check(nbytes_a, error);
+  std::string data_a(buffer, nbytes_a);
+
+  reset_emit();
+  int nbytes_c = pbwire_dynamic_emit(&ectx, plan_c, &message_c);
+  check(nbytes_c, error);
+  std::string data_c(buffer, nbytes_c);
+
+  report("emit A (gen)", count, nbytes_a, [&]() {
+    reset_emit();
+    check(pbemit_MyMessageA(&ectx, &message_a), error);
+  });
+  report("emit A (dyn)", count, nbytes_a, [&]() {
+    reset_emit();
+    check(pbwire_dynamic_emit(&ectx, plan_a, &message_a), error);
+  });
+  report("emit C (dyn)", count, nbytes_c, [&]() {
+    reset_emit();
+    check(pbwire_dynamic_emit(&ectx, plan_c, &message_c), error);
+  });
+
+  pbwire_ParseContext pctx{};
+  pctx.error = &error;
+  report("parse A (gen)", count, data_a.size(), [&]() {
+    pbwire_readbuffer_init(&pctx.buffer, data_a.data(),
+                           data_a.data() + data_a.size());
+    MyMessageA out{};
+    check(pbparse_MyMessageA(&pctx, &out), error);
+  });
+  report("parse A (dyn)", count, data_a.size(), [&]() {
+    pbwire_readbuffer_init(&pctx.buffer, data_a.data(),
+                           data_a.data() + data_a.size());
+    MyMessageA out{};
+    check(pbwire_dynamic_parse(&pctx, plan_a, &out), error);
+  });
+  report("parse C (gen)", count, data_c.size(), [&]() {
+    pbwire_readbuffer_init(&pctx.buffer, data_c.data(),
+                           data_c.data() + data_c.size());
+    MyMessageC out{};
+    check(pbparse_MyMessageC(&pctx, &out), error);
+  });
+  report("parse C (dyn)", count, data_c.size(), [&]() {
+    pbwire_readbuffer_init(&pctx.buffer, data_c.data(),
+                           data_c.data() + data_c.size());
+    MyMessageC out{};
+    check(pbwire_dynamic_parse(&pctx, plan_c, &out), error);
+  });
+  return 0;
+}
@@ -0,0 +1,440 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <cstddef>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <gtest/gtest.h>
+
+#include "tangent/protostruct/descriptor_extensions.pb.h"
+#include "tangent/protostruct/pbwire_dynamic.h"
+#include "tangent/protostruct/test/test_messages.h"
+#include "tangent/protostruct/test/test_messages.pb.h"
+#include "tangent/protostruct/test/test_messages.pbwire.h"
+
+namespace gpb = google::protobuf;
+
+static void add_file(const gpb::FileDescriptor* file,
+                     std::set<std::string>* visited,
+                     gpb::FileDescriptorSet* fdset) {
+  if (!visited->insert(file->name()).second) {
+    return;
+  }
+  for (int idx = 0; idx < file->dependency_count(); idx++) {
+    add_file(file->dependency(idx), visited, fdset);
+  }
+  file->CopyTo(fdset->add_file());
+}
+
+// Return the serialized descriptor set for test_messages.proto
+static std::string get_test_fdset() {
+  gpb::FileDescriptorSet fdset;
+  std::set<std::string> visited;
+  add_file(tangent::test::MyMessageC::descriptor()->file(), &visited, &fdset);
+  return fdset.SerializeAsString();
+}
+
+static const pbwire_DynamicPlan* get_test_plan(const std::string& name) {
+  static const std::string fdset = get_test_fdset();
+  pbwire_Error error{};
+  const pbwire_DynamicPlan* plan =
+      pbwire_dynamic_get_plan(fdset.data(), fdset.size(), name.c_str(), &error);
+  EXPECT_NE(nullptr, plan) << error.msg;
+  return plan;
+}
+
+static int parse(const std::string& data, const pbwire_DynamicPlan* plan,
+                 void* image, pbwire_Error* error) {
+  pbwire_ParseContext ctx{};
+  ctx.error = error;
+  pbwire_readbuffer_init(&ctx.buffer, data.data(), data.data() + data.size());
+  return pbwire_dynamic_parse(&ctx, plan, image);
+}
+
+static std::string emit(const pbwire_DynamicPlan* plan, const void* image,
+                        pbwire_Error* error) {
+  char buffer[1024];
+  uint32_t lengths[64];
+  pbwire_EmitContext ctx{};
+  ctx.error = error;
+  pbwire_writebuffer_init(&ctx.buffer, buffer, buffer + sizeof(buffer));
+  pbwire_lengthcache_init(&ctx.length_cache, lengths, lengths + 64);
+  int nbytes = pbwire_dynamic_emit(&ctx, plan, image);
+  if (nbytes < 0) {
+    return "";
+  }
+  EXPECT_EQ(buffer + nbytes, ctx.buffer.ptr);
+  return std::string(buffer, nbytes);
+}
+
+#define EXPECT_FIELD_AT(plan, type, field)                                \
+  do {                                                                    \
+    const pbwire_DynamicField* info =                                     \
+        pbwire_dynamic_find_field(plan, #field);                          \
+    ASSERT_NE(nullptr, info) << #field;                                   \
+    EXPECT_EQ(offsetof(type, field), info->offset) << #field;             \
+    EXPECT_EQ(sizeof(static_cast<type*>(nullptr)->field),                 \
+              info->size * info->capacity)                                \
+        << #field;                                                        \
+  } while (0)
+
+TEST(pbwireDynamicTest, ImageMatchesGeneratedLayout) {
+  const pbwire_DynamicPlan* plan = get_test_plan("tangent.test.MyMessageA");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_STREQ("tangent.test.MyMessageA", pbwire_dynamic_name(plan));
+  EXPECT_EQ(sizeof(MyMessageA), pbwire_dynamic_sizeof(plan));
+  EXPECT_EQ(alignof(MyMessageA), pbwire_dynamic_alignof(plan));
+  EXPECT_FIELD_AT(plan, MyMessageA, fieldA);
+  EXPECT_FIELD_AT(plan, MyMessageA, fieldB);
+  EXPECT_FIELD_AT(plan, MyMessageA, fieldC);
+  EXPECT_FIELD_AT(plan, MyMessageA, fieldD);
+
+  // fieldtype options select the C storage
+  plan = get_test_plan(".tangent.test.TestPrimitives");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(sizeof(TestPrimitives), pbwire_dynamic_sizeof(plan));
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldA);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldB);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldD);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldE);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldF);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldI);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldK);
+
+  // repeated fields are followed by their count, and capacities may come
+  // from the capacity macros
+  plan = get_test_plan("tangent.test.MyMessageC");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(sizeof(MyMessageC), pbwire_dynamic_sizeof(plan));
+  EXPECT_FIELD_AT(plan, MyMessageC, fieldA);
+  EXPECT_FIELD_AT(plan, MyMessageC, fieldB);
+  EXPECT_FIELD_AT(plan, MyMessageC, fieldC);
+  const pbwire_DynamicField* field = pbwire_dynamic_find_number(plan, 2);
+  ASSERT_NE(nullptr, field);
+  EXPECT_STREQ("fieldB", field->name);
+  EXPECT_EQ(FIELD_B_CAPACITY, field->capacity);
+  EXPECT_EQ(offsetof(MyMessageC, fieldBCount), field->count_offset);
+  EXPECT_EQ(nullptr, pbwire_dynamic_find_number(plan, 3));
+  EXPECT_EQ(get_test_plan("tangent.test.MyMessageA"),
+            pbwire_dynamic_find_field(plan, "fieldA")->message);
+}
+
+// Every generated struct, including those whose repeated fields have no count
+// or which have alignment specifiers
+TEST(pbwireDynamicTest, LayoutMatchesAllGeneratedStructs) {
+  const pbwire_DynamicPlan* plan = get_test_plan("tangent.test.MyMessageB");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(sizeof(MyMessageB), pbwire_dynamic_sizeof(plan));
+  EXPECT_EQ(alignof(MyMessageB), pbwire_dynamic_alignof(plan));
+  EXPECT_FIELD_AT(plan, MyMessageB, fieldA);
+
+  plan = get_test_plan("tangent.test.MyMessageC");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(alignof(MyMessageC), pbwire_dynamic_alignof(plan));
+  struct {
+    const char* name;
+    size_t count_offset;
+  } counts[] = {
+      {"fieldA", offsetof(MyMessageC, fieldACount)},
+      {"fieldB", offsetof(MyMessageC, fieldBCount)},
+      {"fieldC", offsetof(MyMessageC, fieldCCount)},
+  };
+  for (const auto& count : counts) {
+    const pbwire_DynamicField* field =
+        pbwire_dynamic_find_field(plan, count.name);
+    ASSERT_NE(nullptr, field) << count.name;
+    EXPECT_EQ(count.count_offset, field->count_offset) << count.name;
+  }
+
+  plan = get_test_plan("tangent.test.TestFixedArray");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(sizeof(TestFixedArray), pbwire_dynamic_sizeof(plan));
+  EXPECT_EQ(alignof(TestFixedArray), pbwire_dynamic_alignof(plan));
+  EXPECT_FIELD_AT(plan, TestFixedArray, fixedSizedArray);
+  EXPECT_EQ(-1, pbwire_dynamic_find_number(plan, 1)->count_offset);
+
+  plan = get_test_plan("tangent.test.TestAlignas");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(sizeof(TestAlignas), pbwire_dynamic_sizeof(plan));
+  EXPECT_EQ(alignof(TestAlignas), pbwire_dynamic_alignof(plan));
+  EXPECT_FIELD_AT(plan, TestAlignas, array);
+
+  plan = get_test_plan("tangent.test.TestPrimitives");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(sizeof(TestPrimitives), pbwire_dynamic_sizeof(plan));
+  EXPECT_EQ(alignof(TestPrimitives), pbwire_dynamic_alignof(plan));
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldA);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldB);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldC);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldD);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldE);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldF);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldG);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldH);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldI);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldJ);
+  EXPECT_FIELD_AT(plan, TestPrimitives, fieldK);
+}
+
+TEST(pbwireDynamicTest, FixedSizeArrays) {
+  TestFixedArray message{};
+  for (int idx = 0; idx < 10; idx++) {
+    message.fixedSizedArray[idx] = 0.25 * idx;
+  }
+
+  const pbwire_DynamicPlan* plan =
+      get_test_plan("tangent.test.TestFixedArray");
+  ASSERT_NE(nullptr, plan);
+  pbwire_Error error{};
+  std::string data = emit(plan, &message, &error);
+  ASSERT_FALSE(data.empty()) << error.msg;
+
+  // Every element is emitted, and a fixed size array is filled from the
+  // start each time a message is parsed
+  tangent::test::TestFixedArray parsed;
+  ASSERT_TRUE(parsed.ParseFromString(data));
+  ASSERT_EQ(10, parsed.fixedsizedarray_size());
+  EXPECT_EQ(2.25, parsed.fixedsizedarray(9));
+
+  TestFixedArray image{};
+  for (int iter = 0; iter < 2; iter++) {
+    ASSERT_EQ(data.size(), parse(data, plan, &image, &error)) << error.msg;
+    for (int idx = 0; idx < 10; idx++) {
+      EXPECT_EQ(0.25 * idx, image.fixedSizedArray[idx]);
+    }
+  }
+}
+
+TEST(pbwireDynamicTest, RoundTripThroughProtobuf) {
+  tangent::test::MyMessageC message;
+  for (int idx = 0; idx < 3; idx++) {
+    auto* item = message.add_fielda();
+    item->set_fielda(-10 * idx);
+    item->set_fieldb(0.5 * idx);
+    item->set_fieldc(1ull << (20 * idx));
+    item->set_fieldd(tangent::test::MyEnumA_VALUE3);
+  }
+  for (int idx = 0; idx < 5; idx++) {
+    message.add_fieldb(idx * 1000);
+  }
+  message.add_fieldc(-1);
+  message.add_fieldc(7);
+
+  const pbwire_DynamicPlan* plan = get_test_plan("tangent.test.MyMessageC");
+  ASSERT_NE(nullptr, plan);
+
+  pbwire_Error error{};
+  MyMessageC image{};
+  std::string data = message.SerializeAsString();
+  ASSERT_EQ(data.size(), parse(data, plan, &image, &error)) << error.msg;
+
+  ASSERT_EQ(3, image.fieldACount);
+  EXPECT_EQ(-20, image.fieldA[2].fieldA);
+  EXPECT_EQ(1.0, image.fieldA[2].fieldB);
+  EXPECT_EQ(1ull << 40, image.fieldA[2].fieldC);
+  EXPECT_EQ(MyEnumA_VALUE3, image.fieldA[2].fieldD);
+  ASSERT_EQ(5, image.fieldBCount);
+  EXPECT_EQ(4000, image.fieldB[4]);
+  ASSERT_EQ(2, image.fieldCCount);
+  EXPECT_EQ(-1, image.fieldC[0]);
+  EXPECT_EQ(7, image.fieldC[1]);
+
+  std::string emitted = emit(plan, &image, &error);
+  ASSERT_FALSE(emitted.empty()) << error.msg;
+  tangent::test::MyMessageC reparsed;
+  ASSERT_TRUE(reparsed.ParseFromString(emitted));
+  EXPECT_EQ(message.DebugString(), reparsed.DebugString());
+}
+
+TEST(pbwireDynamicTest, MatchesGeneratedCodec) {
+  MyMessageA message{};
+  message.fieldA = -12345;
+  message.fieldB = 3.25;
+  message.fieldC = 1ull << 50;
+  message.fieldD = MyEnumA_VALUE2;
+
+  char buffer[128];
+  uint32_t lengths[4];
+  pbwire_Error error{};
+  pbwire_EmitContext ctx{};
+  ctx.error = &error;
+  pbwire_writebuffer_init(&ctx.buffer, buffer, buffer + sizeof(buffer));
+  pbwire_lengthcache_init(&ctx.length_cache, lengths, lengths + 4);
+  int nbytes = pbemit_MyMessageA(&ctx, &message);
+  ASSERT_LT(0, nbytes) << error.msg;
+  std::string generated(buffer, nbytes);
+
+  const pbwire_DynamicPlan* plan = get_test_plan("tangent.test.MyMessageA");
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ(generated, emit(plan, &message, &error)) << error.msg;
+
+  MyMessageA image{};
+  ASSERT_EQ(generated.size(), parse(generated, plan, &image, &error));
+  EXPECT_EQ(message.fieldA, image.fieldA);
+  EXPECT_EQ(message.fieldB, image.fieldB);
+  EXPECT_EQ(message.fieldC, image.fieldC);
+  EXPECT_EQ(message.fieldD, image.fieldD);
+}
+
+TEST(pbwireDynamicTest, ExtraElementsAreDropped) {
+  tangent::test::MyMessageC message;
+  for (int idx = 0; idx < FIELD_B_CAPACITY + 3; idx++) {
+    message.add_fieldb(idx);
+  }
+  // unknown fields are skipped
+  message.GetReflection()->MutableUnknownFields(&message)->AddLengthDelimited(
+      15, "hello");
+
+  const pbwire_DynamicPlan* plan = get_test_plan("tangent.test.MyMessageC");
+  ASSERT_NE(nullptr, plan);
+  pbwire_Error error{};
+  MyMessageC image{};
+  std::string data = message.SerializeAsString();
+  ASSERT_EQ(data.size(), parse(data, plan, &image, &error)) << error.msg;
+  EXPECT_EQ(FIELD_B_CAPACITY, image.fieldBCount);
+  EXPECT_EQ(FIELD_B_CAPACITY - 1, image.fieldB[FIELD_B_CAPACITY - 1]);
+
+  // a truncated message is an error
+  data.resize(data.size() - 2);
+  image = MyMessageC{};
+  EXPECT_GT(0, parse(data, plan, &image, &error));
+  EXPECT_EQ(PBWIRE_DELIMIT_OVERFLOW, error.code);
+}
+
+TEST(pbwireDynamicTest, StringsAndBytes) {
+  gpb::FileDescriptorSet fdset;
+  gpb::FileDescriptorProto* file = fdset.add_file();
+  file->set_name("strings.proto");
+  file->set_package("foo");
+  file->set_syntax("proto3");
+  file->mutable_options()
+      ->MutableExtension(protostruct::fileopts)
+      ->add_capacity_macros("NAME_CAPACITY 8");
+  gpb::DescriptorProto* msg = file->add_message_type();
+  msg->set_name("Record");
+  gpb::FieldDescriptorProto* field = msg->add_field();
+  field->set_name("name");
+  field->set_number(1);
+  field->set_type(gpb::FieldDescriptorProto::TYPE_STRING);
+  field->mutable_options()
+      ->MutableExtension(protostruct::fieldopts)
+      ->set_capname("NAME_CAPACITY");
+  field = msg->add_field();
+  field->set_name("blob");
+  field->set_number(2);
+  field->set_type(gpb::FieldDescriptorProto::TYPE_BYTES);
+  field->mutable_options()
+      ->MutableExtension(protostruct::fieldopts)
+      ->set_capacity(4);
+  std::string serialized = fdset.SerializeAsString();
+
+  pbwire_Error error{};
+  const pbwire_DynamicPlan* plan = pbwire_dynamic_get_plan(
+      serialized.data(), serialized.size(), "foo.Record", &error);
+  ASSERT_NE(nullptr, plan) << error.msg;
+
+  struct Record {
+    char name[8];
+    uint8_t blob[4];
+    uint32_t blobCount;
+  };
+  ASSERT_EQ(sizeof(Record), pbwire_dynamic_sizeof(plan));
+
+  // name is truncated to leave room for the null terminator, blob to the
+  // capacity
+  std::string data;
+  data += '\x0a';
+  data += '\x0b';
+  data += "hello world";
+  data += '\x12';
+  data += '\x06';
+  data += "abcdef";
+  Record image{};
+  ASSERT_EQ(data.size(), parse(data, plan, &image, &error)) << error.msg;
+  EXPECT_STREQ("hello w", image.name);
+  EXPECT_EQ(4, image.blobCount);
+  EXPECT_EQ("abcd", std::string(image.blob, image.blob + 4));
+
+  std::string emitted = emit(plan, &image, &error);
+  EXPECT_EQ(std::string("\x0a\x07hello w\x12\x04" "abcd"), emitted);
+}
+
+TEST(pbwireDynamicTest, PlansAreCachedAcrossThreads) {
+  std::string fdset = get_test_fdset();
+  const int kThreads = 8;
+  const pbwire_DynamicPlan* plans[kThreads] = {};
+  std::thread threads[kThreads];
+  for (int idx = 0; idx < kThreads; idx++) {
+    threads[idx] = std::thread{[&fdset, &plans, idx]() {
+      // Each thread has its own copy of the descriptor set
+      std::string copy = fdset;
+      pbwire_Error error{};
+      plans[idx] = pbwire_dynamic_get_plan(copy.data(), copy.size(),
+                                           "tangent.test.MyMessageB", &error);
+    }};
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_NE(nullptr, plans[0]);
+  for (int idx = 1; idx < kThreads; idx++) {
+    EXPECT_EQ(plans[0], plans[idx]);
+  }
+  EXPECT_EQ(plans[0], get_test_plan("tangent.test.MyMessageB"));
+}
+
+TEST(pbwireDynamicTest, Errors) {
+  std::string fdset = get_test_fdset();
+  pbwire_Error error{};
+  EXPECT_EQ(nullptr, pbwire_dynamic_get_plan(fdset.data(), fdset.size(),
+                                             "tangent.test.Nope", &error));
+  EXPECT_EQ(PBWIRE_BAD_DESCRIPTOR, error.code);
+
+  // A truncated descriptor set
+  error = pbwire_Error{};
+  EXPECT_EQ(nullptr, pbwire_dynamic_get_plan(fdset.data(), fdset.size() / 2,
+                                             "tangent.test.MyMessageA",
+                                             &error));
+  EXPECT_NE(PBWIRE_NOERROR, error.code);
+
+  // A message which contains itself can't be laid out, nor can messages
+  // which contain it. Other messages in the same set are unaffected.
+  gpb::FileDescriptorSet recursive;
+  gpb::FileDescriptorProto* file = recursive.add_file();
+  file->set_name("recursive.proto");
+  file->set_package("foo");
+  gpb::DescriptorProto* msg = file->add_message_type();
+  msg->set_name("Node");
+  gpb::FieldDescriptorProto* field = msg->add_field();
+  field->set_name("child");
+  field->set_number(1);
+  field->set_type(gpb::FieldDescriptorProto::TYPE_MESSAGE);
+  field->set_type_name(".foo.Node");
+  msg = file->add_message_type();
+  msg->set_name("Tree");
+  field = msg->add_field();
+  field->set_name("root");
+  field->set_number(1);
+  field->set_type(gpb::FieldDescriptorProto::TYPE_MESSAGE);
+  field->set_type_name("Node");
+  msg = file->add_message_type();
+  msg->set_name("Leaf");
+  field = msg->add_field();
+  field->set_name("value");
+  field->set_number(1);
+  field->set_type(gpb::FieldDescriptorProto::TYPE_INT32);
+  std::string serialized = recursive.SerializeAsString();
+
+  error = pbwire_Error{};
+  EXPECT_EQ(nullptr, pbwire_dynamic_get_plan(serialized.data(),
+                                             serialized.size(), "foo.Tree",
+                                             &error));
+  EXPECT_EQ(PBWIRE_BAD_DESCRIPTOR, error.code);
+  EXPECT_NE(nullptr, strstr(error.msg, "contains itself")) << error.msg;
+  EXPECT_NE(nullptr, pbwire_dynamic_get_plan(serialized.data(),
+                                             serialized.size(), "foo.Leaf",
+                                             &error));
+}
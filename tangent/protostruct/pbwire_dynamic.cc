@@ -0,0 +1,1553 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/protostruct/pbwire_dynamic.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tangent/protostruct/pbwire_internal.h"
+#ifdef PBWIRE_WITH_STATS
+#include "tangent/protostruct/pbwire_stats.h"
+#endif
+
+namespace {
+
+enum WireType : uint8_t {
+  WIRE_VARINT = 0,
+  WIRE_FIXED64 = 1,
+  WIRE_DELIMITED = 2,
+  WIRE_FIXED32 = 5,
+};
+
+// How a value is encoded on the wire
+enum FieldKind : uint8_t {
+  KIND_VARINT,  //< int32, int64, uint32, uint64, bool, enum
+  KIND_ZIGZAG,  //< sint32, sint64
+  KIND_FIXED,   //< fixed32, sfixed32, float, fixed64, sfixed64, double
+  KIND_STRING,
+  KIND_BYTES,
+  KIND_MESSAGE,
+};
+
+enum FieldFlags : uint8_t {
+  FLAG_SIGNED = 0x01,    //< the C storage is a signed integer
+  FLAG_BOOL = 0x02,      //< the C storage is a bool
+  FLAG_SEXT32 = 0x04,    //< the protobuf type is a signed 32 bit integer
+  FLAG_REPEATED = 0x08,  //< the field is an array
+  FLAG_PACKED = 0x10,    //< emit the elements as a single packed field
+};
+
+// Everything needed to parse or emit one field, packed together so that the
+// codec loops only touch one array
+struct FieldCodec {
+  uint32_t number;
+  FieldKind kind;
+  uint8_t wire_type;
+  uint8_t width;  //< size of the protobuf type (4 or 8) for numeric kinds
+  uint8_t flags;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t capacity;
+  int32_t count_offset;
+  uint32_t fixed_index;  //< index of the parse-time count of a fixed size
+                         //  array (one with no count in the image)
+  const pbwire_DynamicPlan* message;
+};
+
+}  // namespace
+
+struct pbwire_DynamicPlan {
+  std::string name;
+  size_t size = 0;
+  size_t align = 1;
+
+  // Number of fixed size arrays, which are counted on the stack while parsing
+  uint32_t num_fixed = 0;
+
+  // Parallel arrays in declaration order
+  std::vector<FieldCodec> codecs;
+  std::vector<std::string> field_names;
+  std::vector<pbwire_DynamicField> fields;
+
+  // One plus the index of the field with a given number, or zero if there is
+  // no such field. Only populated if the field numbers are reasonably dense.
+  std::vector<uint16_t> dense_index;
+
+  // Field indices sorted by field number, for lookups beyond dense_index
+  std::vector<uint32_t> sorted_index;
+
+#ifdef PBWIRE_WITH_STATS
+  mutable pbwire_StatsType stats_type{};
+#endif
+
+  const FieldCodec* lookup(uint64_t number) const {
+    if (number < dense_index.size()) {
+      uint16_t idx = dense_index[number];
+      return idx ? &codecs[idx - 1] : nullptr;
+    }
+    auto iter = std::lower_bound(
+        sorted_index.begin(), sorted_index.end(), number,
+        [this](uint32_t idx, uint64_t query) {
+          return codecs[idx].number < query;
+        });
+    if (iter != sorted_index.end() && codecs[*iter].number == number) {
+      return &codecs[*iter];
+    }
+    return nullptr;
+  }
+};
+
+namespace {
+
+/* ========================== Descriptor Decoding =========================== */
+// The descriptor set is decoded with pbwire itself so that the dynamic codec
+// does not pull libprotobuf into libpbwire. Only the parts of
+// descriptor.proto (and the protostruct extensions) which affect the layout
+// are retained.
+
+// Field number of the protostruct extensions in descriptor_extensions.proto
+constexpr uint32_t kProtostructExtension = 83111;
+
+// Iterates over the fields of a serialized message
+class WireReader {
+ public:
+  WireReader(const char* begin, const char* end, pbwire_Error* error) {
+    ctx_.error = error;
+    pbwire_readbuffer_init(&ctx_.buffer, begin, end);
+  }
+
+  // Advance to the next field. Return false at the end of the message or if
+  // the message is malformed, in which case failed() is true.
+  bool next() {
+    if (failed_ || ctx_.buffer.ptr >= ctx_.buffer.end) {
+      return false;
+    }
+    uint64_t tag = 0;
+    int bytes_read = pbwire_parse_varint64(&ctx_, &tag);
+    if (bytes_read < 0) {
+      return fail();
+    }
+    ctx_.buffer.ptr += bytes_read;
+    number_ = tag >> 3;
+    wire_type_ = tag & 0x7;
+
+    size_t length = 0;
+    switch (wire_type_) {
+      case WIRE_VARINT:
+        bytes_read = pbwire_parse_varint64(&ctx_, &varint_);
+        if (bytes_read < 0) {
+          return fail();
+        }
+        ctx_.buffer.ptr += bytes_read;
+        return true;
+      case WIRE_FIXED64:
+        length = 8;
+        break;
+      case WIRE_FIXED32:
+        length = 4;
+        break;
+      case WIRE_DELIMITED:
+        bytes_read = pbwire_parse_varint64(&ctx_, &varint_);
+        if (bytes_read < 0) {
+          return fail();
+        }
+        ctx_.buffer.ptr += bytes_read;
+        length = varint_;
+        break;
+      default:
+        pbwire_error(ctx_.error, PBWIRE_BAD_DESCRIPTOR)
+            << "unsupported wire type " << wire_type_ << " for field "
+            << number_;
+        return fail();
+    }
+
+    if (length > static_cast<size_t>(ctx_.buffer.end - ctx_.buffer.ptr)) {
+      pbwire_error(ctx_.error, PBWIRE_DELIMIT_OVERFLOW)
+          << "field " << number_ << " has length " << length << " but only "
+          << (ctx_.buffer.end - ctx_.buffer.ptr) << " bytes remain";
+      return fail();
+    }
+    begin_ = ctx_.buffer.ptr;
+    end_ = begin_ + length;
+    ctx_.buffer.ptr = end_;
+    return true;
+  }
+
+  bool failed() const {
+    return failed_;
+  }
+
+  uint64_t number() const {
+    return number_;
+  }
+
+  // Return true if the current field has the given number and is length
+  // delimited
+  bool is_delimited(uint64_t number) const {
+    return number_ == number && wire_type_ == WIRE_DELIMITED;
+  }
+
+  // Return true if the current field has the given number and is a varint
+  bool is_varint(uint64_t number) const {
+    return number_ == number && wire_type_ == WIRE_VARINT;
+  }
+
+  uint64_t varint() const {
+    return varint_;
+  }
+
+  std::string str() const {
+    return std::string(begin_, end_);
+  }
+
+  // Return a reader over the payload of the current (length delimited) field
+  WireReader sub() const {
+    return WireReader(begin_, end_, ctx_.error);
+  }
+
+ private:
+  bool fail() {
+    failed_ = true;
+    return false;
+  }
+
+  pbwire_ParseContext ctx_{};
+  bool failed_ = false;
+  uint64_t number_ = 0;
+  uint32_t wire_type_ = 0;
+  uint64_t varint_ = 0;
+  const char* begin_ = nullptr;
+  const char* end_ = nullptr;
+};
+
+// google.protobuf.FieldDescriptorProto.Type
+enum ProtoType {
+  TYPE_DOUBLE = 1,
+  TYPE_FLOAT = 2,
+  TYPE_INT64 = 3,
+  TYPE_UINT64 = 4,
+  TYPE_INT32 = 5,
+  TYPE_FIXED64 = 6,
+  TYPE_FIXED32 = 7,
+  TYPE_BOOL = 8,
+  TYPE_STRING = 9,
+  TYPE_GROUP = 10,
+  TYPE_MESSAGE = 11,
+  TYPE_BYTES = 12,
+  TYPE_UINT32 = 13,
+  TYPE_ENUM = 14,
+  TYPE_SFIXED32 = 15,
+  TYPE_SFIXED64 = 16,
+  TYPE_SINT32 = 17,
+  TYPE_SINT64 = 18,
+};
+
+constexpr uint64_t kLabelRepeated = 3;
+
+struct FileInfo {
+  bool proto3 = false;
+  std::map<std::string, int64_t> capacity_macros;
+};
+
+struct FieldInfo {
+  std::string name;
+  uint32_t number = 0;
+  uint64_t label = 0;
+  uint64_t type = 0;
+  std::string type_name;
+  bool has_packed = false;
+  bool packed = false;
+  std::string fieldtype;
+  std::string lenfield;
+  int64_t capacity = -1;
+  std::string capname;
+  int64_t alignment = 0;
+};
+
+struct MessageInfo {
+  std::string name;  //< fully qualified, without the leading dot
+  const FileInfo* file = nullptr;
+  std::vector<FieldInfo> fields;
+};
+
+struct DescriptorSetInfo {
+  std::vector<std::unique_ptr<FileInfo>> files;
+  std::map<std::string, MessageInfo> messages;
+  std::set<std::string> enums;
+};
+
+std::string join_name(const std::string& scope, const std::string& name) {
+  return scope.empty() ? name : scope + "." + name;
+}
+
+bool parse_field_options(WireReader reader, FieldInfo* field) {
+  while (reader.next()) {
+    if (reader.is_varint(2)) {
+      field->has_packed = true;
+      field->packed = reader.varint() != 0;
+    } else if (reader.is_delimited(kProtostructExtension)) {
+      WireReader ext = reader.sub();
+      while (ext.next()) {
+        if (ext.is_delimited(2)) {
+          field->fieldtype = ext.str();
+        } else if (ext.is_delimited(3)) {
+          field->lenfield = ext.str();
+        } else if (ext.is_varint(4)) {
+          field->capacity = static_cast<int64_t>(ext.varint());
+        } else if (ext.is_delimited(5)) {
+          field->capname = ext.str();
+        } else if (ext.is_varint(6)) {
+          field->alignment = static_cast<int64_t>(ext.varint());
+        }
+      }
+      if (ext.failed()) {
+        return false;
+      }
+    }
+  }
+  return !reader.failed();
+}
+
+bool parse_field(WireReader reader, FieldInfo* field) {
+  while (reader.next()) {
+    if (reader.is_delimited(1)) {
+      field->name = reader.str();
+    } else if (reader.is_varint(3)) {
+      field->number = reader.varint();
+    } else if (reader.is_varint(4)) {
+      field->label = reader.varint();
+    } else if (reader.is_varint(5)) {
+      field->type = reader.varint();
+    } else if (reader.is_delimited(6)) {
+      field->type_name = reader.str();
+    } else if (reader.is_delimited(8)) {
+      if (!parse_field_options(reader.sub(), field)) {
+        return false;
+      }
+    }
+  }
+  return !reader.failed();
+}
+
+bool parse_enum_name(WireReader reader, std::string* name) {
+  while (reader.next()) {
+    if (reader.is_delimited(1)) {
+      *name = reader.str();
+    }
+  }
+  return !reader.failed();
+}
+
+bool parse_message_type(WireReader reader, const std::string& scope,
+                        const FileInfo* file, DescriptorSetInfo* out) {
+  MessageInfo message{};
+  message.file = file;
+  // Nested types are parsed after the name is known, which it always is in
+  // practice since name is field 1
+  while (reader.next()) {
+    if (reader.is_delimited(1)) {
+      message.name = join_name(scope, reader.str());
+    } else if (reader.is_delimited(2)) {
+      message.fields.emplace_back();
+      if (!parse_field(reader.sub(), &message.fields.back())) {
+        return false;
+      }
+    } else if (reader.is_delimited(3)) {
+      if (!parse_message_type(reader.sub(), message.name, file, out)) {
+        return false;
+      }
+    } else if (reader.is_delimited(4)) {
+      std::string name;
+      if (!parse_enum_name(reader.sub(), &name)) {
+        return false;
+      }
+      out->enums.insert(join_name(message.name, name));
+    }
+  }
+  if (reader.failed()) {
+    return false;
+  }
+  std::string name = message.name;
+  out->messages[name] = std::move(message);
+  return true;
+}
+
+// Parse a capacity macro definition of the form "NAME VALUE"
+void parse_capacity_macro(const std::string& macro, FileInfo* file) {
+  size_t split = macro.find_first_of(" \t");
+  if (split == std::string::npos) {
+    return;
+  }
+  std::string name = macro.substr(0, split);
+  const char* value_str = macro.c_str() + split;
+  char* end = nullptr;
+  int64_t value = strtoll(value_str, &end, 0);
+  if (end != value_str) {
+    file->capacity_macros[name] = value;
+  }
+}
+
+bool parse_file_options(WireReader reader, FileInfo* file) {
+  while (reader.next()) {
+    if (reader.is_delimited(kProtostructExtension)) {
+      WireReader ext = reader.sub();
+      while (ext.next()) {
+        if (ext.is_delimited(2)) {
+          parse_capacity_macro(ext.str(), file);
+        }
+      }
+      if (ext.failed()) {
+        return false;
+      }
+    }
+  }
+  return !reader.failed();
+}
+
+bool parse_file(WireReader reader, DescriptorSetInfo* out) {
+  out->files.emplace_back(new FileInfo{});
+  FileInfo* file = out->files.back().get();
+
+  // Fields are serialized in field number order, so the package (2) is known
+  // before any message types (4) are encountered. The options (8) and syntax
+  // (12) are filled into `file` after the messages which refer to it.
+  std::string package;
+  while (reader.next()) {
+    if (reader.is_delimited(2)) {
+      package = reader.str();
+    } else if (reader.is_delimited(4)) {
+      if (!parse_message_type(reader.sub(), package, file, out)) {
+        return false;
+      }
+    } else if (reader.is_delimited(5)) {
+      std::string name;
+      if (!parse_enum_name(reader.sub(), &name)) {
+        return false;
+      }
+      out->enums.insert(join_name(package, name));
+    } else if (reader.is_delimited(8)) {
+      if (!parse_file_options(reader.sub(), file)) {
+        return false;
+      }
+    } else if (reader.is_delimited(12)) {
+      file->proto3 = (reader.str() == "proto3");
+    }
+  }
+  return !reader.failed();
+}
+
+/* ============================ Plan Compilation ============================ */
+
+struct CType {
+  const char* name;
+  uint8_t size;
+  uint8_t flags;
+  bool is_float;
+};
+
+const CType kCTypes[] = {
+    {"bool", 1, FLAG_BOOL, false},       {"char", 1, FLAG_SIGNED, false},
+    {"int8_t", 1, FLAG_SIGNED, false},   {"uint8_t", 1, 0, false},
+    {"int16_t", 2, FLAG_SIGNED, false},  {"uint16_t", 2, 0, false},
+    {"int32_t", 4, FLAG_SIGNED, false},  {"uint32_t", 4, 0, false},
+    {"int64_t", 8, FLAG_SIGNED, false},  {"uint64_t", 8, 0, false},
+    {"float", 4, 0, true},               {"double", 8, 0, true},
+};
+
+const CType* find_ctype(const std::string& name) {
+  for (const CType& ctype : kCTypes) {
+    if (name == ctype.name) {
+      return &ctype;
+    }
+  }
+  return nullptr;
+}
+
+// Fill in the wire encoding and default C storage of a field of the given
+// protobuf type. Return the name of the default C type, or NULL if the type
+// is not a scalar.
+const char* get_scalar_codec(uint64_t type, FieldCodec* codec) {
+  switch (type) {
+    case TYPE_DOUBLE:
+      codec->kind = KIND_FIXED;
+      codec->width = 8;
+      return "double";
+    case TYPE_FLOAT:
+      codec->kind = KIND_FIXED;
+      codec->width = 4;
+      return "float";
+    case TYPE_INT64:
+      codec->kind = KIND_VARINT;
+      codec->width = 8;
+      return "int64_t";
+    case TYPE_UINT64:
+      codec->kind = KIND_VARINT;
+      codec->width = 8;
+      return "uint64_t";
+    case TYPE_INT32:
+      codec->kind = KIND_VARINT;
+      codec->width = 4;
+      codec->flags |= FLAG_SEXT32;
+      return "int32_t";
+    case TYPE_FIXED64:
+      codec->kind = KIND_FIXED;
+      codec->width = 8;
+      return "uint64_t";
+    case TYPE_FIXED32:
+      codec->kind = KIND_FIXED;
+      codec->width = 4;
+      return "uint32_t";
+    case TYPE_BOOL:
+      codec->kind = KIND_VARINT;
+      codec->width = 4;
+      return "bool";
+    case TYPE_UINT32:
+      codec->kind = KIND_VARINT;
+      codec->width = 4;
+      return "uint32_t";
+    case TYPE_ENUM:
+      codec->kind = KIND_VARINT;
+      codec->width = 4;
+      codec->flags |= FLAG_SEXT32;
+      return "int32_t";
+    case TYPE_SFIXED32:
+      codec->kind = KIND_FIXED;
+      codec->width = 4;
+      codec->flags |= FLAG_SEXT32;
+      return "int32_t";
+    case TYPE_SFIXED64:
+      codec->kind = KIND_FIXED;
+      codec->width = 8;
+      return "int64_t";
+    case TYPE_SINT32:
+      codec->kind = KIND_ZIGZAG;
+      codec->width = 4;
+      return "int32_t";
+    case TYPE_SINT64:
+      codec->kind = KIND_ZIGZAG;
+      codec->width = 8;
+      return "int64_t";
+  }
+  return nullptr;
+}
+
+uint8_t get_wire_type(FieldKind kind, uint8_t width) {
+  switch (kind) {
+    case KIND_VARINT:
+    case KIND_ZIGZAG:
+      return WIRE_VARINT;
+    case KIND_FIXED:
+      return width == 4 ? WIRE_FIXED32 : WIRE_FIXED64;
+    default:
+      return WIRE_DELIMITED;
+  }
+}
+
+size_t align_up(size_t offset, size_t align) {
+  return (offset + align - 1) / align * align;
+}
+
+// The compiled plans for one descriptor set
+struct PlanSet {
+  std::string fdset;
+
+  // If the descriptor set itself could not be parsed
+  pbwire_ErrorCode error_code = PBWIRE_NOERROR;
+  std::string error;
+
+  // Plans for each message which could be compiled, by fully qualified name
+  std::map<std::string, std::unique_ptr<pbwire_DynamicPlan>> plans;
+
+  // Reason each message which could not be compiled was rejected
+  std::map<std::string, std::string> errors;
+};
+
+class Compiler {
+ public:
+  Compiler(const DescriptorSetInfo& info, PlanSet* out)
+      : info_(info), out_(out) {}
+
+  // Compile the plan for the named message and any message types it
+  // contains. Return NULL if the message cannot be laid out, in which case
+  // the reason is recorded in `out->errors`.
+  const pbwire_DynamicPlan* compile(const std::string& name) {
+    auto plan_iter = out_->plans.find(name);
+    if (plan_iter != out_->plans.end()) {
+      return plan_iter->second.get();
+    }
+    if (out_->errors.count(name)) {
+      return nullptr;
+    }
+    if (visiting_.count(name)) {
+      out_->errors[name] = "message " + name + " contains itself";
+      return nullptr;
+    }
+
+    visiting_.insert(name);
+    std::unique_ptr<pbwire_DynamicPlan> plan{new pbwire_DynamicPlan{}};
+    std::string error;
+    bool ok = layout(info_.messages.at(name), plan.get(), &error);
+    visiting_.erase(name);
+
+    if (!ok) {
+      // The error may already be recorded if the message contains itself
+      out_->errors.emplace(name, error);
+      return nullptr;
+    }
+    const pbwire_DynamicPlan* result = plan.get();
+    out_->plans[name] = std::move(plan);
+    return result;
+  }
+
+ private:
+  // Resolve a (possibly relative) type name referenced from `scope` to the
+  // fully qualified name of a message or enum
+  std::string resolve(const std::string& scope, const std::string& type_name) {
+    if (!type_name.empty() && type_name[0] == '.') {
+      return type_name.substr(1);
+    }
+    std::string prefix = scope;
+    while (true) {
+      std::string candidate = join_name(prefix, type_name);
+      if (info_.messages.count(candidate) || info_.enums.count(candidate)) {
+        return candidate;
+      }
+      if (prefix.empty()) {
+        return type_name;
+      }
+      size_t split = prefix.rfind('.');
+      prefix = (split == std::string::npos) ? "" : prefix.substr(0, split);
+    }
+  }
+
+  bool layout_field(const MessageInfo& message, const FieldInfo& field,
+                    FieldCodec* codec, size_t* align, std::string* error) {
+    codec->number = field.number;
+    codec->count_offset = -1;
+    codec->capacity = 1;
+    if (field.label == kLabelRepeated) {
+      codec->flags |= FLAG_REPEATED;
+    }
+
+    uint64_t type = field.type;
+    std::string type_name;
+    if (!field.type_name.empty()) {
+      type_name = resolve(message.name, field.type_name);
+      if (!type) {
+        type = info_.messages.count(type_name) ? TYPE_MESSAGE : TYPE_ENUM;
+      }
+    }
+
+    bool needs_capacity = (codec->flags & FLAG_REPEATED);
+    const char* default_ctype = get_scalar_codec(type, codec);
+    if (default_ctype) {
+      std::string ctype_name =
+          field.fieldtype.empty() ? default_ctype : field.fieldtype;
+      const CType* ctype = find_ctype(ctype_name);
+      if (!ctype) {
+        *error = "unsupported fieldtype '" + ctype_name + "'";
+        return false;
+      }
+      bool is_float = (type == TYPE_FLOAT || type == TYPE_DOUBLE);
+      if (ctype->is_float != is_float ||
+          (is_float && ctype->size != codec->width)) {
+        *error = "fieldtype '" + ctype_name + "' does not match the type";
+        return false;
+      }
+      codec->size = ctype->size;
+      codec->flags |= ctype->flags;
+      *align = ctype->size;
+      if (codec->flags & FLAG_REPEATED) {
+        bool packed = field.has_packed ? field.packed : message.file->proto3;
+        if (packed) {
+          codec->flags |= FLAG_PACKED;
+        }
+      }
+    } else if (type == TYPE_STRING || type == TYPE_BYTES) {
+      if (codec->flags & FLAG_REPEATED) {
+        *error = "repeated string and bytes fields are not supported";
+        return false;
+      }
+      codec->kind = (type == TYPE_STRING) ? KIND_STRING : KIND_BYTES;
+      codec->size = 1;
+      *align = 1;
+      needs_capacity = true;
+    } else if (type == TYPE_MESSAGE) {
+      if (!info_.messages.count(type_name)) {
+        *error = "unknown message type '" + field.type_name + "'";
+        return false;
+      }
+      codec->kind = KIND_MESSAGE;
+      codec->message = compile(type_name);
+      if (!codec->message) {
+        *error = "message " + type_name + ": " + out_->errors[type_name];
+        return false;
+      }
+      codec->size = codec->message->size;
+      *align = codec->message->align;
+    } else {
+      *error = "unsupported field type " + std::to_string(type);
+      return false;
+    }
+    codec->wire_type = get_wire_type(codec->kind, codec->width);
+
+    if (needs_capacity) {
+      int64_t capacity = field.capacity;
+      if (capacity < 0 && !field.capname.empty()) {
+        auto iter = message.file->capacity_macros.find(field.capname);
+        if (iter != message.file->capacity_macros.end()) {
+          capacity = iter->second;
+        }
+      }
+      if (capacity <= 0 || capacity > (1 << 24)) {
+        *error = "missing or invalid capacity";
+        return false;
+      }
+      codec->capacity = capacity;
+    }
+
+    if (field.alignment) {
+      // alignas() on the field
+      if (field.alignment < 0 || field.alignment > 4096 ||
+          (field.alignment & (field.alignment - 1))) {
+        *error = "invalid alignment " + std::to_string(field.alignment);
+        return false;
+      }
+      *align = std::max<size_t>(*align, field.alignment);
+    }
+    return true;
+  }
+
+  bool layout(const MessageInfo& message, pbwire_DynamicPlan* plan,
+              std::string* error) {
+    plan->name = message.name;
+    plan->codecs.reserve(message.fields.size());
+    plan->field_names.reserve(message.fields.size());
+
+    size_t offset = 0;
+    for (const FieldInfo& field : message.fields) {
+      FieldCodec codec{};
+      size_t align = 1;
+      if (!layout_field(message, field, &codec, &align, error)) {
+        *error = "field " + field.name + ": " + *error;
+        return false;
+      }
+
+      offset = align_up(offset, align);
+      codec.offset = offset;
+      offset += static_cast<size_t>(codec.size) * codec.capacity;
+      plan->align = std::max(plan->align, align);
+
+      // The count of a repeated field is the `lenfield` which follows it. A
+      // repeated field without one is a fixed size array.
+      bool is_repeated = (codec.flags & FLAG_REPEATED);
+      if ((is_repeated && !field.lenfield.empty()) ||
+          codec.kind == KIND_BYTES) {
+        offset = align_up(offset, alignof(uint32_t));
+        codec.count_offset = offset;
+        offset += sizeof(uint32_t);
+        plan->align = std::max(plan->align, alignof(uint32_t));
+      } else if (is_repeated) {
+        codec.fixed_index = plan->num_fixed++;
+      }
+      if (offset > INT32_MAX) {
+        *error = "message is too large";
+        return false;
+      }
+
+      plan->codecs.push_back(codec);
+      plan->field_names.push_back(field.name);
+    }
+    plan->size = align_up(offset, plan->align);
+
+    uint32_t max_number = 0;
+    for (size_t idx = 0; idx < plan->codecs.size(); idx++) {
+      const FieldCodec& codec = plan->codecs[idx];
+      max_number = std::max(max_number, codec.number);
+      pbwire_DynamicField field{};
+      field.name = plan->field_names[idx].c_str();
+      field.number = codec.number;
+      field.offset = codec.offset;
+      field.size = codec.size;
+      field.capacity = codec.capacity;
+      field.count_offset = codec.count_offset;
+      field.message = codec.message;
+      plan->fields.push_back(field);
+      plan->sorted_index.push_back(idx);
+    }
+
+    std::sort(plan->sorted_index.begin(), plan->sorted_index.end(),
+              [plan](uint32_t lhs, uint32_t rhs) {
+                return plan->codecs[lhs].number < plan->codecs[rhs].number;
+              });
+    if (max_number < 256 || max_number < 8 * plan->codecs.size()) {
+      plan->dense_index.resize(max_number + 1, 0);
+      for (size_t idx = 0; idx < plan->codecs.size(); idx++) {
+        plan->dense_index[plan->codecs[idx].number] = idx + 1;
+      }
+    }
+
+#ifdef PBWIRE_WITH_STATS
+    plan->stats_type.name = plan->name.c_str();
+#endif
+    return true;
+  }
+
+  const DescriptorSetInfo& info_;
+  PlanSet* out_;
+  std::set<std::string> visiting_;
+};
+
+std::unique_ptr<PlanSet> compile_set(const char* fdset, size_t fdset_len) {
+  std::unique_ptr<PlanSet> out{new PlanSet{}};
+  out->fdset.assign(fdset, fdset_len);
+
+  pbwire_Error error{};
+  DescriptorSetInfo info{};
+  WireReader reader{fdset, fdset + fdset_len, &error};
+  while (reader.next()) {
+    if (reader.is_delimited(1) && !parse_file(reader.sub(), &info)) {
+      break;
+    }
+  }
+  if (error.code != PBWIRE_NOERROR) {
+    out->error_code = error.code;
+    out->error = std::string("failed to parse descriptor set: ") + error.msg;
+    return out;
+  }
+
+  Compiler compiler{info, out.get()};
+  for (const auto& pair : info.messages) {
+    compiler.compile(pair.first);
+  }
+  return out;
+}
+
+/* =============================== Plan Cache =============================== */
+
+// 64-bit FNV-1a
+uint64_t get_fingerprint(const char* data, size_t len) {
+  uint64_t digest = 0xcbf29ce484222325ull;
+  for (size_t idx = 0; idx < len; idx++) {
+    digest = (digest ^ static_cast<uint8_t>(data[idx])) * 0x100000001b3ull;
+  }
+  return digest;
+}
+
+struct PlanCache {
+  std::shared_mutex mutex;
+  std::unordered_multimap<uint64_t, std::unique_ptr<PlanSet>> sets;
+
+  // Return the plans compiled from `fdset` or NULL if it has not been seen.
+  // The caller must hold `mutex`.
+  const PlanSet* find(uint64_t fingerprint, const char* fdset,
+                      size_t fdset_len) const {
+    auto range = sets.equal_range(fingerprint);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+      const std::string& other = iter->second->fdset;
+      if (other.size() == fdset_len &&
+          memcmp(other.data(), fdset, fdset_len) == 0) {
+        return iter->second.get();
+      }
+    }
+    return nullptr;
+  }
+};
+
+// NOTE(josh): intentionally leaked so that plans handed out to other threads
+// remain valid during process shutdown.
+PlanCache* get_cache() {
+  static PlanCache* cache = new PlanCache{};
+  return cache;
+}
+
+const pbwire_DynamicPlan* get_plan(const PlanSet* set, const char* name,
+                                   pbwire_Error* error) {
+  if (set->error_code != PBWIRE_NOERROR) {
+    pbwire_error(error, set->error_code) << set->error;
+    return nullptr;
+  }
+  if (name[0] == '.') {
+    name++;
+  }
+  auto iter = set->plans.find(name);
+  if (iter != set->plans.end()) {
+    return iter->second.get();
+  }
+  auto error_iter = set->errors.find(name);
+  if (error_iter != set->errors.end()) {
+    pbwire_error(error, PBWIRE_BAD_DESCRIPTOR)
+        << "message " << name << ": " << error_iter->second;
+  } else {
+    pbwire_error(error, PBWIRE_BAD_DESCRIPTOR)
+        << "no message named " << name << " in the descriptor set";
+  }
+  return nullptr;
+}
+
+/* ================================ Parsing ================================= */
+
+inline int read_varint(pbwire_ParseContext* ctx, uint64_t* value) {
+  // Fast path for single byte varints (most tags and small values)
+  if (ctx->buffer.ptr < ctx->buffer.end && !(*ctx->buffer.ptr & 0x80)) {
+    *value = static_cast<uint8_t>(*ctx->buffer.ptr++);
+    return 1;
+  }
+  int bytes_read = pbwire_parse_varint64(ctx, value);
+  if (bytes_read > 0) {
+    ctx->buffer.ptr += bytes_read;
+  }
+  return bytes_read;
+}
+
+// Read the length prefix of a delimited field and check that the payload is
+// contained in the buffer
+inline int read_length(pbwire_ParseContext* ctx, size_t* length) {
+  uint64_t value = 0;
+  if (read_varint(ctx, &value) < 0) {
+    return -1;
+  }
+  if (value > static_cast<uint64_t>(ctx->buffer.end - ctx->buffer.ptr)) {
+    pbwire_error(ctx->error, PBWIRE_DELIMIT_OVERFLOW)
+        << "Read a delmited length of " << value << " but only have "
+        << (ctx->buffer.end - ctx->buffer.ptr) << " bytes left";
+    return -1;
+  }
+  *length = value;
+  return 0;
+}
+
+inline int read_scalar(pbwire_ParseContext* ctx, const FieldCodec& codec,
+                       uint64_t* raw) {
+  if (codec.kind == KIND_FIXED) {
+    if (ctx->buffer.end - ctx->buffer.ptr < codec.width) {
+      pbwire_error(ctx->error, PBWIRE_VALUE_OVERFLOW)
+          << "got " << (ctx->buffer.end - ctx->buffer.ptr)
+          << " bytes while parsing a value that requires "
+          << static_cast<int>(codec.width);
+      return -1;
+    }
+    if (codec.width == 4) {
+      uint32_t value = 0;
+      memcpy(&value, ctx->buffer.ptr, sizeof(value));
+      *raw = value;
+    } else {
+      memcpy(raw, ctx->buffer.ptr, sizeof(*raw));
+    }
+    ctx->buffer.ptr += codec.width;
+  } else if (read_varint(ctx, raw) < 0) {
+    return -1;
+  }
+
+  if (codec.kind == KIND_ZIGZAG) {
+    *raw = (*raw >> 1) ^ -(*raw & 1);
+  } else if (codec.flags & FLAG_SEXT32) {
+    *raw = static_cast<int64_t>(static_cast<int32_t>(*raw));
+  }
+  return 0;
+}
+
+inline void store_scalar(const FieldCodec& codec, uint64_t raw, char* dest) {
+  if (codec.flags & FLAG_BOOL) {
+    bool value = (raw != 0);
+    memcpy(dest, &value, sizeof(value));
+    return;
+  }
+  switch (codec.size) {
+    case 1: {
+      uint8_t value = raw;
+      memcpy(dest, &value, sizeof(value));
+      break;
+    }
+    case 2: {
+      uint16_t value = raw;
+      memcpy(dest, &value, sizeof(value));
+      break;
+    }
+    case 4: {
+      uint32_t value = raw;
+      memcpy(dest, &value, sizeof(value));
+      break;
+    }
+    default:
+      memcpy(dest, &raw, sizeof(raw));
+      break;
+  }
+}
+
+inline uint32_t get_count(const FieldCodec& codec, const char* image) {
+  if (codec.count_offset < 0) {
+    // Every element of a fixed size array is occupied
+    return (codec.flags & FLAG_REPEATED) ? codec.capacity : 1;
+  }
+  uint32_t count = 0;
+  memcpy(&count, image + codec.count_offset, sizeof(count));
+  return std::min(count, codec.capacity);
+}
+
+// Return the storage for the next element of `codec`, or NULL if the array
+// is full. Fixed size arrays are counted in `fixed_counts`, which is local to
+// the message being parsed.
+inline char* next_element(const FieldCodec& codec, char* image,
+                          uint32_t* fixed_counts) {
+  if (!(codec.flags & FLAG_REPEATED)) {
+    return image + codec.offset;
+  }
+  uint32_t count = 0;
+  if (codec.count_offset < 0) {
+    count = fixed_counts[codec.fixed_index];
+  } else {
+    memcpy(&count, image + codec.count_offset, sizeof(count));
+  }
+  if (count >= codec.capacity) {
+    return nullptr;
+  }
+  uint32_t next_count = count + 1;
+  if (codec.count_offset < 0) {
+    fixed_counts[codec.fixed_index] = next_count;
+  } else {
+    memcpy(image + codec.count_offset, &next_count, sizeof(next_count));
+  }
+  return image + codec.offset + static_cast<size_t>(count) * codec.size;
+}
+
+inline void count_truncated(pbwire_ParseContext* ctx) {
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+#else
+  (void)ctx;
+#endif
+}
+
+int parse_message(pbwire_ParseContext* ctx, const pbwire_DynamicPlan* plan,
+                  char* image);
+
+int skip_field(pbwire_ParseContext* ctx, uint32_t wire_type) {
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_count(ctx->stats, PBWIRE_STAT_UNKNOWN_FIELDS, 1);
+#endif
+  size_t length = 0;
+  switch (wire_type) {
+    case WIRE_VARINT: {
+      uint64_t dummy = 0;
+      return read_varint(ctx, &dummy) < 0 ? -1 : 0;
+    }
+    case WIRE_FIXED64:
+      length = 8;
+      break;
+    case WIRE_FIXED32:
+      length = 4;
+      break;
+    case WIRE_DELIMITED:
+      if (read_length(ctx, &length) < 0) {
+        return -1;
+      }
+      break;
+    default:
+      pbwire_error(ctx->error, PBWIRE_NOTIMPLEMENTED)
+          << "unsupported wire type " << wire_type;
+      return -1;
+  }
+  if (static_cast<size_t>(ctx->buffer.end - ctx->buffer.ptr) < length) {
+    pbwire_error(ctx->error, PBWIRE_VALUE_OVERFLOW)
+        << "got " << (ctx->buffer.end - ctx->buffer.ptr)
+        << " bytes while skipping a value that requires " << length;
+    return -1;
+  }
+  ctx->buffer.ptr += length;
+  return 0;
+}
+
+// Parse a packed run of scalars into a repeated field
+int parse_packed(pbwire_ParseContext* ctx, const FieldCodec& codec,
+                 char* image, uint32_t* fixed_counts) {
+  size_t length = 0;
+  if (read_length(ctx, &length) < 0) {
+    return -1;
+  }
+  pbwire_ParseContext sub_ctx = *ctx;
+  sub_ctx.buffer.end = ctx->buffer.ptr + length;
+  uint64_t dropped = 0;
+  while (sub_ctx.buffer.ptr < sub_ctx.buffer.end) {
+    uint64_t raw = 0;
+    if (read_scalar(&sub_ctx, codec, &raw) < 0) {
+      return -1;
+    }
+    char* dest = next_element(codec, image, fixed_counts);
+    if (dest) {
+      store_scalar(codec, raw, dest);
+    } else {
+      dropped++;
+    }
+  }
+  if (dropped) {
+    count_truncated(ctx);
+  }
+  ctx->buffer.ptr = sub_ctx.buffer.end;
+  return 0;
+}
+
+int parse_field(pbwire_ParseContext* ctx, const FieldCodec& codec,
+                uint32_t wire_type, char* image, uint32_t* fixed_counts) {
+  if (wire_type != codec.wire_type) {
+    if (wire_type == WIRE_DELIMITED && (codec.flags & FLAG_REPEATED) &&
+        codec.kind <= KIND_FIXED) {
+      // Parsers must accept both packed and unpacked encodings
+      return parse_packed(ctx, codec, image, fixed_counts);
+    }
+    return skip_field(ctx, wire_type);
+  }
+
+  switch (codec.kind) {
+    case KIND_VARINT:
+    case KIND_ZIGZAG:
+    case KIND_FIXED: {
+      uint64_t raw = 0;
+      if (read_scalar(ctx, codec, &raw) < 0) {
+        return -1;
+      }
+      char* dest = next_element(codec, image, fixed_counts);
+      if (dest) {
+        store_scalar(codec, raw, dest);
+      } else {
+        count_truncated(ctx);
+      }
+      return 0;
+    }
+
+    case KIND_STRING:
+    case KIND_BYTES: {
+      size_t length = 0;
+      if (read_length(ctx, &length) < 0) {
+        return -1;
+      }
+      char* dest = image + codec.offset;
+      size_t ncopy = codec.capacity;
+      if (codec.kind == KIND_STRING) {
+        // leave room for the terminating null
+        ncopy--;
+      }
+      ncopy = std::min(ncopy, length);
+      memcpy(dest, ctx->buffer.ptr, ncopy);
+      if (codec.kind == KIND_STRING) {
+        dest[ncopy] = '\0';
+      } else {
+        uint32_t count = ncopy;
+        memcpy(image + codec.count_offset, &count, sizeof(count));
+      }
+#ifdef PBWIRE_WITH_STATS
+      if (ncopy < length) {
+        pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_STRINGS, 1);
+      }
+#endif
+      ctx->buffer.ptr += length;
+      return 0;
+    }
+
+    case KIND_MESSAGE: {
+      size_t length = 0;
+      if (read_length(ctx, &length) < 0) {
+        return -1;
+      }
+      char* dest = next_element(codec, image, fixed_counts);
+      if (dest) {
+        pbwire_ParseContext sub_ctx = *ctx;
+        sub_ctx.buffer.begin = ctx->buffer.ptr;
+        sub_ctx.buffer.end = ctx->buffer.ptr + length;
+        if (parse_message(&sub_ctx, codec.message, dest) < 0) {
+          return -1;
+        }
+      } else {
+        count_truncated(ctx);
+      }
+      ctx->buffer.ptr += length;
+      return 0;
+    }
+  }
+  return 0;
+}
+
+int parse_message(pbwire_ParseContext* ctx, const pbwire_DynamicPlan* plan,
+                  char* image) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &plan->stats_type);
+#endif
+  // Messages rarely have more than a few fixed size arrays, so their counts
+  // live on the stack
+  uint32_t local_counts[8] = {};
+  std::vector<uint32_t> heap_counts;
+  uint32_t* fixed_counts = local_counts;
+  if (plan->num_fixed > 8) {
+    heap_counts.resize(plan->num_fixed);
+    fixed_counts = heap_counts.data();
+  }
+
+  const char* begin = ctx->buffer.ptr;
+  int result = 0;
+  while (ctx->buffer.ptr < ctx->buffer.end) {
+    uint64_t tag = 0;
+    if (read_varint(ctx, &tag) < 0) {
+      result = -1;
+      break;
+    }
+    const FieldCodec* codec = plan->lookup(tag >> 3);
+    uint32_t wire_type = tag & 0x7;
+    result = codec ? parse_field(ctx, *codec, wire_type, image, fixed_counts)
+                   : skip_field(ctx, wire_type);
+    if (result < 0) {
+      break;
+    }
+  }
+  if (result >= 0) {
+    result = ctx->buffer.ptr - begin;
+  }
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, result,
+                    ctx->error);
+#endif
+  return result;
+}
+
+/* ================================ Emitting ================================ */
+// Emitting takes two passes, as with the generated code. The first pass
+// computes the encoded size of each packed field and nested message (in
+// pre-order) and records them in the length cache. Once the total size is
+// known to fit in the buffer, the second pass writes the message without any
+// further bounds checks.
+
+inline size_t varint_size(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+inline char* write_varint(char* out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<char>(value);
+  return out;
+}
+
+inline uint64_t load_scalar(const FieldCodec& codec, const char* src) {
+  if (codec.flags & FLAG_BOOL) {
+    bool value = false;
+    memcpy(&value, src, sizeof(value));
+    return value;
+  }
+  bool is_signed = (codec.flags & FLAG_SIGNED);
+  switch (codec.size) {
+    case 1: {
+      uint8_t value = 0;
+      memcpy(&value, src, sizeof(value));
+      return is_signed ? static_cast<int64_t>(static_cast<int8_t>(value))
+                       : value;
+    }
+    case 2: {
+      uint16_t value = 0;
+      memcpy(&value, src, sizeof(value));
+      return is_signed ? static_cast<int64_t>(static_cast<int16_t>(value))
+                       : value;
+    }
+    case 4: {
+      uint32_t value = 0;
+      memcpy(&value, src, sizeof(value));
+      return is_signed ? static_cast<int64_t>(static_cast<int32_t>(value))
+                       : value;
+    }
+    default: {
+      uint64_t value = 0;
+      memcpy(&value, src, sizeof(value));
+      return value;
+    }
+  }
+}
+
+// Return the value which is written to the wire (as a varint, or the low
+// `width` bytes for fixed fields)
+inline uint64_t encode_scalar(const FieldCodec& codec, const char* src) {
+  uint64_t raw = load_scalar(codec, src);
+  switch (codec.kind) {
+    case KIND_VARINT:
+      // NOTE(josh): 32 bit values are written as (at most) five bytes, the
+      // same as the generated pbemit_int32(). Protobuf parsers truncate to
+      // 32 bits so this is equivalent to the ten byte encoding.
+      return codec.width == 4 ? static_cast<uint32_t>(raw) : raw;
+    case KIND_ZIGZAG: {
+      int64_t value = (codec.width == 4)
+                          ? static_cast<int32_t>(raw)
+                          : static_cast<int64_t>(raw);
+      return (static_cast<uint64_t>(value) << 1) ^
+             static_cast<uint64_t>(value >> 63);
+    }
+    default:
+      return raw;
+  }
+}
+
+inline size_t scalar_size(const FieldCodec& codec, const char* src) {
+  if (codec.kind == KIND_FIXED) {
+    return codec.width;
+  }
+  return varint_size(encode_scalar(codec, src));
+}
+
+inline char* write_scalar(const FieldCodec& codec, const char* src,
+                          char* out) {
+  uint64_t value = encode_scalar(codec, src);
+  if (codec.kind != KIND_FIXED) {
+    return write_varint(out, value);
+  }
+  if (codec.width == 4) {
+    uint32_t value32 = value;
+    memcpy(out, &value32, sizeof(value32));
+  } else {
+    memcpy(out, &value, sizeof(value));
+  }
+  return out + codec.width;
+}
+
+inline uint32_t* reserve_length(pbwire_EmitContext* ctx) {
+  if (ctx->length_cache.ptr >= ctx->length_cache.end) {
+    pbwire_error(ctx->error, PBWIRE_VALUE_OVERFLOW)
+        << "length cache exhausted after "
+        << (ctx->length_cache.end - ctx->length_cache.begin) << " entries";
+    return nullptr;
+  }
+  return ctx->length_cache.ptr++;
+}
+
+inline size_t get_string_length(const FieldCodec& codec, const char* image) {
+  if (codec.kind == KIND_STRING) {
+    return strnlen(image + codec.offset, codec.capacity);
+  }
+  return get_count(codec, image);
+}
+
+// First pass: return the encoded size of the message, or -1 on error
+int64_t measure_message(pbwire_EmitContext* ctx,
+                        const pbwire_DynamicPlan* plan, const char* image) {
+  int64_t total = 0;
+  for (const FieldCodec& codec : plan->codecs) {
+    const char* base = image + codec.offset;
+    size_t tag_size = varint_size(codec.number << 3);
+    switch (codec.kind) {
+      case KIND_STRING:
+      case KIND_BYTES: {
+        size_t length = get_string_length(codec, image);
+        total += tag_size + varint_size(length) + length;
+        break;
+      }
+
+      case KIND_MESSAGE: {
+        uint32_t count = get_count(codec, image);
+        for (uint32_t idx = 0; idx < count; idx++) {
+          uint32_t* length_slot = reserve_length(ctx);
+          if (!length_slot) {
+            return -1;
+          }
+          int64_t length = measure_message(
+              ctx, codec.message,
+              base + static_cast<size_t>(idx) * codec.size);
+          if (length < 0) {
+            return length;
+          }
+          *length_slot = length;
+          total += tag_size + varint_size(length) + length;
+        }
+        break;
+      }
+
+      default: {
+        uint32_t count = get_count(codec, image);
+        size_t body = 0;
+        for (uint32_t idx = 0; idx < count; idx++) {
+          body += scalar_size(codec, base + idx * codec.size);
+        }
+        if (!(codec.flags & FLAG_PACKED)) {
+          total += count * tag_size + body;
+        } else if (count) {
+          uint32_t* length_slot = reserve_length(ctx);
+          if (!length_slot) {
+            return -1;
+          }
+          *length_slot = body;
+          total += tag_size + varint_size(body) + body;
+        }
+        break;
+      }
+    }
+    if (total > INT32_MAX) {
+      pbwire_error(ctx->error, PBWIRE_VALUE_OVERFLOW)
+          << "message " << plan->name << " is too large to encode";
+      return -1;
+    }
+  }
+  return total;
+}
+
+// Second pass: write the message and return the new end of the buffer
+char* write_message(pbwire_EmitContext* ctx, const pbwire_DynamicPlan* plan,
+                    const char* image, char* out) {
+  for (const FieldCodec& codec : plan->codecs) {
+    const char* base = image + codec.offset;
+    uint32_t tag = (codec.number << 3) | codec.wire_type;
+    switch (codec.kind) {
+      case KIND_STRING:
+      case KIND_BYTES: {
+        size_t length = get_string_length(codec, image);
+        out = write_varint(out, tag);
+        out = write_varint(out, length);
+        memcpy(out, base, length);
+        out += length;
+        break;
+      }
+
+      case KIND_MESSAGE: {
+        uint32_t count = get_count(codec, image);
+        for (uint32_t idx = 0; idx < count; idx++) {
+          uint32_t length = *ctx->length_cache.ptr++;
+          out = write_varint(out, tag);
+          out = write_varint(out, length);
+#ifdef PBWIRE_WITH_STATS
+          int32_t prev_type =
+              pbwire_stats_enter(ctx->stats, &codec.message->stats_type);
+#endif
+          out = write_message(ctx, codec.message,
+                              base + static_cast<size_t>(idx) * codec.size,
+                              out);
+#ifdef PBWIRE_WITH_STATS
+          pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS,
+                            length, ctx->error);
+#endif
+        }
+        break;
+      }
+
+      default: {
+        uint32_t count = get_count(codec, image);
+        if (!(codec.flags & FLAG_PACKED)) {
+          for (uint32_t idx = 0; idx < count; idx++) {
+            out = write_varint(out, tag);
+            out = write_scalar(codec, base + idx * codec.size, out);
+          }
+        } else if (count) {
+          out = write_varint(out, (codec.number << 3) | WIRE_DELIMITED);
+          out = write_varint(out, *ctx->length_cache.ptr++);
+          for (uint32_t idx = 0; idx < count; idx++) {
+            out = write_scalar(codec, base + idx * codec.size, out);
+          }
+        }
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+const pbwire_DynamicPlan* pbwire_dynamic_get_plan(const char* fdset,
+                                                  size_t fdset_len,
+                                                  const char* message_name,
+                                                  pbwire_Error* error) {
+  PlanCache* cache = get_cache();
+  uint64_t fingerprint = get_fingerprint(fdset, fdset_len);
+  {
+    std::shared_lock<std::shared_mutex> lock{cache->mutex};
+    const PlanSet* set = cache->find(fingerprint, fdset, fdset_len);
+    if (set) {
+      return get_plan(set, message_name, error);
+    }
+  }
+
+  // Compile without holding the lock. If another thread compiles the same
+  // descriptor set in the meantime, theirs wins and ours is discarded.
+  std::unique_ptr<PlanSet> compiled = compile_set(fdset, fdset_len);
+  std::unique_lock<std::shared_mutex> lock{cache->mutex};
+  const PlanSet* set = cache->find(fingerprint, fdset, fdset_len);
+  if (!set) {
+    set = compiled.get();
+    cache->sets.emplace(fingerprint, std::move(compiled));
+  }
+  return get_plan(set, message_name, error);
+}
+
+const char* pbwire_dynamic_name(const pbwire_DynamicPlan* plan) {
+  return plan->name.c_str();
+}
+
+size_t pbwire_dynamic_sizeof(const pbwire_DynamicPlan* plan) {
+  return plan->size;
+}
+
+size_t pbwire_dynamic_alignof(const pbwire_DynamicPlan* plan) {
+  return plan->align;
+}
+
+const pbwire_DynamicField* pbwire_dynamic_fields(
+    const pbwire_DynamicPlan* plan, size_t* nfields) {
+  *nfields = plan->fields.size();
+  return plan->fields.data();
+}
+
+const pbwire_DynamicField* pbwire_dynamic_find_field(
+    const pbwire_DynamicPlan* plan, const char* name) {
+  for (const pbwire_DynamicField& field : plan->fields) {
+    if (strcmp(field.name, name) == 0) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+const pbwire_DynamicField* pbwire_dynamic_find_number(
+    const pbwire_DynamicPlan* plan, uint32_t number) {
+  const FieldCodec* codec = plan->lookup(number);
+  if (!codec) {
+    return nullptr;
+  }
+  return &plan->fields[codec - plan->codecs.data()];
+}
+
+int pbwire_dynamic_parse(pbwire_ParseContext* ctx,
+                         const pbwire_DynamicPlan* plan, void* image) {
+  return parse_message(ctx, plan, static_cast<char*>(image));
+}
+
+int pbwire_dynamic_emit(pbwire_EmitContext* ctx,
+                        const pbwire_DynamicPlan* plan, const void* image) {
+  const char* src = static_cast<const char*>(image);
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &plan->stats_type);
+#endif
+  uint32_t* cache_begin = ctx->length_cache.ptr;
+  int64_t size = measure_message(ctx, plan, src);
+  if (size >= 0 && size > ctx->buffer.end - ctx->buffer.ptr) {
+    pbwire_error(ctx->error, PBWIRE_VALUE_OVERFLOW)
+        << "buffer only has " << (ctx->buffer.end - ctx->buffer.ptr)
+        << " bytes left, and need to write " << size;
+    size = -1;
+  }
+  if (size >= 0) {
+    ctx->length_cache.ptr = cache_begin;
+    ctx->buffer.ptr = write_message(ctx, plan, src, ctx->buffer.ptr);
+  }
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, size,
+                    ctx->error);
+#endif
+  return size;
+}
@@ -0,0 +1,114 @@
+#pragma once
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tangent/protostruct/pbwire.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================= Dynamic Codec ============================== */
+// Parse and emit messages whose type is only known at runtime, from a
+// serialized FileDescriptorSet (such as the .pb3 written by `protostruct
+// compile`). The descriptor is compiled once into a "plan" for each message
+// type, which fixes the layout of a C struct "image" of the message and maps
+// each field number to an offset within that image. Parsing and emitting then
+// walk the plan instead of calling generated code.
+//
+// The image is laid out the way the equivalent C struct would be:
+//
+//   * singular fields are stored by value, using the `fieldtype` option if
+//     present, otherwise the natural C type of the protobuf type (enums are
+//     stored as int32_t)
+//   * repeated fields are stored as an array of `capacity` elements. If the
+//     field has a `lenfield` option then the array is followed by a uint32_t
+//     count of occupied elements, otherwise it is a fixed size array and
+//     every element is emitted.
+//   * string fields are stored as a char array of `capacity` bytes, which is
+//     always null terminated
+//   * bytes fields are stored as a uint8_t array of `capacity` bytes followed
+//     by a uint32_t length
+//   * message fields are embedded by value (so recursive types are rejected)
+//   * a field with an `alignment` option (from `alignas()` in the original
+//     header) is aligned to at least that boundary
+//
+// The capacity of a repeated, string, or bytes field comes from the
+// protostruct `capacity` field option, or the file-level `capacity_macros`
+// definition named by `capname`.
+//
+// Plans are cached by a fingerprint of the serialized descriptor set, are
+// immutable once compiled, and live until the process exits, so the returned
+// pointer may be stored and shared freely between threads:
+//
+//   const pbwire_DynamicPlan* plan =
+//       pbwire_dynamic_get_plan(fdset, fdset_len, "foo.Bar", &error);
+//   void* image = calloc(1, pbwire_dynamic_sizeof(plan));
+//   pbwire_dynamic_parse(&ctx, plan, image);
+
+typedef struct pbwire_DynamicPlan pbwire_DynamicPlan;
+
+// Location of one field within the image
+typedef struct pbwire_DynamicField {
+  const char* name;
+  uint32_t number;    //< protobuf field number
+  uint32_t offset;    //< byte offset of the value (or array) in the image
+  uint32_t size;      //< size in bytes of one element
+  uint32_t capacity;  //< number of elements (or bytes, for strings and
+                      //  bytes), 1 for singular fields
+  int32_t count_offset;  //< byte offset of the uint32_t element count (or
+                         //  byte length) or -1 if the field has none
+  const pbwire_DynamicPlan* message;  //< plan of the element type, for
+                                      //  message fields, otherwise NULL
+} pbwire_DynamicField;
+
+// Return the plan for the message named `message_name` (fully qualified,
+// e.g. "foo.Bar") within the serialized FileDescriptorSet `fdset`, compiling
+// and caching the plans for the set if this is the first request for it.
+// Return NULL and fill `error` if the descriptor set cannot be parsed, does
+// not contain the message, or the message cannot be laid out.
+const pbwire_DynamicPlan* pbwire_dynamic_get_plan(const char* fdset,
+                                                  size_t fdset_len,
+                                                  const char* message_name,
+                                                  pbwire_Error* error);
+
+// Return the fully qualified name of the message type
+const char* pbwire_dynamic_name(const pbwire_DynamicPlan* plan);
+
+// Return the size and alignment requirement of an image of the message type
+size_t pbwire_dynamic_sizeof(const pbwire_DynamicPlan* plan);
+size_t pbwire_dynamic_alignof(const pbwire_DynamicPlan* plan);
+
+// Return the fields of the message type in declaration order. The number of
+// fields is written to `nfields`.
+const pbwire_DynamicField* pbwire_dynamic_fields(
+    const pbwire_DynamicPlan* plan, size_t* nfields);
+
+// Return the field with the given name or number, or NULL if there is none
+const pbwire_DynamicField* pbwire_dynamic_find_field(
+    const pbwire_DynamicPlan* plan, const char* name);
+const pbwire_DynamicField* pbwire_dynamic_find_number(
+    const pbwire_DynamicPlan* plan, uint32_t number);
+
+// Parse a serialized message from `ctx->buffer` into `image`, which must be
+// at least pbwire_dynamic_sizeof() bytes, suitably aligned, and initialized
+// (e.g. zeroed). Elements of repeated fields are appended after any which
+// are already counted in the image, while fixed size arrays are filled from
+// the start. Elements beyond the capacity of a field are dropped. Return the
+// number of bytes consumed, or -1 on error.
+int pbwire_dynamic_parse(pbwire_ParseContext* ctx,
+                         const pbwire_DynamicPlan* plan, void* image);
+
+// Serialize `image` into `ctx->buffer`, advancing `ctx->buffer.ptr`. As with
+// the generated pbemit_XXX() functions, `ctx->length_cache` must have room
+// for one entry per packed field and per message value that is emitted.
+// Singular fields are always emitted, as in the generated code.
+// Return the number of bytes written or -1 on error.
+int pbwire_dynamic_emit(pbwire_EmitContext* ctx,
+                        const pbwire_DynamicPlan* plan, const void* image);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+// Implementation details shared between the pbwire translation units. Not
+// installed.
+
+#include "tangent/protostruct/pbwire.h"
+#include "tangent/util/fixed_string_stream.h"
+
+// Set the error code and return a stream to write the error message into
+util::FixedCharStream pbwire_error(pbwire_Error* err, pbwire_ErrorCode code);
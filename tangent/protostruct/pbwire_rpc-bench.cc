@@ -0,0 +1,115 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure requests per second and latency percentiles of the pbwire RPC layer
+// over a unix domain socket, with the server in a separate process.
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "tangent/protostruct/pbwire_rpc.h"
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static int echo_handler(pbwire_ParseContext* request,
+                        pbwire_EmitContext* response, void* /*userdata*/) {
+  size_t len = request->buffer.end - request->buffer.begin;
+  memcpy(response->buffer.ptr, request->buffer.begin, len);
+  return len;
+}
+
+static void check(int result, const pbwire_Error& error) {
+  if (result < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+}
+
+// Issue `count` requests in batches of `depth` and report per-request
+// latency (measured from batch send to response receipt) and throughput.
+static void run(pbwire_RpcClient* client, uint32_t count, uint32_t depth,
+                size_t payload_size) {
+  pbwire_Error error{};
+  std::string payload(payload_size, 'x');
+  std::vector<uint64_t> samples;
+  samples.reserve(count);
+
+  uint64_t begin = now_ns();
+  for (uint32_t done = 0; done < count; done += depth) {
+    uint64_t start = now_ns();
+    for (uint32_t idx = 0; idx < depth; idx++) {
+      pbwire_EmitContext ectx{};
+      pbwire_rpcclient_begin_request(client, &ectx);
+      memcpy(ectx.buffer.ptr, payload.data(), payload.size());
+      pbwire_rpcclient_commit_request(client, &ectx, 1, payload.size());
+    }
+    check(pbwire_rpcclient_flush(client, &error), error);
+
+    pbwire_ParseContext pctx{};
+    pctx.error = &error;
+    for (uint32_t idx = 0; idx < depth; idx++) {
+      uint32_t method_id = 0;
+      check(pbwire_rpcclient_recv(client, &method_id, &pctx), error);
+      samples.push_back(now_ns() - start);
+    }
+  }
+  double elapsed = (now_ns() - begin) * 1e-9;
+
+  std::sort(samples.begin(), samples.end());
+  printf(
+      "depth=%-4u payload=%-5zu %9.0f req/s | p50=%7.2fus p99=%7.2fus "
+      "max=%8.2fus\n",
+      depth, payload_size, samples.size() / elapsed,
+      samples[samples.size() / 2] * 1e-3,
+      samples[samples.size() * 99 / 100] * 1e-3, samples.back() * 1e-3);
+}
+
+int main(int argc, char** argv) {
+  uint32_t count = 100000;
+  if (argc > 1) {
+    count = strtoul(argv[1], nullptr, 10);
+  }
+  std::string path = "/tmp/pbwire_rpc-bench." + std::to_string(getpid());
+
+  pbwire_Error error{};
+  pbwire_RpcMethod methods[] = {{1, echo_handler, nullptr}};
+  pbwire_RpcServer* server = pbwire_rpcserver_new(methods, 1, nullptr, &error);
+  if (!server || pbwire_rpcserver_listen(server, path.c_str(), &error)) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+
+  pid_t child = fork();
+  if (child == 0) {
+    pbwire_rpcserver_run(server, &error);
+    _exit(0);
+  }
+
+  pbwire_RpcClient* client =
+      pbwire_rpcclient_connect(path.c_str(), nullptr, &error);
+  if (!client) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+  for (uint32_t depth : {1u, 16u, 256u}) {
+    for (size_t payload_size : {16u, 1024u}) {
+      run(client, count, depth, payload_size);
+    }
+  }
+
+  pbwire_rpcclient_free(client);
+  kill(child, SIGTERM);
+  waitpid(child, nullptr, 0);
+  pbwire_rpcserver_free(server);
+  unlink(path.c_str());
+  return 0;
+}
@@ -0,0 +1,221 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "tangent/protostruct/pbwire_rpc.h"
+#include "tangent/protostruct/test/test_messages.pbrpc.h"
+
+// Respond with a copy of the request payload
+static int echo_handler(pbwire_ParseContext* request,
+                        pbwire_EmitContext* response, void* userdata) {
+  size_t len = request->buffer.end - request->buffer.begin;
+  memcpy(response->buffer.ptr, request->buffer.begin, len);
+  (*static_cast<int*>(userdata))++;
+  return len;
+}
+
+static int failing_handler(pbwire_ParseContext* /*request*/,
+                           pbwire_EmitContext* response, void* /*userdata*/) {
+  snprintf(response->error->msg, sizeof(response->error->msg), "nope");
+  return -1;
+}
+
+static void queue_raw(pbwire_RpcClient* client, uint32_t method_id,
+                      const std::string& payload) {
+  pbwire_EmitContext ctx{};
+  pbwire_rpcclient_begin_request(client, &ctx);
+  memcpy(ctx.buffer.ptr, payload.data(), payload.size());
+  pbwire_rpcclient_commit_request(client, &ctx, method_id, payload.size());
+}
+
+class RpcTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    pbwire_RpcMethod methods[] = {
+        {1, echo_handler, &echo_count_},
+        {2, failing_handler, nullptr},
+    };
+    server_ = pbwire_rpcserver_new(methods, 2, nullptr, &error_);
+    ASSERT_NE(nullptr, server_) << error_.msg;
+    ASSERT_EQ(0, pbwire_rpcserver_add_connection(server_, fds[0], &error_))
+        << error_.msg;
+    client_ = pbwire_rpcclient_new(fds[1], nullptr, &error_);
+    ASSERT_NE(nullptr, client_) << error_.msg;
+  }
+
+  void TearDown() override {
+    if (client_) {
+      pbwire_rpcclient_free(client_);
+    }
+    if (server_) {
+      pbwire_rpcserver_free(server_);
+    }
+  }
+
+  // Poll the server until it has dispatched `count` requests
+  void serve(int count) {
+    while (count > 0) {
+      int result = pbwire_rpcserver_poll(server_, 1000, &error_);
+      ASSERT_LT(0, result) << error_.msg;
+      count -= result;
+    }
+  }
+
+  pbwire_Error error_{};
+  int echo_count_ = 0;
+  pbwire_RpcServer* server_ = nullptr;
+  pbwire_RpcClient* client_ = nullptr;
+};
+
+TEST_F(RpcTest, PipelinedRequestsAreBatched) {
+  const int kCount = 1000;
+  for (int idx = 0; idx < kCount; idx++) {
+    queue_raw(client_, 1, "request-" + std::to_string(idx));
+  }
+  ASSERT_EQ(0, pbwire_rpcclient_flush(client_, &error_)) << error_.msg;
+  serve(kCount);
+  EXPECT_EQ(kCount, echo_count_);
+
+  pbwire_ParseContext ctx{};
+  ctx.error = &error_;
+  for (int idx = 0; idx < kCount; idx++) {
+    uint32_t method_id = 0;
+    ASSERT_EQ(0, pbwire_rpcclient_recv(client_, &method_id, &ctx))
+        << error_.msg;
+    EXPECT_EQ(1, method_id);
+    EXPECT_EQ("request-" + std::to_string(idx),
+              std::string(ctx.buffer.begin, ctx.buffer.end));
+  }
+
+  // All of the requests should have been consumed with far fewer syscalls
+  // than there are frames
+  pbwire_RpcStats stats{};
+  pbwire_rpcserver_get_stats(server_, &stats);
+  EXPECT_EQ(kCount, stats.frames_in);
+  EXPECT_EQ(kCount, stats.frames_out);
+  EXPECT_LT(stats.read_calls, kCount / 10);
+  EXPECT_LT(stats.write_calls, kCount / 10);
+}
+
+TEST_F(RpcTest, ErrorResponses) {
+  queue_raw(client_, 2, "hello");
+  queue_raw(client_, 99, "hello");
+  queue_raw(client_, 1, "world");
+  ASSERT_EQ(0, pbwire_rpcclient_flush(client_, &error_)) << error_.msg;
+  serve(3);
+
+  pbwire_ParseContext ctx{};
+  ctx.error = &error_;
+  uint32_t method_id = 0;
+  ASSERT_EQ(0, pbwire_rpcclient_recv(client_, &method_id, &ctx));
+  EXPECT_EQ(PBWIRE_RPC_ERROR_METHOD, method_id);
+  EXPECT_EQ("nope", std::string(ctx.buffer.begin, ctx.buffer.end));
+
+  ASSERT_EQ(0, pbwire_rpcclient_recv(client_, &method_id, &ctx));
+  EXPECT_EQ(PBWIRE_RPC_ERROR_METHOD, method_id);
+  EXPECT_EQ("no handler for method 99",
+            std::string(ctx.buffer.begin, ctx.buffer.end));
+
+  ASSERT_EQ(0, pbwire_rpcclient_recv(client_, &method_id, &ctx));
+  EXPECT_EQ(1, method_id);
+  EXPECT_EQ("world", std::string(ctx.buffer.begin, ctx.buffer.end));
+
+  pbwire_RpcStats stats{};
+  pbwire_rpcserver_get_stats(server_, &stats);
+  EXPECT_EQ(2, stats.errors);
+}
+
+TEST_F(RpcTest, MalformedFrameDropsConnection) {
+  // The server notices when the client hangs up
+  pbwire_rpcclient_free(client_);
+  client_ = nullptr;
+  ASSERT_EQ(0, pbwire_rpcserver_poll(server_, 1000, &error_));
+  ASSERT_EQ(0, pbwire_rpcserver_connection_count(server_));
+
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT_EQ(0, pbwire_rpcserver_add_connection(server_, fds[0], &error_));
+  ASSERT_EQ(1, pbwire_rpcserver_connection_count(server_));
+
+  // frame header claiming a 1MiB payload
+  const char header[] = "\x80\x80\x40\x01";
+  ASSERT_EQ(4, write(fds[1], header, 4));
+  ASSERT_EQ(0, pbwire_rpcserver_poll(server_, 1000, &error_));
+  EXPECT_EQ(0, pbwire_rpcserver_connection_count(server_));
+  close(fds[1]);
+}
+
+// Handler for the generated table: respond with fieldA doubled
+static int on_my_message_a(const MyMessageA* request,
+                           pbwire_EmitContext* response, void* /*userdata*/) {
+  MyMessageA reply = *request;
+  reply.fieldA *= 2;
+  return pbemit_MyMessageA(response, &reply);
+}
+
+TEST(RpcGeneratedTest, TypedHandlerTableOverUnixSocket) {
+  std::string path = "/tmp/pbwire_rpc-test." + std::to_string(getpid());
+  pbwire_Error error{};
+
+  pbrpc_test_messages_Handlers handlers{};
+  handlers.on_MyMessageA = on_my_message_a;
+  pbwire_RpcMethod methods[6];
+  ASSERT_EQ(1, pbrpc_test_messages_get_methods(&handlers, methods, 6));
+  EXPECT_EQ(PBRPC_METHOD_MyMessageA, methods[0].id);
+
+  pbwire_RpcServer* server =
+      pbwire_rpcserver_new(methods, 1, nullptr, &error);
+  ASSERT_NE(nullptr, server) << error.msg;
+  ASSERT_EQ(0, pbwire_rpcserver_listen(server, path.c_str(), &error))
+      << error.msg;
+  std::thread server_thread{[server]() {
+    pbwire_Error error{};
+    pbwire_rpcserver_run(server, &error);
+  }};
+
+  pbwire_RpcClient* client =
+      pbwire_rpcclient_connect(path.c_str(), nullptr, &error);
+  ASSERT_NE(nullptr, client) << error.msg;
+
+  for (int32_t value = 1; value <= 10; value++) {
+    MyMessageA request{};
+    request.fieldA = value;
+    request.fieldB = 1.5;
+    request.fieldD = MyEnumA_VALUE3;
+    ASSERT_LE(0, pbrpc_send_MyMessageA(client, &request, &error))
+        << error.msg;
+  }
+  // An unhandled message type is reported as an error
+  MyMessageB unhandled{};
+  ASSERT_LE(0, pbrpc_send_MyMessageB(client, &unhandled, &error));
+
+  pbwire_ParseContext ctx{};
+  ctx.error = &error;
+  for (int32_t value = 1; value <= 10; value++) {
+    uint32_t method_id = 0;
+    ASSERT_EQ(0, pbwire_rpcclient_recv(client, &method_id, &ctx))
+        << error.msg;
+    ASSERT_EQ(PBRPC_METHOD_MyMessageA, method_id);
+    MyMessageA reply{};
+    ASSERT_LE(0, pbparse_MyMessageA(&ctx, &reply)) << error.msg;
+    EXPECT_EQ(2 * value, reply.fieldA);
+    EXPECT_EQ(1.5, reply.fieldB);
+    EXPECT_EQ(MyEnumA_VALUE3, reply.fieldD);
+  }
+  uint32_t method_id = 0;
+  ASSERT_EQ(0, pbwire_rpcclient_recv(client, &method_id, &ctx));
+  EXPECT_EQ(PBWIRE_RPC_ERROR_METHOD, method_id);
+
+  pbwire_rpcclient_free(client);
+  pbwire_rpcserver_stop(server);
+  server_thread.join();
+  pbwire_rpcserver_free(server);
+  unlink(path.c_str());
+}
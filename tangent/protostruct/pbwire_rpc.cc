@@ -0,0 +1,842 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/protostruct/pbwire_rpc.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "tangent/protostruct/pbwire_internal.h"
+#ifdef PBWIRE_WITH_STATS
+#include "tangent/protostruct/pbwire_stats.h"
+#endif
+
+namespace {
+
+// Minimum amount of free space we ask the kernel to fill on each read
+constexpr size_t kReadChunk = 64 * 1024;
+
+#ifdef IOV_MAX
+constexpr size_t kMaxIov = IOV_MAX;
+#else
+constexpr size_t kMaxIov = 1024;
+#endif
+
+int varint_size(uint32_t value) {
+  int size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+int write_varint(char* out, uint32_t value) {
+  int size = 0;
+  while (value >= 0x80) {
+    out[size++] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out[size++] = static_cast<char>(value);
+  return size;
+}
+
+// Decode a varint from [begin, end). Return the number of bytes consumed, 0 if
+// more bytes are needed, or -1 if the encoding is too long for 32 bits.
+int read_varint(const char* begin, const char* end, uint32_t* value) {
+  uint32_t out = 0;
+  for (int idx = 0; idx < 5; idx++) {
+    if (begin + idx >= end) {
+      return 0;
+    }
+    uint8_t byte = static_cast<uint8_t>(begin[idx]);
+    out |= static_cast<uint32_t>(byte & 0x7f) << (7 * idx);
+    if (!(byte & 0x80)) {
+      *value = out;
+      return idx + 1;
+    }
+  }
+  return -1;
+}
+
+// Result of attempting to decode one frame from the front of a buffer
+struct Frame {
+  uint32_t method_id;
+  const char* payload;
+  size_t payload_len;
+  size_t frame_len;  //< total bytes including the header
+};
+
+// Return 1 if a complete frame was decoded, 0 if more bytes are needed, or -1
+// if the stream is malformed.
+int read_frame(const char* begin, const char* end, uint32_t max_message_size,
+               Frame* frame, pbwire_Error* error) {
+  uint32_t length = 0;
+  int nbytes = read_varint(begin, end, &length);
+  if (nbytes <= 0) {
+    if (nbytes < 0) {
+      pbwire_error(error, PBWIRE_RPC_PROTOCOL) << "malformed frame length";
+    }
+    return nbytes;
+  }
+  // The method id adds at most five bytes. The sum is widened so that a
+  // limit near UINT32_MAX doesn't wrap around.
+  if (length > uint64_t{max_message_size} + 5u) {
+    pbwire_error(error, PBWIRE_RPC_PROTOCOL)
+        << "frame of " << length << " bytes exceeds limit of "
+        << max_message_size;
+    return -1;
+  }
+  const char* body = begin + nbytes;
+  if (static_cast<size_t>(end - body) < length) {
+    return 0;
+  }
+
+  int idlen = read_varint(body, body + length, &frame->method_id);
+  if (idlen <= 0) {
+    pbwire_error(error, PBWIRE_RPC_PROTOCOL) << "malformed method id";
+    return -1;
+  }
+  frame->payload = body + idlen;
+  frame->payload_len = length - idlen;
+  frame->frame_len = nbytes + length;
+  return 1;
+}
+
+// Receive buffer. Bytes in [begin_, end_) have been read but not consumed.
+class InBuffer {
+ public:
+  // Ensure there is at least `size` bytes of free space after end_ and return
+  // a pointer to it
+  char* reserve(size_t size) {
+    if (begin_ == end_) {
+      begin_ = end_ = 0;
+    }
+    if (data_.size() - end_ < size) {
+      if (begin_ > 0) {
+        memmove(&data_[0], &data_[begin_], end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+      }
+      if (data_.size() - end_ < size) {
+        data_.resize(std::max(end_ + size, 2 * data_.size()));
+      }
+    }
+    return &data_[end_];
+  }
+
+  size_t free_space() const {
+    return data_.size() - end_;
+  }
+
+  void commit(size_t size) {
+    end_ += size;
+  }
+
+  void consume(size_t size) {
+    begin_ += size;
+  }
+
+  const char* begin() const {
+    return data_.data() + begin_;
+  }
+
+  const char* end() const {
+    return data_.data() + end_;
+  }
+
+ private:
+  std::vector<char> data_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+};
+
+// Send queue. Each frame is emitted with PBWIRE_RPC_MAX_HEADER bytes of slack
+// in front of it. Once the payload size is known the header is written
+// right-aligned into that slack, so the frame is contiguous without moving
+// the payload. The frames are then gathered with writev().
+class OutQueue {
+ public:
+  // Return a pointer to `capacity` bytes where the next payload may be
+  // written
+  char* reserve(size_t capacity) {
+    size_t need = used_ + PBWIRE_RPC_MAX_HEADER + capacity;
+    if (data_.size() < need) {
+      data_.resize(std::max(need, 2 * data_.size()));
+    }
+    return &data_[used_ + PBWIRE_RPC_MAX_HEADER];
+  }
+
+  // Frame the `nbytes` of payload which were written to the last reserve()
+  void commit(uint32_t method_id, size_t nbytes) {
+    size_t payload_offset = used_ + PBWIRE_RPC_MAX_HEADER;
+    char header[PBWIRE_RPC_MAX_HEADER];
+    uint32_t length = varint_size(method_id) + nbytes;
+    int hdrlen = write_varint(header, length);
+    hdrlen += write_varint(header + hdrlen, method_id);
+
+    size_t frame_offset = payload_offset - hdrlen;
+    memcpy(&data_[frame_offset], header, hdrlen);
+    frames_.push_back({frame_offset, hdrlen + nbytes});
+    used_ = payload_offset + nbytes;
+  }
+
+  bool empty() const {
+    return next_frame_ == frames_.size();
+  }
+
+  size_t pending_frames() const {
+    return frames_.size() - next_frame_;
+  }
+
+  // Write as much of the queue as the socket will accept, gathering up to
+  // IOV_MAX frames per syscall. Return the number of frames completed, or -1
+  // on error. If the socket would block, the remainder is left queued.
+  ssize_t flush(int fd, pbwire_RpcStats* stats, pbwire_Error* error) {
+    ssize_t frames_done = 0;
+    while (!empty()) {
+      iovec iov[kMaxIov];
+      size_t niov = 0;
+      for (size_t idx = next_frame_; idx < frames_.size() && niov < kMaxIov;
+           idx++, niov++) {
+        size_t skip = (idx == next_frame_) ? sent_ : 0;
+        iov[niov].iov_base = &data_[frames_[idx].offset + skip];
+        iov[niov].iov_len = frames_[idx].length - skip;
+      }
+
+      ssize_t nbytes = writev(fd, iov, niov);
+      if (stats) {
+        stats->write_calls++;
+      }
+      if (nbytes < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return frames_done;
+        }
+        pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+            << "writev failed: " << strerror(errno);
+        return -1;
+      }
+      if (stats) {
+        stats->bytes_out += nbytes;
+      }
+
+      size_t remaining = nbytes;
+      while (remaining > 0) {
+        size_t left = frames_[next_frame_].length - sent_;
+        if (remaining < left) {
+          sent_ += remaining;
+          break;
+        }
+        remaining -= left;
+        sent_ = 0;
+        next_frame_++;
+        frames_done++;
+      }
+    }
+
+    frames_.clear();
+    next_frame_ = 0;
+    sent_ = 0;
+    used_ = 0;
+    return frames_done;
+  }
+
+ private:
+  struct Span {
+    size_t offset;
+    size_t length;
+  };
+
+  std::vector<char> data_;
+  std::vector<Span> frames_;
+  size_t used_ = 0;
+  size_t next_frame_ = 0;  //< first frame not completely sent
+  size_t sent_ = 0;        //< bytes of frames_[next_frame_] already sent
+};
+
+int set_nonblocking(int fd, pbwire_Error* error) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "fcntl failed: " << strerror(errno);
+    return -1;
+  }
+  return 0;
+}
+
+int make_unix_address(const char* path, sockaddr_un* addr,
+                      pbwire_Error* error) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "socket path is too long: " << path;
+    return -1;
+  }
+  strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+  return 0;
+}
+
+void init_options(const pbwire_RpcOptions* opts, pbwire_RpcOptions* out) {
+  pbwire_rpcoptions_init(out);
+  if (opts) {
+    if (opts->max_message_size) {
+      out->max_message_size = opts->max_message_size;
+    }
+    if (opts->length_cache_size) {
+      out->length_cache_size = opts->length_cache_size;
+    }
+    if (opts->max_events) {
+      out->max_events = opts->max_events;
+    }
+  }
+}
+
+enum EndpointKind { LISTENER, WAKER, CONNECTION };
+
+struct Endpoint {
+  int fd;
+  EndpointKind kind;
+};
+
+struct Connection : Endpoint {
+  InBuffer in;
+  OutQueue out;
+  bool want_write;  //< EPOLLOUT is armed
+  bool dirty;       //< has responses queued this iteration
+  bool closed;
+};
+
+}  // namespace
+
+void pbwire_rpcoptions_init(pbwire_RpcOptions* opts) {
+  opts->max_message_size = 64 * 1024;
+  opts->length_cache_size = 1024;
+  opts->max_events = 64;
+}
+
+/* ================================= Server ================================= */
+
+struct pbwire_RpcServer {
+  pbwire_RpcOptions opts;
+  std::vector<pbwire_RpcMethod> methods;  //< sorted by id
+  int epoll_fd;
+  Endpoint listener;
+  Endpoint waker;
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::vector<Connection*> dirty;
+  std::vector<epoll_event> events;
+  std::vector<uint32_t> length_cache;
+  std::atomic<bool> stop_requested;
+  pbwire_RpcStats stats;
+};
+
+namespace {
+
+const pbwire_RpcMethod* find_method(const pbwire_RpcServer* server,
+                                    uint32_t method_id) {
+  auto iter = std::lower_bound(
+      server->methods.begin(), server->methods.end(), method_id,
+      [](const pbwire_RpcMethod& method, uint32_t id) {
+        return method.id < id;
+      });
+  if (iter == server->methods.end() || iter->id != method_id) {
+    return nullptr;
+  }
+  return &(*iter);
+}
+
+void queue_error(pbwire_RpcServer* server, Connection* conn,
+                 const pbwire_Error& error) {
+  size_t len = strnlen(error.msg, sizeof(error.msg));
+  char* payload = conn->out.reserve(len);
+  memcpy(payload, error.msg, len);
+  conn->out.commit(PBWIRE_RPC_ERROR_METHOD, len);
+  server->stats.errors++;
+}
+
+// Dispatch every complete frame in the connection's receive buffer. Return
+// the number of frames dispatched, or -1 if the stream is malformed.
+int dispatch_frames(pbwire_RpcServer* server, Connection* conn,
+                    pbwire_Error* error) {
+  int count = 0;
+  while (true) {
+    Frame frame{};
+    int result = read_frame(conn->in.begin(), conn->in.end(),
+                            server->opts.max_message_size, &frame, error);
+    if (result <= 0) {
+      return result < 0 ? -1 : count;
+    }
+
+    pbwire_Error handler_error{};
+    pbwire_ParseContext request{};
+    pbwire_readbuffer_init(&request.buffer, frame.payload,
+                           frame.payload + frame.payload_len);
+    request.error = &handler_error;
+#ifdef PBWIRE_WITH_STATS
+    request.stats = pbwire_stats_thread_slot();
+#endif
+
+    const pbwire_RpcMethod* method = find_method(server, frame.method_id);
+    if (!method) {
+      pbwire_error(&handler_error, PBWIRE_NOTIMPLEMENTED)
+          << "no handler for method " << frame.method_id;
+      queue_error(server, conn, handler_error);
+    } else {
+      pbwire_EmitContext response{};
+      char* payload = conn->out.reserve(server->opts.max_message_size);
+      pbwire_writebuffer_init(&response.buffer, payload,
+                              payload + server->opts.max_message_size);
+      pbwire_lengthcache_init(
+          &response.length_cache, server->length_cache.data(),
+          server->length_cache.data() + server->length_cache.size());
+      response.error = &handler_error;
+#ifdef PBWIRE_WITH_STATS
+      response.stats = request.stats;
+#endif
+
+      int nbytes = method->handler(&request, &response, method->userdata);
+      if (nbytes < 0) {
+        queue_error(server, conn, handler_error);
+      } else {
+        conn->out.commit(frame.method_id, nbytes);
+      }
+    }
+
+    conn->in.consume(frame.frame_len);
+    server->stats.frames_in++;
+    count++;
+  }
+}
+
+void close_connection(pbwire_RpcServer* server, Connection* conn) {
+  if (conn->closed) {
+    return;
+  }
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+  close(conn->fd);
+  conn->closed = true;
+}
+
+// Read whatever is available and dispatch it. Return the number of frames
+// dispatched.
+int handle_readable(pbwire_RpcServer* server, Connection* conn) {
+  int count = 0;
+  while (!conn->closed) {
+    char* buf = conn->in.reserve(kReadChunk);
+    size_t space = conn->in.free_space();
+    ssize_t nbytes = read(conn->fd, buf, space);
+    server->stats.read_calls++;
+    if (nbytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close_connection(server, conn);
+      }
+      break;
+    }
+    if (nbytes == 0) {
+      close_connection(server, conn);
+      break;
+    }
+    server->stats.bytes_in += nbytes;
+    conn->in.commit(nbytes);
+
+    pbwire_Error error{};
+    int result = dispatch_frames(server, conn, &error);
+    if (result < 0) {
+      close_connection(server, conn);
+      break;
+    }
+    count += result;
+
+    // NOTE(josh): epoll is level-triggered so if there is more data we will
+    // get it on the next iteration. Only read again now if we filled the
+    // buffer, in which case there is likely more waiting.
+    if (static_cast<size_t>(nbytes) < space) {
+      break;
+    }
+  }
+
+  if (!conn->out.empty() && !conn->dirty && !conn->closed) {
+    conn->dirty = true;
+    server->dirty.push_back(conn);
+  }
+  return count;
+}
+
+void update_interest(pbwire_RpcServer* server, Connection* conn) {
+  bool want_write = !conn->out.empty();
+  if (want_write == conn->want_write) {
+    return;
+  }
+  epoll_event event{};
+  event.events = static_cast<uint32_t>(EPOLLIN) |
+                 (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+  event.data.ptr = static_cast<Endpoint*>(conn);
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+  conn->want_write = want_write;
+}
+
+void flush_connection(pbwire_RpcServer* server, Connection* conn) {
+  pbwire_Error error{};
+  ssize_t frames = conn->out.flush(conn->fd, &server->stats, &error);
+  if (frames < 0) {
+    close_connection(server, conn);
+    return;
+  }
+  server->stats.frames_out += frames;
+  update_interest(server, conn);
+}
+
+int accept_connections(pbwire_RpcServer* server, pbwire_Error* error) {
+  while (true) {
+    int fd = accept4(server->listener.fd, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+      }
+      pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+          << "accept failed: " << strerror(errno);
+      return -1;
+    }
+    if (pbwire_rpcserver_add_connection(server, fd, error)) {
+      return -1;
+    }
+  }
+}
+
+}  // namespace
+
+pbwire_RpcServer* pbwire_rpcserver_new(const pbwire_RpcMethod* methods,
+                                       size_t nmethods,
+                                       const pbwire_RpcOptions* opts,
+                                       pbwire_Error* error) {
+  std::unique_ptr<pbwire_RpcServer> server{new pbwire_RpcServer{}};
+  init_options(opts, &server->opts);
+  server->methods.assign(methods, methods + nmethods);
+  std::sort(server->methods.begin(), server->methods.end(),
+            [](const pbwire_RpcMethod& a, const pbwire_RpcMethod& b) {
+              return a.id < b.id;
+            });
+  for (size_t idx = 0; idx < server->methods.size(); idx++) {
+    if (server->methods[idx].id == PBWIRE_RPC_ERROR_METHOD ||
+        (idx > 0 && server->methods[idx].id == server->methods[idx - 1].id)) {
+      pbwire_error(error, PBWIRE_INTERNAL_ERROR)
+          << "invalid or duplicate method id " << server->methods[idx].id;
+      return nullptr;
+    }
+  }
+  server->events.resize(server->opts.max_events);
+  server->length_cache.resize(server->opts.length_cache_size);
+  server->listener = {-1, LISTENER};
+
+  server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (server->epoll_fd < 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "epoll_create failed: " << strerror(errno);
+    return nullptr;
+  }
+
+  server->waker = {eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), WAKER};
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = &server->waker;
+  if (server->waker.fd < 0 ||
+      epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->waker.fd, &event)) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "eventfd failed: " << strerror(errno);
+    pbwire_rpcserver_free(server.release());
+    return nullptr;
+  }
+  return server.release();
+}
+
+int pbwire_rpcserver_listen(pbwire_RpcServer* server, const char* path,
+                            pbwire_Error* error) {
+  sockaddr_un addr{};
+  if (make_unix_address(path, &addr, error)) {
+    return -1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "socket failed: " << strerror(errno);
+    return -1;
+  }
+  unlink(path);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+      listen(fd, SOMAXCONN)) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "failed to listen on " << path << ": " << strerror(errno);
+    close(fd);
+    return -1;
+  }
+
+  server->listener.fd = fd;
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = &server->listener;
+  if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "epoll_ctl failed: " << strerror(errno);
+    return -1;
+  }
+  return 0;
+}
+
+int pbwire_rpcserver_add_connection(pbwire_RpcServer* server, int fd,
+                                    pbwire_Error* error) {
+  if (set_nonblocking(fd, error)) {
+    return -1;
+  }
+
+  std::unique_ptr<Connection> conn{new Connection{}};
+  conn->fd = fd;
+  conn->kind = CONNECTION;
+
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = static_cast<Endpoint*>(conn.get());
+  if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "epoll_ctl failed: " << strerror(errno);
+    return -1;
+  }
+  server->connections.push_back(std::move(conn));
+  server->stats.connections++;
+  return 0;
+}
+
+int pbwire_rpcserver_poll(pbwire_RpcServer* server, int timeout_ms,
+                          pbwire_Error* error) {
+  int nevents = epoll_wait(server->epoll_fd, server->events.data(),
+                           server->events.size(), timeout_ms);
+  if (nevents < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "epoll_wait failed: " << strerror(errno);
+    return -1;
+  }
+  server->stats.loop_iterations++;
+
+  int count = 0;
+  for (int idx = 0; idx < nevents; idx++) {
+    const epoll_event& event = server->events[idx];
+    Endpoint* endpoint = static_cast<Endpoint*>(event.data.ptr);
+    switch (endpoint->kind) {
+      case LISTENER:
+        if (accept_connections(server, error)) {
+          return -1;
+        }
+        break;
+      case WAKER: {
+        uint64_t value = 0;
+        ssize_t unused = read(endpoint->fd, &value, sizeof(value));
+        (void)unused;
+        break;
+      }
+      case CONNECTION: {
+        Connection* conn = static_cast<Connection*>(endpoint);
+        if (event.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+          count += handle_readable(server, conn);
+        }
+        if ((event.events & EPOLLOUT) && !conn->dirty && !conn->closed) {
+          conn->dirty = true;
+          server->dirty.push_back(conn);
+        }
+        break;
+      }
+    }
+  }
+
+  // Flush all responses generated during this iteration, one writev() per
+  // connection
+  for (Connection* conn : server->dirty) {
+    conn->dirty = false;
+    if (!conn->closed) {
+      flush_connection(server, conn);
+    }
+  }
+  server->dirty.clear();
+
+  server->connections.erase(
+      std::remove_if(server->connections.begin(), server->connections.end(),
+                     [](const std::unique_ptr<Connection>& conn) {
+                       return conn->closed;
+                     }),
+      server->connections.end());
+  return count;
+}
+
+int pbwire_rpcserver_run(pbwire_RpcServer* server, pbwire_Error* error) {
+  while (!server->stop_requested.load()) {
+    if (pbwire_rpcserver_poll(server, -1, error) < 0) {
+      return -1;
+    }
+  }
+  server->stop_requested = false;
+  return 0;
+}
+
+void pbwire_rpcserver_stop(pbwire_RpcServer* server) {
+  server->stop_requested = true;
+  uint64_t value = 1;
+  ssize_t unused = write(server->waker.fd, &value, sizeof(value));
+  (void)unused;
+}
+
+size_t pbwire_rpcserver_connection_count(const pbwire_RpcServer* server) {
+  return server->connections.size();
+}
+
+void pbwire_rpcserver_get_stats(const pbwire_RpcServer* server,
+                                pbwire_RpcStats* stats) {
+  *stats = server->stats;
+}
+
+void pbwire_rpcserver_free(pbwire_RpcServer* server) {
+  for (auto& conn : server->connections) {
+    close_connection(server, conn.get());
+  }
+  for (int fd : {server->listener.fd, server->waker.fd, server->epoll_fd}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  delete server;
+}
+
+/* ================================= Client ================================= */
+
+struct pbwire_RpcClient {
+  int fd;
+  pbwire_RpcOptions opts;
+  InBuffer in;
+  OutQueue out;
+  std::vector<uint32_t> length_cache;
+  size_t last_frame_len;  //< bytes to consume on the next recv()
+};
+
+pbwire_RpcClient* pbwire_rpcclient_connect(const char* path,
+                                           const pbwire_RpcOptions* opts,
+                                           pbwire_Error* error) {
+  sockaddr_un addr{};
+  if (make_unix_address(path, &addr, error)) {
+    return nullptr;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "socket failed: " << strerror(errno);
+    return nullptr;
+  }
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "failed to connect to " << path << ": " << strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  return pbwire_rpcclient_new(fd, opts, error);
+}
+
+pbwire_RpcClient* pbwire_rpcclient_new(int fd, const pbwire_RpcOptions* opts,
+                                       pbwire_Error* error) {
+  (void)error;
+  pbwire_RpcClient* client = new pbwire_RpcClient{};
+  client->fd = fd;
+  init_options(opts, &client->opts);
+  client->length_cache.resize(client->opts.length_cache_size);
+  return client;
+}
+
+void pbwire_rpcclient_begin_request(pbwire_RpcClient* client,
+                                    pbwire_EmitContext* ctx) {
+  char* payload = client->out.reserve(client->opts.max_message_size);
+  pbwire_writebuffer_init(&ctx->buffer, payload,
+                          payload + client->opts.max_message_size);
+  pbwire_lengthcache_init(
+      &ctx->length_cache, client->length_cache.data(),
+      client->length_cache.data() + client->length_cache.size());
+}
+
+int pbwire_rpcclient_commit_request(pbwire_RpcClient* client,
+                                    pbwire_EmitContext* ctx, uint32_t method_id,
+                                    int nbytes) {
+  (void)ctx;
+  if (nbytes >= 0) {
+    client->out.commit(method_id, nbytes);
+  }
+  return 0;
+}
+
+int pbwire_rpcclient_flush(pbwire_RpcClient* client, pbwire_Error* error) {
+  // NOTE(josh): the client socket is blocking, so this only returns early on
+  // error.
+  return client->out.flush(client->fd, nullptr, error) < 0 ? -1 : 0;
+}
+
+int pbwire_rpcclient_recv(pbwire_RpcClient* client, uint32_t* method_id,
+                          pbwire_ParseContext* ctx) {
+  if (!client->out.empty() && pbwire_rpcclient_flush(client, ctx->error)) {
+    return -1;
+  }
+  client->in.consume(client->last_frame_len);
+  client->last_frame_len = 0;
+
+  while (true) {
+    Frame frame{};
+    int result = read_frame(client->in.begin(), client->in.end(),
+                            client->opts.max_message_size, &frame, ctx->error);
+    if (result < 0) {
+      return -1;
+    }
+    if (result > 0) {
+      *method_id = frame.method_id;
+      pbwire_readbuffer_init(&ctx->buffer, frame.payload,
+                             frame.payload + frame.payload_len);
+      client->last_frame_len = frame.frame_len;
+      return 0;
+    }
+
+    char* buf = client->in.reserve(kReadChunk);
+    ssize_t nbytes = read(client->fd, buf, client->in.free_space());
+    if (nbytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      pbwire_error(ctx->error, PBWIRE_SYSTEM_ERROR)
+          << "read failed: " << strerror(errno);
+      return -1;
+    }
+    if (nbytes == 0) {
+      pbwire_error(ctx->error, PBWIRE_RPC_CLOSED) << "connection closed";
+      return -1;
+    }
+    client->in.commit(nbytes);
+  }
+}
+
+void pbwire_rpcclient_free(pbwire_RpcClient* client) {
+  close(client->fd);
+  delete client;
+}
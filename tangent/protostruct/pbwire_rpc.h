@@ -0,0 +1,159 @@
+#pragma once
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tangent/protostruct/pbwire.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================== RPC Framing =============================== */
+// A minimal request/response layer for pbwire messages over stream sockets
+// (typically unix domain sockets). Each frame on the wire is:
+//
+//   varint  frame_length   (number of bytes that follow)
+//   varint  method_id
+//   bytes   payload        (a pbwire-encoded message)
+//
+// The server replies to each request with exactly one frame, in order. The
+// response carries the method id of the request, or PBWIRE_RPC_ERROR_METHOD
+// with a text payload describing the failure.
+//
+// Method ids are typically generated per message type by the "pbrpc"
+// protostruct template (see XXX.pbrpc.h), which also generates typed handler
+// tables.
+
+// Method id reserved for error responses
+#define PBWIRE_RPC_ERROR_METHOD 0
+
+// Maximum number of bytes in an encoded frame header
+#define PBWIRE_RPC_MAX_HEADER 10
+
+// Request handler. Parse the request from `request` and emit the response
+// into `response`. Return the number of response bytes written or a negative
+// value on error (in which case `response->error` should be filled).
+typedef int (*pbwire_RpcHandler)(pbwire_ParseContext* request,
+                                 pbwire_EmitContext* response, void* userdata);
+
+// One entry in a server's dispatch table
+typedef struct pbwire_RpcMethod {
+  uint32_t id;
+  pbwire_RpcHandler handler;
+  void* userdata;
+} pbwire_RpcMethod;
+
+typedef struct pbwire_RpcOptions {
+  // Maximum encoded size of a request or response payload. Connections which
+  // send a larger frame are dropped. Default 64KiB.
+  uint32_t max_message_size;
+
+  // Number of entries in the length cache for nested message emission.
+  // Default 1024.
+  uint32_t length_cache_size;
+
+  // Maximum number of epoll events handled per loop iteration. Default 64.
+  uint32_t max_events;
+} pbwire_RpcOptions;
+
+// Initialize `opts` with default values
+void pbwire_rpcoptions_init(pbwire_RpcOptions* opts);
+
+// Counters describing how much batching the event loop achieved
+typedef struct pbwire_RpcStats {
+  uint64_t loop_iterations;  //< number of epoll_wait() calls which returned
+  uint64_t read_calls;       //< number of read() syscalls
+  uint64_t write_calls;      //< number of writev() syscalls
+  uint64_t frames_in;        //< number of request frames dispatched
+  uint64_t frames_out;       //< number of response frames sent
+  uint64_t bytes_in;         //< total bytes read
+  uint64_t bytes_out;        //< total bytes written
+  uint64_t errors;           //< error responses sent
+  uint64_t connections;      //< number of connections accepted or added
+} pbwire_RpcStats;
+
+/* ================================= Server ================================= */
+
+typedef struct pbwire_RpcServer pbwire_RpcServer;
+
+// Create a server dispatching to the given methods. The method table is
+// copied. `opts` may be NULL for defaults. Return NULL on error.
+pbwire_RpcServer* pbwire_rpcserver_new(const pbwire_RpcMethod* methods,
+                                       size_t nmethods,
+                                       const pbwire_RpcOptions* opts,
+                                       pbwire_Error* error);
+
+// Bind and listen on a unix socket at `path`. Any existing file at `path` is
+// unlinked first.
+int pbwire_rpcserver_listen(pbwire_RpcServer* server, const char* path,
+                            pbwire_Error* error);
+
+// Serve requests on an already connected socket (e.g. one end of a
+// socketpair()). The server takes ownership of `fd`.
+int pbwire_rpcserver_add_connection(pbwire_RpcServer* server, int fd,
+                                    pbwire_Error* error);
+
+// Run one iteration of the event loop: wait up to `timeout_ms` for activity,
+// read everything available from each ready connection, dispatch all complete
+// frames, and flush the responses with one writev() per connection. Return
+// the number of requests dispatched, or -1 on error.
+int pbwire_rpcserver_poll(pbwire_RpcServer* server, int timeout_ms,
+                          pbwire_Error* error);
+
+// Run the event loop until pbwire_rpcserver_stop() is called
+int pbwire_rpcserver_run(pbwire_RpcServer* server, pbwire_Error* error);
+
+// Ask the event loop to exit. May be called from any thread.
+void pbwire_rpcserver_stop(pbwire_RpcServer* server);
+
+// Number of open client connections
+size_t pbwire_rpcserver_connection_count(const pbwire_RpcServer* server);
+
+void pbwire_rpcserver_get_stats(const pbwire_RpcServer* server,
+                                pbwire_RpcStats* stats);
+
+void pbwire_rpcserver_free(pbwire_RpcServer* server);
+
+/* ================================= Client ================================= */
+
+// Blocking client for a single connection. Requests may be pipelined: queue
+// any number of requests, flush them with one syscall, then receive the
+// responses in order.
+typedef struct pbwire_RpcClient pbwire_RpcClient;
+
+// Connect to a server listening on the unix socket at `path`
+pbwire_RpcClient* pbwire_rpcclient_connect(const char* path,
+                                           const pbwire_RpcOptions* opts,
+                                           pbwire_Error* error);
+
+// Create a client on an already connected socket. Takes ownership of `fd`.
+pbwire_RpcClient* pbwire_rpcclient_new(int fd, const pbwire_RpcOptions* opts,
+                                       pbwire_Error* error);
+
+// Reserve space for a request and point `ctx->buffer` and
+// `ctx->length_cache` at it. `ctx->error` is left unchanged.
+void pbwire_rpcclient_begin_request(pbwire_RpcClient* client,
+                                    pbwire_EmitContext* ctx);
+
+// Frame the request emitted into `ctx` and queue it for sending. If `nbytes`
+// is negative the request is discarded.
+int pbwire_rpcclient_commit_request(pbwire_RpcClient* client,
+                                    pbwire_EmitContext* ctx, uint32_t method_id,
+                                    int nbytes);
+
+// Send all queued requests
+int pbwire_rpcclient_flush(pbwire_RpcClient* client, pbwire_Error* error);
+
+// Flush any queued requests and then wait for the next response. On success
+// `ctx->buffer` points at the response payload which remains valid until the
+// next call to recv().
+int pbwire_rpcclient_recv(pbwire_RpcClient* client, uint32_t* method_id,
+                          pbwire_ParseContext* ctx);
+
+void pbwire_rpcclient_free(pbwire_RpcClient* client);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
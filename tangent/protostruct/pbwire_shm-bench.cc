@@ -0,0 +1,119 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure round-trip latency and one-way throughput of the shared memory ring
+// between two processes.
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "tangent/protostruct/pbwire_shm.h"
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Emit a single-field message containing `value`
+static void send(pbwire_ShmRing* ring, uint32_t value) {
+  pbwire_Error error{};
+  pbwire_EmitContext ctx{};
+  ctx.error = &error;
+  if (pbwire_shmring_begin_write(ring, &ctx, -1)) {
+    fprintf(stderr, "begin_write: %s\n", error.msg);
+    exit(1);
+  }
+  int nbytes = pbwire_emit_varint32(&ctx, 1 << 3);
+  ctx.buffer.ptr += nbytes;
+  nbytes += pbwire_emit_varint32(&ctx, value);
+  pbwire_shmring_commit_write(ring, &ctx, nbytes);
+}
+
+static uint32_t recv(pbwire_ShmRing* ring) {
+  pbwire_Error error{};
+  pbwire_ParseContext ctx{};
+  ctx.error = &error;
+  if (pbwire_shmring_begin_read(ring, &ctx, -1)) {
+    fprintf(stderr, "begin_read: %s\n", error.msg);
+    exit(1);
+  }
+  uint32_t value = 0;
+  ctx.buffer.ptr += pbwire_parse_varint32(&ctx, nullptr);
+  pbwire_parse_varint32(&ctx, &value);
+  pbwire_shmring_end_read(ring, &ctx);
+  return value;
+}
+
+static void run(uint32_t busy_poll, uint32_t count) {
+  pbwire_Error error{};
+  pbwire_ShmRing ping{};
+  pbwire_ShmRing pong{};
+  if (pbwire_shmring_create(&ping, nullptr, 256, 1024, 0, &error) ||
+      pbwire_shmring_create(&pong, nullptr, 256, 1024, 0, &error)) {
+    fprintf(stderr, "create: %s\n", error.msg);
+    exit(1);
+  }
+  ping.busy_poll = busy_poll;
+  pong.busy_poll = busy_poll;
+
+  // Child echoes every ping and then drains the throughput phase
+  pid_t child = fork();
+  if (child == 0) {
+    for (uint32_t idx = 0; idx < count; idx++) {
+      send(&pong, recv(&ping));
+    }
+    for (uint32_t idx = 0; idx < count; idx++) {
+      recv(&ping);
+    }
+    send(&pong, 0);
+    _exit(0);
+  }
+
+  std::vector<uint64_t> samples;
+  samples.reserve(count);
+  for (uint32_t idx = 0; idx < count; idx++) {
+    uint64_t start = now_ns();
+    send(&ping, idx);
+    recv(&pong);
+    samples.push_back(now_ns() - start);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  uint64_t start = now_ns();
+  for (uint32_t idx = 0; idx < count; idx++) {
+    send(&ping, idx);
+  }
+  recv(&pong);
+  double elapsed = (now_ns() - start) * 1e-9;
+  waitpid(child, nullptr, 0);
+
+  pbwire_ShmStats stats{};
+  pbwire_shmring_get_stats(&ping, &stats);
+  printf(
+      "busy_poll=%-6u rtt p50=%6.2fus p99=%6.2fus max=%8.2fus | "
+      "%6.2f Mmsg/s | full=%lu waits=%lu/%lu wakeups=%lu\n",
+      busy_poll, samples[count / 2] * 1e-3, samples[count * 99 / 100] * 1e-3,
+      samples.back() * 1e-3, count / elapsed * 1e-6,
+      static_cast<unsigned long>(stats.full_events),
+      static_cast<unsigned long>(stats.producer_waits),
+      static_cast<unsigned long>(stats.consumer_waits),
+      static_cast<unsigned long>(stats.wakeups));
+
+  pbwire_shmring_close(&ping);
+  pbwire_shmring_close(&pong);
+}
+
+int main(int argc, char** argv) {
+  uint32_t count = 100000;
+  if (argc > 1) {
+    count = strtoul(argv[1], nullptr, 10);
+  }
+  for (uint32_t busy_poll : {0u, 100u, 10000u}) {
+    run(busy_poll, count);
+  }
+  return 0;
+}
@@ -0,0 +1,308 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "tangent/protostruct/pbwire_shm.h"
+#include "tangent/protostruct/test/test_messages.pbwire.h"
+
+// Emit the producer id and sequence number as a MyMessageA directly into the
+// ring slot.
+static int emit_message(pbwire_EmitContext* ctx, uint32_t producer,
+                        uint32_t seqno) {
+  uint32_t lengths[4];
+  pbwire_lengthcache_init(&ctx->length_cache, lengths, lengths + 4);
+  MyMessageA message{};
+  message.fieldA = producer;
+  message.fieldC = seqno;
+  return pbemit_MyMessageA(ctx, &message);
+}
+
+static int parse_message(pbwire_ParseContext* ctx, uint32_t* producer,
+                         uint32_t* seqno) {
+  MyMessageA message{};
+  int nbytes = pbparse_MyMessageA(ctx, &message);
+  if (nbytes < 0) {
+    return nbytes;
+  }
+  *producer = message.fieldA;
+  *seqno = message.fieldC;
+  return 0;
+}
+
+// Fork a child which produces `count` messages into the ring and exits
+static pid_t spawn_producer(pbwire_ShmRing* ring, uint32_t producer,
+                            uint32_t count) {
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+
+  pbwire_Error error{};
+  for (uint32_t seqno = 0; seqno < count; seqno++) {
+    pbwire_EmitContext ctx{};
+    ctx.error = &error;
+    if (pbwire_shmring_begin_write(ring, &ctx, 5000)) {
+      _exit(1);
+    }
+    int nbytes = emit_message(&ctx, producer, seqno);
+    if (pbwire_shmring_commit_write(ring, &ctx, nbytes) || nbytes < 0) {
+      _exit(2);
+    }
+  }
+  _exit(0);
+}
+
+TEST(pbwireShmTest, SingleProducerAcrossProcesses) {
+  pbwire_Error error{};
+  pbwire_ShmRing ring{};
+  ring.busy_poll = 100;
+  ASSERT_EQ(0, pbwire_shmring_create(&ring, nullptr, 64, 8, 0, &error))
+      << error.msg;
+
+  const uint32_t kCount = 10000;
+  pid_t child = spawn_producer(&ring, 7, kCount);
+  ASSERT_LT(0, child);
+
+  for (uint32_t expect = 0; expect < kCount; expect++) {
+    pbwire_ParseContext ctx{};
+    ctx.error = &error;
+    ASSERT_EQ(0, pbwire_shmring_begin_read(&ring, &ctx, 5000)) << error.msg;
+    uint32_t producer = 0;
+    uint32_t seqno = 0;
+    ASSERT_EQ(0, parse_message(&ctx, &producer, &seqno)) << error.msg;
+    EXPECT_EQ(7, producer);
+    ASSERT_EQ(expect, seqno);
+    pbwire_shmring_end_read(&ring, &ctx);
+  }
+
+  int status = 0;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+
+  pbwire_ShmStats stats{};
+  pbwire_shmring_get_stats(&ring, &stats);
+  EXPECT_EQ(kCount, stats.messages_written);
+  EXPECT_EQ(kCount, stats.messages_read);
+  EXPECT_LE(stats.high_watermark, 8);
+  EXPECT_EQ(0, pbwire_shmring_size(&ring));
+  pbwire_shmring_close(&ring);
+}
+
+TEST(pbwireShmTest, MultipleProducersAcrossProcesses) {
+  pbwire_Error error{};
+  pbwire_ShmRing ring{};
+  ASSERT_EQ(0, pbwire_shmring_create(&ring, nullptr, 64, 4, PBWIRE_SHM_MPSC,
+                                     &error))
+      << error.msg;
+
+  const uint32_t kCount = 5000;
+  pid_t children[] = {spawn_producer(&ring, 0, kCount),
+                      spawn_producer(&ring, 1, kCount)};
+
+  // Messages from different producers may interleave, but each producer's
+  // messages must arrive in order.
+  uint32_t expect[2] = {0, 0};
+  for (uint32_t idx = 0; idx < 2 * kCount; idx++) {
+    pbwire_ParseContext ctx{};
+    ctx.error = &error;
+    ASSERT_EQ(0, pbwire_shmring_begin_read(&ring, &ctx, 5000)) << error.msg;
+    uint32_t producer = 0;
+    uint32_t seqno = 0;
+    ASSERT_EQ(0, parse_message(&ctx, &producer, &seqno)) << error.msg;
+    ASSERT_LT(producer, 2);
+    ASSERT_EQ(expect[producer]++, seqno);
+    pbwire_shmring_end_read(&ring, &ctx);
+  }
+
+  for (pid_t child : children) {
+    int status = 0;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+  }
+  pbwire_shmring_close(&ring);
+}
+
+TEST(pbwireShmTest, Backpressure) {
+  pbwire_Error error{};
+  pbwire_ShmRing ring{};
+  ASSERT_EQ(0, pbwire_shmring_create(&ring, nullptr, 16, 3, 0, &error))
+      << error.msg;
+
+  // Slot count is rounded up to a power of two
+  for (uint32_t idx = 0; idx < 4; idx++) {
+    ASSERT_EQ(0, pbwire_shmring_write(&ring, "hello", 5, 0, &error))
+        << error.msg;
+  }
+  EXPECT_EQ(-1, pbwire_shmring_write(&ring, "hello", 5, 0, &error));
+  EXPECT_EQ(PBWIRE_SHM_WOULDBLOCK, error.code);
+  EXPECT_EQ(-1, pbwire_shmring_write(&ring, "hello", 5, 10, &error));
+  EXPECT_EQ(PBWIRE_SHM_WOULDBLOCK, error.code);
+  EXPECT_EQ(-1, pbwire_shmring_write(&ring, "0123456789abcdefg", 17, 0,
+                                     &error));
+  EXPECT_EQ(PBWIRE_SHM_TOOLARGE, error.code);
+
+  pbwire_ShmStats stats{};
+  pbwire_shmring_get_stats(&ring, &stats);
+  EXPECT_EQ(2, stats.full_events);
+  EXPECT_LE(1, stats.producer_waits);
+  EXPECT_EQ(4, stats.high_watermark);
+
+  // An abandoned write is never delivered to the consumer
+  pbwire_ParseContext pctx{};
+  pctx.error = &error;
+  ASSERT_EQ(0, pbwire_shmring_begin_read(&ring, &pctx, 0));
+  pbwire_shmring_end_read(&ring, &pctx);
+  pbwire_EmitContext ectx{};
+  ectx.error = &error;
+  ASSERT_EQ(0, pbwire_shmring_begin_write(&ring, &ectx, 0));
+  ASSERT_EQ(0, pbwire_shmring_commit_write(&ring, &ectx, -1));
+
+  for (uint32_t idx = 0; idx < 3; idx++) {
+    ASSERT_EQ(0, pbwire_shmring_begin_read(&ring, &pctx, 0));
+    EXPECT_EQ(5, pctx.buffer.end - pctx.buffer.begin);
+    EXPECT_EQ(0, memcmp(pctx.buffer.begin, "hello", 5));
+    pbwire_shmring_end_read(&ring, &pctx);
+  }
+  EXPECT_EQ(-1, pbwire_shmring_begin_read(&ring, &pctx, 0));
+  EXPECT_EQ(PBWIRE_SHM_WOULDBLOCK, error.code);
+  pbwire_shmring_close(&ring);
+}
+
+TEST(pbwireShmTest, AttachByFd) {
+  pbwire_Error error{};
+  pbwire_ShmRing ring{};
+  ASSERT_EQ(0, pbwire_shmring_create(&ring, nullptr, 32, 2, 0, &error))
+      << error.msg;
+
+  pbwire_ShmRing other{};
+  ASSERT_EQ(0, pbwire_shmring_attach(&other, dup(ring.fd), &error))
+      << error.msg;
+  EXPECT_EQ(32, pbwire_shmring_capacity(&other));
+  ASSERT_EQ(0, pbwire_shmring_write(&other, "abc", 3, 0, &error));
+
+  pbwire_ParseContext pctx{};
+  pctx.error = &error;
+  ASSERT_EQ(0, pbwire_shmring_begin_read(&ring, &pctx, 0)) << error.msg;
+  EXPECT_EQ(0, memcmp(pctx.buffer.begin, "abc", 3));
+  pbwire_shmring_end_read(&ring, &pctx);
+
+  pbwire_shmring_close(&other);
+  pbwire_shmring_close(&ring);
+
+  int pipefd[2];
+  ASSERT_EQ(0, pipe(pipefd));
+  close(pipefd[1]);
+  EXPECT_EQ(-1, pbwire_shmring_attach(&other, pipefd[0], &error));
+  close(pipefd[0]);
+}
+
+TEST(pbwireShmTest, CreateRejectsInvalidGeometry) {
+  struct {
+    uint32_t slot_size;
+    uint32_t slot_count;
+  } geometries[] = {
+      {32, 0},               // no slots
+      {32, (1u << 30) + 1},  // too many slots
+      {0, 4},                // empty slots
+      {0xFFFFFFF0, 1},       // slot stride doesn't fit in 32 bits
+  };
+  for (const auto& geometry : geometries) {
+    pbwire_Error error{};
+    pbwire_ShmRing ring{};
+    ring.fd = -1;
+    EXPECT_EQ(-1, pbwire_shmring_create(&ring, nullptr, geometry.slot_size,
+                                        geometry.slot_count, 0, &error))
+        << geometry.slot_size << " x " << geometry.slot_count;
+    EXPECT_EQ(PBWIRE_INTERNAL_ERROR, error.code);
+    EXPECT_EQ(-1, ring.fd);
+  }
+}
+
+TEST(pbwireShmTest, OpenByName) {
+  std::string name = "/pbwire_shm-test-" + std::to_string(getpid());
+  pbwire_Error error{};
+  pbwire_ShmRing ring{};
+  ASSERT_EQ(0, pbwire_shmring_create(&ring, name.c_str(), 32, 2, 0, &error))
+      << error.msg;
+
+  // The name is taken until it is unlinked
+  pbwire_ShmRing other{};
+  EXPECT_EQ(-1,
+            pbwire_shmring_create(&other, name.c_str(), 32, 2, 0, &error));
+
+  ASSERT_EQ(0, pbwire_shmring_open(&other, name.c_str(), &error)) << error.msg;
+  EXPECT_EQ(32, pbwire_shmring_capacity(&other));
+  ASSERT_EQ(0, pbwire_shmring_write(&other, "abc", 3, 0, &error));
+
+  // Mapped rings outlive the name
+  ASSERT_EQ(0, pbwire_shmring_unlink(name.c_str(), &error)) << error.msg;
+  pbwire_ParseContext pctx{};
+  pctx.error = &error;
+  ASSERT_EQ(0, pbwire_shmring_begin_read(&ring, &pctx, 0)) << error.msg;
+  EXPECT_EQ(0, memcmp(pctx.buffer.begin, "abc", 3));
+  pbwire_shmring_end_read(&ring, &pctx);
+  pbwire_shmring_close(&other);
+
+  pbwire_ShmRing missing{};
+  EXPECT_EQ(-1, pbwire_shmring_open(&missing, name.c_str(), &error));
+  EXPECT_EQ(-1, pbwire_shmring_unlink(name.c_str(), &error));
+
+  // After the unlink the name can be used again
+  ASSERT_EQ(0, pbwire_shmring_create(&other, name.c_str(), 32, 2, 0, &error))
+      << error.msg;
+  EXPECT_EQ(0, pbwire_shmring_unlink(name.c_str(), &error)) << error.msg;
+  pbwire_shmring_close(&other);
+  pbwire_shmring_close(&ring);
+}
+
+// Overwrite the 32-bit word at `offset` in the segment header
+static void poke_header(int fd, off_t offset, uint32_t value) {
+  ASSERT_EQ(sizeof(value), pwrite(fd, &value, sizeof(value), offset));
+}
+
+TEST(pbwireShmTest, AttachRejectsInvalidGeometry) {
+  pbwire_Error error{};
+  pbwire_ShmRing ring{};
+  ASSERT_EQ(0, pbwire_shmring_create(&ring, nullptr, 32, 4, 0, &error))
+      << error.msg;
+
+  // Offsets of slot_size, slot_count and slot_stride in the header
+  const off_t kSlotSize = 3 * sizeof(uint32_t);
+  const off_t kSlotCount = 4 * sizeof(uint32_t);
+  const off_t kSlotStride = 5 * sizeof(uint32_t);
+  struct {
+    off_t offset;
+    uint32_t value;
+  } corruptions[] = {
+      {kSlotCount, 0},          // no slots
+      {kSlotCount, 3},          // not a power of two
+      {kSlotCount, 1u << 20},   // more slots than the segment holds
+      {kSlotStride, 1u << 20},  // larger slots than the segment holds
+      {kSlotStride, 65},        // misaligned slots
+      {kSlotSize, 4096},        // payload larger than the slot
+  };
+  for (const auto& corruption : corruptions) {
+    uint32_t original = 0;
+    ASSERT_EQ(sizeof(original), pread(ring.fd, &original, sizeof(original),
+                                      corruption.offset));
+    poke_header(ring.fd, corruption.offset, corruption.value);
+    pbwire_ShmRing other{};
+    int fd = dup(ring.fd);
+    EXPECT_EQ(-1, pbwire_shmring_attach(&other, fd, &error))
+        << corruption.offset << ": " << corruption.value;
+    EXPECT_EQ(PBWIRE_SHM_BADSEGMENT, error.code);
+    close(fd);
+    poke_header(ring.fd, corruption.offset, original);
+  }
+
+  pbwire_ShmRing other{};
+  ASSERT_EQ(0, pbwire_shmring_attach(&other, dup(ring.fd), &error))
+      << error.msg;
+  pbwire_shmring_close(&other);
+  pbwire_shmring_close(&ring);
+}
@@ -0,0 +1,590 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/protostruct/pbwire_shm.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <new>
+
+#include "tangent/protostruct/pbwire_internal.h"
+
+namespace {
+
+constexpr uint32_t kShmMagic = 0x70627368;  // "pbsh"
+constexpr uint32_t kShmVersion = 1;
+constexpr size_t kCacheLine = 64;
+
+// Slot length marker for a slot that was claimed but whose message was
+// abandoned by the producer. The consumer skips these.
+constexpr uint32_t kAbandoned = UINT32_MAX;
+
+typedef std::atomic<uint64_t> Counter;
+
+// Layout of the shared segment. Fields written by different parties are kept
+// on separate cache lines so that the producer(s) and consumer don't ping-pong
+// lines on the fast path.
+struct ShmHeader {
+  // Immutable after creation
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint32_t slot_size;
+  uint32_t slot_count;
+  uint32_t slot_stride;
+  uint64_t segment_size;
+
+  // Written by producers
+  alignas(kCacheLine) std::atomic<uint64_t> head;
+  // Written by the consumer
+  alignas(kCacheLine) std::atomic<uint64_t> tail;
+
+  // Consumer sleeps on `data_seq`, producers bump it on commit if
+  // `consumer_waiting` is set
+  alignas(kCacheLine) std::atomic<uint32_t> data_seq;
+  std::atomic<uint32_t> consumer_waiting;
+
+  // Producers sleep on `space_seq`, the consumer bumps it on release if
+  // `producers_waiting` is nonzero
+  alignas(kCacheLine) std::atomic<uint32_t> space_seq;
+  std::atomic<uint32_t> producers_waiting;
+
+  alignas(kCacheLine) Counter messages_written;
+  Counter bytes_written;
+  Counter full_events;
+  Counter producer_waits;
+  Counter high_watermark;
+  alignas(kCacheLine) Counter messages_read;
+  Counter consumer_waits;
+  Counter wakeups;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory ring requires lock-free 64bit atomics");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex words must be 32 bits");
+
+// Each slot is a sequence number followed by the payload length and payload.
+// The sequence number follows the scheme of Dmitry Vyukov's bounded queue:
+// a slot at ring position `pos` is free for writing when `seq == pos`, and
+// ready for reading when `seq == pos + 1`.
+struct SlotHeader {
+  std::atomic<uint64_t> seq;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+inline uint64_t round_up(uint64_t value, uint64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+inline uint32_t next_pow2(uint32_t value) {
+  uint32_t out = 1;
+  while (out < value) {
+    out <<= 1;
+  }
+  return out;
+}
+
+inline ShmHeader* get_header(const pbwire_ShmRing* ring) {
+  return static_cast<ShmHeader*>(ring->_mem);
+}
+
+inline char* slot_base(ShmHeader* header) {
+  return reinterpret_cast<char*>(header) + round_up(sizeof(ShmHeader), 4096);
+}
+
+inline SlotHeader* get_slot(ShmHeader* header, uint64_t pos) {
+  uint64_t idx = pos & (header->slot_count - 1);
+  return reinterpret_cast<SlotHeader*>(slot_base(header) +
+                                       idx * header->slot_stride);
+}
+
+inline char* slot_payload(SlotHeader* slot) {
+  return reinterpret_cast<char*>(slot) + sizeof(SlotHeader);
+}
+
+// Inverse of slot_payload(), used to recover the slot from the buffer that we
+// handed out to the caller.
+inline SlotHeader* payload_slot(const char* payload) {
+  return reinterpret_cast<SlotHeader*>(const_cast<char*>(payload) -
+                                       sizeof(SlotHeader));
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// NOTE(josh): not FUTEX_PRIVATE_FLAG, the futex word is in a shared mapping
+// and the waker may be a different process.
+int futex_wait(std::atomic<uint32_t>* addr, uint32_t expected,
+               const struct timespec* timeout) {
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT,
+                 expected, timeout, nullptr, 0);
+}
+
+int futex_wake(std::atomic<uint32_t>* addr, int count) {
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE,
+                 count, nullptr, nullptr, 0);
+}
+
+// Tracks the remaining time for a wait which may be split over several
+// futex calls
+struct Deadline {
+  explicit Deadline(int32_t timeout_ms) : infinite(timeout_ms < 0) {
+    if (!infinite) {
+      clock_gettime(CLOCK_MONOTONIC, &when);
+      when.tv_sec += timeout_ms / 1000;
+      when.tv_nsec += (timeout_ms % 1000) * 1000000L;
+      if (when.tv_nsec >= 1000000000L) {
+        when.tv_sec += 1;
+        when.tv_nsec -= 1000000000L;
+      }
+    }
+  }
+
+  // Fill `remaining` with the time until the deadline. Return false if the
+  // deadline has already passed.
+  bool get_remaining(struct timespec* remaining) const {
+    struct timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    remaining->tv_sec = when.tv_sec - now.tv_sec;
+    remaining->tv_nsec = when.tv_nsec - now.tv_nsec;
+    if (remaining->tv_nsec < 0) {
+      remaining->tv_sec -= 1;
+      remaining->tv_nsec += 1000000000L;
+    }
+    return remaining->tv_sec >= 0;
+  }
+
+  bool infinite;
+  struct timespec when {};
+};
+
+void update_max(Counter* counter, uint64_t value) {
+  uint64_t prev = counter->load(std::memory_order_relaxed);
+  while (prev < value && !counter->compare_exchange_weak(
+                             prev, value, std::memory_order_relaxed)) {
+  }
+}
+
+// Try to claim the slot at the head of the ring. Return the slot or null if
+// the ring is full.
+SlotHeader* try_claim(ShmHeader* header) {
+  uint64_t pos = header->head.load(std::memory_order_relaxed);
+  while (true) {
+    SlotHeader* slot = get_slot(header, pos);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      if (!(header->flags & PBWIRE_SHM_MPSC)) {
+        header->head.store(pos + 1, std::memory_order_relaxed);
+        return slot;
+      }
+      if (header->head.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        return slot;
+      }
+      // `pos` was reloaded by the failed CAS
+    } else if (diff < 0) {
+      return nullptr;
+    } else {
+      pos = header->head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// Return the slot at the tail of the ring if it is ready to be read, else
+// null.
+SlotHeader* try_peek(ShmHeader* header) {
+  uint64_t pos = header->tail.load(std::memory_order_relaxed);
+  SlotHeader* slot = get_slot(header, pos);
+  if (slot->seq.load(std::memory_order_acquire) == pos + 1) {
+    return slot;
+  }
+  return nullptr;
+}
+
+void release_slot(ShmHeader* header, SlotHeader* slot) {
+  uint64_t pos = header->tail.load(std::memory_order_relaxed);
+  slot->seq.store(pos + header->slot_count, std::memory_order_release);
+  header->tail.store(pos + 1, std::memory_order_relaxed);
+
+  // Pairs with the fence in wait_for(): either a producer sees the
+  // released slot, or we see that it is waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (header->producers_waiting.load(std::memory_order_relaxed)) {
+    header->space_seq.fetch_add(1, std::memory_order_relaxed);
+    futex_wake(&header->space_seq, INT_MAX);
+    header->wakeups.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void publish_slot(ShmHeader* header, SlotHeader* slot, uint32_t length) {
+  uint64_t pos = slot->seq.load(std::memory_order_relaxed);
+  slot->length = length;
+  slot->seq.store(pos + 1, std::memory_order_release);
+
+  // Pairs with the fence in wait_for()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (header->consumer_waiting.load(std::memory_order_relaxed)) {
+    header->data_seq.fetch_add(1, std::memory_order_relaxed);
+    futex_wake(&header->data_seq, 1);
+    header->wakeups.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Shared implementation of the blocking wait for both sides of the ring.
+// `try_fn` is polled until it returns non-null or the deadline expires.
+template <typename TryFn>
+SlotHeader* wait_for(pbwire_ShmRing* ring, int32_t timeout_ms,
+                     std::atomic<uint32_t>* futex_word,
+                     std::atomic<uint32_t>* waiting, Counter* wait_counter,
+                     TryFn try_fn) {
+  SlotHeader* slot = try_fn();
+  if (slot || timeout_ms == 0) {
+    return slot;
+  }
+
+  for (uint32_t iter = 0; iter < ring->busy_poll; iter++) {
+    cpu_relax();
+    if ((slot = try_fn())) {
+      return slot;
+    }
+  }
+
+  Deadline deadline{timeout_ms};
+  while (true) {
+    waiting->fetch_add(1, std::memory_order_relaxed);
+    uint32_t seq = futex_word->load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ((slot = try_fn())) {
+      waiting->fetch_sub(1, std::memory_order_relaxed);
+      return slot;
+    }
+
+    struct timespec remaining {};
+    if (!deadline.infinite && !deadline.get_remaining(&remaining)) {
+      waiting->fetch_sub(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    wait_counter->fetch_add(1, std::memory_order_relaxed);
+    futex_wait(futex_word, seq, deadline.infinite ? nullptr : &remaining);
+    waiting->fetch_sub(1, std::memory_order_relaxed);
+
+    if ((slot = try_fn())) {
+      return slot;
+    }
+  }
+}
+
+int map_segment(pbwire_ShmRing* ring, int fd, pbwire_Error* error) {
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "fstat failed: " << strerror(errno);
+    return -1;
+  }
+  if (static_cast<size_t>(info.st_size) < round_up(sizeof(ShmHeader), 4096)) {
+    pbwire_error(error, PBWIRE_SHM_BADSEGMENT)
+        << "segment is too small (" << info.st_size << " bytes)";
+    return -1;
+  }
+
+  void* mem = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  if (mem == MAP_FAILED) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "mmap failed: " << strerror(errno);
+    return -1;
+  }
+
+  ShmHeader* header = static_cast<ShmHeader*>(mem);
+  if (header->magic != kShmMagic || header->version != kShmVersion ||
+      header->segment_size != static_cast<uint64_t>(info.st_size)) {
+    munmap(mem, info.st_size);
+    pbwire_error(error, PBWIRE_SHM_BADSEGMENT)
+        << "segment is not a pbwire ring (or has a different version)";
+    return -1;
+  }
+
+  // Everything else in the header is used to index into the mapping, so
+  // don't trust it any more than the magic.
+  uint32_t slot_count = header->slot_count;
+  uint32_t slot_stride = header->slot_stride;
+  uint64_t slots_size = static_cast<uint64_t>(slot_stride) * slot_count;
+  if (slot_count == 0 || (slot_count & (slot_count - 1)) ||
+      header->slot_size == 0 || slot_stride % alignof(SlotHeader) ||
+      slot_stride < sizeof(SlotHeader) + uint64_t{header->slot_size} ||
+      slots_size > info.st_size - round_up(sizeof(ShmHeader), 4096)) {
+    munmap(mem, info.st_size);
+    pbwire_error(error, PBWIRE_SHM_BADSEGMENT)
+        << "segment has an invalid ring geometry (" << slot_count
+        << " slots of " << slot_stride << " bytes in " << info.st_size
+        << " bytes)";
+    return -1;
+  }
+
+  ring->fd = fd;
+  ring->_mem = mem;
+  ring->_mapsize = info.st_size;
+  return 0;
+}
+
+// Close a segment which failed to initialize, and remove its name so that
+// nobody opens it half made
+void discard_segment(const char* name, int fd) {
+  if (name) {
+    shm_unlink(name);
+  }
+  close(fd);
+}
+
+}  // namespace
+
+int pbwire_shmring_create(pbwire_ShmRing* ring, const char* name,
+                          uint32_t slot_size, uint32_t slot_count,
+                          uint32_t flags, pbwire_Error* error) {
+  if (slot_count < 1 || slot_count > (1u << 30)) {
+    pbwire_error(error, PBWIRE_INTERNAL_ERROR)
+        << "invalid slot count " << slot_count;
+    return -1;
+  }
+  slot_count = next_pow2(slot_count);
+
+  // The stride is stored in 32 bits and the segment must be mappable, so
+  // reject the geometries which attach would reject.
+  uint64_t header_size = round_up(sizeof(ShmHeader), 4096);
+  uint64_t max_segment_size =
+      std::min<uint64_t>(SIZE_MAX, std::numeric_limits<off_t>::max());
+  uint64_t slot_stride = round_up(sizeof(SlotHeader) + uint64_t{slot_size},
+                                  kCacheLine);
+  if (slot_size == 0 || slot_stride > UINT32_MAX ||
+      slot_stride * slot_count > max_segment_size - header_size) {
+    pbwire_error(error, PBWIRE_INTERNAL_ERROR)
+        << "invalid ring geometry (" << slot_count << " slots of " << slot_size
+        << " bytes)";
+    return -1;
+  }
+  uint64_t segment_size = header_size + slot_stride * slot_count;
+
+  int fd = -1;
+  if (name) {
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  } else {
+    fd = memfd_create("pbwire-ring", MFD_CLOEXEC);
+  }
+  if (fd < 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "failed to create segment: " << strerror(errno);
+    return -1;
+  }
+
+  if (ftruncate(fd, segment_size) != 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "ftruncate failed: " << strerror(errno);
+    discard_segment(name, fd);
+    return -1;
+  }
+
+  void* mem = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  if (mem == MAP_FAILED) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "mmap failed: " << strerror(errno);
+    discard_segment(name, fd);
+    return -1;
+  }
+
+  ShmHeader* header = new (mem) ShmHeader{};
+  header->version = kShmVersion;
+  header->flags = flags;
+  header->slot_size = slot_size;
+  header->slot_count = slot_count;
+  header->slot_stride = static_cast<uint32_t>(slot_stride);
+  header->segment_size = segment_size;
+  for (uint32_t idx = 0; idx < slot_count; idx++) {
+    new (get_slot(header, idx)) SlotHeader{{idx}, 0, 0};
+  }
+
+  // Publish the magic last so that a process that attaches by name doesn't
+  // see a partially initialized header.
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kShmMagic;
+
+  ring->fd = fd;
+  ring->_mem = mem;
+  ring->_mapsize = segment_size;
+  return 0;
+}
+
+int pbwire_shmring_attach(pbwire_ShmRing* ring, int fd, pbwire_Error* error) {
+  return map_segment(ring, fd, error);
+}
+
+int pbwire_shmring_open(pbwire_ShmRing* ring, const char* name,
+                        pbwire_Error* error) {
+  int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "shm_open(" << name << ") failed: " << strerror(errno);
+    return -1;
+  }
+  if (map_segment(ring, fd, error)) {
+    close(fd);
+    return -1;
+  }
+  return 0;
+}
+
+int pbwire_shmring_unlink(const char* name, pbwire_Error* error) {
+  if (shm_unlink(name) != 0) {
+    pbwire_error(error, PBWIRE_SYSTEM_ERROR)
+        << "shm_unlink(" << name << ") failed: " << strerror(errno);
+    return -1;
+  }
+  return 0;
+}
+
+void pbwire_shmring_close(pbwire_ShmRing* ring) {
+  if (ring->_mem) {
+    munmap(ring->_mem, ring->_mapsize);
+    ring->_mem = nullptr;
+    ring->_mapsize = 0;
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+    ring->fd = -1;
+  }
+}
+
+uint32_t pbwire_shmring_capacity(const pbwire_ShmRing* ring) {
+  return get_header(ring)->slot_size;
+}
+
+int pbwire_shmring_begin_write(pbwire_ShmRing* ring, pbwire_EmitContext* ctx,
+                               int32_t timeout_ms) {
+  ShmHeader* header = get_header(ring);
+  SlotHeader* slot = try_claim(header);
+  if (!slot) {
+    header->full_events.fetch_add(1, std::memory_order_relaxed);
+    slot = wait_for(ring, timeout_ms, &header->space_seq,
+                    &header->producers_waiting, &header->producer_waits,
+                    [header]() { return try_claim(header); });
+  }
+  if (!slot) {
+    pbwire_error(ctx->error, PBWIRE_SHM_WOULDBLOCK) << "ring is full";
+    return -1;
+  }
+
+  uint64_t occupancy = header->head.load(std::memory_order_relaxed) -
+                       header->tail.load(std::memory_order_relaxed);
+  update_max(&header->high_watermark, occupancy);
+
+  char* payload = slot_payload(slot);
+  pbwire_writebuffer_init(&ctx->buffer, payload, payload + header->slot_size);
+  return 0;
+}
+
+int pbwire_shmring_commit_write(pbwire_ShmRing* ring, pbwire_EmitContext* ctx,
+                                int nbytes) {
+  ShmHeader* header = get_header(ring);
+  SlotHeader* slot = payload_slot(ctx->buffer.begin);
+  if (nbytes < 0) {
+    publish_slot(header, slot, kAbandoned);
+    return 0;
+  }
+  if (static_cast<uint32_t>(nbytes) > header->slot_size) {
+    publish_slot(header, slot, kAbandoned);
+    pbwire_error(ctx->error, PBWIRE_SHM_TOOLARGE)
+        << "message of " << nbytes << " bytes exceeds slot size "
+        << header->slot_size;
+    return -1;
+  }
+
+  header->messages_written.fetch_add(1, std::memory_order_relaxed);
+  header->bytes_written.fetch_add(nbytes, std::memory_order_relaxed);
+  publish_slot(header, slot, nbytes);
+  return 0;
+}
+
+int pbwire_shmring_write(pbwire_ShmRing* ring, const char* data, size_t len,
+                         int32_t timeout_ms, pbwire_Error* error) {
+  if (len > get_header(ring)->slot_size) {
+    pbwire_error(error, PBWIRE_SHM_TOOLARGE)
+        << "message of " << len << " bytes exceeds slot size "
+        << get_header(ring)->slot_size;
+    return -1;
+  }
+
+  pbwire_EmitContext ctx{};
+  ctx.error = error;
+  if (pbwire_shmring_begin_write(ring, &ctx, timeout_ms)) {
+    return -1;
+  }
+  memcpy(ctx.buffer.begin, data, len);
+  return pbwire_shmring_commit_write(ring, &ctx, len);
+}
+
+int pbwire_shmring_begin_read(pbwire_ShmRing* ring, pbwire_ParseContext* ctx,
+                              int32_t timeout_ms) {
+  ShmHeader* header = get_header(ring);
+  while (true) {
+    SlotHeader* slot =
+        wait_for(ring, timeout_ms, &header->data_seq,
+                 &header->consumer_waiting, &header->consumer_waits,
+                 [header]() { return try_peek(header); });
+    if (!slot) {
+      pbwire_error(ctx->error, PBWIRE_SHM_WOULDBLOCK) << "ring is empty";
+      return -1;
+    }
+    if (slot->length == kAbandoned) {
+      release_slot(header, slot);
+      continue;
+    }
+
+    const char* payload = slot_payload(slot);
+    pbwire_readbuffer_init(&ctx->buffer, payload, payload + slot->length);
+    return 0;
+  }
+}
+
+void pbwire_shmring_end_read(pbwire_ShmRing* ring, pbwire_ParseContext* ctx) {
+  ShmHeader* header = get_header(ring);
+  header->messages_read.fetch_add(1, std::memory_order_relaxed);
+  release_slot(header, payload_slot(ctx->buffer.begin));
+}
+
+void pbwire_shmring_get_stats(const pbwire_ShmRing* ring,
+                              pbwire_ShmStats* stats) {
+  ShmHeader* header = get_header(ring);
+  stats->messages_written = header->messages_written.load();
+  stats->bytes_written = header->bytes_written.load();
+  stats->messages_read = header->messages_read.load();
+  stats->full_events = header->full_events.load();
+  stats->producer_waits = header->producer_waits.load();
+  stats->consumer_waits = header->consumer_waits.load();
+  stats->wakeups = header->wakeups.load();
+  stats->high_watermark = header->high_watermark.load();
+}
+
+uint64_t pbwire_shmring_size(const pbwire_ShmRing* ring) {
+  ShmHeader* header = get_header(ring);
+  return header->head.load(std::memory_order_relaxed) -
+         header->tail.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,143 @@
+#pragma once
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/protostruct/pbwire.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================== Shared Memory Ring ============================ */
+// A fixed-slot message ring living in a shared memory segment (memfd or POSIX
+// shm). Producers serialize directly into a ring slot with pbemit_XXX() and
+// the consumer parses directly out of the slot with pbparse_XXX(), so a
+// message crosses the process boundary without any syscalls or copies on the
+// fast path. Blocking waits use a futex in the shared segment, optionally
+// preceded by a bounded busy-poll.
+//
+// Typical producer usage:
+//
+//   pbwire_EmitContext ectx{};
+//   ectx.error = &error;
+//   pbwire_lengthcache_init(&ectx.length_cache, cache, cache + 32);
+//   if (pbwire_shmring_begin_write(&ring, &ectx, -1) == 0) {
+//     int nbytes = pbemit_MyMessage(&ectx, &msg);
+//     pbwire_shmring_commit_write(&ring, &ectx, nbytes);
+//   }
+//
+// Typical consumer usage:
+//
+//   pbwire_ParseContext pctx{};
+//   pctx.error = &error;
+//   if (pbwire_shmring_begin_read(&ring, &pctx, -1) == 0) {
+//     pbparse_MyMessage(&pctx, &msg);
+//     pbwire_shmring_end_read(&ring, &pctx);
+//   }
+
+enum pbwire_ShmFlags {
+  // Allow multiple concurrent producers (processes or threads). Without this
+  // flag the ring assumes exactly one producer and skips the CAS on claim.
+  PBWIRE_SHM_MPSC = 0x01,
+};
+
+// Backpressure and activity counters. These are maintained in the shared
+// segment so that both sides observe the same values.
+typedef struct pbwire_ShmStats {
+  uint64_t messages_written;  //< number of committed messages
+  uint64_t bytes_written;     //< total payload bytes committed
+  uint64_t messages_read;     //< number of messages released by the consumer
+  uint64_t full_events;       //< producer found the ring full
+  uint64_t producer_waits;    //< producer went to sleep on the futex
+  uint64_t consumer_waits;    //< consumer went to sleep on the futex
+  uint64_t wakeups;           //< futex wake syscalls issued
+  uint64_t high_watermark;    //< maximum observed occupancy (in slots)
+} pbwire_ShmStats;
+
+// Process-local handle to a mapped ring. The handle is not modified by reads
+// or writes so it may be shared by all producer threads in a process.
+typedef struct pbwire_ShmRing {
+  // File descriptor of the shared segment. Can be sent to another process
+  // (e.g. over a unix socket or by inheritance) and passed to
+  // pbwire_shmring_attach().
+  int fd;
+
+  // Number of iterations to busy-poll before sleeping on the futex. Zero
+  // means go straight to sleep.
+  uint32_t busy_poll;
+
+  void* _mem;
+  size_t _mapsize;
+} pbwire_ShmRing;
+
+// Create a new ring segment and map it. If `name` is NULL the segment is
+// anonymous (memfd_create) and can only be shared by fd. Otherwise it is
+// created with shm_open(name), which fails if the name already exists. The
+// caller owns the name and must remove it with pbwire_shmring_unlink(), e.g.
+// once every peer has opened the ring, or before re-creating the ring after a
+// restart. `slot_size` is the maximum encoded message size. `slot_count` is
+// rounded up to a power of two. Return 0 on success or -1 on error.
+int pbwire_shmring_create(pbwire_ShmRing* ring, const char* name,
+                          uint32_t slot_size, uint32_t slot_count,
+                          uint32_t flags, pbwire_Error* error);
+
+// Map an existing ring segment given its file descriptor. On success the ring
+// takes ownership of `fd`.
+int pbwire_shmring_attach(pbwire_ShmRing* ring, int fd, pbwire_Error* error);
+
+// Map an existing ring segment that was created with a name.
+int pbwire_shmring_open(pbwire_ShmRing* ring, const char* name,
+                        pbwire_Error* error);
+
+// Remove the name of a ring segment created with a name. Rings which are
+// already mapped stay usable. Return 0 on success or -1 on error (including
+// if there is no such name).
+int pbwire_shmring_unlink(const char* name, pbwire_Error* error);
+
+// Unmap the ring and close the file descriptor.
+void pbwire_shmring_close(pbwire_ShmRing* ring);
+
+// Maximum number of payload bytes that fit in a slot
+uint32_t pbwire_shmring_capacity(const pbwire_ShmRing* ring);
+
+/* -------------------------------- Producer -------------------------------- */
+
+// Claim the next free slot and point `ctx->buffer` at it. `timeout_ms` of 0
+// returns immediately with PBWIRE_SHM_WOULDBLOCK if the ring is full, a
+// negative value waits indefinitely. Return 0 on success or -1 on error.
+int pbwire_shmring_begin_write(pbwire_ShmRing* ring, pbwire_EmitContext* ctx,
+                               int32_t timeout_ms);
+
+// Publish the slot claimed by begin_write() with `nbytes` of payload. If
+// `nbytes` is negative (i.e. the emitter failed) the slot is released without
+// being delivered.
+int pbwire_shmring_commit_write(pbwire_ShmRing* ring, pbwire_EmitContext* ctx,
+                                int nbytes);
+
+// Convenience wrapper to copy an already-serialized message into the ring
+int pbwire_shmring_write(pbwire_ShmRing* ring, const char* data, size_t len,
+                         int32_t timeout_ms, pbwire_Error* error);
+
+/* -------------------------------- Consumer -------------------------------- */
+
+// Wait for the next message and point `ctx->buffer` at its payload, in place.
+// Return 0 on success or -1 on error (PBWIRE_SHM_WOULDBLOCK on timeout).
+int pbwire_shmring_begin_read(pbwire_ShmRing* ring, pbwire_ParseContext* ctx,
+                              int32_t timeout_ms);
+
+// Release the slot returned by begin_read() back to the producers.
+void pbwire_shmring_end_read(pbwire_ShmRing* ring, pbwire_ParseContext* ctx);
+
+/* -------------------------------- Statistics ------------------------------ */
+
+// Copy out the current counters
+void pbwire_shmring_get_stats(const pbwire_ShmRing* ring,
+                              pbwire_ShmStats* stats);
+
+// Number of messages currently queued
+uint64_t pbwire_shmring_size(const pbwire_ShmRing* ring);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
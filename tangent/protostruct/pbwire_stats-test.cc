@@ -0,0 +1,216 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/protostruct/pbwire_stats.h"
+#include "tangent/protostruct/test/test_messages.pbwire.h"
+
+#ifndef PBWIRE_WITH_STATS
+#error "pbwire_stats-test must be compiled with PBWIRE_WITH_STATS"
+#endif
+
+// Return the current process-wide counters for the type named `name`
+static pbwire_TypeStats get_stats(const std::string& name) {
+  std::vector<pbwire_TypeStats> all(PBWIRE_STATS_MAX_TYPES);
+  size_t ntypes = pbwire_stats_snapshot(all.data(), all.size());
+  for (size_t idx = 0; idx < ntypes; idx++) {
+    if (name == all[idx].name) {
+      return all[idx];
+    }
+  }
+  pbwire_TypeStats empty{};
+  empty.name = "";
+  return empty;
+}
+
+// Counters for one type accumulated since construction
+class StatsDelta {
+ public:
+  explicit StatsDelta(const std::string& name)
+      : name_(name), begin_(get_stats(name)) {}
+
+  uint64_t operator[](pbwire_StatsCounter counter) const {
+    return get_stats(name_).counters[counter] - begin_.counters[counter];
+  }
+
+  uint64_t errors(pbwire_ErrorCode code) const {
+    return get_stats(name_).errors[code] - begin_.errors[code];
+  }
+
+ private:
+  std::string name_;
+  pbwire_TypeStats begin_;
+};
+
+static void append_varint(std::string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+static int parse(const std::string& data, int (*fn)(pbwire_ParseContext*,
+                                                    MyMessageC*),
+                 MyMessageC* obj, pbwire_Error* error) {
+  pbwire_ParseContext ctx{};
+  ctx.error = error;
+  ctx.stats = pbwire_stats_thread_slot();
+  pbwire_readbuffer_init(&ctx.buffer, data.data(), data.data() + data.size());
+  return fn(&ctx, obj);
+}
+
+TEST(pbwireStatsTest, CountsCallsAndBytesPerType) {
+  StatsDelta stats_a{"MyMessageA"};
+  StatsDelta stats_b{"MyMessageB"};
+
+  char buffer[256];
+  uint32_t lengths[16];
+  pbwire_Error error{};
+  pbwire_EmitContext ectx{};
+  ectx.error = &error;
+  ectx.stats = pbwire_stats_thread_slot();
+  pbwire_writebuffer_init(&ectx.buffer, buffer, buffer + sizeof(buffer));
+  pbwire_lengthcache_init(&ectx.length_cache, lengths, lengths + 16);
+
+  MyMessageA message{};
+  message.fieldA = 42;
+  message.fieldD = MyEnumA_VALUE2;
+  int nbytes = pbemit_MyMessageA(&ectx, &message);
+  ASSERT_LT(0, nbytes) << error.msg;
+  EXPECT_EQ(1, stats_a[PBWIRE_STAT_EMIT_CALLS]);
+  EXPECT_EQ(nbytes, stats_a[PBWIRE_STAT_EMIT_BYTES]);
+
+  // Wrap the message as field 2 of a MyMessageB
+  std::string data;
+  append_varint(&data, (2 << 3) | 2);
+  append_varint(&data, nbytes);
+  data.append(buffer, nbytes);
+
+  pbwire_ParseContext pctx{};
+  pctx.error = &error;
+  pctx.stats = pbwire_stats_thread_slot();
+  pbwire_readbuffer_init(&pctx.buffer, data.data(), data.data() + data.size());
+  MyMessageB parsed{};
+  ASSERT_EQ(data.size(), pbparse_MyMessageB(&pctx, &parsed)) << error.msg;
+  EXPECT_EQ(42, parsed.fieldA.fieldA);
+  EXPECT_EQ(MyEnumA_VALUE2, parsed.fieldA.fieldD);
+
+  EXPECT_EQ(1, stats_b[PBWIRE_STAT_PARSE_CALLS]);
+  EXPECT_EQ(data.size(), stats_b[PBWIRE_STAT_PARSE_BYTES]);
+  EXPECT_EQ(0, stats_b[PBWIRE_STAT_EMIT_CALLS]);
+
+  // The nested message is counted under its own type
+  EXPECT_EQ(1, stats_a[PBWIRE_STAT_PARSE_CALLS]);
+  EXPECT_EQ(nbytes, stats_a[PBWIRE_STAT_PARSE_BYTES]);
+
+  // Contexts without a slot are not counted
+  pctx.stats = nullptr;
+  pbwire_readbuffer_init(&pctx.buffer, data.data(), data.data() + data.size());
+  ASSERT_EQ(data.size(), pbparse_MyMessageB(&pctx, &parsed));
+  EXPECT_EQ(1, stats_b[PBWIRE_STAT_PARSE_CALLS]);
+}
+
+TEST(pbwireStatsTest, CountsUnknownFieldsAndErrors) {
+  StatsDelta stats{"MyMessageC"};
+
+  // field 15 is not part of MyMessageC
+  std::string data;
+  append_varint(&data, (15 << 3) | 0);
+  append_varint(&data, 1234);
+  append_varint(&data, (5 << 3) | 0);
+  append_varint(&data, 7);
+
+  pbwire_Error error{};
+  MyMessageC message{};
+  ASSERT_EQ(data.size(), parse(data, pbparse_MyMessageC, &message, &error))
+      << error.msg;
+  EXPECT_EQ(1, message.fieldCCount);
+  EXPECT_EQ(1, stats[PBWIRE_STAT_UNKNOWN_FIELDS]);
+
+  // Truncated varint
+  data.push_back('\x80');
+  message = MyMessageC{};
+  EXPECT_GT(0, parse(data, pbparse_MyMessageC, &message, &error));
+  EXPECT_EQ(PBWIRE_VARINT_UNDERFLOW, error.code);
+  EXPECT_EQ(1, stats.errors(PBWIRE_VARINT_UNDERFLOW));
+  EXPECT_EQ(2, stats[PBWIRE_STAT_PARSE_CALLS]);
+}
+
+TEST(pbwireStatsTest, CountsTruncatedRepeatedFields) {
+  StatsDelta stats{"MyMessageC"};
+
+  std::string data;
+  // One more unpacked element of fieldC than will fit
+  for (int idx = 0; idx < FIELD_C_CAPACITY + 1; idx++) {
+    append_varint(&data, (5 << 3) | 0);
+    append_varint(&data, idx);
+  }
+  // Two more packed elements of fieldB than will fit
+  std::string packed;
+  for (int idx = 0; idx < FIELD_B_CAPACITY + 2; idx++) {
+    append_varint(&packed, idx);
+  }
+  append_varint(&data, (2 << 3) | 2);
+  append_varint(&data, packed.size());
+  data += packed;
+
+  pbwire_Error error{};
+  MyMessageC message{};
+  ASSERT_EQ(data.size(), parse(data, pbparse_MyMessageC, &message, &error))
+      << error.msg;
+  EXPECT_EQ(FIELD_C_CAPACITY, message.fieldCCount);
+  EXPECT_EQ(FIELD_C_CAPACITY - 1, message.fieldC[FIELD_C_CAPACITY - 1]);
+  EXPECT_EQ(2, stats[PBWIRE_STAT_TRUNCATED_REPEATED]);
+}
+
+TEST(pbwireStatsTest, CountsTruncatedStrings) {
+  StatsDelta stats{"<untyped>"};
+
+  std::string data;
+  append_varint(&data, 11);
+  data += "hello world";
+
+  pbwire_Error error{};
+  pbwire_ParseContext ctx{};
+  ctx.error = &error;
+  ctx.stats = pbwire_stats_thread_slot();
+  pbwire_readbuffer_init(&ctx.buffer, data.data(), data.data() + data.size());
+
+  char value[5];
+  size_t value_len = sizeof(value);
+  ASSERT_EQ(data.size(), pbparse_string(&ctx, value, &value_len));
+  EXPECT_EQ(5, value_len);
+  EXPECT_EQ(1, stats[PBWIRE_STAT_TRUNCATED_STRINGS]);
+}
+
+TEST(pbwireStatsTest, SnapshotIncludesOtherThreads) {
+  StatsDelta stats{"MyMessageC"};
+
+  std::string data;
+  append_varint(&data, (5 << 3) | 0);
+  append_varint(&data, 1);
+
+  const int kThreads = 4;
+  const int kIters = 1000;
+  std::thread threads[kThreads];
+  for (auto& thread : threads) {
+    thread = std::thread{[&data]() {
+      pbwire_Error error{};
+      for (int idx = 0; idx < kIters; idx++) {
+        MyMessageC message{};
+        parse(data, pbparse_MyMessageC, &message, &error);
+      }
+    }};
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The threads have exited, so their counts come from the retired totals
+  EXPECT_EQ(kThreads * kIters, stats[PBWIRE_STAT_PARSE_CALLS]);
+  EXPECT_EQ(kThreads * kIters * data.size(), stats[PBWIRE_STAT_PARSE_BYTES]);
+}
@@ -0,0 +1,234 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/protostruct/pbwire_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+constexpr size_t kCacheLine = 64;
+
+typedef std::atomic<uint64_t> Counter;
+
+// Counters for one message type within one thread's slot. Only the owning
+// thread writes these, so increments are a relaxed load and store rather than
+// a locked read-modify-write. Each block is cache-line aligned so that slots
+// owned by different threads never share a line.
+struct alignas(kCacheLine) TypeCounters {
+  Counter counters[PBWIRE_STAT_NUM_COUNTERS];
+  Counter errors[PBWIRE_STATS_NUM_ERRORS];
+};
+
+inline void bump(Counter* counter, uint64_t amount) {
+  counter->store(counter->load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+}
+
+struct Registry {
+  std::mutex mutex;
+
+  // Type names, indexed by id. Entry 0 is reserved for unattributed counts.
+  std::atomic<int32_t> ntypes{1};
+  const char* names[PBWIRE_STATS_MAX_TYPES] = {"<untyped>"};
+
+  // Slots of all live threads
+  std::vector<pbwire_StatsSlot*> slots;
+
+  // Totals folded in from the slots of threads which have exited
+  std::vector<pbwire_TypeStats> retired;
+};
+
+// NOTE(josh): intentionally leaked so that it outlives any thread_local slot
+// destructors which run during process shutdown.
+Registry* get_registry() {
+  static Registry* registry = new Registry{};
+  return registry;
+}
+
+int32_t get_type_id(Registry* registry, pbwire_StatsType* type) {
+  int32_t id = __atomic_load_n(&type->id, __ATOMIC_ACQUIRE);
+  if (id) {
+    return id;
+  }
+
+  std::lock_guard<std::mutex> lock{registry->mutex};
+  id = __atomic_load_n(&type->id, __ATOMIC_RELAXED);
+  if (id) {
+    return id;
+  }
+  id = registry->ntypes.load(std::memory_order_relaxed);
+  if (id >= PBWIRE_STATS_MAX_TYPES) {
+    // Out of space, count these as untyped. Don't store the id so that the
+    // common case (no overflow) has no extra branch.
+    return 0;
+  }
+  registry->names[id] = type->name;
+  registry->ntypes.store(id + 1, std::memory_order_release);
+  __atomic_store_n(&type->id, id, __ATOMIC_RELEASE);
+  return id;
+}
+
+void accumulate(const TypeCounters& src, pbwire_TypeStats* dst) {
+  for (size_t idx = 0; idx < PBWIRE_STAT_NUM_COUNTERS; idx++) {
+    dst->counters[idx] += src.counters[idx].load(std::memory_order_relaxed);
+  }
+  for (size_t idx = 0; idx < PBWIRE_STATS_NUM_ERRORS; idx++) {
+    dst->errors[idx] += src.errors[idx].load(std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+struct pbwire_StatsSlot {
+  // Id of the message type currently being parsed or emitted by this thread
+  int32_t active_type = 0;
+
+  // Allocated on first use by the owning thread, read by snapshot()
+  std::atomic<TypeCounters*> types[PBWIRE_STATS_MAX_TYPES] = {};
+
+  ~pbwire_StatsSlot() {
+    for (auto& block : types) {
+      delete block.load(std::memory_order_relaxed);
+    }
+  }
+
+  TypeCounters* get_counters(int32_t id) {
+    TypeCounters* block = types[id].load(std::memory_order_relaxed);
+    if (!block) {
+      block = new TypeCounters{};
+      types[id].store(block, std::memory_order_release);
+    }
+    return block;
+  }
+};
+
+namespace {
+
+// Registers the calling thread's slot on construction and retires it when the
+// thread exits
+struct SlotHolder {
+  pbwire_StatsSlot* slot = nullptr;
+
+  pbwire_StatsSlot* get() {
+    if (!slot) {
+      slot = new pbwire_StatsSlot{};
+      Registry* registry = get_registry();
+      std::lock_guard<std::mutex> lock{registry->mutex};
+      registry->slots.push_back(slot);
+    }
+    return slot;
+  }
+
+  ~SlotHolder() {
+    if (!slot) {
+      return;
+    }
+    Registry* registry = get_registry();
+    {
+      std::lock_guard<std::mutex> lock{registry->mutex};
+      auto& slots = registry->slots;
+      slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+      registry->retired.resize(PBWIRE_STATS_MAX_TYPES, pbwire_TypeStats{});
+      for (size_t id = 0; id < PBWIRE_STATS_MAX_TYPES; id++) {
+        TypeCounters* block = slot->types[id].load(std::memory_order_relaxed);
+        if (block) {
+          accumulate(*block, &registry->retired[id]);
+        }
+      }
+    }
+    delete slot;
+  }
+};
+
+thread_local SlotHolder tls_slot;
+
+}  // namespace
+
+const char* pbwire_StatsCounter_tostring(enum pbwire_StatsCounter value) {
+  switch (value) {
+    case PBWIRE_STAT_PARSE_CALLS:
+      return "parse_calls";
+    case PBWIRE_STAT_PARSE_BYTES:
+      return "parse_bytes";
+    case PBWIRE_STAT_EMIT_CALLS:
+      return "emit_calls";
+    case PBWIRE_STAT_EMIT_BYTES:
+      return "emit_bytes";
+    case PBWIRE_STAT_UNKNOWN_FIELDS:
+      return "unknown_fields";
+    case PBWIRE_STAT_TRUNCATED_STRINGS:
+      return "truncated_strings";
+    case PBWIRE_STAT_TRUNCATED_REPEATED:
+      return "truncated_repeated";
+    case PBWIRE_STAT_NUM_COUNTERS:
+      break;
+  }
+  return "<invalid>";
+}
+
+pbwire_StatsSlot* pbwire_stats_thread_slot(void) {
+  return tls_slot.get();
+}
+
+int32_t pbwire_stats_enter(pbwire_StatsSlot* slot, pbwire_StatsType* type) {
+  if (!slot) {
+    return 0;
+  }
+  int32_t prev_type = slot->active_type;
+  slot->active_type = get_type_id(get_registry(), type);
+  return prev_type;
+}
+
+void pbwire_stats_exit(pbwire_StatsSlot* slot, int32_t prev_type,
+                       pbwire_StatsCounter counter, int result,
+                       const pbwire_Error* error) {
+  if (!slot) {
+    return;
+  }
+  TypeCounters* block = slot->get_counters(slot->active_type);
+  bump(&block->counters[counter], 1);
+  if (result >= 0) {
+    // The bytes counter immediately follows the calls counter
+    bump(&block->counters[counter + 1], result);
+  } else if (error && static_cast<size_t>(error->code) <
+                          PBWIRE_STATS_NUM_ERRORS) {
+    bump(&block->errors[error->code], 1);
+  }
+  slot->active_type = prev_type;
+}
+
+void pbwire_stats_count(pbwire_StatsSlot* slot, pbwire_StatsCounter counter,
+                        uint64_t amount) {
+  if (!slot) {
+    return;
+  }
+  bump(&slot->get_counters(slot->active_type)->counters[counter], amount);
+}
+
+size_t pbwire_stats_snapshot(pbwire_TypeStats* out, size_t capacity) {
+  Registry* registry = get_registry();
+  std::lock_guard<std::mutex> lock{registry->mutex};
+  size_t ntypes = registry->ntypes.load(std::memory_order_acquire);
+  size_t ncopy = std::min(ntypes, capacity);
+
+  for (size_t id = 0; id < ncopy; id++) {
+    pbwire_TypeStats* stats = &out[id];
+    if (id < registry->retired.size()) {
+      *stats = registry->retired[id];
+    } else {
+      memset(stats, 0, sizeof(pbwire_TypeStats));
+    }
+    stats->name = registry->names[id];
+    for (pbwire_StatsSlot* slot : registry->slots) {
+      TypeCounters* block = slot->types[id].load(std::memory_order_acquire);
+      if (block) {
+        accumulate(*block, stats);
+      }
+    }
+  }
+  return ntypes;
+}
@@ -0,0 +1,100 @@
+#pragma once
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tangent/protostruct/pbwire.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================ Runtime Counters ============================ */
+// Optional per-message-type counters for the pbwire codec. Instrumentation is
+// compiled in only when PBWIRE_WITH_STATS is defined, in which case
+// pbwire_ParseContext and pbwire_EmitContext gain a `stats` member. The
+// library, the generated code, and any code which allocates contexts must all
+// agree on the definition (use the pbwire-stats library variant).
+//
+// Counting is enabled per-context by pointing `ctx->stats` at the calling
+// thread's slot:
+//
+//   pbwire_ParseContext ctx{};
+//   ctx.stats = pbwire_stats_thread_slot();
+//
+// Each thread owns one slot and is the only writer of the counters in it, so
+// the hot path is a plain load/store to a cache line that no other thread
+// writes. pbwire_stats_snapshot() sums over all slots.
+
+// Maximum number of distinct message types which can be tracked. Types
+// registered beyond this limit are counted under index 0.
+#define PBWIRE_STATS_MAX_TYPES 1024
+
+// Number of distinct pbwire_ErrorCode values
+#define PBWIRE_STATS_NUM_ERRORS (PBWIRE_BAD_DESCRIPTOR + 1)
+
+typedef enum pbwire_StatsCounter {
+  PBWIRE_STAT_PARSE_CALLS = 0,       //< number of pbparse_XXX() calls,
+                                     //  including nested messages
+  PBWIRE_STAT_PARSE_BYTES,           //< bytes consumed by successful parses
+  PBWIRE_STAT_EMIT_CALLS,            //< number of pbemit_XXX() calls
+  PBWIRE_STAT_EMIT_BYTES,            //< bytes written by successful emits
+  PBWIRE_STAT_UNKNOWN_FIELDS,        //< fields skipped by pbparse_sink_unknown
+  PBWIRE_STAT_TRUNCATED_STRINGS,     //< strings/bytes longer than the buffer
+  PBWIRE_STAT_TRUNCATED_REPEATED,    //< repeated fields with more elements
+                                     //  than the array capacity
+  PBWIRE_STAT_NUM_COUNTERS
+} pbwire_StatsCounter;
+
+const char* pbwire_StatsCounter_tostring(enum pbwire_StatsCounter value);
+
+// Static descriptor for one message type. The generated code declares one of
+// these for each message. `id` is assigned lazily on first use and should be
+// initialized to zero.
+typedef struct pbwire_StatsType {
+  const char* name;
+  int32_t id;
+} pbwire_StatsType;
+
+// Counters for one message type, as returned by pbwire_stats_snapshot()
+typedef struct pbwire_TypeStats {
+  const char* name;
+  uint64_t counters[PBWIRE_STAT_NUM_COUNTERS];
+  uint64_t errors[PBWIRE_STATS_NUM_ERRORS];  //< indexed by pbwire_ErrorCode
+} pbwire_TypeStats;
+
+// Per-thread counter storage
+typedef struct pbwire_StatsSlot pbwire_StatsSlot;
+
+// Return the calling thread's slot, allocating it on first use. The slot is
+// retired (and its counts folded into the process totals) when the thread
+// exits, after which the pointer must not be used.
+pbwire_StatsSlot* pbwire_stats_thread_slot(void);
+
+// Make `type` the active message type of `slot`. Counts which are not
+// associated with a particular message (e.g. unknown fields) are attributed
+// to the active type. Return the previously active type, which must be passed
+// to the matching pbwire_stats_exit(). `slot` may be NULL.
+int32_t pbwire_stats_enter(pbwire_StatsSlot* slot, pbwire_StatsType* type);
+
+// Record the outcome of a parse (`counter` is PBWIRE_STAT_PARSE_CALLS) or emit
+// (PBWIRE_STAT_EMIT_CALLS) of the active type and restore `prev_type`. If
+// `result` is negative the error is counted by `error->code`, otherwise
+// `result` is counted as bytes.
+void pbwire_stats_exit(pbwire_StatsSlot* slot, int32_t prev_type,
+                       pbwire_StatsCounter counter, int result,
+                       const pbwire_Error* error);
+
+// Add `amount` to `counter` of the active type. `slot` may be NULL.
+void pbwire_stats_count(pbwire_StatsSlot* slot, pbwire_StatsCounter counter,
+                        uint64_t amount);
+
+// Copy the process-wide totals for up to `capacity` types into `out`. Index 0
+// holds counts which could not be attributed to a registered type. Return the
+// number of types, which may be larger than `capacity`.
+size_t pbwire_stats_snapshot(pbwire_TypeStats* out, size_t capacity);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
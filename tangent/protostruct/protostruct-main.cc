@@ -50,5 +50,8 @@ int main(int argc, char** argv) {
   if (popts.command == "generate") {
     result = gen_main(popts);
   }
+  if (popts.command == "advise") {
+    result = advise_main(popts);
+  }
   return result;
 }
@@ -262,6 +262,7 @@ void setup_compile_options(argue::Parser* compile_parser,
 void setup_parser(argue::Parser* parser, ProgramOptions* opts) {
   using argue::keywords::action;
   using argue::keywords::choices;
+  using argue::keywords::default_;
   using argue::keywords::dest;
   using argue::keywords::help;
   using argue::keywords::nargs;
@@ -271,8 +272,8 @@ void setup_parser(argue::Parser* parser, ProgramOptions* opts) {
   // clang-format off
   auto subparsers = parser->add_subparsers(
       "command", &opts->command, {
-        .help="`compile` a proto description from an existing header, or `gen`"
-        " bindings from a proto description"});
+        .help="`compile` a proto description from an existing header, `gen`"
+        " bindings from a proto description, or `advise` on capacities"});
 
   auto compile_parser = subparsers->add_parser(
       "compile", {.help="compile a proto description from an existing header"});
@@ -288,8 +289,39 @@ void setup_parser(argue::Parser* parser, ProgramOptions* opts) {
 
   gen_parser->add_argument(
       "templates", dest=&(opts->gen_opts.templates), nargs="+",
-      choices={"cpp-simple", "cereal", "pb2c", "pbwire", "proto", "recon"},
+      choices={"cpp-simple", "cereal", "pb2c", "pbrpc", "pbwire", "proto",
+               "recon"},
       help="Generate bindings from these templates");
+
+  auto advise_parser = subparsers->add_parser(
+      "advise", {.help="recommend capacities for repeated fields from a corpus"
+                 " of encoded messages"});
+
+  advise_parser->add_argument(
+      "-m", "--message", dest=&(opts->advise_opts.message_name),
+      help="Fully qualified name of the message type in the corpus");
+
+  advise_parser->add_argument(
+      "--delimited", action="store_true", dest=&(opts->advise_opts.delimited),
+      help="Each corpus file is a stream of varint length-prefixed messages."
+           " By default each file contains exactly one message.");
+
+  advise_parser->add_argument(
+      "-q", "--quantile", dest=&(opts->advise_opts.quantile), default_=0.99,
+      help="Suggest capacities large enough for this fraction of messages");
+
+  advise_parser->add_argument(
+      "-j", "--jobs", dest=&(opts->advise_opts.num_threads), default_=0,
+      help="Number of threads used to read the corpus (default: one per"
+           " core)");
+
+  advise_parser->add_argument(
+      "-o", "--report-out", dest=&(opts->advise_opts.report_outpath),
+      help="Where to write the JSON report (default: stdout)");
+
+  advise_parser->add_argument(
+      "corpus", dest=&(opts->advise_opts.corpus_paths), nargs="+",
+      help="Files containing encoded messages");
   // clang-format on
 }
 
@@ -884,6 +916,27 @@ class FieldVisitor : public ClangVisitor {
   virtual ~FieldVisitor() {}
 
   CXChildVisitResult visit(CXCursor c, CXCursor parent) override {
+    if (clang_getCursorKind(c) == CXCursor_AlignedAttr) {
+      // The argument of alignas() is the only child of the attribute. Don't
+      // recurse into it, it isn't an array size.
+      CXEvalResult result = nullptr;
+      clang_visitChildren(
+          c,
+          [](CXCursor child, CXCursor, CXClientData data) {
+            *static_cast<CXEvalResult*>(data) = clang_Cursor_Evaluate(child);
+            return CXChildVisit_Break;
+          },
+          &result);
+      if (result && clang_EvalResult_getKind(result) == CXEval_Int) {
+        proto_->mutable_options()
+            ->MutableExtension(protostruct::fieldopts)
+            ->set_alignment(clang_EvalResult_getAsLongLong(result));
+      }
+      if (result) {
+        clang_EvalResult_dispose(result);
+      }
+      return CXChildVisit_Continue;
+    }
     if (clang_getCursorKind(c) == CXCursor_IntegerLiteral) {
       std::string capname = ctx_->get_source(c);
       bool is_macro = ctx_->note_capname(capname);
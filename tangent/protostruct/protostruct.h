@@ -60,6 +60,28 @@ struct ProgramOptions {
     /// List of templates to use for generation
     std::vector<std::string> templates;
   } gen_opts;
+
+  struct AdviseOptions {
+    /// Fully qualified name of the message type encoded in the corpus
+    std::string message_name;
+
+    /// Files containing encoded messages
+    std::vector<std::string> corpus_paths;
+
+    /// If true, each corpus file is a stream of varint length-prefixed
+    /// messages. Otherwise each file contains exactly one message.
+    bool delimited;
+
+    /// Suggested capacities are large enough for this fraction of the
+    /// messages in the corpus
+    double quantile;
+
+    /// Number of threads used to scan the corpus. If zero, use one per core.
+    int num_threads;
+
+    /// Where to write the JSON report. If empty, write to stdout.
+    std::string report_outpath;
+  } advise_opts;
 };
 
 void setup_parser_for_compile(argue::Parser* parser, ProgramOptions* opts);
@@ -67,3 +89,4 @@ void setup_parser(argue::Parser* parser, ProgramOptions* opts);
 void compile_descriptor_set(const ProgramOptions& popts);
 int compile_main(const ProgramOptions& popts);
 int gen_main(const ProgramOptions& popts);
+int advise_main(const ProgramOptions& popts);
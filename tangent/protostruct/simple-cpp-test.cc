@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 
 #include "tangent/protostruct/test/test_messages-simple.h"
+#include "tangent/tjson/cpputil.h"
 
 TEST(SimpleCpp, ToJSONMatchesExpectedFormat) {
   tangent::test::MyMessageC msg{};
@@ -16,14 +17,15 @@ TEST(SimpleCpp, ToJSONMatchesExpectedFormat) {
     "fieldA": [
         {
           "fieldA": 1,
-          "fieldB": 2,
+          "fieldB": 2.0,
           "fieldC": 3,
           "fieldD": "MyEnumA_VALUE3"
       }
     ],
     "fieldB": [
         4
-    ]
+    ],
+    "fieldC": []
 }
 )");
 }
@@ -48,3 +50,60 @@ TEST(SimpleCpp, FromJSONMatchesExpectedValues) {
   ASSERT_EQ(msg.fieldB.size(), 1);
   EXPECT_EQ(msg.fieldB[0], 4);
 }
+
+TEST(SimpleCpp, FromJSONMatchesNormalizedKeys) {
+  tangent::test::MyMessageA msg{};
+  msg.parse_json(R"({
+    "field_a": 1,
+    "FIELDB": 2,
+    "Field_C": 3
+  })");
+  EXPECT_EQ(msg.fieldA, 1);
+  EXPECT_EQ(msg.fieldB, 2);
+  EXPECT_EQ(msg.fieldC, 3);
+}
+
+TEST(SimpleCpp, FromJSONSkipsUnknownFields) {
+  tangent::test::MyMessageA msg{};
+  msg.parse_json(R"({
+    "fieldA": 1,
+    "unknownScalar": "x",
+    "unknownObject": {"x": 1, "y": [2, {"z": 3}]},
+    "fieldB": 2,
+    "unknownList": [1, [2, 3], {"x": 4}],
+    "fieldC": 3
+  })");
+  EXPECT_EQ(msg.fieldA, 1);
+  EXPECT_EQ(msg.fieldB, 2);
+  EXPECT_EQ(msg.fieldC, 3);
+
+  tangent::test::MyMessageC msgc{};
+  msgc.parse_json(R"({"fieldB": [1], "unknown": {"x": 1}, "fieldC": [2]})");
+  ASSERT_EQ(msgc.fieldB.size(), 1);
+  EXPECT_EQ(msgc.fieldB[0], 1);
+  ASSERT_EQ(msgc.fieldC.size(), 1);
+  EXPECT_EQ(msgc.fieldC[0], 2);
+}
+
+TEST(SimpleCpp, FromJSONIntoArena) {
+  const std::string json = R"({
+    "fieldA": [
+      {"fieldA": 1, "fieldB": 2, "fieldC": 3, "fieldD": "MyEnumA_VALUE3"},
+      {"fieldA": 4, "fieldB": 5, "fieldC": 6, "fieldD": "MyEnumA_VALUE2"}
+    ],
+    "fieldB": [7, 8, 9]
+})";
+  tjson::Arena arena{
+      tjson_StringPiece{json.data(), json.data() + json.size()}};
+  tangent::test::MyMessageC* msg =
+      tangent::test::MyMessageC::parse_json(json, &arena);
+
+  ASSERT_EQ(msg->fieldA.size(), 2);
+  EXPECT_EQ(msg->fieldA[1].fieldA, 4);
+  EXPECT_EQ(msg->fieldA[1].fieldD, tangent::test::MyEnumA_VALUE2);
+  ASSERT_EQ(msg->fieldB.size(), 3);
+  EXPECT_EQ(msg->fieldB[2], 9);
+  EXPECT_EQ(msg->fieldA.get_allocator().resource(), &arena);
+  EXPECT_EQ(msg->fieldB.get_allocator().resource(), &arena);
+  EXPECT_EQ(arena.overflow(), 0);
+}
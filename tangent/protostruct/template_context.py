@@ -41,7 +41,7 @@ def get_simple_cpp_typename(typeid):
   proto = descriptor_pb2.FieldDescriptorProto
   return {
       proto.TYPE_BOOL: "bool",
-      proto.TYPE_BYTES: "std::vector<uint8_t>",
+      proto.TYPE_BYTES: "std::pmr::vector<uint8_t>",
       proto.TYPE_DOUBLE: "double",
       proto.TYPE_FIXED32: "int32_t",
       proto.TYPE_FIXED64: "int64_t",
@@ -52,7 +52,7 @@ def get_simple_cpp_typename(typeid):
       proto.TYPE_SFIXED64: "int32_t",
       proto.TYPE_SINT32: "int32_t",
       proto.TYPE_SINT64: "int64_t",
-      proto.TYPE_STRING: "std::string",
+      proto.TYPE_STRING: "std::pmr::string",
       proto.TYPE_UINT32: "uint32_t",
       proto.TYPE_UINT64: "uint64_t",
   }[typeid]
@@ -75,15 +75,17 @@ def get_options(fielddescr):
     if psopts.HasField("fieldtype"):
       opsdict["fieldtype"] = psopts.fieldtype
     if psopts.lenfield:
-      # We only need to record this if it's not the default
-      # TODO(josh): make a configuration option
-      if psopts.lenfield != fielddescr.name + "Count":
-        opsdict["lenfield"] = psopts.lenfield
+      # NOTE(josh): this is recorded even when it's the default, otherwise a
+      # descriptor compiled from the .proto can't tell an array with a count
+      # from a fixed size one.
+      opsdict["lenfield"] = psopts.lenfield
     if psopts.capacity:
       opsdict["capacity"] = psopts.capacity
     if psopts.capname:
       opsdict.pop("capacity", None)
       opsdict["capname"] = psopts.capname
+    if psopts.alignment:
+      opsdict["alignment"] = psopts.alignment
 
     if len(opsdict) > 1:
       options.append(
@@ -154,6 +156,23 @@ class TemplateContext(object):
     name_parts.append(descr.name)
     return "::".join(name_parts)
 
+  def get_rpc_method_id(self, descr):
+    """
+    Return the RPC method id for requests carrying the message described by
+    the DescriptorProto `descr`, formatted as a C literal. The id is the
+    32-bit FNV-1a hash of the fully-qualified proto name (e.g.
+    "foo.bar.Baz"), so it is stable across reordering of the .proto. Zero is
+    reserved for error responses.
+    """
+    name_parts = self.filedescr.package.strip(".").split(".")
+    name_parts.append(descr.name)
+    digest = 0x811c9dc5
+    for char in ".".join(part for part in name_parts if part).encode("utf-8"):
+      digest = ((digest ^ char) * 0x01000193) & 0xffffffff
+    if digest == 0:
+      digest = 1
+    return "0x{:08x}u".format(digest)
+
   def canonicalize_typename(self, typename, style=None):
     """
     Given a qualified protobuf typename for a message or enum, strip the
@@ -229,6 +248,19 @@ class TemplateContext(object):
 
     return "_pbemit{}_".format(passno) + self.get_typename(fielddescr)
 
+  def get_tjson_typename(self, fielddescr):
+    """Return the suffix of the `tjson_parse_` and `tjson_emit_` functions for
+       a single value of the C type of the given field."""
+
+    if fielddescr.type in (descriptor_pb2.FieldDescriptorProto.TYPE_MESSAGE,
+                           descriptor_pb2.FieldDescriptorProto.TYPE_ENUM):
+      return self.get_typename(fielddescr)
+
+    ctype = self.get_typename(fielddescr, "cpp")
+    if ctype == "bool":
+      return "boolean"
+    return re.sub("(.*)(?:_t)", r"\1", ctype)
+
   def get_sourcecodeinfo_location(self, query_path):
     if not self.filedescr.HasField("source_code_info"):
       return None
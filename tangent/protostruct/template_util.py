@@ -8,6 +8,15 @@ from google.protobuf import descriptor_pb2
 from tangent.protostruct import descriptor_extensions_pb2
 
 
+def fnv1a32(data):
+  """Return the 32-bit FNV-1a hash of a string, as computed by
+  tjson_StringPiece_suci_normalize()."""
+  hashv = 2166136261
+  for char in data.encode("utf-8"):
+    hashv = ((hashv ^ char) * 16777619) & 0xffffffff
+  return hashv
+
+
 def format_reserved(ranges):
   """Given a list of reserved fieldnumber ranges, format a `reserved`
   declaration for emission in .proto. For example, given the ranges::
@@ -176,6 +185,76 @@ def get_protostruct_options(descr):
   return None
 
 
+class PerfectHash(object):
+  """A minimal perfect hash table. Each key is in slot
+  `phash_slot(fnv1a32(key), seeds[fnv1a32(key) % len(seeds)], len(slots))`,
+  which holds the (key, item) pair."""
+
+  def __init__(self, seeds, slots):
+    self.seeds = seeds
+    self.slots = slots
+
+  @property
+  def nbuckets(self):
+    return len(self.seeds)
+
+  @property
+  def maxsize(self):
+    return max(len(key) for key, _ in self.slots)
+
+
+def get_suci_phash(items, scope_name):
+  """Build a minimal perfect hash table over the suci-normalized names of
+  `items` (e.g. the fields of a message, named `scope_name` in errors).
+
+  Keys are distributed among buckets by their hash. Starting with the
+  largest bucket, each bucket gets the first seed which maps all of its keys
+  to distinct free slots (hash-and-displace). Names which normalize to the
+  same key are an error, since they could never be told apart when
+  parsing."""
+
+  keyed = {}
+  for item in items:
+    key = suci_normalize(item.name)
+    if key in keyed:
+      raise ValueError(
+          "{}: {} and {} have the same key '{}' when normalized".format(
+              scope_name, keyed[key].name, item.name, key))
+    keyed[key] = item
+
+  nslots = len(keyed)
+  if not nslots:
+    return PerfectHash([], [])
+
+  nbuckets = (nslots + 1) // 2
+  buckets = [[] for _ in range(nbuckets)]
+  for key in keyed:
+    buckets[fnv1a32(key) % nbuckets].append(key)
+
+  seeds = [0] * nbuckets
+  slots = [None] * nslots
+  order = sorted(range(nbuckets), key=lambda idx: -len(buckets[idx]))
+  for bucket_idx in order:
+    bucket = buckets[bucket_idx]
+    if not bucket:
+      continue
+    for seed in range(1, 1 << 24):
+      candidate = [phash_slot(fnv1a32(key), seed, nslots) for key in bucket]
+      if (len(set(candidate)) == len(candidate) and
+          all(slots[slot] is None for slot in candidate)):
+        break
+    else:
+      # Only possible if two keys have the same 32-bit hash
+      raise ValueError(
+          "{}: failed to build a perfect hash for keys {}".format(
+              scope_name, ", ".join(bucket)))
+    seeds[bucket_idx] = seed
+    for key, slot in zip(bucket, candidate):
+      slots[slot] = (key, keyed[key])
+
+  return PerfectHash(seeds, slots)
+
+
 def get_tag(fielddescr):
   """Return an integer "tag" which is a bitfield composed of the fieldid
      and the wire type."""
@@ -230,6 +309,14 @@ def has_packed_field(descr):
   return False
 
 
+def is_allocator_aware(fielddescr):
+  """Return true if the field is a container (or message) in the simple-cpp
+     bindings, and so is constructed with the allocator of its message."""
+  proto = descriptor_pb2.FieldDescriptorProto
+  return (is_repeated(fielddescr) or is_message(fielddescr)
+          or fielddescr.type in (proto.TYPE_STRING, proto.TYPE_BYTES))
+
+
 def is_enum(fielddescr):
   return fielddescr.type == descriptor_pb2.FieldDescriptorProto.TYPE_ENUM
 
@@ -269,3 +356,19 @@ def is_repeated(descr):
     return False
 
   return descr.label == descriptor_pb2.FieldDescriptorProto.LABEL_REPEATED
+
+
+def phash_slot(hashv, seed, nslots):
+  """Return the slot of a key with hash `hashv` in a minimal perfect hash
+  table of `nslots` slots, as computed by tjson_phash_slot()."""
+  mixed = ((hashv ^ seed) * 0x9e3779b1) & 0xffffffff
+  mixed ^= mixed >> 15
+  return (mixed * nslots) >> 32
+
+
+def suci_normalize(name):
+  """Return the stripped-underscore, case-insensitive form of a name, as
+  computed by tjson_StringPiece_suci_normalize()."""
+  return "".join(
+      char.lower() if "A" <= char <= "Z" else char
+      for char in name if char != "_")
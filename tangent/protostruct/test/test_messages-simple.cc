@@ -1,5 +1,8 @@
 #include "tangent/protostruct/test/test_messages-simple.h"
 
+#include <cstring>
+#include <utility>
+
 #include "tangent/tjson/cpputil.h"
 #include "tangent/tjson/parse.h"
 #include "tangent/util/exception.h"
@@ -43,6 +46,27 @@ tjson::OStream& operator<<(tjson::OStream& out, const MyEnumA& value) {
   return out;
 }
 
+MyMessageA::MyMessageA(const allocator_type& alloc)
+    : fieldA(), fieldB(), fieldC(), fieldD() {
+  (void)alloc;
+}
+
+MyMessageA::MyMessageA(const MyMessageA& other, const allocator_type& alloc)
+    : fieldA(other.fieldA),
+      fieldB(other.fieldB),
+      fieldC(other.fieldC),
+      fieldD(other.fieldD) {
+  (void)alloc;
+}
+
+MyMessageA::MyMessageA(MyMessageA&& other, const allocator_type& alloc)
+    : fieldA(std::move(other.fieldA)),
+      fieldB(std::move(other.fieldB)),
+      fieldC(std::move(other.fieldC)),
+      fieldD(std::move(other.fieldD)) {
+  (void)alloc;
+}
+
 std::string MyMessageA::to_json() {
   tjson::OSStream strm{};
   strm << *this;
@@ -53,6 +77,13 @@ void MyMessageA::parse_json(const std::string& json_str) {
   return tjson::parse_json(json_str, this);
 }
 
+MyMessageA* MyMessageA::parse_json(const std::string& json_str,
+                                   tjson::Arena* arena) {
+  return tjson::parse_json<MyMessageA>(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      arena, json_str);
+}
+
 tjson::OStream& operator<<(tjson::OStream& out, const MyMessageA& value) {
   tjson::Guard guard{&out, tjson::OBJECT};
   out << "fieldA" << value.fieldA;
@@ -62,6 +93,14 @@ tjson::OStream& operator<<(tjson::OStream& out, const MyMessageA& value) {
   return out;
 }
 
+MyMessageB::MyMessageB(const allocator_type& alloc) : fieldA(alloc) {}
+
+MyMessageB::MyMessageB(const MyMessageB& other, const allocator_type& alloc)
+    : fieldA(other.fieldA, alloc) {}
+
+MyMessageB::MyMessageB(MyMessageB&& other, const allocator_type& alloc)
+    : fieldA(std::move(other.fieldA), alloc) {}
+
 std::string MyMessageB::to_json() {
   tjson::OSStream strm{};
   strm << *this;
@@ -72,12 +111,32 @@ void MyMessageB::parse_json(const std::string& json_str) {
   return tjson::parse_json(json_str, this);
 }
 
+MyMessageB* MyMessageB::parse_json(const std::string& json_str,
+                                   tjson::Arena* arena) {
+  return tjson::parse_json<MyMessageB>(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      arena, json_str);
+}
+
 tjson::OStream& operator<<(tjson::OStream& out, const MyMessageB& value) {
   tjson::Guard guard{&out, tjson::OBJECT};
   out << "fieldA" << value.fieldA;
   return out;
 }
 
+MyMessageC::MyMessageC(const allocator_type& alloc)
+    : fieldA(alloc), fieldB(alloc), fieldC(alloc) {}
+
+MyMessageC::MyMessageC(const MyMessageC& other, const allocator_type& alloc)
+    : fieldA(other.fieldA, alloc),
+      fieldB(other.fieldB, alloc),
+      fieldC(other.fieldC, alloc) {}
+
+MyMessageC::MyMessageC(MyMessageC&& other, const allocator_type& alloc)
+    : fieldA(std::move(other.fieldA), alloc),
+      fieldB(std::move(other.fieldB), alloc),
+      fieldC(std::move(other.fieldC), alloc) {}
+
 std::string MyMessageC::to_json() {
   tjson::OSStream strm{};
   strm << *this;
@@ -88,6 +147,13 @@ void MyMessageC::parse_json(const std::string& json_str) {
   return tjson::parse_json(json_str, this);
 }
 
+MyMessageC* MyMessageC::parse_json(const std::string& json_str,
+                                   tjson::Arena* arena) {
+  return tjson::parse_json<MyMessageC>(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      arena, json_str);
+}
+
 tjson::OStream& operator<<(tjson::OStream& out, const MyMessageC& value) {
   tjson::Guard guard{&out, tjson::OBJECT};
   out << "fieldA" << value.fieldA;
@@ -96,6 +162,17 @@ tjson::OStream& operator<<(tjson::OStream& out, const MyMessageC& value) {
   return out;
 }
 
+TestFixedArray::TestFixedArray(const allocator_type& alloc)
+    : fixedSizedArray(alloc) {}
+
+TestFixedArray::TestFixedArray(const TestFixedArray& other,
+                               const allocator_type& alloc)
+    : fixedSizedArray(other.fixedSizedArray, alloc) {}
+
+TestFixedArray::TestFixedArray(TestFixedArray&& other,
+                               const allocator_type& alloc)
+    : fixedSizedArray(std::move(other.fixedSizedArray), alloc) {}
+
 std::string TestFixedArray::to_json() {
   tjson::OSStream strm{};
   strm << *this;
@@ -106,12 +183,27 @@ void TestFixedArray::parse_json(const std::string& json_str) {
   return tjson::parse_json(json_str, this);
 }
 
+TestFixedArray* TestFixedArray::parse_json(const std::string& json_str,
+                                           tjson::Arena* arena) {
+  return tjson::parse_json<TestFixedArray>(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      arena, json_str);
+}
+
 tjson::OStream& operator<<(tjson::OStream& out, const TestFixedArray& value) {
   tjson::Guard guard{&out, tjson::OBJECT};
   out << "fixedSizedArray" << value.fixedSizedArray;
   return out;
 }
 
+TestAlignas::TestAlignas(const allocator_type& alloc) : array(alloc) {}
+
+TestAlignas::TestAlignas(const TestAlignas& other, const allocator_type& alloc)
+    : array(other.array, alloc) {}
+
+TestAlignas::TestAlignas(TestAlignas&& other, const allocator_type& alloc)
+    : array(std::move(other.array), alloc) {}
+
 std::string TestAlignas::to_json() {
   tjson::OSStream strm{};
   strm << *this;
@@ -122,12 +214,66 @@ void TestAlignas::parse_json(const std::string& json_str) {
   return tjson::parse_json(json_str, this);
 }
 
+TestAlignas* TestAlignas::parse_json(const std::string& json_str,
+                                     tjson::Arena* arena) {
+  return tjson::parse_json<TestAlignas>(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      arena, json_str);
+}
+
 tjson::OStream& operator<<(tjson::OStream& out, const TestAlignas& value) {
   tjson::Guard guard{&out, tjson::OBJECT};
   out << "array" << value.array;
   return out;
 }
 
+TestPrimitives::TestPrimitives(const allocator_type& alloc)
+    : fieldA(),
+      fieldB(),
+      fieldC(),
+      fieldD(),
+      fieldE(),
+      fieldF(),
+      fieldG(),
+      fieldH(),
+      fieldI(),
+      fieldJ(),
+      fieldK() {
+  (void)alloc;
+}
+
+TestPrimitives::TestPrimitives(const TestPrimitives& other,
+                               const allocator_type& alloc)
+    : fieldA(other.fieldA),
+      fieldB(other.fieldB),
+      fieldC(other.fieldC),
+      fieldD(other.fieldD),
+      fieldE(other.fieldE),
+      fieldF(other.fieldF),
+      fieldG(other.fieldG),
+      fieldH(other.fieldH),
+      fieldI(other.fieldI),
+      fieldJ(other.fieldJ),
+      fieldK(other.fieldK) {
+  (void)alloc;
+}
+
+TestPrimitives::TestPrimitives(TestPrimitives&& other,
+                               const allocator_type& alloc)
+    : fieldA(std::move(other.fieldA)),
+      fieldB(std::move(other.fieldB)),
+      fieldC(std::move(other.fieldC)),
+      fieldD(std::move(other.fieldD)),
+      fieldE(std::move(other.fieldE)),
+      fieldF(std::move(other.fieldF)),
+      fieldG(std::move(other.fieldG)),
+      fieldH(std::move(other.fieldH)),
+      fieldI(std::move(other.fieldI)),
+      fieldJ(std::move(other.fieldJ)),
+      fieldK(std::move(other.fieldK)) {
+  (void)alloc;
+}
+
 std::string TestPrimitives::to_json() {
   tjson::OSStream strm{};
   strm << *this;
@@ -138,6 +284,13 @@ void TestPrimitives::parse_json(const std::string& json_str) {
   return tjson::parse_json(json_str, this);
 }
 
+TestPrimitives* TestPrimitives::parse_json(const std::string& json_str,
+                                           tjson::Arena* arena) {
+  return tjson::parse_json<TestPrimitives>(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      arena, json_str);
+}
+
 tjson::OStream& operator<<(tjson::OStream& out, const TestPrimitives& value) {
   tjson::Guard guard{&out, tjson::OBJECT};
   out << "fieldA" << value.fieldA;
@@ -169,117 +322,278 @@ int parse(tjson_ParseContext ctx, tangent::test::MyEnumA* value) {
 }
 
 static int MyMessageA_fielditem_callback(void* pobj, tjson_ParseContext ctx,
-                                         tjson_StringPiece fieldname) {
+                                         tjson_StringPiece fieldname,
+                                         uint32_t keyid) {
+  // Minimal perfect hash of the normalized field names
+  static const uint32_t kSeeds[2] = {1, 16};
+  static const char* const kKeys[4] = {"fielda", "fieldd", "fieldc", "fieldb"};
+  static const uint32_t kSizes[4] = {6, 6, 6, 6};
+
   auto* obj = reinterpret_cast<tangent::test::MyMessageA*>(pobj);
-  switch (tjson_StringPiece_suci_digest(fieldname)) {
-    case tangent::suci_hash("fieldA"):
+  // Slot of the field, or -1 for an unknown field. Once it is learned for an
+  // interned key it is bound to the key, with kKeys as the shape.
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size =
+        tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key), &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 2], 4);
+      if (static_cast<uint32_t>(size) == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = static_cast<int32_t>(candidate);
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    case 0:
       return tjson::parse(ctx, &obj->fieldA);
-    case tangent::suci_hash("fieldB"):
-      return tjson::parse(ctx, &obj->fieldB);
-    case tangent::suci_hash("fieldC"):
-      return tjson::parse(ctx, &obj->fieldC);
-    case tangent::suci_hash("fieldD"):
+    case 1:
       return tjson::parse(ctx, &obj->fieldD);
+    case 2:
+      return tjson::parse(ctx, &obj->fieldC);
+    case 3:
+      return tjson::parse(ctx, &obj->fieldB);
+    default:
+      break;
   }
-  return 0;
+  // Unknown field, consume and ignore its value
+  return tjson_sink_value(ctx);
 }
 
 int parse(tjson_ParseContext ctx, tangent::test::MyMessageA* value) {
-  return tjson_parse_object(ctx, MyMessageA_fielditem_callback, value);
+  return tjson_parse_object_interned(ctx, MyMessageA_fielditem_callback, value);
 }
 
 static int MyMessageB_fielditem_callback(void* pobj, tjson_ParseContext ctx,
-                                         tjson_StringPiece fieldname) {
+                                         tjson_StringPiece fieldname,
+                                         uint32_t keyid) {
+  // Minimal perfect hash of the normalized field names
+  static const uint32_t kSeeds[1] = {1};
+  static const char* const kKeys[1] = {"fielda"};
+  static const uint32_t kSizes[1] = {6};
+
   auto* obj = reinterpret_cast<tangent::test::MyMessageB*>(pobj);
-  switch (tjson_StringPiece_suci_digest(fieldname)) {
-    case tangent::suci_hash("fieldA"):
+  // Slot of the field, or -1 for an unknown field. Once it is learned for an
+  // interned key it is bound to the key, with kKeys as the shape.
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size =
+        tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key), &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 1], 1);
+      if (static_cast<uint32_t>(size) == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = static_cast<int32_t>(candidate);
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    case 0:
       return tjson::parse(ctx, &obj->fieldA);
+    default:
+      break;
   }
-  return 0;
+  // Unknown field, consume and ignore its value
+  return tjson_sink_value(ctx);
 }
 
 int parse(tjson_ParseContext ctx, tangent::test::MyMessageB* value) {
-  return tjson_parse_object(ctx, MyMessageB_fielditem_callback, value);
+  return tjson_parse_object_interned(ctx, MyMessageB_fielditem_callback, value);
 }
 
 static int MyMessageC_fielditem_callback(void* pobj, tjson_ParseContext ctx,
-                                         tjson_StringPiece fieldname) {
+                                         tjson_StringPiece fieldname,
+                                         uint32_t keyid) {
+  // Minimal perfect hash of the normalized field names
+  static const uint32_t kSeeds[2] = {1, 3};
+  static const char* const kKeys[3] = {"fielda", "fieldc", "fieldb"};
+  static const uint32_t kSizes[3] = {6, 6, 6};
+
   auto* obj = reinterpret_cast<tangent::test::MyMessageC*>(pobj);
-  switch (tjson_StringPiece_suci_digest(fieldname)) {
-    case tangent::suci_hash("fieldA"):
+  // Slot of the field, or -1 for an unknown field. Once it is learned for an
+  // interned key it is bound to the key, with kKeys as the shape.
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size =
+        tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key), &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 2], 3);
+      if (static_cast<uint32_t>(size) == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = static_cast<int32_t>(candidate);
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    case 0:
       return tjson::parse(ctx, &obj->fieldA);
-    case tangent::suci_hash("fieldB"):
-      return tjson::parse(ctx, &obj->fieldB);
-    case tangent::suci_hash("fieldC"):
+    case 1:
       return tjson::parse(ctx, &obj->fieldC);
+    case 2:
+      return tjson::parse(ctx, &obj->fieldB);
+    default:
+      break;
   }
-  return 0;
+  // Unknown field, consume and ignore its value
+  return tjson_sink_value(ctx);
 }
 
 int parse(tjson_ParseContext ctx, tangent::test::MyMessageC* value) {
-  return tjson_parse_object(ctx, MyMessageC_fielditem_callback, value);
+  return tjson_parse_object_interned(ctx, MyMessageC_fielditem_callback, value);
 }
 
 static int TestFixedArray_fielditem_callback(void* pobj, tjson_ParseContext ctx,
-                                             tjson_StringPiece fieldname) {
+                                             tjson_StringPiece fieldname,
+                                             uint32_t keyid) {
+  // Minimal perfect hash of the normalized field names
+  static const uint32_t kSeeds[1] = {1};
+  static const char* const kKeys[1] = {"fixedsizedarray"};
+  static const uint32_t kSizes[1] = {15};
+
   auto* obj = reinterpret_cast<tangent::test::TestFixedArray*>(pobj);
-  switch (tjson_StringPiece_suci_digest(fieldname)) {
-    case tangent::suci_hash("fixedSizedArray"):
+  // Slot of the field, or -1 for an unknown field. Once it is learned for an
+  // interned key it is bound to the key, with kKeys as the shape.
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[15];
+    uint32_t hash = 0;
+    int32_t size =
+        tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key), &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 1], 1);
+      if (static_cast<uint32_t>(size) == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = static_cast<int32_t>(candidate);
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    case 0:
       return tjson::parse(ctx, &obj->fixedSizedArray);
+    default:
+      break;
   }
-  return 0;
+  // Unknown field, consume and ignore its value
+  return tjson_sink_value(ctx);
 }
 
 int parse(tjson_ParseContext ctx, tangent::test::TestFixedArray* value) {
-  return tjson_parse_object(ctx, TestFixedArray_fielditem_callback, value);
+  return tjson_parse_object_interned(ctx, TestFixedArray_fielditem_callback,
+                                     value);
 }
 
 static int TestAlignas_fielditem_callback(void* pobj, tjson_ParseContext ctx,
-                                          tjson_StringPiece fieldname) {
+                                          tjson_StringPiece fieldname,
+                                          uint32_t keyid) {
+  // Minimal perfect hash of the normalized field names
+  static const uint32_t kSeeds[1] = {1};
+  static const char* const kKeys[1] = {"array"};
+  static const uint32_t kSizes[1] = {5};
+
   auto* obj = reinterpret_cast<tangent::test::TestAlignas*>(pobj);
-  switch (tjson_StringPiece_suci_digest(fieldname)) {
-    case tangent::suci_hash("array"):
+  // Slot of the field, or -1 for an unknown field. Once it is learned for an
+  // interned key it is bound to the key, with kKeys as the shape.
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[5];
+    uint32_t hash = 0;
+    int32_t size =
+        tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key), &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 1], 1);
+      if (static_cast<uint32_t>(size) == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = static_cast<int32_t>(candidate);
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    case 0:
       return tjson::parse(ctx, &obj->array);
+    default:
+      break;
   }
-  return 0;
+  // Unknown field, consume and ignore its value
+  return tjson_sink_value(ctx);
 }
 
 int parse(tjson_ParseContext ctx, tangent::test::TestAlignas* value) {
-  return tjson_parse_object(ctx, TestAlignas_fielditem_callback, value);
+  return tjson_parse_object_interned(ctx, TestAlignas_fielditem_callback,
+                                     value);
 }
 
 static int TestPrimitives_fielditem_callback(void* pobj, tjson_ParseContext ctx,
-                                             tjson_StringPiece fieldname) {
+                                             tjson_StringPiece fieldname,
+                                             uint32_t keyid) {
+  // Minimal perfect hash of the normalized field names
+  static const uint32_t kSeeds[6] = {1, 2, 2, 11, 1, 12};
+  static const char* const kKeys[11] = {
+      "fielda", "fieldi", "fielde", "fieldb", "fieldd", "fieldg",
+      "fieldc", "fieldk", "fieldf", "fieldj", "fieldh"};
+  static const uint32_t kSizes[11] = {6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6};
+
   auto* obj = reinterpret_cast<tangent::test::TestPrimitives*>(pobj);
-  switch (tjson_StringPiece_suci_digest(fieldname)) {
-    case tangent::suci_hash("fieldA"):
+  // Slot of the field, or -1 for an unknown field. Once it is learned for an
+  // interned key it is bound to the key, with kKeys as the shape.
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size =
+        tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key), &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 6], 11);
+      if (static_cast<uint32_t>(size) == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = static_cast<int32_t>(candidate);
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    case 0:
       return tjson::parse(ctx, &obj->fieldA);
-    case tangent::suci_hash("fieldB"):
+    case 1:
+      return tjson::parse(ctx, &obj->fieldI);
+    case 2:
+      return tjson::parse(ctx, &obj->fieldE);
+    case 3:
       return tjson::parse(ctx, &obj->fieldB);
-    case tangent::suci_hash("fieldC"):
-      return tjson::parse(ctx, &obj->fieldC);
-    case tangent::suci_hash("fieldD"):
+    case 4:
       return tjson::parse(ctx, &obj->fieldD);
-    case tangent::suci_hash("fieldE"):
-      return tjson::parse(ctx, &obj->fieldE);
-    case tangent::suci_hash("fieldF"):
-      return tjson::parse(ctx, &obj->fieldF);
-    case tangent::suci_hash("fieldG"):
+    case 5:
       return tjson::parse(ctx, &obj->fieldG);
-    case tangent::suci_hash("fieldH"):
-      return tjson::parse(ctx, &obj->fieldH);
-    case tangent::suci_hash("fieldI"):
-      return tjson::parse(ctx, &obj->fieldI);
-    case tangent::suci_hash("fieldJ"):
-      return tjson::parse(ctx, &obj->fieldJ);
-    case tangent::suci_hash("fieldK"):
+    case 6:
+      return tjson::parse(ctx, &obj->fieldC);
+    case 7:
       return tjson::parse(ctx, &obj->fieldK);
+    case 8:
+      return tjson::parse(ctx, &obj->fieldF);
+    case 9:
+      return tjson::parse(ctx, &obj->fieldJ);
+    case 10:
+      return tjson::parse(ctx, &obj->fieldH);
+    default:
+      break;
   }
-  return 0;
+  // Unknown field, consume and ignore its value
+  return tjson_sink_value(ctx);
 }
 
 int parse(tjson_ParseContext ctx, tangent::test::TestPrimitives* value) {
-  return tjson_parse_object(ctx, TestPrimitives_fielditem_callback, value);
+  return tjson_parse_object_interned(ctx, TestPrimitives_fielditem_callback,
+                                     value);
 }
 
 }  // namespace tjson
@@ -2,12 +2,17 @@
 // Generated by protostruct. DO NOT EDIT BY HAND!
 
 #include <cstdint>
+#include <memory_resource>
 #include <string>
 #include <vector>
 
 #include "tangent/tjson/ostream.h"
 #include "tangent/tjson/parse.h"
 
+namespace tjson {
+class Arena;
+}  // namespace tjson
+
 namespace tangent {
 namespace test {
 
@@ -23,6 +28,14 @@ tjson::OStream& operator<<(tjson::OStream& out, const MyEnumA& value);
 
 /// This is message "A"
 struct MyMessageA {
+  // Lists, strings and nested messages all use the allocator of the message
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  MyMessageA() = default;
+  explicit MyMessageA(const allocator_type& alloc);
+  MyMessageA(const MyMessageA& other, const allocator_type& alloc);
+  MyMessageA(MyMessageA&& other, const allocator_type& alloc);
+
   int32_t fieldA;   //!< field A
   double fieldB;    //!< field B
   uint64_t fieldC;  //!< field C
@@ -30,51 +43,116 @@ struct MyMessageA {
 
   void parse_json(const std::string& json_str);
   std::string to_json();
+
+  // Parse `json_str` into a new object which, along with all of its lists and
+  // strings, is allocated from `arena`.
+  static MyMessageA* parse_json(const std::string& json_str,
+                                tjson::Arena* arena);
 };
 
 tjson::OStream& operator<<(tjson::OStream& out, const MyMessageA& value);
 
 /// This is message "B"
 struct MyMessageB {
+  // Lists, strings and nested messages all use the allocator of the message
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  MyMessageB() = default;
+  explicit MyMessageB(const allocator_type& alloc);
+  MyMessageB(const MyMessageB& other, const allocator_type& alloc);
+  MyMessageB(MyMessageB&& other, const allocator_type& alloc);
+
   MyMessageA fieldA;  //!< field A
 
   void parse_json(const std::string& json_str);
   std::string to_json();
+
+  // Parse `json_str` into a new object which, along with all of its lists and
+  // strings, is allocated from `arena`.
+  static MyMessageB* parse_json(const std::string& json_str,
+                                tjson::Arena* arena);
 };
 
 tjson::OStream& operator<<(tjson::OStream& out, const MyMessageB& value);
 
 /// This is message "C"
 struct MyMessageC {
-  std::vector<MyMessageA> fieldA;
-  std::vector<int32_t> fieldB;
-  std::vector<int32_t> fieldC;
+  // Lists, strings and nested messages all use the allocator of the message
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  MyMessageC() = default;
+  explicit MyMessageC(const allocator_type& alloc);
+  MyMessageC(const MyMessageC& other, const allocator_type& alloc);
+  MyMessageC(MyMessageC&& other, const allocator_type& alloc);
+
+  std::pmr::vector<MyMessageA> fieldA;
+  std::pmr::vector<int32_t> fieldB;
+  std::pmr::vector<int32_t> fieldC;
 
   void parse_json(const std::string& json_str);
   std::string to_json();
+
+  // Parse `json_str` into a new object which, along with all of its lists and
+  // strings, is allocated from `arena`.
+  static MyMessageC* parse_json(const std::string& json_str,
+                                tjson::Arena* arena);
 };
 
 tjson::OStream& operator<<(tjson::OStream& out, const MyMessageC& value);
 
 struct TestFixedArray {
-  std::vector<double> fixedSizedArray;
+  // Lists, strings and nested messages all use the allocator of the message
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  TestFixedArray() = default;
+  explicit TestFixedArray(const allocator_type& alloc);
+  TestFixedArray(const TestFixedArray& other, const allocator_type& alloc);
+  TestFixedArray(TestFixedArray&& other, const allocator_type& alloc);
+
+  std::pmr::vector<double> fixedSizedArray;
 
   void parse_json(const std::string& json_str);
   std::string to_json();
+
+  // Parse `json_str` into a new object which, along with all of its lists and
+  // strings, is allocated from `arena`.
+  static TestFixedArray* parse_json(const std::string& json_str,
+                                    tjson::Arena* arena);
 };
 
 tjson::OStream& operator<<(tjson::OStream& out, const TestFixedArray& value);
 
 struct TestAlignas {
-  std::vector<float> array;
+  // Lists, strings and nested messages all use the allocator of the message
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  TestAlignas() = default;
+  explicit TestAlignas(const allocator_type& alloc);
+  TestAlignas(const TestAlignas& other, const allocator_type& alloc);
+  TestAlignas(TestAlignas&& other, const allocator_type& alloc);
+
+  std::pmr::vector<float> array;
 
   void parse_json(const std::string& json_str);
   std::string to_json();
+
+  // Parse `json_str` into a new object which, along with all of its lists and
+  // strings, is allocated from `arena`.
+  static TestAlignas* parse_json(const std::string& json_str,
+                                 tjson::Arena* arena);
 };
 
 tjson::OStream& operator<<(tjson::OStream& out, const TestAlignas& value);
 
 struct TestPrimitives {
+  // Lists, strings and nested messages all use the allocator of the message
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  TestPrimitives() = default;
+  explicit TestPrimitives(const allocator_type& alloc);
+  TestPrimitives(const TestPrimitives& other, const allocator_type& alloc);
+  TestPrimitives(TestPrimitives&& other, const allocator_type& alloc);
+
   int8_t fieldA;
   int16_t fieldB;
   int32_t fieldC;
@@ -89,6 +167,11 @@ struct TestPrimitives {
 
   void parse_json(const std::string& json_str);
   std::string to_json();
+
+  // Parse `json_str` into a new object which, along with all of its lists and
+  // strings, is allocated from `arena`.
+  static TestPrimitives* parse_json(const std::string& json_str,
+                                    tjson::Arena* arena);
 };
 
 tjson::OStream& operator<<(tjson::OStream& out, const TestPrimitives& value);
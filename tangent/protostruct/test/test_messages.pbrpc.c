@@ -0,0 +1,244 @@
+// Generated by protostruct. DO NOT EDIT BY HAND!
+
+#include <string.h>
+
+#include "tangent/protostruct/test/test_messages.pbrpc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static int _pbrpc_dispatch_MyMessageA(pbwire_ParseContext* request,
+                                      pbwire_EmitContext* response,
+                                      void* userdata) {
+  const pbrpc_test_messages_Handlers* handlers =
+      (const pbrpc_test_messages_Handlers*)userdata;
+  MyMessageA obj;
+  memset(&obj, 0, sizeof(obj));
+  int result = pbparse_MyMessageA(request, &obj);
+  if (result < 0) {
+    return result;
+  }
+  return handlers->on_MyMessageA(&obj, response, handlers->userdata);
+}
+
+static int _pbrpc_dispatch_MyMessageB(pbwire_ParseContext* request,
+                                      pbwire_EmitContext* response,
+                                      void* userdata) {
+  const pbrpc_test_messages_Handlers* handlers =
+      (const pbrpc_test_messages_Handlers*)userdata;
+  MyMessageB obj;
+  memset(&obj, 0, sizeof(obj));
+  int result = pbparse_MyMessageB(request, &obj);
+  if (result < 0) {
+    return result;
+  }
+  return handlers->on_MyMessageB(&obj, response, handlers->userdata);
+}
+
+static int _pbrpc_dispatch_MyMessageC(pbwire_ParseContext* request,
+                                      pbwire_EmitContext* response,
+                                      void* userdata) {
+  const pbrpc_test_messages_Handlers* handlers =
+      (const pbrpc_test_messages_Handlers*)userdata;
+  MyMessageC obj;
+  memset(&obj, 0, sizeof(obj));
+  int result = pbparse_MyMessageC(request, &obj);
+  if (result < 0) {
+    return result;
+  }
+  return handlers->on_MyMessageC(&obj, response, handlers->userdata);
+}
+
+static int _pbrpc_dispatch_TestFixedArray(pbwire_ParseContext* request,
+                                          pbwire_EmitContext* response,
+                                          void* userdata) {
+  const pbrpc_test_messages_Handlers* handlers =
+      (const pbrpc_test_messages_Handlers*)userdata;
+  TestFixedArray obj;
+  memset(&obj, 0, sizeof(obj));
+  int result = pbparse_TestFixedArray(request, &obj);
+  if (result < 0) {
+    return result;
+  }
+  return handlers->on_TestFixedArray(&obj, response, handlers->userdata);
+}
+
+static int _pbrpc_dispatch_TestAlignas(pbwire_ParseContext* request,
+                                       pbwire_EmitContext* response,
+                                       void* userdata) {
+  const pbrpc_test_messages_Handlers* handlers =
+      (const pbrpc_test_messages_Handlers*)userdata;
+  TestAlignas obj;
+  memset(&obj, 0, sizeof(obj));
+  int result = pbparse_TestAlignas(request, &obj);
+  if (result < 0) {
+    return result;
+  }
+  return handlers->on_TestAlignas(&obj, response, handlers->userdata);
+}
+
+static int _pbrpc_dispatch_TestPrimitives(pbwire_ParseContext* request,
+                                          pbwire_EmitContext* response,
+                                          void* userdata) {
+  const pbrpc_test_messages_Handlers* handlers =
+      (const pbrpc_test_messages_Handlers*)userdata;
+  TestPrimitives obj;
+  memset(&obj, 0, sizeof(obj));
+  int result = pbparse_TestPrimitives(request, &obj);
+  if (result < 0) {
+    return result;
+  }
+  return handlers->on_TestPrimitives(&obj, response, handlers->userdata);
+}
+
+int pbrpc_test_messages_get_methods(
+    const pbrpc_test_messages_Handlers* handlers, pbwire_RpcMethod* methods,
+    size_t capacity) {
+  size_t count = 0;
+  if (handlers->on_MyMessageA) {
+    if (count >= capacity) {
+      return -1;
+    }
+    methods[count].id = PBRPC_METHOD_MyMessageA;
+    methods[count].handler = _pbrpc_dispatch_MyMessageA;
+    methods[count].userdata = (void*)handlers;
+    count++;
+  }
+  if (handlers->on_MyMessageB) {
+    if (count >= capacity) {
+      return -1;
+    }
+    methods[count].id = PBRPC_METHOD_MyMessageB;
+    methods[count].handler = _pbrpc_dispatch_MyMessageB;
+    methods[count].userdata = (void*)handlers;
+    count++;
+  }
+  if (handlers->on_MyMessageC) {
+    if (count >= capacity) {
+      return -1;
+    }
+    methods[count].id = PBRPC_METHOD_MyMessageC;
+    methods[count].handler = _pbrpc_dispatch_MyMessageC;
+    methods[count].userdata = (void*)handlers;
+    count++;
+  }
+  if (handlers->on_TestFixedArray) {
+    if (count >= capacity) {
+      return -1;
+    }
+    methods[count].id = PBRPC_METHOD_TestFixedArray;
+    methods[count].handler = _pbrpc_dispatch_TestFixedArray;
+    methods[count].userdata = (void*)handlers;
+    count++;
+  }
+  if (handlers->on_TestAlignas) {
+    if (count >= capacity) {
+      return -1;
+    }
+    methods[count].id = PBRPC_METHOD_TestAlignas;
+    methods[count].handler = _pbrpc_dispatch_TestAlignas;
+    methods[count].userdata = (void*)handlers;
+    count++;
+  }
+  if (handlers->on_TestPrimitives) {
+    if (count >= capacity) {
+      return -1;
+    }
+    methods[count].id = PBRPC_METHOD_TestPrimitives;
+    methods[count].handler = _pbrpc_dispatch_TestPrimitives;
+    methods[count].userdata = (void*)handlers;
+    count++;
+  }
+  return (int)count;
+}
+
+int pbrpc_send_MyMessageA(pbwire_RpcClient* client, const MyMessageA* request,
+                          pbwire_Error* error) {
+  pbwire_EmitContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.error = error;
+  pbwire_rpcclient_begin_request(client, &ctx);
+  int result = pbemit_MyMessageA(&ctx, request);
+  if (result < 0) {
+    return result;
+  }
+  return pbwire_rpcclient_commit_request(client, &ctx, PBRPC_METHOD_MyMessageA,
+                                         result);
+}
+
+int pbrpc_send_MyMessageB(pbwire_RpcClient* client, const MyMessageB* request,
+                          pbwire_Error* error) {
+  pbwire_EmitContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.error = error;
+  pbwire_rpcclient_begin_request(client, &ctx);
+  int result = pbemit_MyMessageB(&ctx, request);
+  if (result < 0) {
+    return result;
+  }
+  return pbwire_rpcclient_commit_request(client, &ctx, PBRPC_METHOD_MyMessageB,
+                                         result);
+}
+
+int pbrpc_send_MyMessageC(pbwire_RpcClient* client, const MyMessageC* request,
+                          pbwire_Error* error) {
+  pbwire_EmitContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.error = error;
+  pbwire_rpcclient_begin_request(client, &ctx);
+  int result = pbemit_MyMessageC(&ctx, request);
+  if (result < 0) {
+    return result;
+  }
+  return pbwire_rpcclient_commit_request(client, &ctx, PBRPC_METHOD_MyMessageC,
+                                         result);
+}
+
+int pbrpc_send_TestFixedArray(pbwire_RpcClient* client,
+                              const TestFixedArray* request,
+                              pbwire_Error* error) {
+  pbwire_EmitContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.error = error;
+  pbwire_rpcclient_begin_request(client, &ctx);
+  int result = pbemit_TestFixedArray(&ctx, request);
+  if (result < 0) {
+    return result;
+  }
+  return pbwire_rpcclient_commit_request(client, &ctx,
+                                         PBRPC_METHOD_TestFixedArray, result);
+}
+
+int pbrpc_send_TestAlignas(pbwire_RpcClient* client, const TestAlignas* request,
+                           pbwire_Error* error) {
+  pbwire_EmitContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.error = error;
+  pbwire_rpcclient_begin_request(client, &ctx);
+  int result = pbemit_TestAlignas(&ctx, request);
+  if (result < 0) {
+    return result;
+  }
+  return pbwire_rpcclient_commit_request(client, &ctx, PBRPC_METHOD_TestAlignas,
+                                         result);
+}
+
+int pbrpc_send_TestPrimitives(pbwire_RpcClient* client,
+                              const TestPrimitives* request,
+                              pbwire_Error* error) {
+  pbwire_EmitContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.error = error;
+  pbwire_rpcclient_begin_request(client, &ctx);
+  int result = pbemit_TestPrimitives(&ctx, request);
+  if (result < 0) {
+    return result;
+  }
+  return pbwire_rpcclient_commit_request(client, &ctx,
+                                         PBRPC_METHOD_TestPrimitives, result);
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+// Generated by protostruct. DO NOT EDIT BY HAND!
+
+#include "tangent/protostruct/pbwire_rpc.h"
+#include "tangent/protostruct/test/test_messages.pbwire.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* RPC method ids, derived from the fully qualified message name */
+#define PBRPC_METHOD_MyMessageA 0xb6c282f6u
+#define PBRPC_METHOD_MyMessageB 0xb5c28163u
+#define PBRPC_METHOD_MyMessageC 0xb4c27fd0u
+#define PBRPC_METHOD_TestFixedArray 0x4599c7b9u
+#define PBRPC_METHOD_TestAlignas 0xa3cda227u
+#define PBRPC_METHOD_TestPrimitives 0x4f5ab98cu
+
+/* Typed request handlers, keyed by request message type. Each handler
+   receives the parsed request and should emit its response into `response`,
+   returning the number of bytes written or a negative value on error. Leave
+   a handler NULL to not serve that message type. */
+typedef struct pbrpc_test_messages_Handlers {
+  int (*on_MyMessageA)(const MyMessageA* request, pbwire_EmitContext* response,
+                       void* userdata);
+  int (*on_MyMessageB)(const MyMessageB* request, pbwire_EmitContext* response,
+                       void* userdata);
+  int (*on_MyMessageC)(const MyMessageC* request, pbwire_EmitContext* response,
+                       void* userdata);
+  int (*on_TestFixedArray)(const TestFixedArray* request,
+                           pbwire_EmitContext* response, void* userdata);
+  int (*on_TestAlignas)(const TestAlignas* request,
+                        pbwire_EmitContext* response, void* userdata);
+  int (*on_TestPrimitives)(const TestPrimitives* request,
+                           pbwire_EmitContext* response, void* userdata);
+  void* userdata;
+} pbrpc_test_messages_Handlers;
+
+/* Fill `methods` with one dispatch table entry for each non-null handler in
+   `handlers`, which must outlive the server. Return the number of entries
+   written, or -1 if `capacity` is too small. */
+int pbrpc_test_messages_get_methods(
+    const pbrpc_test_messages_Handlers* handlers, pbwire_RpcMethod* methods,
+    size_t capacity);
+
+/* Queue a MyMessageA request on the client connection */
+int pbrpc_send_MyMessageA(pbwire_RpcClient* client, const MyMessageA* request,
+                          pbwire_Error* error);
+/* Queue a MyMessageB request on the client connection */
+int pbrpc_send_MyMessageB(pbwire_RpcClient* client, const MyMessageB* request,
+                          pbwire_Error* error);
+/* Queue a MyMessageC request on the client connection */
+int pbrpc_send_MyMessageC(pbwire_RpcClient* client, const MyMessageC* request,
+                          pbwire_Error* error);
+/* Queue a TestFixedArray request on the client connection */
+int pbrpc_send_TestFixedArray(pbwire_RpcClient* client,
+                              const TestFixedArray* request,
+                              pbwire_Error* error);
+/* Queue a TestAlignas request on the client connection */
+int pbrpc_send_TestAlignas(pbwire_RpcClient* client, const TestAlignas* request,
+                           pbwire_Error* error);
+/* Queue a TestPrimitives request on the client connection */
+int pbrpc_send_TestPrimitives(pbwire_RpcClient* client,
+                              const TestPrimitives* request,
+                              pbwire_Error* error);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -3,6 +3,9 @@
 #include <stdint.h>
 
 #include "tangent/protostruct/test/test_messages.pbwire.h"
+#ifdef PBWIRE_WITH_STATS
+#include "tangent/protostruct/pbwire_stats.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +40,15 @@ int pbparse_MyEnumA(pbwire_ParseContext* ctx, MyEnumA* value) {
   return result;
 }
 
+#ifdef PBWIRE_WITH_STATS
+static pbwire_StatsType _pbstats_MyMessageA = {"MyMessageA", 0};
+static pbwire_StatsType _pbstats_MyMessageB = {"MyMessageB", 0};
+static pbwire_StatsType _pbstats_MyMessageC = {"MyMessageC", 0};
+static pbwire_StatsType _pbstats_TestFixedArray = {"TestFixedArray", 0};
+static pbwire_StatsType _pbstats_TestAlignas = {"TestAlignas", 0};
+static pbwire_StatsType _pbstats_TestPrimitives = {"TestPrimitives", 0};
+#endif
+
 int _pbemit0_MyMessageA(pbwire_EmitContext* ctx, const MyMessageA* obj) {
   int write_result = 0;
 
@@ -150,12 +162,18 @@ int _pbemit1_MyMessageA(pbwire_EmitContext* ctx, const MyMessageA* obj) {
 
 int pbemit_MyMessageA(pbwire_EmitContext* ctx, const MyMessageA* obj) {
   int retcode = 0;
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_MyMessageA);
+#endif
 
   retcode = _pbemit0_MyMessageA(ctx, obj);
-  if (retcode < 0) {
-    return retcode;
+  if (retcode >= 0) {
+    retcode = _pbemit1_MyMessageA(ctx, obj);
   }
-  retcode = _pbemit1_MyMessageA(ctx, obj);
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, retcode,
+                    ctx->error);
+#endif
   return retcode;
 }
 
@@ -185,8 +203,17 @@ static int _parse_fielditem_MyMessageA(pbwire_ParseContext* ctx,
 }
 
 int pbparse_MyMessageA(pbwire_ParseContext* ctx, MyMessageA* obj) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_MyMessageA);
+  int retcode = pbwire_parse_message(
+      ctx, (pbwire_FieldItemCallback)_parse_fielditem_MyMessageA, obj);
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, retcode,
+                    ctx->error);
+  return retcode;
+#else
   return pbwire_parse_message(
       ctx, (pbwire_FieldItemCallback)_parse_fielditem_MyMessageA, obj);
+#endif
 }
 
 int _pbemit0_MyMessageB(pbwire_EmitContext* ctx, const MyMessageB* obj) {
@@ -253,12 +280,18 @@ int _pbemit1_MyMessageB(pbwire_EmitContext* ctx, const MyMessageB* obj) {
 
 int pbemit_MyMessageB(pbwire_EmitContext* ctx, const MyMessageB* obj) {
   int retcode = 0;
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_MyMessageB);
+#endif
 
   retcode = _pbemit0_MyMessageB(ctx, obj);
-  if (retcode < 0) {
-    return retcode;
+  if (retcode >= 0) {
+    retcode = _pbemit1_MyMessageB(ctx, obj);
   }
-  retcode = _pbemit1_MyMessageB(ctx, obj);
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, retcode,
+                    ctx->error);
+#endif
   return retcode;
 }
 
@@ -276,8 +309,17 @@ static int _parse_fielditem_MyMessageB(pbwire_ParseContext* ctx,
 }
 
 int pbparse_MyMessageB(pbwire_ParseContext* ctx, MyMessageB* obj) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_MyMessageB);
+  int retcode = pbwire_parse_message(
+      ctx, (pbwire_FieldItemCallback)_parse_fielditem_MyMessageB, obj);
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, retcode,
+                    ctx->error);
+  return retcode;
+#else
   return pbwire_parse_message(
       ctx, (pbwire_FieldItemCallback)_parse_fielditem_MyMessageB, obj);
+#endif
 }
 
 int _pbemit0_MyMessageC(pbwire_EmitContext* ctx, const MyMessageC* obj) {
@@ -424,12 +466,18 @@ int _pbemit1_MyMessageC(pbwire_EmitContext* ctx, const MyMessageC* obj) {
 
 int pbemit_MyMessageC(pbwire_EmitContext* ctx, const MyMessageC* obj) {
   int retcode = 0;
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_MyMessageC);
+#endif
 
   retcode = _pbemit0_MyMessageC(ctx, obj);
-  if (retcode < 0) {
-    return retcode;
+  if (retcode >= 0) {
+    retcode = _pbemit1_MyMessageC(ctx, obj);
   }
-  retcode = _pbemit1_MyMessageC(ctx, obj);
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, retcode,
+                    ctx->error);
+#endif
   return retcode;
 }
 
@@ -438,6 +486,13 @@ static int _parse_fielditem_MyMessageC(pbwire_ParseContext* ctx,
   switch (tag) {
     /* fieldA */
     case 10: {
+      if (obj->fieldACount >= ARRAY_SIZE(obj->fieldA)) {
+        /* Array is full, drop the element */
+#ifdef PBWIRE_WITH_STATS
+        pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+#endif
+        return (ctx->buffer.end - ctx->buffer.begin);
+      }
       return pbparse_MyMessageA(ctx, &obj->fieldA[obj->fieldACount++]);
     }
     /* fieldB */
@@ -445,6 +500,9 @@ static int _parse_fielditem_MyMessageC(pbwire_ParseContext* ctx,
       if (obj->fieldBCount < ARRAY_SIZE(obj->fieldB)) {
         return pbparse_int32(ctx, &obj->fieldB[obj->fieldBCount++]);
       } else {
+#ifdef PBWIRE_WITH_STATS
+        pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+#endif
         return pbparse_int32(ctx, NULL);
       }
     }
@@ -460,6 +518,13 @@ static int _parse_fielditem_MyMessageC(pbwire_ParseContext* ctx,
     }
     /* fieldC */
     case 40: {
+      if (obj->fieldCCount >= ARRAY_SIZE(obj->fieldC)) {
+        /* Array is full, drop the element */
+#ifdef PBWIRE_WITH_STATS
+        pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+#endif
+        return pbparse_int32(ctx, NULL);
+      }
       return pbparse_int32(ctx, &obj->fieldC[obj->fieldCCount++]);
     }
     default:
@@ -469,8 +534,17 @@ static int _parse_fielditem_MyMessageC(pbwire_ParseContext* ctx,
 }
 
 int pbparse_MyMessageC(pbwire_ParseContext* ctx, MyMessageC* obj) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_MyMessageC);
+  int retcode = pbwire_parse_message(
+      ctx, (pbwire_FieldItemCallback)_parse_fielditem_MyMessageC, obj);
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, retcode,
+                    ctx->error);
+  return retcode;
+#else
   return pbwire_parse_message(
       ctx, (pbwire_FieldItemCallback)_parse_fielditem_MyMessageC, obj);
+#endif
 }
 
 int _pbemit0_TestFixedArray(pbwire_EmitContext* ctx,
@@ -521,12 +595,18 @@ int _pbemit1_TestFixedArray(pbwire_EmitContext* ctx,
 
 int pbemit_TestFixedArray(pbwire_EmitContext* ctx, const TestFixedArray* obj) {
   int retcode = 0;
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_TestFixedArray);
+#endif
 
   retcode = _pbemit0_TestFixedArray(ctx, obj);
-  if (retcode < 0) {
-    return retcode;
+  if (retcode >= 0) {
+    retcode = _pbemit1_TestFixedArray(ctx, obj);
   }
-  retcode = _pbemit1_TestFixedArray(ctx, obj);
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, retcode,
+                    ctx->error);
+#endif
   return retcode;
 }
 
@@ -536,6 +616,13 @@ static int _parse_fielditem_TestFixedArray(pbwire_ParseContext* ctx,
   switch (tag) {
     /* fixedSizedArray */
     case 9: {
+      if (fixedSizedArrayCount >= ARRAY_SIZE(obj->fixedSizedArray)) {
+        /* Array is full, drop the element */
+#ifdef PBWIRE_WITH_STATS
+        pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+#endif
+        return pbparse_double(ctx, NULL);
+      }
       return pbparse_double(ctx, &obj->fixedSizedArray[fixedSizedArrayCount++]);
     }
     default:
@@ -545,8 +632,17 @@ static int _parse_fielditem_TestFixedArray(pbwire_ParseContext* ctx,
 }
 
 int pbparse_TestFixedArray(pbwire_ParseContext* ctx, TestFixedArray* obj) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_TestFixedArray);
+  int retcode = pbwire_parse_message(
+      ctx, (pbwire_FieldItemCallback)_parse_fielditem_TestFixedArray, obj);
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, retcode,
+                    ctx->error);
+  return retcode;
+#else
   return pbwire_parse_message(
       ctx, (pbwire_FieldItemCallback)_parse_fielditem_TestFixedArray, obj);
+#endif
 }
 
 int _pbemit0_TestAlignas(pbwire_EmitContext* ctx, const TestAlignas* obj) {
@@ -595,12 +691,18 @@ int _pbemit1_TestAlignas(pbwire_EmitContext* ctx, const TestAlignas* obj) {
 
 int pbemit_TestAlignas(pbwire_EmitContext* ctx, const TestAlignas* obj) {
   int retcode = 0;
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_TestAlignas);
+#endif
 
   retcode = _pbemit0_TestAlignas(ctx, obj);
-  if (retcode < 0) {
-    return retcode;
+  if (retcode >= 0) {
+    retcode = _pbemit1_TestAlignas(ctx, obj);
   }
-  retcode = _pbemit1_TestAlignas(ctx, obj);
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, retcode,
+                    ctx->error);
+#endif
   return retcode;
 }
 
@@ -610,6 +712,13 @@ static int _parse_fielditem_TestAlignas(pbwire_ParseContext* ctx,
   switch (tag) {
     /* array */
     case 13: {
+      if (arrayCount >= ARRAY_SIZE(obj->array)) {
+        /* Array is full, drop the element */
+#ifdef PBWIRE_WITH_STATS
+        pbwire_stats_count(ctx->stats, PBWIRE_STAT_TRUNCATED_REPEATED, 1);
+#endif
+        return pbparse_float(ctx, NULL);
+      }
       return pbparse_float(ctx, &obj->array[arrayCount++]);
     }
     default:
@@ -619,8 +728,17 @@ static int _parse_fielditem_TestAlignas(pbwire_ParseContext* ctx,
 }
 
 int pbparse_TestAlignas(pbwire_ParseContext* ctx, TestAlignas* obj) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_TestAlignas);
+  int retcode = pbwire_parse_message(
+      ctx, (pbwire_FieldItemCallback)_parse_fielditem_TestAlignas, obj);
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, retcode,
+                    ctx->error);
+  return retcode;
+#else
   return pbwire_parse_message(
       ctx, (pbwire_FieldItemCallback)_parse_fielditem_TestAlignas, obj);
+#endif
 }
 
 int _pbemit0_TestPrimitives(pbwire_EmitContext* ctx,
@@ -906,12 +1024,18 @@ int _pbemit1_TestPrimitives(pbwire_EmitContext* ctx,
 
 int pbemit_TestPrimitives(pbwire_EmitContext* ctx, const TestPrimitives* obj) {
   int retcode = 0;
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_TestPrimitives);
+#endif
 
   retcode = _pbemit0_TestPrimitives(ctx, obj);
-  if (retcode < 0) {
-    return retcode;
+  if (retcode >= 0) {
+    retcode = _pbemit1_TestPrimitives(ctx, obj);
   }
-  retcode = _pbemit1_TestPrimitives(ctx, obj);
+#ifdef PBWIRE_WITH_STATS
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_EMIT_CALLS, retcode,
+                    ctx->error);
+#endif
   return retcode;
 }
 
@@ -969,8 +1093,17 @@ static int _parse_fielditem_TestPrimitives(pbwire_ParseContext* ctx,
 }
 
 int pbparse_TestPrimitives(pbwire_ParseContext* ctx, TestPrimitives* obj) {
+#ifdef PBWIRE_WITH_STATS
+  int32_t prev_type = pbwire_stats_enter(ctx->stats, &_pbstats_TestPrimitives);
+  int retcode = pbwire_parse_message(
+      ctx, (pbwire_FieldItemCallback)_parse_fielditem_TestPrimitives, obj);
+  pbwire_stats_exit(ctx->stats, prev_type, PBWIRE_STAT_PARSE_CALLS, retcode,
+                    ctx->error);
+  return retcode;
+#else
   return pbwire_parse_message(
       ctx, (pbwire_FieldItemCallback)_parse_fielditem_TestPrimitives, obj);
+#endif
 }
 
 #ifdef __cplusplus
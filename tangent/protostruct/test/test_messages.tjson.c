@@ -0,0 +1,601 @@
+// Generated by protostruct. DO NOT EDIT BY HAND!
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tangent/protostruct/test/test_messages.tjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define _TJSON_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+/* Destination of the items of a repeated field */
+typedef struct _tjson_Items {
+  void* obj;
+  uint32_t count;
+} _tjson_Items;
+
+int tjson_parse_MyEnumA(tjson_ParseContext ctx, MyEnumA* value) {
+  /* Minimal perfect hash of the normalized value names */
+  static const uint32_t kSeeds[2] = {3, 1};
+  static const char* const kKeys[3] = {
+      "myenumavalue3", "myenumavalue1", "myenumavalue2"};
+  static const uint32_t kSizes[3] = {13, 13, 13};
+  static const MyEnumA kValues[3] = {
+      MyEnumA_VALUE3, MyEnumA_VALUE1, MyEnumA_VALUE2};
+
+  struct tjson_Event event;
+  if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
+    return -1;
+  }
+  if (event.token.typeno == TJSON_NUMERIC_LITERAL) {
+    int32_t numeric_value = 0;
+    if (tjson_parse_value_int32(&event.token, &numeric_value, ctx.error)) {
+      tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
+      return -1;
+    }
+    switch (numeric_value) {
+      case MyEnumA_VALUE1:
+      case MyEnumA_VALUE2:
+      case MyEnumA_VALUE3:
+        *value = (MyEnumA)numeric_value;
+        return 0;
+      default:
+        break;
+    }
+  } else if (event.token.typeno == TJSON_STRING_LITERAL) {
+    char key[13];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(
+        tjson_StringPiece_substr(event.token.spelling, 1, -1), key, sizeof(key),
+        &hash);
+    if (size >= 0) {
+      uint32_t slot = tjson_phash_slot(hash, kSeeds[hash % 2], 3);
+      if ((uint32_t)size == kSizes[slot] &&
+          memcmp(key, kKeys[slot], size) == 0) {
+        *value = kValues[slot];
+        return 0;
+      }
+    }
+  }
+
+  ctx.error->code = TJSON_PARSE_SEMANTIC;
+  ctx.error->loc = event.token.location;
+  tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
+  snprintf(ctx.error->msg, sizeof(ctx.error->msg),
+           "%.*s is not a value of MyEnumA at %d:%d",
+           (int)tjson_StringPiece_size(event.token.spelling),
+           event.token.spelling.begin, (int)ctx.error->loc.lineno,
+           (int)ctx.error->loc.colno);
+  return -1;
+}
+
+void tjson_emit_MyEnumA(tjson_WriteBuffer* buf, MyEnumA value) {
+  switch (value) {
+    case MyEnumA_VALUE1:
+      tjson_emit_raw(buf, "\"MyEnumA_VALUE1\"", 16);
+      return;
+    case MyEnumA_VALUE2:
+      tjson_emit_raw(buf, "\"MyEnumA_VALUE2\"", 16);
+      return;
+    case MyEnumA_VALUE3:
+      tjson_emit_raw(buf, "\"MyEnumA_VALUE3\"", 16);
+      return;
+    default:
+      tjson_emit_int32(buf, (int32_t)value);
+      return;
+  }
+}
+
+static int _tjson_fielditem_MyMessageA(void* pobj, tjson_ParseContext ctx,
+                                       tjson_StringPiece fieldname,
+                                       uint32_t keyid) {
+  /* Minimal perfect hash of the normalized field names */
+  static const uint32_t kSeeds[2] = {1, 16};
+  static const char* const kKeys[4] = {"fielda", "fieldd", "fieldc", "fieldb"};
+  static const uint32_t kSizes[4] = {6, 6, 6, 6};
+
+  MyMessageA* obj = (MyMessageA*)pobj;
+  /* Slot of the field, or -1 for an unknown field. Once it is learned for an
+     interned key it is bound to the key, with kKeys as the shape. */
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key),
+                                                    &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 2], 4);
+      if ((uint32_t)size == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = (int32_t)candidate;
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    /* fieldA */
+    case 0: {
+      return tjson_parse_int32(ctx, &obj->fieldA);
+    }
+    /* fieldD */
+    case 1: {
+      return tjson_parse_MyEnumA(ctx, &obj->fieldD);
+    }
+    /* fieldC */
+    case 2: {
+      return tjson_parse_uint64(ctx, &obj->fieldC);
+    }
+    /* fieldB */
+    case 3: {
+      return tjson_parse_double(ctx, &obj->fieldB);
+    }
+    default:
+      break;
+  }
+  return tjson_sink_value(ctx);
+}
+
+int tjson_parse_MyMessageA(tjson_ParseContext ctx, MyMessageA* obj) {
+  return tjson_parse_object_interned(ctx, _tjson_fielditem_MyMessageA, obj);
+}
+
+void tjson_emit_MyMessageA(tjson_WriteBuffer* buf, const MyMessageA* obj) {
+  tjson_emit_raw(buf, "{\"fieldA\":", 10);
+  tjson_emit_int32(buf, obj->fieldA);
+  tjson_emit_raw(buf, ",\"fieldB\":", 10);
+  tjson_emit_double(buf, obj->fieldB);
+  tjson_emit_raw(buf, ",\"fieldC\":", 10);
+  tjson_emit_uint64(buf, obj->fieldC);
+  tjson_emit_raw(buf, ",\"fieldD\":", 10);
+  tjson_emit_MyEnumA(buf, obj->fieldD);
+  tjson_emit_raw(buf, "}", 1);
+}
+
+static int _tjson_fielditem_MyMessageB(void* pobj, tjson_ParseContext ctx,
+                                       tjson_StringPiece fieldname,
+                                       uint32_t keyid) {
+  /* Minimal perfect hash of the normalized field names */
+  static const uint32_t kSeeds[1] = {1};
+  static const char* const kKeys[1] = {"fielda"};
+  static const uint32_t kSizes[1] = {6};
+
+  MyMessageB* obj = (MyMessageB*)pobj;
+  /* Slot of the field, or -1 for an unknown field. Once it is learned for an
+     interned key it is bound to the key, with kKeys as the shape. */
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key),
+                                                    &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 1], 1);
+      if ((uint32_t)size == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = (int32_t)candidate;
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    /* fieldA */
+    case 0: {
+      return tjson_parse_MyMessageA(ctx, &obj->fieldA);
+    }
+    default:
+      break;
+  }
+  return tjson_sink_value(ctx);
+}
+
+int tjson_parse_MyMessageB(tjson_ParseContext ctx, MyMessageB* obj) {
+  return tjson_parse_object_interned(ctx, _tjson_fielditem_MyMessageB, obj);
+}
+
+void tjson_emit_MyMessageB(tjson_WriteBuffer* buf, const MyMessageB* obj) {
+  tjson_emit_raw(buf, "{\"fieldA\":", 10);
+  tjson_emit_MyMessageA(buf, &obj->fieldA);
+  tjson_emit_raw(buf, "}", 1);
+}
+
+static int _tjson_item_MyMessageC_fieldA(void* pitems, tjson_ParseContext ctx) {
+  _tjson_Items* items = (_tjson_Items*)pitems;
+  MyMessageC* obj = (MyMessageC*)items->obj;
+  if (items->count >= _TJSON_ARRAY_SIZE(obj->fieldA)) {
+    return tjson_list_overflow(ctx, "MyMessageC.fieldA",
+                               _TJSON_ARRAY_SIZE(obj->fieldA));
+  }
+  return tjson_parse_MyMessageA(ctx, &obj->fieldA[items->count++]);
+}
+
+static int _tjson_item_MyMessageC_fieldB(void* pitems, tjson_ParseContext ctx) {
+  _tjson_Items* items = (_tjson_Items*)pitems;
+  MyMessageC* obj = (MyMessageC*)items->obj;
+  if (items->count >= _TJSON_ARRAY_SIZE(obj->fieldB)) {
+    return tjson_list_overflow(ctx, "MyMessageC.fieldB",
+                               _TJSON_ARRAY_SIZE(obj->fieldB));
+  }
+  return tjson_parse_int32(ctx, &obj->fieldB[items->count++]);
+}
+
+static int _tjson_item_MyMessageC_fieldC(void* pitems, tjson_ParseContext ctx) {
+  _tjson_Items* items = (_tjson_Items*)pitems;
+  MyMessageC* obj = (MyMessageC*)items->obj;
+  if (items->count >= _TJSON_ARRAY_SIZE(obj->fieldC)) {
+    return tjson_list_overflow(ctx, "MyMessageC.fieldC",
+                               _TJSON_ARRAY_SIZE(obj->fieldC));
+  }
+  return tjson_parse_int32(ctx, &obj->fieldC[items->count++]);
+}
+
+static int _tjson_fielditem_MyMessageC(void* pobj, tjson_ParseContext ctx,
+                                       tjson_StringPiece fieldname,
+                                       uint32_t keyid) {
+  /* Minimal perfect hash of the normalized field names */
+  static const uint32_t kSeeds[2] = {1, 3};
+  static const char* const kKeys[3] = {"fielda", "fieldc", "fieldb"};
+  static const uint32_t kSizes[3] = {6, 6, 6};
+
+  MyMessageC* obj = (MyMessageC*)pobj;
+  /* Slot of the field, or -1 for an unknown field. Once it is learned for an
+     interned key it is bound to the key, with kKeys as the shape. */
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key),
+                                                    &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 2], 3);
+      if ((uint32_t)size == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = (int32_t)candidate;
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    /* fieldA */
+    case 0: {
+      _tjson_Items items = {obj, 0};
+      int result = tjson_parse_list(ctx, _tjson_item_MyMessageC_fieldA, &items);
+      obj->fieldACount = items.count;
+      return result;
+    }
+    /* fieldC */
+    case 1: {
+      _tjson_Items items = {obj, 0};
+      int result = tjson_parse_list(ctx, _tjson_item_MyMessageC_fieldC, &items);
+      obj->fieldCCount = items.count;
+      return result;
+    }
+    /* fieldB */
+    case 2: {
+      _tjson_Items items = {obj, 0};
+      int result = tjson_parse_list(ctx, _tjson_item_MyMessageC_fieldB, &items);
+      obj->fieldBCount = items.count;
+      return result;
+    }
+    default:
+      break;
+  }
+  return tjson_sink_value(ctx);
+}
+
+int tjson_parse_MyMessageC(tjson_ParseContext ctx, MyMessageC* obj) {
+  return tjson_parse_object_interned(ctx, _tjson_fielditem_MyMessageC, obj);
+}
+
+void tjson_emit_MyMessageC(tjson_WriteBuffer* buf, const MyMessageC* obj) {
+  tjson_emit_raw(buf, "{\"fieldA\":", 10);
+  {
+    uint32_t count = obj->fieldACount;
+    if (count > _TJSON_ARRAY_SIZE(obj->fieldA)) {
+      count = _TJSON_ARRAY_SIZE(obj->fieldA);
+    }
+    tjson_emit_raw(buf, "[", 1);
+    for (uint32_t idx = 0; idx < count; idx++) {
+      if (idx) {
+        tjson_emit_raw(buf, ",", 1);
+      }
+      tjson_emit_MyMessageA(buf, &obj->fieldA[idx]);
+    }
+    tjson_emit_raw(buf, "]", 1);
+  }
+  tjson_emit_raw(buf, ",\"fieldB\":", 10);
+  {
+    uint32_t count = obj->fieldBCount;
+    if (count > _TJSON_ARRAY_SIZE(obj->fieldB)) {
+      count = _TJSON_ARRAY_SIZE(obj->fieldB);
+    }
+    tjson_emit_raw(buf, "[", 1);
+    for (uint32_t idx = 0; idx < count; idx++) {
+      if (idx) {
+        tjson_emit_raw(buf, ",", 1);
+      }
+      tjson_emit_int32(buf, obj->fieldB[idx]);
+    }
+    tjson_emit_raw(buf, "]", 1);
+  }
+  tjson_emit_raw(buf, ",\"fieldC\":", 10);
+  {
+    uint32_t count = obj->fieldCCount;
+    if (count > _TJSON_ARRAY_SIZE(obj->fieldC)) {
+      count = _TJSON_ARRAY_SIZE(obj->fieldC);
+    }
+    tjson_emit_raw(buf, "[", 1);
+    for (uint32_t idx = 0; idx < count; idx++) {
+      if (idx) {
+        tjson_emit_raw(buf, ",", 1);
+      }
+      tjson_emit_int32(buf, obj->fieldC[idx]);
+    }
+    tjson_emit_raw(buf, "]", 1);
+  }
+  tjson_emit_raw(buf, "}", 1);
+}
+
+static int _tjson_item_TestFixedArray_fixedSizedArray(void* pitems,
+                                                      tjson_ParseContext ctx) {
+  _tjson_Items* items = (_tjson_Items*)pitems;
+  TestFixedArray* obj = (TestFixedArray*)items->obj;
+  if (items->count >= _TJSON_ARRAY_SIZE(obj->fixedSizedArray)) {
+    return tjson_list_overflow(ctx, "TestFixedArray.fixedSizedArray",
+                               _TJSON_ARRAY_SIZE(obj->fixedSizedArray));
+  }
+  return tjson_parse_double(ctx, &obj->fixedSizedArray[items->count++]);
+}
+
+static int _tjson_fielditem_TestFixedArray(void* pobj, tjson_ParseContext ctx,
+                                           tjson_StringPiece fieldname,
+                                           uint32_t keyid) {
+  /* Minimal perfect hash of the normalized field names */
+  static const uint32_t kSeeds[1] = {1};
+  static const char* const kKeys[1] = {"fixedsizedarray"};
+  static const uint32_t kSizes[1] = {15};
+
+  TestFixedArray* obj = (TestFixedArray*)pobj;
+  /* Slot of the field, or -1 for an unknown field. Once it is learned for an
+     interned key it is bound to the key, with kKeys as the shape. */
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[15];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key),
+                                                    &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 1], 1);
+      if ((uint32_t)size == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = (int32_t)candidate;
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    /* fixedSizedArray */
+    case 0: {
+      _tjson_Items items = {obj, 0};
+      int result = tjson_parse_list(ctx,
+                                    _tjson_item_TestFixedArray_fixedSizedArray,
+                                    &items);
+      return result;
+    }
+    default:
+      break;
+  }
+  return tjson_sink_value(ctx);
+}
+
+int tjson_parse_TestFixedArray(tjson_ParseContext ctx, TestFixedArray* obj) {
+  return tjson_parse_object_interned(ctx, _tjson_fielditem_TestFixedArray, obj);
+}
+
+void tjson_emit_TestFixedArray(tjson_WriteBuffer* buf,
+                               const TestFixedArray* obj) {
+  tjson_emit_raw(buf, "{\"fixedSizedArray\":", 19);
+  {
+    uint32_t count = _TJSON_ARRAY_SIZE(obj->fixedSizedArray);
+    tjson_emit_raw(buf, "[", 1);
+    for (uint32_t idx = 0; idx < count; idx++) {
+      if (idx) {
+        tjson_emit_raw(buf, ",", 1);
+      }
+      tjson_emit_double(buf, obj->fixedSizedArray[idx]);
+    }
+    tjson_emit_raw(buf, "]", 1);
+  }
+  tjson_emit_raw(buf, "}", 1);
+}
+
+static int _tjson_item_TestAlignas_array(void* pitems, tjson_ParseContext ctx) {
+  _tjson_Items* items = (_tjson_Items*)pitems;
+  TestAlignas* obj = (TestAlignas*)items->obj;
+  if (items->count >= _TJSON_ARRAY_SIZE(obj->array)) {
+    return tjson_list_overflow(ctx, "TestAlignas.array",
+                               _TJSON_ARRAY_SIZE(obj->array));
+  }
+  return tjson_parse_float(ctx, &obj->array[items->count++]);
+}
+
+static int _tjson_fielditem_TestAlignas(void* pobj, tjson_ParseContext ctx,
+                                        tjson_StringPiece fieldname,
+                                        uint32_t keyid) {
+  /* Minimal perfect hash of the normalized field names */
+  static const uint32_t kSeeds[1] = {1};
+  static const char* const kKeys[1] = {"array"};
+  static const uint32_t kSizes[1] = {5};
+
+  TestAlignas* obj = (TestAlignas*)pobj;
+  /* Slot of the field, or -1 for an unknown field. Once it is learned for an
+     interned key it is bound to the key, with kKeys as the shape. */
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[5];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key),
+                                                    &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 1], 1);
+      if ((uint32_t)size == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = (int32_t)candidate;
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    /* array */
+    case 0: {
+      _tjson_Items items = {obj, 0};
+      int result = tjson_parse_list(ctx, _tjson_item_TestAlignas_array, &items);
+      return result;
+    }
+    default:
+      break;
+  }
+  return tjson_sink_value(ctx);
+}
+
+int tjson_parse_TestAlignas(tjson_ParseContext ctx, TestAlignas* obj) {
+  return tjson_parse_object_interned(ctx, _tjson_fielditem_TestAlignas, obj);
+}
+
+void tjson_emit_TestAlignas(tjson_WriteBuffer* buf, const TestAlignas* obj) {
+  tjson_emit_raw(buf, "{\"array\":", 9);
+  {
+    uint32_t count = _TJSON_ARRAY_SIZE(obj->array);
+    tjson_emit_raw(buf, "[", 1);
+    for (uint32_t idx = 0; idx < count; idx++) {
+      if (idx) {
+        tjson_emit_raw(buf, ",", 1);
+      }
+      tjson_emit_float(buf, obj->array[idx]);
+    }
+    tjson_emit_raw(buf, "]", 1);
+  }
+  tjson_emit_raw(buf, "}", 1);
+}
+
+static int _tjson_fielditem_TestPrimitives(void* pobj, tjson_ParseContext ctx,
+                                           tjson_StringPiece fieldname,
+                                           uint32_t keyid) {
+  /* Minimal perfect hash of the normalized field names */
+  static const uint32_t kSeeds[6] = {1, 2, 2, 11, 1, 12};
+  static const char* const kKeys[11] = {
+      "fielda", "fieldi", "fielde", "fieldb", "fieldd", "fieldg", "fieldc",
+      "fieldk", "fieldf", "fieldj", "fieldh"};
+  static const uint32_t kSizes[11] = {6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6};
+
+  TestPrimitives* obj = (TestPrimitives*)pobj;
+  /* Slot of the field, or -1 for an unknown field. Once it is learned for an
+     interned key it is bound to the key, with kKeys as the shape. */
+  int32_t slot = -1;
+  if (!tjson_lookup_key(ctx, kKeys, keyid, &slot)) {
+    char key[6];
+    uint32_t hash = 0;
+    int32_t size = tjson_StringPiece_suci_normalize(fieldname, key, sizeof(key),
+                                                    &hash);
+    if (size >= 0) {
+      uint32_t candidate = tjson_phash_slot(hash, kSeeds[hash % 6], 11);
+      if ((uint32_t)size == kSizes[candidate] &&
+          memcmp(key, kKeys[candidate], size) == 0) {
+        slot = (int32_t)candidate;
+      }
+    }
+    tjson_bind_key(ctx, kKeys, keyid, slot);
+  }
+  switch (slot) {
+    /* fieldA */
+    case 0: {
+      return tjson_parse_int8(ctx, &obj->fieldA);
+    }
+    /* fieldI */
+    case 1: {
+      return tjson_parse_float(ctx, &obj->fieldI);
+    }
+    /* fieldE */
+    case 2: {
+      return tjson_parse_uint8(ctx, &obj->fieldE);
+    }
+    /* fieldB */
+    case 3: {
+      return tjson_parse_int16(ctx, &obj->fieldB);
+    }
+    /* fieldD */
+    case 4: {
+      return tjson_parse_int64(ctx, &obj->fieldD);
+    }
+    /* fieldG */
+    case 5: {
+      return tjson_parse_uint32(ctx, &obj->fieldG);
+    }
+    /* fieldC */
+    case 6: {
+      return tjson_parse_int32(ctx, &obj->fieldC);
+    }
+    /* fieldK */
+    case 7: {
+      int8_t value = 0;
+      if (tjson_parse_boolean(ctx, &value)) {
+        return -1;
+      }
+      obj->fieldK = value;
+      return 0;
+    }
+    /* fieldF */
+    case 8: {
+      return tjson_parse_uint16(ctx, &obj->fieldF);
+    }
+    /* fieldJ */
+    case 9: {
+      return tjson_parse_double(ctx, &obj->fieldJ);
+    }
+    /* fieldH */
+    case 10: {
+      return tjson_parse_uint64(ctx, &obj->fieldH);
+    }
+    default:
+      break;
+  }
+  return tjson_sink_value(ctx);
+}
+
+int tjson_parse_TestPrimitives(tjson_ParseContext ctx, TestPrimitives* obj) {
+  return tjson_parse_object_interned(ctx, _tjson_fielditem_TestPrimitives, obj);
+}
+
+void tjson_emit_TestPrimitives(tjson_WriteBuffer* buf,
+                               const TestPrimitives* obj) {
+  tjson_emit_raw(buf, "{\"fieldA\":", 10);
+  tjson_emit_int8(buf, obj->fieldA);
+  tjson_emit_raw(buf, ",\"fieldB\":", 10);
+  tjson_emit_int16(buf, obj->fieldB);
+  tjson_emit_raw(buf, ",\"fieldC\":", 10);
+  tjson_emit_int32(buf, obj->fieldC);
+  tjson_emit_raw(buf, ",\"fieldD\":", 10);
+  tjson_emit_int64(buf, obj->fieldD);
+  tjson_emit_raw(buf, ",\"fieldE\":", 10);
+  tjson_emit_uint8(buf, obj->fieldE);
+  tjson_emit_raw(buf, ",\"fieldF\":", 10);
+  tjson_emit_uint16(buf, obj->fieldF);
+  tjson_emit_raw(buf, ",\"fieldG\":", 10);
+  tjson_emit_uint32(buf, obj->fieldG);
+  tjson_emit_raw(buf, ",\"fieldH\":", 10);
+  tjson_emit_uint64(buf, obj->fieldH);
+  tjson_emit_raw(buf, ",\"fieldI\":", 10);
+  tjson_emit_float(buf, obj->fieldI);
+  tjson_emit_raw(buf, ",\"fieldJ\":", 10);
+  tjson_emit_double(buf, obj->fieldJ);
+  tjson_emit_raw(buf, ",\"fieldK\":", 10);
+  tjson_emit_boolean(buf, obj->fieldK);
+  tjson_emit_raw(buf, "}", 1);
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
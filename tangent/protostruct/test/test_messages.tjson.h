@@ -0,0 +1,82 @@
+#pragma once
+// Generated by protostruct. DO NOT EDIT BY HAND!
+
+#include "tangent/tjson/emit.h"
+#include "tangent/tjson/parse.h"
+#include "tangent/protostruct/test/test_messages.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Parse a MyEnumA value from its name, or from its numeric value */
+int tjson_parse_MyEnumA(tjson_ParseContext ctx, MyEnumA* value);
+
+/* Parse a MyMessageA object. Repeated fields fill their fixed array (and
+   length field) and more items than the array holds is a TJSON_PARSE_OVERFLOW
+   error. Unknown fields are skipped. If the stream has a key table (see
+   tjson_LexerParser_set_keytable()) then the field of each interned key is
+   looked up once and remembered. */
+int tjson_parse_MyMessageA(tjson_ParseContext ctx, MyMessageA* obj);
+
+/* Parse a MyMessageB object. Repeated fields fill their fixed array (and
+   length field) and more items than the array holds is a TJSON_PARSE_OVERFLOW
+   error. Unknown fields are skipped. If the stream has a key table (see
+   tjson_LexerParser_set_keytable()) then the field of each interned key is
+   looked up once and remembered. */
+int tjson_parse_MyMessageB(tjson_ParseContext ctx, MyMessageB* obj);
+
+/* Parse a MyMessageC object. Repeated fields fill their fixed array (and
+   length field) and more items than the array holds is a TJSON_PARSE_OVERFLOW
+   error. Unknown fields are skipped. If the stream has a key table (see
+   tjson_LexerParser_set_keytable()) then the field of each interned key is
+   looked up once and remembered. */
+int tjson_parse_MyMessageC(tjson_ParseContext ctx, MyMessageC* obj);
+
+/* Parse a TestFixedArray object. Repeated fields fill their fixed array (and
+   length field) and more items than the array holds is a TJSON_PARSE_OVERFLOW
+   error. Unknown fields are skipped. If the stream has a key table (see
+   tjson_LexerParser_set_keytable()) then the field of each interned key is
+   looked up once and remembered. */
+int tjson_parse_TestFixedArray(tjson_ParseContext ctx, TestFixedArray* obj);
+
+/* Parse a TestAlignas object. Repeated fields fill their fixed array (and
+   length field) and more items than the array holds is a TJSON_PARSE_OVERFLOW
+   error. Unknown fields are skipped. If the stream has a key table (see
+   tjson_LexerParser_set_keytable()) then the field of each interned key is
+   looked up once and remembered. */
+int tjson_parse_TestAlignas(tjson_ParseContext ctx, TestAlignas* obj);
+
+/* Parse a TestPrimitives object. Repeated fields fill their fixed array (and
+   length field) and more items than the array holds is a TJSON_PARSE_OVERFLOW
+   error. Unknown fields are skipped. If the stream has a key table (see
+   tjson_LexerParser_set_keytable()) then the field of each interned key is
+   looked up once and remembered. */
+int tjson_parse_TestPrimitives(tjson_ParseContext ctx, TestPrimitives* obj);
+
+/* Serialize a MyEnumA value as its name */
+void tjson_emit_MyEnumA(tjson_WriteBuffer* buf, MyEnumA value);
+
+/* Serialize a MyMessageA object as compact JSON */
+void tjson_emit_MyMessageA(tjson_WriteBuffer* buf, const MyMessageA* obj);
+
+/* Serialize a MyMessageB object as compact JSON */
+void tjson_emit_MyMessageB(tjson_WriteBuffer* buf, const MyMessageB* obj);
+
+/* Serialize a MyMessageC object as compact JSON */
+void tjson_emit_MyMessageC(tjson_WriteBuffer* buf, const MyMessageC* obj);
+
+/* Serialize a TestFixedArray object as compact JSON */
+void tjson_emit_TestFixedArray(tjson_WriteBuffer* buf,
+                               const TestFixedArray* obj);
+
+/* Serialize a TestAlignas object as compact JSON */
+void tjson_emit_TestAlignas(tjson_WriteBuffer* buf, const TestAlignas* obj);
+
+/* Serialize a TestPrimitives object as compact JSON */
+void tjson_emit_TestPrimitives(tjson_WriteBuffer* buf,
+                               const TestPrimitives* obj);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,159 @@
+// Copyright 2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "tangent/protostruct/test/test_messages.tjson.h"
+#include "tangent/tjson/keytable.h"
+
+template <typename T>
+static int parse(const std::string& content,
+                 int (*fn)(tjson_ParseContext, T*), T* obj,
+                 tjson_Error* error) {
+  tjson_LexerParser stream;
+  if (tjson_LexerParser_init(&stream, error)) {
+    return -1;
+  }
+  tjson_StringPiece source = tjson_StringPiece_fromstr(content.c_str());
+  if (tjson_LexerParser_begin(&stream, source, error)) {
+    return -1;
+  }
+  tjson_ParseContext ctx{&stream, error, nullptr};
+  return fn(ctx, obj);
+}
+
+template <typename T>
+static std::string emit(void (*fn)(tjson_WriteBuffer*, const T*),
+                        const T& obj) {
+  char storage[1024];
+  tjson_WriteBuffer buf;
+  tjson_WriteBuffer_init(&buf, storage, storage + sizeof(storage));
+  fn(&buf, &obj);
+  EXPECT_EQ(0u, buf.overflow);
+  return std::string(storage, buf.begin);
+}
+
+TEST(ProtostructTJSON, EmitMatchesExpectedFormat) {
+  MyMessageC msg{};
+  msg.fieldA[0].fieldA = 1;
+  msg.fieldA[0].fieldB = 2.0;
+  msg.fieldA[0].fieldC = 3;
+  msg.fieldA[0].fieldD = MyEnumA_VALUE3;
+  msg.fieldACount = 1;
+  msg.fieldB[0] = 4;
+  msg.fieldBCount = 1;
+  EXPECT_EQ(
+      "{\"fieldA\":[{\"fieldA\":1,\"fieldB\":2.0,\"fieldC\":3,"
+      "\"fieldD\":\"MyEnumA_VALUE3\"}],\"fieldB\":[4],\"fieldC\":[]}",
+      emit(tjson_emit_MyMessageC, msg));
+}
+
+TEST(ProtostructTJSON, RoundTrip) {
+  MyMessageC msg{};
+  for (uint32_t idx = 0; idx < 3; idx++) {
+    msg.fieldA[idx].fieldA = -static_cast<int32_t>(idx);
+    msg.fieldA[idx].fieldB = 0.5 * idx;
+    msg.fieldA[idx].fieldC = 1000000000000ull * idx;
+    msg.fieldA[idx].fieldD = MyEnumA_VALUE2;
+  }
+  msg.fieldACount = 3;
+  for (uint32_t idx = 0; idx < FIELD_C_CAPACITY; idx++) {
+    msg.fieldC[idx] = idx * idx;
+  }
+  msg.fieldCCount = FIELD_C_CAPACITY;
+
+  tjson_Error error{};
+  MyMessageC parsed{};
+  std::string serial = emit(tjson_emit_MyMessageC, msg);
+  ASSERT_EQ(0, parse(serial, tjson_parse_MyMessageC, &parsed, &error))
+      << error.msg;
+  EXPECT_EQ(serial, emit(tjson_emit_MyMessageC, parsed));
+  EXPECT_EQ(3u, parsed.fieldACount);
+  EXPECT_EQ(0u, parsed.fieldBCount);
+  EXPECT_EQ(static_cast<uint32_t>(FIELD_C_CAPACITY), parsed.fieldCCount);
+  EXPECT_EQ(1000000000000ull * 2, parsed.fieldA[2].fieldC);
+
+  TestPrimitives prim{};
+  prim.fieldA = -8;
+  prim.fieldB = -1600;
+  prim.fieldC = -320000;
+  prim.fieldD = -6400000000ll;
+  prim.fieldE = 8;
+  prim.fieldF = 1600;
+  prim.fieldG = 320000;
+  prim.fieldH = 6400000000ull;
+  prim.fieldI = 0.25f;
+  prim.fieldJ = 1e-3;
+  prim.fieldK = true;
+  TestPrimitives prim_parsed{};
+  serial = emit(tjson_emit_TestPrimitives, prim);
+  ASSERT_EQ(0, parse(serial, tjson_parse_TestPrimitives, &prim_parsed, &error))
+      << error.msg;
+  EXPECT_EQ(serial, emit(tjson_emit_TestPrimitives, prim_parsed));
+}
+
+TEST(ProtostructTJSON, ParseReportsOverflow) {
+  std::string content = "{\"fieldB\": [";
+  for (int idx = 0; idx <= FIELD_B_CAPACITY; idx++) {
+    content += (idx ? ", " : "") + std::to_string(idx);
+  }
+  content += "]}";
+
+  tjson_Error error{};
+  MyMessageC msg{};
+  EXPECT_EQ(-1, parse(content, tjson_parse_MyMessageC, &msg, &error));
+  EXPECT_EQ(TJSON_PARSE_OVERFLOW, error.code);
+  EXPECT_EQ(static_cast<uint32_t>(FIELD_B_CAPACITY), msg.fieldBCount);
+  EXPECT_EQ(content.rfind(std::to_string(FIELD_B_CAPACITY)), error.loc.offset);
+}
+
+TEST(ProtostructTJSON, ParseMatchesNormalizedKeysAndSkipsUnknown) {
+  tjson_Error error{};
+  MyMessageA msg{};
+  ASSERT_EQ(0, parse("{\"field_a\": 7, \"unknown\": {\"x\": [1, 2]},"
+                     " \"FIELDD\": \"MyEnumA_VALUE2\"}",
+                     tjson_parse_MyMessageA, &msg, &error))
+      << error.msg;
+  EXPECT_EQ(7, msg.fieldA);
+  EXPECT_EQ(MyEnumA_VALUE2, msg.fieldD);
+
+  ASSERT_EQ(0, parse("{\"fieldD\": 2}", tjson_parse_MyMessageA, &msg, &error))
+      << error.msg;
+  EXPECT_EQ(MyEnumA_VALUE3, msg.fieldD);
+
+  EXPECT_EQ(-1, parse("{\"fieldD\": 7}", tjson_parse_MyMessageA, &msg, &error));
+  EXPECT_EQ(TJSON_PARSE_SEMANTIC, error.code);
+  EXPECT_EQ(-1, parse("{\"fieldD\": \"VALUE4\"}", tjson_parse_MyMessageA, &msg,
+                      &error));
+  EXPECT_EQ(TJSON_PARSE_SEMANTIC, error.code);
+}
+
+TEST(ProtostructTJSON, ParseWithKeyTable) {
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+  tjson_Error error{};
+  tjson_LexerParser stream;
+  ASSERT_EQ(0, tjson_LexerParser_init(&stream, &error)) << error.msg;
+  tjson_LexerParser_set_keytable(&stream, table.get());
+
+  // The same keys in every document and every object of the list are
+  // interned once, and the unknown key is skipped each time.
+  std::string content =
+      "{\"fieldA\": [{\"fieldA\": 1, \"field_c\": 2, \"extra\": [3]},"
+      " {\"fieldA\": 4, \"field_c\": 5, \"extra\": [6]}]}";
+  for (int pass = 0; pass < 2; pass++) {
+    MyMessageC msg{};
+    ASSERT_EQ(0, tjson_LexerParser_begin(
+                     &stream, tjson_StringPiece_fromstr(content.c_str()),
+                     &error));
+    tjson_ParseContext ctx{&stream, &error, nullptr};
+    ASSERT_EQ(0, tjson_parse_MyMessageC(ctx, &msg)) << error.msg;
+    ASSERT_EQ(2u, msg.fieldACount);
+    EXPECT_EQ(1, msg.fieldA[0].fieldA);
+    EXPECT_EQ(2u, msg.fieldA[0].fieldC);
+    EXPECT_EQ(4, msg.fieldA[1].fieldA);
+    EXPECT_EQ(5u, msg.fieldA[1].fieldC);
+    EXPECT_EQ(3u, table->nkeys);
+  }
+}
@@ -121,10 +121,16 @@ def protostruct_gen(
       if groupname == "pbwire":
         outs.append(basename + ".pbwire.h")
         outs.append(basename + ".pbwire.c")
+      if groupname == "pbrpc":
+        outs.append(basename + ".pbrpc.h")
+        outs.append(basename + ".pbrpc.c")
       if groupname == "proto":
         outs.append(basename + ".proto")
       if groupname == "cereal":
         outs.append(basename + ".cereal.h")
+      if groupname == "tjson":
+        outs.append(basename + ".tjson.h")
+        outs.append(basename + ".tjson.c")
 
   native.genrule(
     name = name,
@@ -0,0 +1,47 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Helpers shared by the *-bench programs. Not installed.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+inline uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Append records, one per line and each followed by a comma, until `out`
+// holds at least `target_size` bytes. `indent` prefixes each line and `extra`
+// is inserted among the members of each record.
+inline void append_records(std::string* out, size_t target_size,
+                           const char* indent = "  ",
+                           const char* extra = "") {
+  char buf[512];
+  for (uint32_t idx = 0; out->size() < target_size; idx++) {
+    snprintf(buf, sizeof(buf),
+             "%s{\"id\": %u, \"name\": \"record %u\", \"value\": %u.%03u,"
+             " \"tags\": [\"alpha\", \"beta\"]%s, \"enabled\": %s},\n",
+             indent, idx, idx, idx * 7, idx % 1000, extra,
+             (idx % 2) ? "true" : "false");
+    *out += buf;
+  }
+}
+
+// Return a list of records of roughly `target_size` bytes
+inline std::string make_record_list(size_t target_size,
+                                    const char* extra = "") {
+  std::string out;
+  out.reserve(target_size + 1024);
+  out += "[\n";
+  append_records(&out, target_size, "  ", extra);
+  out += "  {}\n]\n";
+  return out;
+}
+
+inline void report_throughput(const char* name, size_t nbytes,
+                              uint64_t elapsed_ns) {
+  printf("%-20s %8.1f MB/s\n", name, nbytes / (elapsed_ns * 1e-9) / 1e6);
+}
@@ -0,0 +1,115 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure repeatedly parsing documents of the same shape, as a polling loop
+// would, into a fresh object each time with tjson::parse_json() and into the
+// same object with tjson::Parser::parse_into().
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/cpputil.h"
+
+struct Sample {
+  std::unordered_map<std::string, std::vector<double>> channels;
+  std::vector<std::string> labels;
+};
+
+static int sample_fielditem(void* pobj, tjson_ParseContext ctx,
+                            tjson_StringPiece fieldname) {
+  Sample* sample = static_cast<Sample*>(pobj);
+  std::string_view name{fieldname.begin,
+                        static_cast<size_t>(fieldname.end - fieldname.begin)};
+  if (name == "channels") {
+    return tjson::parse(ctx, &sample->channels);
+  }
+  if (name == "labels") {
+    return tjson::parse(ctx, &sample->labels);
+  }
+  return tjson_sink_value(ctx);
+}
+
+// Found by argument dependent lookup from the templates of cpputil.h
+int parse(tjson_ParseContext ctx, Sample* value) {
+  return tjson_parse_object(ctx, sample_fielditem, value);
+}
+
+static std::string make_document(uint32_t seed) {
+  std::string out = "{\"channels\": {";
+  char buf[64];
+  for (uint32_t channel = 0; channel < 16; channel++) {
+    snprintf(buf, sizeof(buf), "%s\"channel_%02u\": [", channel ? ", " : "",
+             channel);
+    out += buf;
+    for (uint32_t idx = 0; idx < 32; idx++) {
+      snprintf(buf, sizeof(buf), "%s%u.%02u", idx ? ", " : "",
+               seed + channel * idx, (seed + idx) % 100);
+      out += buf;
+    }
+    out += "]";
+  }
+  out += "}, \"labels\": [";
+  for (uint32_t idx = 0; idx < 16; idx++) {
+    snprintf(buf, sizeof(buf), "%s\"a label long enough to allocate %05u\"",
+             idx ? ", " : "", seed + idx);
+    out += buf;
+  }
+  out += "]}";
+  return out;
+}
+
+template <class Fn>
+static void run(const char* name, const std::vector<std::string>& documents,
+                size_t niter, Fn fn) {
+  size_t nbytes = 0;
+  double checksum = 0;
+  uint64_t begin = now_ns();
+  for (size_t iter = 0; iter < niter; iter++) {
+    const std::string& document = documents[iter % documents.size()];
+    const Sample& sample = fn(document);
+    checksum += sample.channels.at("channel_03")[7] + sample.labels.size();
+    nbytes += document.size();
+  }
+  uint64_t elapsed_ns = now_ns() - begin;
+  printf("%-28s %8.1f MB/s %8.2f us/document (%.0f)\n", name,
+         nbytes / (elapsed_ns * 1e-9) / 1e6, elapsed_ns * 1e-3 / niter,
+         checksum);
+}
+
+int main(int argc, char** argv) {
+  size_t niter = 20000;
+  if (argc > 1) {
+    niter = strtoul(argv[1], nullptr, 10);
+  }
+  std::vector<std::string> documents;
+  for (uint32_t seed = 0; seed < 8; seed++) {
+    documents.push_back(make_document(seed));
+  }
+  printf("%zu documents of %zu bytes\n", niter, documents[0].size());
+
+  Sample fresh;
+  run("parse_json, fresh object", documents, niter,
+      [&fresh](const std::string& document) -> const Sample& {
+        fresh = Sample{};
+        tjson::parse_json(document, &fresh);
+        return fresh;
+      });
+
+  Sample reused;
+  tjson::Parser parser;
+  run("parse_into", documents, niter,
+      [&](const std::string& document) -> const Sample& {
+        parser.parse_into(document, &reused);
+        return reused;
+      });
+
+  Sample indexed;
+  tjson::Parser indexed_parser{tjson::Parser::Options{true, true}};
+  run("parse_into, bracket index", documents, niter,
+      [&](const std::string& document) -> const Sample& {
+        indexed_parser.parse_into(document, &indexed);
+        return indexed;
+      });
+  return 0;
+}
@@ -1,5 +1,11 @@
 // Copyright (C) 2021 Josh Bialkowski (josh.bialkowski@gmail.com)
 #include "tangent/tjson/cpputil.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
 #include "tangent/util/exception.h"
 
 std::ostream& operator<<(std::ostream& out,
@@ -69,7 +75,8 @@ int parse(tjson_ParseContext ctx, bool* value) {
   return err;
 }
 
-int parse(tjson_ParseContext ctx, std::string* str) {
+template <class StringT>
+static int parse_string(tjson_ParseContext ctx, StringT* str) {
   struct tjson_Event event {};
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
@@ -79,10 +86,212 @@ int parse(tjson_ParseContext ctx, std::string* str) {
   tjson_StringPiece value =
       tjson_StringPiece_substr(event.token.spelling, 1, -1);
 
-  // TODO(josh): need to decode
-  str->clear();
-  str->insert(0, value.begin, (value.end - value.begin));
+  size_t size = tjson_StringPiece_size(value);
+  if (!memchr(value.begin, '\\', size)) {
+    str->assign(value.begin, value.end);
+    return 0;
+  }
+
+  // Unescaping never grows the string, so decode directly into its storage
+  // (reusing the capacity) with room for the null terminator, then trim.
+  str->resize(size + 1);
+  ssize_t decoded = tjson_unescape(value, &(*str)[0], &(*str)[0] + size + 1);
+  if (decoded < 0) {
+    ctx.error->code = TJSON_PARSE_SEMANTIC;
+    ctx.error->loc = event.token.location;
+    tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
+    snprintf(ctx.error->msg, sizeof(ctx.error->msg),
+             "Failed to unescape string at %d:%d",
+             static_cast<int>(ctx.error->loc.lineno),
+             static_cast<int>(ctx.error->loc.colno));
+    return -1;
+  }
+  str->resize(decoded);
+  return 0;
+}
+
+int parse(tjson_ParseContext ctx, std::string* str) {
+  return parse_string(ctx, str);
+}
+
+int parse(tjson_ParseContext ctx, std::pmr::string* str) {
+  return parse_string(ctx, str);
+}
+
+int parse(tjson_ParseContext ctx, std::string_view* str) {
+  struct tjson_Event event {};
+  if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
+    return -1;
+  }
+
+  tjson_StringPiece value =
+      tjson_StringPiece_substr(event.token.spelling, 1, -1);
+  if (event.token.typeno != TJSON_STRING_LITERAL ||
+      memchr(value.begin, '\\', value.end - value.begin)) {
+    ctx.error->code = TJSON_PARSE_SEMANTIC;
+    ctx.error->loc = event.token.location;
+    tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
+    snprintf(ctx.error->msg, sizeof(ctx.error->msg),
+             "Can't view %.*s as a string at %d:%d",
+             static_cast<int>(tjson_StringPiece_size(event.token.spelling)),
+             event.token.spelling.begin,
+             static_cast<int>(ctx.error->loc.lineno),
+             static_cast<int>(ctx.error->loc.colno));
+    return -1;
+  }
+  *str = std::string_view{value.begin,
+                          static_cast<size_t>(value.end - value.begin)};
   return 0;
 }
 
+// -----------------------------------------------------------------------------
+//    Parser
+// -----------------------------------------------------------------------------
+
+Parser::Parser() : Parser{Options{true, false}} {}
+
+Parser::Parser(const Options& options)
+    : error_{}, stream_{}, index_brackets_{options.index_brackets} {
+  TANGENT_ASSERT(!tjson_LexerParser_init(&stream_, &error_))
+      << "Failed to initialized tjson stream: " << error_.msg;
+  if (options.intern_keys) {
+    keys_.reset(new tjson_KeyTable);
+    tjson_KeyTable_init(keys_.get());
+    tjson_LexerParser_set_keytable(&stream_, keys_.get());
+  }
+}
+
+Parser::~Parser() {}
+
+void Parser::begin(tjson_StringPiece source) {
+  if (tjson_LexerParser_begin(&stream_, source, &error_)) {
+    std::stringstream message;
+    message << "Failed to start tjson parser: " << error_.msg;
+    throw std::runtime_error(message.str());
+  }
+  if (!index_brackets_) {
+    return;
+  }
+
+  // Index into the storage of the previous document, and grow it only if
+  // this document needs more.
+  structurals_.resize(structurals_.capacity());
+  int64_t nstructurals = tjson_index_structurals(
+      source, structurals_.data(), structurals_.size(), &error_);
+  if (nstructurals > static_cast<int64_t>(structurals_.size())) {
+    structurals_.resize(nstructurals);
+    nstructurals = tjson_index_structurals(source, structurals_.data(),
+                                           structurals_.size(), &error_);
+  }
+  TANGENT_ASSERT(nstructurals >= 0)
+      << "Failed to index tjson source: " << error_.msg;
+
+  brackets_.resize(brackets_.capacity());
+  int64_t nbrackets =
+      tjson_index_brackets(source, structurals_.data(), nstructurals,
+                           brackets_.data(), brackets_.size(), &error_);
+  if (nbrackets > static_cast<int64_t>(brackets_.size())) {
+    brackets_.resize(nbrackets);
+    nbrackets =
+        tjson_index_brackets(source, structurals_.data(), nstructurals,
+                             brackets_.data(), brackets_.size(), &error_);
+  }
+  TANGENT_ASSERT(nbrackets >= 0)
+      << "Failed to index tjson source: " << error_.msg;
+
+  TANGENT_ASSERT(!tjson_LexerParser_set_structurals(
+      &stream_, structurals_.data(), static_cast<uint32_t>(nstructurals),
+      &error_))
+      << error_.msg;
+  TANGENT_ASSERT(!tjson_LexerParser_set_brackets(
+      &stream_, brackets_.data(), static_cast<uint32_t>(nbrackets), &error_))
+      << error_.msg;
+}
+
+// -----------------------------------------------------------------------------
+//    Arena
+// -----------------------------------------------------------------------------
+
+Arena::Arena(size_t capacity, std::pmr::memory_resource* upstream)
+    : upstream_{upstream},
+      blocks_{nullptr},
+      cursor_{nullptr},
+      end_{nullptr},
+      capacity_{capacity},
+      first_used_{0},
+      overflow_{0} {
+  if (capacity > 0) {
+    blocks_ = static_cast<Block*>(upstream_->allocate(
+        sizeof(Block) + capacity, alignof(std::max_align_t)));
+    blocks_->next = nullptr;
+    blocks_->size = capacity;
+    cursor_ = reinterpret_cast<char*>(blocks_ + 1);
+    end_ = cursor_ + capacity;
+  }
+}
+
+static size_t measure_arena(tjson_StringPiece source) {
+  tjson_Error error{};
+  tjson_Measure measure{};
+  if (tjson_measure(source, &measure, &error)) {
+    std::stringstream message;
+    message << "Failed to measure tjson source: " << error.msg;
+    throw std::runtime_error(message.str());
+  }
+  uint64_t nvalues = measure.ngroups + measure.nstrings - measure.nkeys +
+                     measure.nnumbers + measure.nliterals;
+  return measure.string_bytes + nvalues * Arena::kValueBytes;
+}
+
+Arena::Arena(tjson_StringPiece source, std::pmr::memory_resource* upstream)
+    : Arena{measure_arena(source), upstream} {}
+
+Arena::~Arena() {
+  while (blocks_) {
+    Block* next = blocks_->next;
+    upstream_->deallocate(blocks_, sizeof(Block) + blocks_->size,
+                          alignof(std::max_align_t));
+    blocks_ = next;
+  }
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+  uintptr_t begin = reinterpret_cast<uintptr_t>(cursor_);
+  begin = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  if (cursor_ && begin + bytes <= reinterpret_cast<uintptr_t>(end_)) {
+    char* ptr = reinterpret_cast<char*>(begin);
+    if (blocks_->next == nullptr) {
+      first_used_ = ptr + bytes - reinterpret_cast<char*>(blocks_ + 1);
+    }
+    cursor_ = ptr + bytes;
+    return ptr;
+  }
+
+  // Start a new block, at least as large as the first one
+  size_t size = bytes + alignment;
+  if (size < capacity_) {
+    size = capacity_;
+  }
+  Block* block = static_cast<Block*>(
+      upstream_->allocate(sizeof(Block) + size, alignof(std::max_align_t)));
+  block->next = blocks_;
+  block->size = size;
+  blocks_ = block;
+  overflow_ += size;
+
+  begin = reinterpret_cast<uintptr_t>(block + 1);
+  begin = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  cursor_ = reinterpret_cast<char*>(begin) + bytes;
+  end_ = reinterpret_cast<char*>(block + 1) + size;
+  return reinterpret_cast<char*>(begin);
+}
+
+void Arena::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+  (void)alignment;
+  // Only the most recent allocation can be given back
+  if (static_cast<char*>(ptr) + bytes == cursor_) {
+    cursor_ = static_cast<char*>(ptr);
+  }
+}
+
 }  // namespace tjson
@@ -1,15 +1,98 @@
 #pragma once
 // Copyright (C) 2021 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/tjson/file.h"
+#include "tangent/tjson/keytable.h"
 #include "tangent/tjson/parse.h"
+#include "tangent/tjson/structural.h"
 #include "tangent/tjson/tjson.h"
 #include "tangent/util/exception.h"
 #include "tangent/util/type_string.h"
 
+#include <array>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace tjson {
 
+// Memory for everything parsed from one document, usually sized by measuring
+// the document first (see tjson_measure()). Allocations are carved off of a
+// single block in order and are only released along with the arena, so
+// objects made in the arena (see make()) need not be destroyed. If the block
+// runs out, further blocks are taken from `upstream` and counted in
+// overflow().
+class Arena : public std::pmr::memory_resource {
+ public:
+  // Bytes reserved per value of the document by the measuring constructor.
+  // Growing a list of n items one at a time allocates fewer than 4n slots in
+  // total, and the largest slot is a std::pmr::string (objects are counted by
+  // their fields).
+  static constexpr size_t kValueBytes = 4 * sizeof(std::pmr::string);
+
+  explicit Arena(size_t capacity, std::pmr::memory_resource* upstream =
+                                      std::pmr::new_delete_resource());
+
+  // Measure `source` and reserve the string bytes plus kValueBytes for each
+  // value. Throws if the source fails to lex.
+  explicit Arena(tjson_StringPiece source,
+                 std::pmr::memory_resource* upstream =
+                     std::pmr::new_delete_resource());
+  ~Arena() override;
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Construct a T in the arena. If T is allocator aware (as are the
+  // protostruct generated types) then so are its members.
+  template <class T>
+  T* make() {
+    std::pmr::polymorphic_allocator<T> alloc{this};
+    T* value = alloc.allocate(1);
+    alloc.construct(value);
+    return value;
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  // High water mark of the first block
+  size_t used() const {
+    return first_used_;
+  }
+
+  // Size of the blocks taken from `upstream` after the first one was full
+  size_t overflow() const {
+    return overflow_;
+  }
+
+ private:
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  Block* blocks_;  //< most recent block first
+  char* cursor_;
+  char* end_;
+  size_t capacity_;
+  size_t first_used_;
+  size_t overflow_;
+};
+
 int parse(tjson_ParseContext ctx, uint64_t* value);
 int parse(tjson_ParseContext ctx, uint32_t* value);
 int parse(tjson_ParseContext ctx, uint16_t* value);
@@ -22,44 +105,262 @@ int parse(tjson_ParseContext ctx, double* value);
 int parse(tjson_ParseContext ctx, float* value);
 
 int parse(tjson_ParseContext ctx, bool* value);
+
+// Strings are unescaped and assigned, reusing the capacity of `value`
 int parse(tjson_ParseContext ctx, std::string* value);
+int parse(tjson_ParseContext ctx, std::pmr::string* value);
+
+// The view refers to the source, which must outlive it. A string with escape
+// sequences can not be viewed and is an error.
+int parse(tjson_ParseContext ctx, std::string_view* value);
 
+// The overloads for containers are all declared before any of them are
+// defined, so that containers of containers resolve.
+
+// A list replaces the contents of the vector. Items are parsed in place into
+// the elements already in the vector (so that their own storage is reused)
+// and the vector is reserved to the size of the list if that is known without
+// parsing it (see tjson_find_list_count()).
+template <class T, class Allocator>
+int parse(tjson_ParseContext ctx, std::vector<T, Allocator>* value);
+
+// A list fills the array. Items which are missing from the list are reset to
+// T{} and more items than the array holds is a TJSON_PARSE_OVERFLOW error.
+template <class T, size_t N>
+int parse(tjson_ParseContext ctx, std::array<T, N>* value);
+
+// An object replaces the contents of the map. The entries of keys which were
+// already in the map are reused, along with their storage. Keys are not
+// unescaped.
+template <class Key, class T, class Compare, class Allocator>
+int parse(tjson_ParseContext ctx, std::map<Key, T, Compare, Allocator>* value);
+template <class Key, class T, class Hash, class KeyEqual, class Allocator>
+int parse(tjson_ParseContext ctx,
+          std::unordered_map<Key, T, Hash, KeyEqual, Allocator>* value);
+
+// null resets the optional, any other value is parsed into it
 template <class T>
-void parse_json(const std::string& json_str, T* value) {
-  tjson_Error error{};
-  tjson_LexerParser stream{};
-  TANGENT_ASSERT(!tjson_LexerParser_init(&stream, &error))
-      << "Failed to initialized tjson stream: " << error.msg;
+int parse(tjson_ParseContext ctx, std::optional<T>* value);
 
-  if (tjson_LexerParser_begin(
-          &stream, tjson_StringPiece_fromstr(json_str.c_str()), &error)) {
-    std::stringstream message;
-    message << "Failed to start tjson parser: " << error.msg;
-    throw std::runtime_error(message.str());
+template <class T, class Allocator>
+struct VectorCursor {
+  std::vector<T, Allocator>* value;
+  size_t idx;
+};
+
+template <class T, class Allocator>
+int vector_listitem_callback(void* pcursor, tjson_ParseContext ctx) {
+  auto* cursor = static_cast<VectorCursor<T, Allocator>*>(pcursor);
+  if (cursor->idx == cursor->value->size()) {
+    cursor->value->emplace_back();
   }
+  return parse(ctx, &(*cursor->value)[cursor->idx++]);
+}
 
-  tjson_ParseContext ctx{};
-  ctx.stream = &stream;
-  ctx.error = &error;
+template <class T, class Allocator>
+inline int parse(tjson_ParseContext ctx, std::vector<T, Allocator>* value) {
+  size_t count = 0;
+  int found = tjson_find_list_count(ctx, &count);
+  if (found < 0) {
+    return -1;
+  }
+  if (found && value->capacity() < count) {
+    value->reserve(count);
+  }
 
-  TANGENT_ASSERT(!parse(ctx, value))
-      << "Failed to parse " << type_string<T>() << error << "\n"
-      << json_str;
+  VectorCursor<T, Allocator> cursor{value, 0};
+  if (tjson_parse_list(ctx, &vector_listitem_callback<T, Allocator>,
+                       &cursor)) {
+    return -1;
+  }
+  value->erase(value->begin() + cursor.idx, value->end());
+  return 0;
 }
 
-template <class T, class Allocator>
-int vector_listitem_callback(std::vector<T, Allocator>* value,
-                             tjson_ParseContext ctx) {
-  value->emplace_back();
-  return parse(ctx, &value->back());
+template <class T, size_t N>
+struct ArrayCursor {
+  std::array<T, N>* value;
+  size_t idx;
+};
+
+template <class T, size_t N>
+int array_listitem_callback(void* pcursor, tjson_ParseContext ctx) {
+  auto* cursor = static_cast<ArrayCursor<T, N>*>(pcursor);
+  if (cursor->idx >= N) {
+    return tjson_list_overflow(ctx, "std::array", N);
+  }
+  return parse(ctx, &(*cursor->value)[cursor->idx++]);
 }
 
-template <class T, class Allocator>
-int parse(tjson_ParseContext ctx, std::vector<T, Allocator>* value) {
-  return tjson_parse_list(ctx,
-                          reinterpret_cast<tjson_listitem_callback>(
-                              &vector_listitem_callback<T, Allocator>),
-                          value);
+template <class T, size_t N>
+inline int parse(tjson_ParseContext ctx, std::array<T, N>* value) {
+  ArrayCursor<T, N> cursor{value, 0};
+  if (tjson_parse_list(ctx, &array_listitem_callback<T, N>, &cursor)) {
+    return -1;
+  }
+  for (size_t idx = cursor.idx; idx < N; idx++) {
+    (*value)[idx] = T{};
+  }
+  return 0;
+}
+
+template <class Map>
+struct MapCursor {
+  Map* value;
+  Map* previous;  //< entries of the map before it was parsed
+};
+
+template <class Map>
+int map_fielditem_callback(void* pcursor, tjson_ParseContext ctx,
+                           tjson_StringPiece key) {
+  auto* cursor = static_cast<MapCursor<Map>*>(pcursor);
+  typename Map::key_type mapkey(key.begin, key.end);
+  auto node = cursor->previous->extract(mapkey);
+  auto iter = node ? cursor->value->insert(std::move(node)).position
+                   : cursor->value->try_emplace(std::move(mapkey)).first;
+  return parse(ctx, &iter->second);
+}
+
+template <class Key, class T, class Compare, class Allocator>
+inline int parse(tjson_ParseContext ctx,
+                 std::map<Key, T, Compare, Allocator>* value) {
+  using Map = std::map<Key, T, Compare, Allocator>;
+  Map previous{value->get_allocator()};
+  previous.swap(*value);
+  MapCursor<Map> cursor{value, &previous};
+  return tjson_parse_object(ctx, &map_fielditem_callback<Map>, &cursor);
+}
+
+template <class Key, class T, class Hash, class KeyEqual, class Allocator>
+inline int parse(tjson_ParseContext ctx,
+                 std::unordered_map<Key, T, Hash, KeyEqual, Allocator>* value) {
+  using Map = std::unordered_map<Key, T, Hash, KeyEqual, Allocator>;
+  Map previous{value->get_allocator()};
+  previous.swap(*value);
+  value->reserve(previous.size());
+  MapCursor<Map> cursor{value, &previous};
+  return tjson_parse_object(ctx, &map_fielditem_callback<Map>, &cursor);
+}
+
+template <class T>
+inline int parse(tjson_ParseContext ctx, std::optional<T>* value) {
+  struct tjson_Event event {};
+  if (tjson_LexerParser_peek_next_event(ctx.stream, &event, ctx.error)) {
+    return -1;
+  }
+  if (event.typeno == TJSON_VALUE_LITERAL &&
+      event.token.typeno == TJSON_NULL_LITERAL) {
+    value->reset();
+    return tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error);
+  }
+  if (!value->has_value()) {
+    value->emplace();
+  }
+  return parse(ctx, &value->value());
+}
+
+// Parses documents into C++ objects. A parser may be used for any number of
+// documents. For documents of the same shape, as in a polling loop, keep the
+// parser and the object and use parse_into(). The stream, the key table and
+// the bracket index storage are kept from one document to the next, and the
+// strings and lists of the object keep their storage (see the parse()
+// overloads above), so once capacity is established nothing is allocated.
+class Parser {
+ public:
+  struct Options {
+    // Intern object keys in a key table (see keytable.h) which is kept for
+    // the life of the parser.
+    bool intern_keys;
+
+    // Build the bracket index (see structural.h) of each document, so that
+    // lists are reserved to their size and unknown fields are skipped without
+    // being lexed.
+    bool index_brackets;
+  };
+
+  Parser();
+  explicit Parser(const Options& options);
+  ~Parser();
+
+  Parser(const Parser&) = delete;
+  Parser& operator=(const Parser&) = delete;
+
+  // Parse the JSON in `source` into `value`, overwriting the fields which are
+  // present in the document. Fields of objects which are absent from the
+  // document keep their previous value. `description` of the source is
+  // included in the exception message on failure.
+  template <class T>
+  void parse_into(tjson_StringPiece source, T* value,
+                  const std::string& description) {
+    begin(source);
+    tjson_ParseContext ctx{};
+    ctx.stream = &stream_;
+    ctx.error = &error_;
+    TANGENT_ASSERT(!parse(ctx, value))
+        << "Failed to parse " << type_string<T>() << error_ << "\n"
+        << description;
+  }
+
+  template <class T>
+  void parse_into(const std::string& json_str, T* value) {
+    parse_into(
+        tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+        value, json_str);
+  }
+
+ private:
+  // Begin parsing `source`, building its bracket index if enabled. Throws on
+  // failure.
+  void begin(tjson_StringPiece source);
+
+  tjson_Error error_;
+  tjson_LexerParser stream_;
+  std::unique_ptr<tjson_KeyTable> keys_;
+  bool index_brackets_;
+  std::vector<uint32_t> structurals_;
+  std::vector<tjson_Bracket> brackets_;
+};
+
+// Parse the JSON in `source` into `value`. `description` of the source is
+// included in the exception message on failure.
+template <class T>
+void parse_json(tjson_StringPiece source, T* value,
+                const std::string& description) {
+  Parser parser{Parser::Options{false, false}};
+  parser.parse_into(source, value, description);
+}
+
+// Parse the JSON in `source` into a new T made in `arena` (see Arena::make()),
+// so that all of its lists and strings are allocated from the arena as well.
+template <class T>
+T* parse_json(tjson_StringPiece source, Arena* arena,
+              const std::string& description) {
+  T* value = arena->make<T>();
+  parse_json(source, value, description);
+  return value;
+}
+
+template <class T>
+void parse_json(const std::string& json_str, T* value) {
+  parse_json(
+      tjson_StringPiece{json_str.data(), json_str.data() + json_str.size()},
+      value, json_str);
+}
+
+// Parse the JSON file at `path` into `value`. The file is mapped rather than
+// copied into memory (see tjson_File).
+template <class T>
+void parse_json_file(const std::string& path, T* value) {
+  tjson_Error error{};
+  tjson_File file{};
+  TANGENT_ASSERT(!tjson_File_open(&file, path.c_str(), &error)) << error.msg;
+  try {
+    parse_json(file.content, value, path);
+  } catch (...) {
+    tjson_File_close(&file);
+    throw;
+  }
+  tjson_File_close(&file);
 }
 
 }  // namespace tjson
@@ -0,0 +1,67 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure building a tjson_Document from a synthetic multi-megabyte document
+// and compare a full traversal of the tape against streaming the events.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/document.h"
+#include "tangent/tjson/tjson.h"
+
+// Depth first traversal of the tape, summing all numbers
+static double sum_numbers(tjson_Node node) {
+  double value = 0;
+  switch (tjson_Node_type(node)) {
+    case TJSON_NODE_OBJECT:
+    case TJSON_NODE_LIST: {
+      double sum = 0;
+      tjson_Node end = tjson_Node_end(node);
+      for (tjson_Node child = tjson_Node_begin(node); child.idx != end.idx;
+           child = tjson_Node_next(child)) {
+        sum += sum_numbers(child);
+      }
+      return sum;
+    }
+    default:
+      tjson_Node_get_double(node, &value);
+      return value;
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t size_mb = 16;
+  if (argc > 1) {
+    size_mb = strtoul(argv[1], nullptr, 10);
+  }
+  std::string document = make_record_list(size_mb * 1024 * 1024);
+  tjson_StringPiece source{document.data(), document.data() + document.size()};
+
+  tjson_Error error{};
+  uint64_t begin = now_ns();
+  int nevents = tjson_parse(source, nullptr, 0, &error);
+  report_throughput("stream events", document.size(), now_ns() - begin);
+  if (nevents < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+
+  tjson_Document doc;
+  begin = now_ns();
+  if (tjson_Document_parse(&doc, source, &error)) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+  report_throughput("build document", document.size(), now_ns() - begin);
+
+  begin = now_ns();
+  double sum = sum_numbers(tjson_Document_root(&doc));
+  uint64_t elapsed_ns = now_ns() - begin;
+  report_throughput("traverse tape", document.size(), elapsed_ns);
+
+  printf("%zu bytes, %d events, %u tape entries, %llu string bytes (%g)\n",
+         document.size(), nevents, doc.ntape,
+         static_cast<unsigned long long>(doc.nstrings), sum);
+  tjson_Document_free(&doc);
+  return 0;
+}
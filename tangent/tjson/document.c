@@ -0,0 +1,524 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/document.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tangent/tjson/number.h"
+#include "tangent/tjson/parse.h"
+
+#define TAPE_PAYLOAD_MASK 0x00ffffffffffffffull
+#define TAPE_MAX_COUNT 0xffffffu
+
+static inline uint64_t tape_entry(enum tjson_NodeTypeNo typeno,
+                                  uint64_t payload) {
+  return ((uint64_t)typeno << 56) | payload;
+}
+
+static inline enum tjson_NodeTypeNo tape_type(uint64_t entry) {
+  return (enum tjson_NodeTypeNo)(entry >> 56);
+}
+
+static inline uint64_t tape_payload(uint64_t entry) {
+  return entry & TAPE_PAYLOAD_MASK;
+}
+
+const char* tjson_NodeTypeNo_tostring(enum tjson_NodeTypeNo value) {
+  switch (value) {
+    case TJSON_NODE_OBJECT:
+      return "OBJECT";
+    case TJSON_NODE_OBJECT_END:
+      return "OBJECT_END";
+    case TJSON_NODE_LIST:
+      return "LIST";
+    case TJSON_NODE_LIST_END:
+      return "LIST_END";
+    case TJSON_NODE_STRING:
+      return "STRING";
+    case TJSON_NODE_INT64:
+      return "INT64";
+    case TJSON_NODE_UINT64:
+      return "UINT64";
+    case TJSON_NODE_DOUBLE:
+      return "DOUBLE";
+    case TJSON_NODE_TRUE:
+      return "TRUE";
+    case TJSON_NODE_FALSE:
+      return "FALSE";
+    case TJSON_NODE_NULL:
+      return "NULL";
+  }
+  return "<invalid>";
+}
+
+// -----------------------------------------------------------------------------
+//    Parse
+// -----------------------------------------------------------------------------
+
+// Lex the whole source to compute the size of the tape and string arena
+static int measure(struct tjson_StringPiece source, uint64_t* ntape,
+                   uint64_t* nstrings, struct tjson_Error* error) {
+  struct tjson_Measure measure;
+  if (tjson_measure(source, &measure, error)) {
+    return -1;
+  }
+
+  // Groups take an entry for the open and one for the close, numbers take
+  // two entries, and each string is preceded by its length in the arena.
+  *ntape = 2 * measure.ngroups + measure.nstrings + measure.nliterals +
+           2 * measure.nnumbers;
+  *nstrings = measure.string_bytes + measure.nstrings * sizeof(uint32_t);
+  return 0;
+}
+
+struct Builder {
+  struct tjson_Document* doc;
+  uint32_t ntape;
+  uint64_t nstrings;
+
+  // Tape index and item count of each open group
+  uint32_t open[TJSON_GROUP_STACK_CAPACITY];
+  uint32_t count[TJSON_GROUP_STACK_CAPACITY];
+  uint32_t depth;
+};
+
+// Count a new item of the innermost list
+static void count_item(struct Builder* builder) {
+  if (builder->depth > 0 &&
+      tape_type(builder->doc->tape[builder->open[builder->depth - 1]]) ==
+          TJSON_NODE_LIST) {
+    builder->count[builder->depth - 1]++;
+  }
+}
+
+static int push_string(struct Builder* builder,
+                       const struct tjson_Token* token,
+                       struct tjson_Error* error) {
+  struct tjson_Document* doc = builder->doc;
+  char* begin = doc->strings + builder->nstrings + sizeof(uint32_t);
+  ssize_t size = tjson_unescape(
+      tjson_StringPiece_substr(token->spelling, 1, -1), begin,
+      doc->strings + doc->nstrings);
+  if (size < 0) {
+    error->code = TJSON_INTERNAL_ERROR;
+    error->loc = token->location;
+    snprintf(error->msg, sizeof(error->msg),
+             "String arena of %llu bytes is too small",
+             (unsigned long long)doc->nstrings);
+    return -1;
+  }
+  uint32_t size32 = (uint32_t)size;
+  memcpy(begin - sizeof(uint32_t), &size32, sizeof(size32));
+  begin[size] = '\0';
+
+  doc->tape[builder->ntape++] =
+      tape_entry(TJSON_NODE_STRING, builder->nstrings);
+  builder->nstrings += sizeof(uint32_t) + size + 1;
+  return 0;
+}
+
+static int push_number(struct Builder* builder,
+                       const struct tjson_Token* token,
+                       struct tjson_Error* error) {
+  struct tjson_Number number;
+  if (tjson_Number_from_token(token, &number)) {
+    error->code = TJSON_PARSE_SEMANTIC;
+    error->loc = token->location;
+    snprintf(error->msg, sizeof(error->msg), "Invalid number: %.*s",
+             (int)tjson_StringPiece_size(token->spelling),
+             token->spelling.begin);
+    return -1;
+  }
+
+  uint64_t* tape = builder->doc->tape + builder->ntape;
+  builder->ntape += 2;
+  if (tjson_StringPiece_size(number.fraction) == 0 &&
+      tjson_StringPiece_size(number.exponent_digits) == 0) {
+    struct tjson_Error local_error;
+    int64_t ivalue;
+    if (tjson_Number_to_int64(&number, &ivalue, &local_error) == 0) {
+      tape[0] = tape_entry(TJSON_NODE_INT64, 0);
+      memcpy(&tape[1], &ivalue, sizeof(ivalue));
+      return 0;
+    }
+    uint64_t uvalue;
+    if (tjson_Number_to_uint64(&number, &uvalue, &local_error) == 0) {
+      tape[0] = tape_entry(TJSON_NODE_UINT64, 0);
+      tape[1] = uvalue;
+      return 0;
+    }
+  }
+
+  double value = tjson_Number_to_double(&number);
+  tape[0] = tape_entry(TJSON_NODE_DOUBLE, 0);
+  memcpy(&tape[1], &value, sizeof(value));
+  return 0;
+}
+
+static int push_event(struct Builder* builder, const struct tjson_Event* event,
+                      struct tjson_Error* error) {
+  uint64_t* tape = builder->doc->tape;
+  switch (event->typeno) {
+    case TJSON_OBJECT_BEGIN:
+    case TJSON_LIST_BEGIN:
+      count_item(builder);
+      builder->open[builder->depth] = builder->ntape;
+      builder->count[builder->depth] = 0;
+      builder->depth++;
+      tape[builder->ntape++] = tape_entry(event->typeno == TJSON_OBJECT_BEGIN
+                                              ? TJSON_NODE_OBJECT
+                                              : TJSON_NODE_LIST,
+                                          0);
+      return 0;
+
+    case TJSON_OBJECT_END:
+    case TJSON_LIST_END: {
+      builder->depth--;
+      uint32_t open = builder->open[builder->depth];
+      uint32_t count = builder->count[builder->depth];
+      if (count > TAPE_MAX_COUNT) {
+        count = TAPE_MAX_COUNT;
+      }
+      tape[open] |= ((uint64_t)count << 32) | builder->ntape;
+      tape[builder->ntape++] = tape_entry(event->typeno == TJSON_OBJECT_END
+                                              ? TJSON_NODE_OBJECT_END
+                                              : TJSON_NODE_LIST_END,
+                                          open);
+      return 0;
+    }
+
+    case TJSON_OBJECT_KEY:
+      builder->count[builder->depth - 1]++;
+      return push_string(builder, &event->token, error);
+
+    case TJSON_VALUE_LITERAL:
+      count_item(builder);
+      switch (event->token.typeno) {
+        case TJSON_STRING_LITERAL:
+          return push_string(builder, &event->token, error);
+        case TJSON_NUMERIC_LITERAL:
+          return push_number(builder, &event->token, error);
+        case TJSON_BOOLEAN_LITERAL:
+          tape[builder->ntape++] =
+              tape_entry(*event->token.spelling.begin == 't' ? TJSON_NODE_TRUE
+                                                             : TJSON_NODE_FALSE,
+                         0);
+          return 0;
+        case TJSON_NULL_LITERAL:
+          tape[builder->ntape++] = tape_entry(TJSON_NODE_NULL, 0);
+          return 0;
+        default:
+          break;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  error->code = TJSON_INTERNAL_ERROR;
+  error->loc = event->token.location;
+  snprintf(error->msg, sizeof(error->msg), "Unexpected %s event",
+           tjson_EventTypeNo_tostring(event->typeno));
+  return -1;
+}
+
+int tjson_Document_parse(struct tjson_Document* doc,
+                         struct tjson_StringPiece source,
+                         struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  memset(doc, 0, sizeof(*doc));
+
+  uint64_t ntape = 0;
+  uint64_t nstrings = 0;
+  if (measure(source, &ntape, &nstrings, error)) {
+    return -1;
+  }
+  if (ntape > UINT32_MAX) {
+    error->code = TJSON_PARSE_OVERFLOW;
+    error->loc.lineno = 0;
+    error->loc.colno = 0;
+    error->loc.offset = 0;
+    snprintf(error->msg, sizeof(error->msg),
+             "Document of %llu nodes is too large", (unsigned long long)ntape);
+    return -1;
+  }
+
+  doc->_block = malloc(ntape * sizeof(uint64_t) + nstrings);
+  if (!doc->_block) {
+    error->code = TJSON_PARSE_OOM;
+    error->loc.lineno = 0;
+    error->loc.colno = 0;
+    error->loc.offset = 0;
+    snprintf(error->msg, sizeof(error->msg),
+             "Failed to allocate %llu tape entries and %llu bytes of strings",
+             (unsigned long long)ntape, (unsigned long long)nstrings);
+    return -1;
+  }
+  doc->tape = (uint64_t*)doc->_block;
+  doc->strings = (char*)(doc->tape + ntape);
+  doc->nstrings = nstrings;
+
+  struct Builder builder;
+  builder.doc = doc;
+  builder.ntape = 0;
+  builder.nstrings = 0;
+  builder.depth = 0;
+
+  struct tjson_LexerParser stream;
+  if (tjson_LexerParser_init(&stream, error) < 0 ||
+      tjson_LexerParser_begin(&stream, source, error) < 0) {
+    tjson_Document_free(doc);
+    return -1;
+  }
+
+  struct tjson_Event event;
+  while (tjson_LexerParser_get_next_event(&stream, &event, error) == 0) {
+    if (push_event(&builder, &event, error)) {
+      tjson_LexerParser_locate(&stream, &error->loc);
+      tjson_Document_free(doc);
+      return -1;
+    }
+  }
+
+  if (error->code != TJSON_LEX_INPUT_FINISHED || builder.depth > 0 ||
+      builder.ntape == 0) {
+    if (error->code == TJSON_LEX_INPUT_FINISHED) {
+      error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+      tjson_LexerParser_locate(&stream, &error->loc);
+      snprintf(error->msg, sizeof(error->msg),
+               "The source ended before the document was complete");
+    }
+    tjson_Document_free(doc);
+    return -1;
+  }
+
+  doc->ntape = builder.ntape;
+  doc->nstrings = builder.nstrings;
+  error->code = TJSON_NOERROR;
+  return 0;
+}
+
+void tjson_Document_free(struct tjson_Document* doc) {
+  free(doc->_block);
+  memset(doc, 0, sizeof(*doc));
+}
+
+// -----------------------------------------------------------------------------
+//    Node
+// -----------------------------------------------------------------------------
+
+struct tjson_Node tjson_Document_root(const struct tjson_Document* doc) {
+  struct tjson_Node node = {doc, 0};
+  return node;
+}
+
+enum tjson_NodeTypeNo tjson_Node_type(struct tjson_Node node) {
+  return tape_type(node.doc->tape[node.idx]);
+}
+
+static inline int8_t is_group(uint64_t entry) {
+  enum tjson_NodeTypeNo typeno = tape_type(entry);
+  return typeno == TJSON_NODE_OBJECT || typeno == TJSON_NODE_LIST;
+}
+
+uint32_t tjson_Node_size(struct tjson_Node node) {
+  uint64_t entry = node.doc->tape[node.idx];
+  if (!is_group(entry)) {
+    return 0;
+  }
+  uint32_t count = (uint32_t)(tape_payload(entry) >> 32);
+  if (count < TAPE_MAX_COUNT) {
+    return count;
+  }
+
+  // The count saturated, so count the children
+  count = 0;
+  struct tjson_Node end = tjson_Node_end(node);
+  for (struct tjson_Node child = tjson_Node_begin(node); child.idx != end.idx;
+       child = tjson_Node_next(child)) {
+    count++;
+  }
+  return tape_type(entry) == TJSON_NODE_OBJECT ? count / 2 : count;
+}
+
+struct tjson_Node tjson_Node_begin(struct tjson_Node node) {
+  if (is_group(node.doc->tape[node.idx])) {
+    node.idx++;
+  }
+  return node;
+}
+
+struct tjson_Node tjson_Node_end(struct tjson_Node node) {
+  uint64_t entry = node.doc->tape[node.idx];
+  if (is_group(entry)) {
+    node.idx = (uint32_t)tape_payload(entry);
+  }
+  return node;
+}
+
+struct tjson_Node tjson_Node_next(struct tjson_Node node) {
+  uint64_t entry = node.doc->tape[node.idx];
+  switch (tape_type(entry)) {
+    case TJSON_NODE_OBJECT:
+    case TJSON_NODE_LIST:
+      node.idx = (uint32_t)tape_payload(entry) + 1;
+      break;
+    case TJSON_NODE_INT64:
+    case TJSON_NODE_UINT64:
+    case TJSON_NODE_DOUBLE:
+      node.idx += 2;
+      break;
+    default:
+      node.idx += 1;
+      break;
+  }
+  return node;
+}
+
+int tjson_Node_find_field(struct tjson_Node node, struct tjson_StringPiece key,
+                          struct tjson_Node* value) {
+  if (tjson_Node_type(node) != TJSON_NODE_OBJECT) {
+    return -1;
+  }
+  size_t keylen = tjson_StringPiece_size(key);
+  struct tjson_Node end = tjson_Node_end(node);
+  for (struct tjson_Node child = tjson_Node_begin(node); child.idx != end.idx;
+       child = tjson_Node_next(tjson_Node_next(child))) {
+    struct tjson_StringPiece name;
+    tjson_Node_get_string(child, &name);
+    if (tjson_StringPiece_size(name) == keylen &&
+        memcmp(name.begin, key.begin, keylen) == 0) {
+      *value = tjson_Node_next(child);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int tjson_Node_at(struct tjson_Node node, uint32_t index,
+                  struct tjson_Node* item) {
+  if (tjson_Node_type(node) != TJSON_NODE_LIST) {
+    return -1;
+  }
+  struct tjson_Node end = tjson_Node_end(node);
+  struct tjson_Node child = tjson_Node_begin(node);
+  for (uint32_t idx = 0; idx < index && child.idx != end.idx; idx++) {
+    child = tjson_Node_next(child);
+  }
+  if (child.idx == end.idx) {
+    return -1;
+  }
+  *item = child;
+  return 0;
+}
+
+int tjson_Node_get_string(struct tjson_Node node,
+                          struct tjson_StringPiece* value) {
+  uint64_t entry = node.doc->tape[node.idx];
+  if (tape_type(entry) != TJSON_NODE_STRING) {
+    return -1;
+  }
+  const char* begin = node.doc->strings + tape_payload(entry);
+  uint32_t size;
+  memcpy(&size, begin, sizeof(size));
+  value->begin = begin + sizeof(size);
+  value->end = value->begin + size;
+  return 0;
+}
+
+int tjson_Node_get_int64(struct tjson_Node node, int64_t* value) {
+  const uint64_t* tape = node.doc->tape + node.idx;
+  switch (tape_type(tape[0])) {
+    case TJSON_NODE_INT64:
+      memcpy(value, &tape[1], sizeof(*value));
+      return 0;
+    case TJSON_NODE_UINT64:
+      if (tape[1] > INT64_MAX) {
+        return -1;
+      }
+      *value = (int64_t)tape[1];
+      return 0;
+    case TJSON_NODE_DOUBLE: {
+      double dvalue;
+      memcpy(&dvalue, &tape[1], sizeof(dvalue));
+      // NOTE(josh): 2^63 is exactly representable, INT64_MAX is not
+      if (!(dvalue >= -9223372036854775808.0 &&
+            dvalue < 9223372036854775808.0) ||
+          (double)(int64_t)dvalue != dvalue) {
+        return -1;
+      }
+      *value = (int64_t)dvalue;
+      return 0;
+    }
+    default:
+      return -1;
+  }
+}
+
+int tjson_Node_get_uint64(struct tjson_Node node, uint64_t* value) {
+  const uint64_t* tape = node.doc->tape + node.idx;
+  switch (tape_type(tape[0])) {
+    case TJSON_NODE_INT64: {
+      int64_t ivalue;
+      memcpy(&ivalue, &tape[1], sizeof(ivalue));
+      if (ivalue < 0) {
+        return -1;
+      }
+      *value = (uint64_t)ivalue;
+      return 0;
+    }
+    case TJSON_NODE_UINT64:
+      *value = tape[1];
+      return 0;
+    case TJSON_NODE_DOUBLE: {
+      double dvalue;
+      memcpy(&dvalue, &tape[1], sizeof(dvalue));
+      if (!(dvalue >= 0 && dvalue < 18446744073709551616.0) ||
+          (double)(uint64_t)dvalue != dvalue) {
+        return -1;
+      }
+      *value = (uint64_t)dvalue;
+      return 0;
+    }
+    default:
+      return -1;
+  }
+}
+
+int tjson_Node_get_double(struct tjson_Node node, double* value) {
+  const uint64_t* tape = node.doc->tape + node.idx;
+  switch (tape_type(tape[0])) {
+    case TJSON_NODE_INT64: {
+      int64_t ivalue;
+      memcpy(&ivalue, &tape[1], sizeof(ivalue));
+      *value = (double)ivalue;
+      return 0;
+    }
+    case TJSON_NODE_UINT64:
+      *value = (double)tape[1];
+      return 0;
+    case TJSON_NODE_DOUBLE:
+      memcpy(value, &tape[1], sizeof(*value));
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+int tjson_Node_get_boolean(struct tjson_Node node, int8_t* value) {
+  switch (tjson_Node_type(node)) {
+    case TJSON_NODE_TRUE:
+      *value = 1;
+      return 0;
+    case TJSON_NODE_FALSE:
+      *value = 0;
+      return 0;
+    default:
+      return -1;
+  }
+}
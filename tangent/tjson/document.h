@@ -0,0 +1,132 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Document
+// -----------------------------------------------------------------------------
+// A parsed JSON document which supports random access. The document is a
+// flat "tape" of 64-bit entries, one per node in document order, and an arena
+// holding the unescaped content of all the strings. Both live in a single
+// allocation which is sized by a first lexing pass over the source.
+//
+// The upper 8 bits of each tape entry hold the node type (one of the
+// tjson_NodeTypeNo characters below) and the lower 56 bits hold a payload:
+//
+//   * `{`, `[`: the low 32 bits are the tape index of the matching close,
+//     and the next 24 bits are the number of fields or items (saturated at
+//     0xffffff)
+//   * `}`, `]`: the tape index of the matching open
+//   * `"`: the arena offset of the string. In the arena the string is
+//     preceded by its length as a (native endian) uint32_t and followed by a
+//     null terminator.
+//   * `l`, `u`, `d`: unused. The value is stored in the next tape entry as an
+//     int64, uint64, or double.
+//   * `t`, `f`, `n`: unused
+//
+// Object fields are stored as a key node followed by a value node.
+
+typedef enum tjson_NodeTypeNo {
+  TJSON_NODE_OBJECT = '{',
+  TJSON_NODE_OBJECT_END = '}',
+  TJSON_NODE_LIST = '[',
+  TJSON_NODE_LIST_END = ']',
+  TJSON_NODE_STRING = '"',
+  TJSON_NODE_INT64 = 'l',
+  TJSON_NODE_UINT64 = 'u',
+  TJSON_NODE_DOUBLE = 'd',
+  TJSON_NODE_TRUE = 't',
+  TJSON_NODE_FALSE = 'f',
+  TJSON_NODE_NULL = 'n',
+} tjson_NodeTypeNo;
+
+const char* tjson_NodeTypeNo_tostring(enum tjson_NodeTypeNo value);
+
+typedef struct tjson_Document {
+  uint64_t* tape;
+  uint32_t ntape;
+
+  // Unescaped string content
+  char* strings;
+  uint64_t nstrings;
+
+  // The single allocation holding both the tape and the strings
+  void* _block;
+} tjson_Document;
+
+// Parse `source` into `doc`. Return 0 on success. On failure fill `error`,
+// leave `doc` empty, and return -1. Any previous content of `doc` must have
+// been released with tjson_Document_free().
+int tjson_Document_parse(struct tjson_Document* doc,
+                         struct tjson_StringPiece source,
+                         struct tjson_Error* error);
+
+// Release the memory of the document.
+void tjson_Document_free(struct tjson_Document* doc);
+
+// -----------------------------------------------------------------------------
+//    Node
+// -----------------------------------------------------------------------------
+// A reference to a node of a document. Nodes are plain values and none of the
+// accessors allocate. A node is only valid as long as its document.
+
+typedef struct tjson_Node {
+  const struct tjson_Document* doc;
+  uint32_t idx;  //< index of the node on the tape
+} tjson_Node;
+
+// Return the root node of the document
+struct tjson_Node tjson_Document_root(const struct tjson_Document* doc);
+
+enum tjson_NodeTypeNo tjson_Node_type(struct tjson_Node node);
+
+// Return the number of fields of an object or items of a list, or 0 for any
+// other node.
+uint32_t tjson_Node_size(struct tjson_Node node);
+
+// Iterate over the children of an object or list:
+//
+//   tjson_Node end = tjson_Node_end(list);
+//   for (tjson_Node item = tjson_Node_begin(list); item.idx != end.idx;
+//        item = tjson_Node_next(item)) {
+//     ...
+//   }
+//
+// For objects the children alternate between keys and values.
+struct tjson_Node tjson_Node_begin(struct tjson_Node node);
+struct tjson_Node tjson_Node_end(struct tjson_Node node);
+
+// Return the node following this one (and all of its descendants)
+struct tjson_Node tjson_Node_next(struct tjson_Node node);
+
+// Find the value of the field named `key`. Return 0 and fill `value` if the
+// node is an object and has the field, otherwise return -1.
+int tjson_Node_find_field(struct tjson_Node node, struct tjson_StringPiece key,
+                          struct tjson_Node* value);
+
+// Find the `index`-th item of a list. Return 0 and fill `item` if the node is
+// a list with at least `index + 1` items, otherwise return -1.
+int tjson_Node_at(struct tjson_Node node, uint32_t index,
+                  struct tjson_Node* item);
+
+// Get the value of a node. Return 0 on success or -1 if the node is not of a
+// compatible type or the value is out of range. Integer nodes can be read as
+// doubles, and doubles with an integral value can be read as integers. The
+// string is not copied, it points into the document.
+int tjson_Node_get_string(struct tjson_Node node,
+                          struct tjson_StringPiece* value);
+int tjson_Node_get_int64(struct tjson_Node node, int64_t* value);
+int tjson_Node_get_uint64(struct tjson_Node node, uint64_t* value);
+int tjson_Node_get_double(struct tjson_Node node, double* value);
+int tjson_Node_get_boolean(struct tjson_Node node, int8_t* value);
+
+#if __cplusplus
+}  // extern "C"
+#endif
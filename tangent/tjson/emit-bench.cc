@@ -0,0 +1,82 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure emitting integers, doubles and strings with the tjson emitters and
+// compare against formatting the same values with snprintf.
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/emit.h"
+
+static void report(const char* name, size_t nvalues, size_t nbytes,
+                   uint64_t elapsed_ns) {
+  printf("%-20s %8.1f M values/s %8.1f MB/s\n", name,
+         nvalues / (elapsed_ns * 1e-9) / 1e6,
+         nbytes / (elapsed_ns * 1e-9) / 1e6);
+}
+
+int main() {
+  const size_t kCount = 1000000;
+  std::mt19937_64 rng(1234);
+  std::vector<int64_t> integers(kCount);
+  std::vector<double> doubles(kCount);
+  std::vector<std::string> strings(kCount);
+  for (size_t idx = 0; idx < kCount; idx++) {
+    integers[idx] = static_cast<int64_t>(rng()) >> (rng() % 64);
+    doubles[idx] = std::uniform_real_distribution<double>(-1e6, 1e6)(rng);
+    strings[idx] = "record " + std::to_string(idx) +
+                   ((idx % 8) ? " plain text" : " with \"quotes\"\n");
+  }
+
+  std::vector<char> out(64 * kCount);
+  char* const out_end = out.data() + out.size();
+
+  uint64_t begin = now_ns();
+  char* ptr = out.data();
+  for (int64_t value : integers) {
+    ptr += snprintf(ptr, out_end - ptr, "%lld,", static_cast<long long>(value));
+  }
+  report("snprintf int64", kCount, ptr - out.data(), now_ns() - begin);
+
+  tjson_WriteBuffer buf;
+  begin = now_ns();
+  tjson_WriteBuffer_init(&buf, out.data(), out_end);
+  for (int64_t value : integers) {
+    tjson_emit_int64(&buf, value);
+    tjson_emit_raw(&buf, ",", 1);
+  }
+  report("emit int64", kCount, buf.begin - out.data(), now_ns() - begin);
+
+  begin = now_ns();
+  ptr = out.data();
+  for (double value : doubles) {
+    ptr += snprintf(ptr, out_end - ptr, "%.17g,", value);
+  }
+  report("snprintf double", kCount, ptr - out.data(), now_ns() - begin);
+
+  begin = now_ns();
+  tjson_WriteBuffer_init(&buf, out.data(), out_end);
+  for (double value : doubles) {
+    tjson_emit_double(&buf, value);
+    tjson_emit_raw(&buf, ",", 1);
+  }
+  report("emit double", kCount, buf.begin - out.data(), now_ns() - begin);
+
+  begin = now_ns();
+  ptr = out.data();
+  for (const std::string& value : strings) {
+    ptr += snprintf(ptr, out_end - ptr, "\"%s\",", value.c_str());
+  }
+  report("snprintf string", kCount, ptr - out.data(), now_ns() - begin);
+
+  begin = now_ns();
+  tjson_WriteBuffer_init(&buf, out.data(), out_end);
+  for (const std::string& value : strings) {
+    tjson_emit_charbuf(&buf, value.data(), value.data() + value.size());
+    tjson_emit_raw(&buf, ",", 1);
+  }
+  report("emit string", kCount, buf.begin - out.data(), now_ns() - begin);
+  return 0;
+}
@@ -1,114 +1,615 @@
 // Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
 #include "tangent/tjson/emit.h"
 
-#include <stdio.h>
-#include <stdlib.h>
-
-static const char* get_unsigned_format(size_t size) {
-  static int8_t is_initialized = 0;
-  static const char* formats[9] = {"%u", "%u", "%u", "%u", "%u",
-                                   "%u", "%u", "%u", "%u"};
-  if (!is_initialized) {
-    formats[sizeof(long long unsigned int)] = "%llu";
-    formats[sizeof(long unsigned int)] = "%lu";
-    formats[sizeof(unsigned int)] = "%u";
-    formats[sizeof(unsigned short)] = "%hu";
-    formats[sizeof(unsigned char)] = "%hhu";
-    is_initialized = 1;
-  }
-  return formats[size];
-}
-
-static const char* get_signed_format(size_t size) {
-  static int8_t is_initialized = 0;
-  static const char* formats[9] = {"%i", "%i", "%i", "%i", "%i",
-                                   "%i", "%i", "%i", "%i"};
-  if (!is_initialized) {
-    formats[sizeof(long long int)] = "%lli";
-    formats[sizeof(long int)] = "%li";
-    formats[sizeof(int)] = "%i";
-    formats[sizeof(short)] = "%hi";
-    formats[sizeof(char)] = "%hhi";
-    is_initialized = 1;
-  }
-  return formats[size];
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// -----------------------------------------------------------------------------
+//    WriteBuffer
+// -----------------------------------------------------------------------------
+
+void tjson_WriteBuffer_init(struct tjson_WriteBuffer* buf, char* begin,
+                            char* end) {
+  buf->begin = begin;
+  buf->end = end;
+  buf->overflow = 0;
+}
+
+static inline void append(struct tjson_WriteBuffer* buf, const char* data,
+                          size_t size) {
+  if (buf->overflow || (size_t)(buf->end - buf->begin) < size) {
+    buf->overflow += size;
+    return;
+  }
+  memcpy(buf->begin, data, size);
+  buf->begin += size;
+}
+
+void tjson_emit_raw(struct tjson_WriteBuffer* buf, const char* data,
+                    size_t size) {
+  append(buf, data, size);
+}
+
+// -----------------------------------------------------------------------------
+//    Integers
+// -----------------------------------------------------------------------------
+
+static const char kDigitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Write the decimal digits of `value` so that they end at `end`, and return
+// the first digit
+static char* format_uint64(uint64_t value, char* end) {
+  char* ptr = end;
+  while (value >= 100) {
+    uint32_t pair = (uint32_t)(value % 100);
+    value /= 100;
+    ptr -= 2;
+    memcpy(ptr, &kDigitPairs[2 * pair], 2);
+  }
+  if (value >= 10) {
+    ptr -= 2;
+    memcpy(ptr, &kDigitPairs[2 * value], 2);
+  } else {
+    *--ptr = (char)('0' + value);
+  }
+  return ptr;
 }
 
 void tjson_emit_uint64(struct tjson_WriteBuffer* buf, uint64_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_unsigned_format(sizeof(uint64_t)), value);
-  buf->begin += count;
+  char digits[20];
+  char* end = digits + sizeof(digits);
+  char* begin = format_uint64(value, end);
+  append(buf, begin, end - begin);
 }
 
 void tjson_emit_uint32(struct tjson_WriteBuffer* buf, uint32_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_unsigned_format(sizeof(uint32_t)), value);
-  buf->begin += count;
+  tjson_emit_uint64(buf, value);
 }
 
 void tjson_emit_uint16(struct tjson_WriteBuffer* buf, uint16_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_unsigned_format(sizeof(uint16_t)), value);
-  buf->begin += count;
+  tjson_emit_uint64(buf, value);
 }
 
 void tjson_emit_uint8(struct tjson_WriteBuffer* buf, uint8_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_unsigned_format(sizeof(uint16_t)), (uint16_t)value);
-  buf->begin += count;
+  tjson_emit_uint64(buf, value);
 }
 
 void tjson_emit_int64(struct tjson_WriteBuffer* buf, int64_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_signed_format(sizeof(int64_t)), value);
-  buf->begin += count;
+  char digits[21];
+  char* end = digits + sizeof(digits);
+  // NOTE(josh): negate as unsigned so that INT64_MIN doesn't overflow
+  char* begin = format_uint64(
+      (value < 0) ? 0 - (uint64_t)value : (uint64_t)value, end);
+  if (value < 0) {
+    *--begin = '-';
+  }
+  append(buf, begin, end - begin);
 }
 
 void tjson_emit_int32(struct tjson_WriteBuffer* buf, int32_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_signed_format(sizeof(int32_t)), value);
-  buf->begin += count;
+  tjson_emit_int64(buf, value);
 }
 
 void tjson_emit_int16(struct tjson_WriteBuffer* buf, int16_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_signed_format(sizeof(int16_t)), value);
-  buf->begin += count;
+  tjson_emit_int64(buf, value);
 }
 
 void tjson_emit_int8(struct tjson_WriteBuffer* buf, int8_t value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin),
-                       get_signed_format(sizeof(int16_t)), (int16_t)value);
-  buf->begin += count;
+  tjson_emit_int64(buf, value);
+}
+
+// -----------------------------------------------------------------------------
+//    Floating Point
+// -----------------------------------------------------------------------------
+// Grisu2, from "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers" by Florian Loitsch. The value and the boundaries of its rounding
+// interval are scaled by a cached power of ten so that the integral part of
+// the upper boundary fits in 32 bits, and digits are generated until the
+// remainder falls within the interval. The result always parses back to the
+// same value and is the shortest such decimal for all but a tiny fraction of
+// inputs, which get one extra digit.
+
+// A floating point number `f * 2^e` with a 64-bit significand
+struct DiyFp {
+  uint64_t f;
+  int e;
+};
+
+static inline struct DiyFp diyfp_sub(struct DiyFp x, struct DiyFp y) {
+  struct DiyFp result = {x.f - y.f, x.e};
+  return result;
+}
+
+// Return x * y rounded to 64 bits of significand
+static inline struct DiyFp diyfp_mul(struct DiyFp x, struct DiyFp y) {
+  unsigned __int128 product = (unsigned __int128)x.f * y.f;
+  uint64_t high = (uint64_t)(product >> 64);
+  uint64_t low = (uint64_t)product;
+  struct DiyFp result = {high + (low >> 63), x.e + y.e + 64};
+  return result;
+}
+
+static inline struct DiyFp diyfp_normalize(struct DiyFp x) {
+  int shift = __builtin_clzll(x.f);
+  struct DiyFp result = {x.f << shift, x.e - shift};
+  return result;
+}
+
+// The value and its rounding interval [minus, plus], with `minus` and `plus`
+// sharing the exponent of the normalized value
+struct Boundaries {
+  struct DiyFp w;
+  struct DiyFp minus;
+  struct DiyFp plus;
+};
+
+// Compute the boundaries of a positive, finite, nonzero value given its raw
+// `fraction` and `biased_exponent` fields. `precision` is the number of bits
+// of significand including the hidden bit, and `bias` is the exponent bias
+// plus `precision - 1`.
+static struct Boundaries compute_boundaries(uint64_t fraction,
+                                            uint32_t biased_exponent,
+                                            int precision, int bias) {
+  uint64_t hidden_bit = 1ull << (precision - 1);
+  struct DiyFp v;
+  if (biased_exponent == 0) {
+    v.f = fraction;
+    v.e = 1 - bias;
+  } else {
+    v.f = fraction + hidden_bit;
+    v.e = (int)biased_exponent - bias;
+  }
+
+  // The lower boundary is closer if the value is a power of two (other than
+  // the smallest normal), since the spacing below it is half that above
+  int8_t lower_is_closer = (fraction == 0 && biased_exponent > 1);
+  struct DiyFp plus = {2 * v.f + 1, v.e - 1};
+  struct DiyFp minus = lower_is_closer ? (struct DiyFp){4 * v.f - 1, v.e - 2}
+                                       : (struct DiyFp){2 * v.f - 1, v.e - 1};
+
+  struct Boundaries result;
+  result.plus = diyfp_normalize(plus);
+  result.minus.f = minus.f << (minus.e - result.plus.e);
+  result.minus.e = result.plus.e;
+  result.w = diyfp_normalize(v);
+  return result;
+}
+
+// Normalized 64-bit approximations of 10^k for k = -300, -292, ..., 324.
+// Generated with exact rational arithmetic, rounded to nearest.
+struct CachedPower {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+static const struct CachedPower kCachedPowers[] = {
+    {0xAB70FE17C79AC6CA, -1060, -300},
+    {0xFF77B1FCBEBCDC4F, -1034, -292},
+    {0xBE5691EF416BD60C, -1007, -284},
+    {0x8DD01FAD907FFC3C, -980, -276},
+    {0xD3515C2831559A83, -954, -268},
+    {0x9D71AC8FADA6C9B5, -927, -260},
+    {0xEA9C227723EE8BCB, -901, -252},
+    {0xAECC49914078536D, -874, -244},
+    {0x823C12795DB6CE57, -847, -236},
+    {0xC21094364DFB5637, -821, -228},
+    {0x9096EA6F3848984F, -794, -220},
+    {0xD77485CB25823AC7, -768, -212},
+    {0xA086CFCD97BF97F4, -741, -204},
+    {0xEF340A98172AACE5, -715, -196},
+    {0xB23867FB2A35B28E, -688, -188},
+    {0x84C8D4DFD2C63F3B, -661, -180},
+    {0xC5DD44271AD3CDBA, -635, -172},
+    {0x936B9FCEBB25C996, -608, -164},
+    {0xDBAC6C247D62A584, -582, -156},
+    {0xA3AB66580D5FDAF6, -555, -148},
+    {0xF3E2F893DEC3F126, -529, -140},
+    {0xB5B5ADA8AAFF80B8, -502, -132},
+    {0x87625F056C7C4A8B, -475, -124},
+    {0xC9BCFF6034C13053, -449, -116},
+    {0x964E858C91BA2655, -422, -108},
+    {0xDFF9772470297EBD, -396, -100},
+    {0xA6DFBD9FB8E5B88F, -369, -92},
+    {0xF8A95FCF88747D94, -343, -84},
+    {0xB94470938FA89BCF, -316, -76},
+    {0x8A08F0F8BF0F156B, -289, -68},
+    {0xCDB02555653131B6, -263, -60},
+    {0x993FE2C6D07B7FAC, -236, -52},
+    {0xE45C10C42A2B3B06, -210, -44},
+    {0xAA242499697392D3, -183, -36},
+    {0xFD87B5F28300CA0E, -157, -28},
+    {0xBCE5086492111AEB, -130, -20},
+    {0x8CBCCC096F5088CC, -103, -12},
+    {0xD1B71758E219652C, -77, -4},
+    {0x9C40000000000000, -50, 4},
+    {0xE8D4A51000000000, -24, 12},
+    {0xAD78EBC5AC620000, 3, 20},
+    {0x813F3978F8940984, 30, 28},
+    {0xC097CE7BC90715B3, 56, 36},
+    {0x8F7E32CE7BEA5C70, 83, 44},
+    {0xD5D238A4ABE98068, 109, 52},
+    {0x9F4F2726179A2245, 136, 60},
+    {0xED63A231D4C4FB27, 162, 68},
+    {0xB0DE65388CC8ADA8, 189, 76},
+    {0x83C7088E1AAB65DB, 216, 84},
+    {0xC45D1DF942711D9A, 242, 92},
+    {0x924D692CA61BE758, 269, 100},
+    {0xDA01EE641A708DEA, 295, 108},
+    {0xA26DA3999AEF774A, 322, 116},
+    {0xF209787BB47D6B85, 348, 124},
+    {0xB454E4A179DD1877, 375, 132},
+    {0x865B86925B9BC5C2, 402, 140},
+    {0xC83553C5C8965D3D, 428, 148},
+    {0x952AB45CFA97A0B3, 455, 156},
+    {0xDE469FBD99A05FE3, 481, 164},
+    {0xA59BC234DB398C25, 508, 172},
+    {0xF6C69A72A3989F5C, 534, 180},
+    {0xB7DCBF5354E9BECE, 561, 188},
+    {0x88FCF317F22241E2, 588, 196},
+    {0xCC20CE9BD35C78A5, 614, 204},
+    {0x98165AF37B2153DF, 641, 212},
+    {0xE2A0B5DC971F303A, 667, 220},
+    {0xA8D9D1535CE3B396, 694, 228},
+    {0xFB9B7CD9A4A7443C, 720, 236},
+    {0xBB764C4CA7A44410, 747, 244},
+    {0x8BAB8EEFB6409C1A, 774, 252},
+    {0xD01FEF10A657842C, 800, 260},
+    {0x9B10A4E5E9913129, 827, 268},
+    {0xE7109BFBA19C0C9D, 853, 276},
+    {0xAC2820D9623BF429, 880, 284},
+    {0x80444B5E7AA7CF85, 907, 292},
+    {0xBF21E44003ACDD2D, 933, 300},
+    {0x8E679C2F5E44FF8F, 960, 308},
+    {0xD433179D9C8CB841, 986, 316},
+    {0x9E19DB92B4E31BA9, 1013, 324},};
+
+#define CACHED_POWERS_MIN_DEC_EXP (-300)
+#define CACHED_POWERS_DEC_STEP 8
+
+// The scaled upper boundary is kept within [2^kAlpha, 2^kGamma) so that its
+// integral part fits in 32 bits and the fraction in 64
+#define GRISU_ALPHA (-60)
+#define GRISU_GAMMA (-32)
+
+// Return a cached power 10^k such that the product of a normalized value with
+// binary exponent `e` and 10^-k has a binary exponent in
+// [GRISU_ALPHA, GRISU_GAMMA]
+static struct CachedPower get_cached_power(int e) {
+  int f = GRISU_ALPHA - e - 1;
+  // ceil(f * log10(2))
+  int k = (f * 78913) / (1 << 18) + (f > 0);
+  int index = (-CACHED_POWERS_MIN_DEC_EXP + k + (CACHED_POWERS_DEC_STEP - 1)) /
+              CACHED_POWERS_DEC_STEP;
+  return kCachedPowers[index];
+}
+
+// Return the number of decimal digits of `value` (which is less than 10^10)
+// and store the largest power of ten not greater than it in `pow10`
+static int find_largest_pow10(uint32_t value, uint32_t* pow10) {
+  static const uint32_t kPowers[] = {
+      1,      10,      100,      1000,      10000,
+      100000, 1000000, 10000000, 100000000, 1000000000};
+  int ndigits = 10;
+  while (ndigits > 1 && value < kPowers[ndigits - 1]) {
+    ndigits--;
+  }
+  *pow10 = kPowers[ndigits - 1];
+  return ndigits;
+}
+
+// Move the last digit down while that brings the number closer to the value
+// without leaving the rounding interval
+static void grisu2_round(char* digits, int ndigits, uint64_t dist,
+                         uint64_t delta, uint64_t rest, uint64_t ten_k) {
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    digits[ndigits - 1]--;
+    rest += ten_k;
+  }
+}
+
+// Generate the digits of a number in [minus, plus] (exclusive) which is as
+// close as possible to `w`. Return the number of digits and add the decimal
+// exponent of the last digit to `*exponent`.
+static int grisu2_digit_gen(char* digits, int* exponent, struct DiyFp minus,
+                            struct DiyFp w, struct DiyFp plus) {
+  uint64_t delta = diyfp_sub(plus, minus).f;
+  uint64_t dist = diyfp_sub(plus, w).f;
+
+  // Split the upper boundary into integral and fractional parts
+  struct DiyFp one = {1ull << -plus.e, plus.e};
+  uint32_t p1 = (uint32_t)(plus.f >> -one.e);
+  uint64_t p2 = plus.f & (one.f - 1);
+
+  int ndigits = 0;
+  uint32_t pow10 = 0;
+  int n = find_largest_pow10(p1, &pow10);
+  while (n > 0) {
+    digits[ndigits++] = (char)('0' + p1 / pow10);
+    p1 %= pow10;
+    n--;
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *exponent += n;
+      grisu2_round(digits, ndigits, dist, delta, rest,
+                   (uint64_t)pow10 << -one.e);
+      return ndigits;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  while (1) {
+    p2 *= 10;
+    digits[ndigits++] = (char)('0' + (p2 >> -one.e));
+    p2 &= one.f - 1;
+    m++;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta) {
+      break;
+    }
+  }
+  *exponent -= m;
+  grisu2_round(digits, ndigits, dist, delta, p2, one.f);
+  return ndigits;
+}
+
+static int grisu2(char* digits, int* exponent, struct Boundaries bounds) {
+  struct CachedPower cached = get_cached_power(bounds.plus.e);
+  struct DiyFp c_minus_k = {cached.f, cached.e};
+  struct DiyFp w = diyfp_mul(bounds.w, c_minus_k);
+  struct DiyFp minus = diyfp_mul(bounds.minus, c_minus_k);
+  struct DiyFp plus = diyfp_mul(bounds.plus, c_minus_k);
+
+  // The products may be off by one ulp, so shrink the interval to stay
+  // safely inside of it
+  minus.f++;
+  plus.f--;
+  *exponent = -cached.k;
+  return grisu2_digit_gen(digits, exponent, minus, w, plus);
+}
+
+// Write a decimal exponent as `e` followed by a sign and at least two digits
+static char* append_exponent(char* out, int exponent) {
+  *out++ = 'e';
+  if (exponent < 0) {
+    *out++ = '-';
+    exponent = -exponent;
+  } else {
+    *out++ = '+';
+  }
+  if (exponent >= 100) {
+    *out++ = (char)('0' + exponent / 100);
+    exponent %= 100;
+  }
+  memcpy(out, &kDigitPairs[2 * exponent], 2);
+  return out + 2;
+}
+
+// Lay out `ndigits` digits (already at `out`) whose value is
+// `digits * 10^exponent`, in positional notation if the decimal exponent of
+// the leading digit is in [min_exp, max_exp) or scientific notation otherwise.
+// Return the end of the output.
+static char* format_digits(char* out, int ndigits, int exponent, int min_exp,
+                           int max_exp) {
+  // The decimal point goes after the first `n` digits
+  int n = ndigits + exponent;
+
+  if (ndigits <= n && n <= max_exp) {
+    // digits[000].0
+    memset(out + ndigits, '0', n - ndigits);
+    out[n] = '.';
+    out[n + 1] = '0';
+    return out + n + 2;
+  }
+  if (0 < n && n <= max_exp) {
+    // dig.its
+    memmove(out + n + 1, out + n, ndigits - n);
+    out[n] = '.';
+    return out + ndigits + 1;
+  }
+  if (min_exp < n && n <= 0) {
+    // 0.[000]digits
+    memmove(out + 2 - n, out, ndigits);
+    out[0] = '0';
+    out[1] = '.';
+    memset(out + 2, '0', -n);
+    return out + 2 - n + ndigits;
+  }
+
+  // d[.igits]e[+-]xx
+  if (ndigits > 1) {
+    memmove(out + 2, out + 1, ndigits - 1);
+    out[1] = '.';
+    out += ndigits + 1;
+  } else {
+    out += 1;
+  }
+  return append_exponent(out, n - 1);
+}
+
+// Format a finite value given its sign and raw fields. `out` must have room
+// for 32 characters.
+static char* format_float(char* out, int8_t negative, uint64_t fraction,
+                          uint32_t biased_exponent, int precision, int bias,
+                          int max_exp) {
+  if (negative) {
+    *out++ = '-';
+  }
+  if (fraction == 0 && biased_exponent == 0) {
+    memcpy(out, "0.0", 3);
+    return out + 3;
+  }
+  int exponent = 0;
+  int ndigits = grisu2(
+      out, &exponent,
+      compute_boundaries(fraction, biased_exponent, precision, bias));
+  return format_digits(out, ndigits, exponent, -4, max_exp);
 }
 
 void tjson_emit_double(struct tjson_WriteBuffer* buf, double value) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin), "%e", value);
-  buf->begin += count;
+  if (!isfinite(value)) {
+    tjson_emit_null(buf);
+    return;
+  }
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  char text[32];
+  char* end =
+      format_float(text, (int8_t)(bits >> 63), bits & ((1ull << 52) - 1),
+                   (uint32_t)(bits >> 52) & 0x7ff, 53, 1075, 15);
+  append(buf, text, end - text);
 }
 
-void tjson_emit_float(struct tjson_WriteBuffer* buf, double value) {
-  int count =
-      snprintf(buf->begin, (buf->end - buf->begin), "%e", (double)value);
-  buf->begin += count;
+void tjson_emit_float(struct tjson_WriteBuffer* buf, float value) {
+  if (!isfinite(value)) {
+    tjson_emit_null(buf);
+    return;
+  }
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  char text[32];
+  char* end = format_float(text, (int8_t)(bits >> 31), bits & ((1u << 23) - 1),
+                           (bits >> 23) & 0xff, 24, 150, 6);
+  append(buf, text, end - text);
 }
 
+// -----------------------------------------------------------------------------
+//    Literals
+// -----------------------------------------------------------------------------
+
 void tjson_emit_boolean(struct tjson_WriteBuffer* buf, int8_t value) {
   if (value) {
-    tjson_emit_string(buf, "true");
+    append(buf, "true", 4);
   } else {
-    tjson_emit_string(buf, "false");
+    append(buf, "false", 5);
+  }
+}
+
+void tjson_emit_null(struct tjson_WriteBuffer* buf) {
+  append(buf, "null", 4);
+}
+
+// -----------------------------------------------------------------------------
+//    Strings
+// -----------------------------------------------------------------------------
+
+static inline int8_t needs_escape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Return the first character in [ptr, end) which must be escaped, or `end`
+static const char* find_escape(const char* ptr, const char* end) {
+#if defined(__AVX2__)
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i backslash32 = _mm256_set1_epi8('\\');
+  const __m256i control32 = _mm256_set1_epi8(0x1f);
+  for (; end - ptr >= 32; ptr += 32) {
+    __m256i chars = _mm256_loadu_si256((const __m256i*)ptr);
+    __m256i escaped = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars, quote32),
+                        _mm256_cmpeq_epi8(chars, backslash32)),
+        _mm256_cmpeq_epi8(_mm256_min_epu8(chars, control32), chars));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(escaped);
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+  for (; end - ptr >= 16; ptr += 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*)ptr);
+    // chars <= 0x1f (unsigned) iff min(chars, 0x1f) == chars
+    __m128i escaped =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, quote),
+                                  _mm_cmpeq_epi8(chars, backslash)),
+                     _mm_cmpeq_epi8(_mm_min_epu8(chars, control), chars));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(escaped);
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (ptr < end && !needs_escape((unsigned char)*ptr)) {
+    ptr++;
+  }
+  return ptr;
+}
+
+static void append_escape(struct tjson_WriteBuffer* buf, unsigned char c) {
+  switch (c) {
+    case '"':
+      append(buf, "\\\"", 2);
+      return;
+    case '\\':
+      append(buf, "\\\\", 2);
+      return;
+    case '\b':
+      append(buf, "\\b", 2);
+      return;
+    case '\f':
+      append(buf, "\\f", 2);
+      return;
+    case '\n':
+      append(buf, "\\n", 2);
+      return;
+    case '\r':
+      append(buf, "\\r", 2);
+      return;
+    case '\t':
+      append(buf, "\\t", 2);
+      return;
+    default: {
+      static const char kHex[] = "0123456789abcdef";
+      char escape[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+      append(buf, escape, sizeof(escape));
+      return;
+    }
   }
 }
 
 void tjson_emit_string(struct tjson_WriteBuffer* buf, const char* str) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin), "\"%s\"", str);
-  buf->begin += count;
+  tjson_emit_charbuf(buf, str, str + strlen(str));
+}
+
+void tjson_emit_escaped(struct tjson_WriteBuffer* buf, const char* begin,
+                        const char* end) {
+  while (begin < end) {
+    const char* escape = find_escape(begin, end);
+    append(buf, begin, escape - begin);
+    if (escape == end) {
+      break;
+    }
+    append_escape(buf, (unsigned char)*escape);
+    begin = escape + 1;
+  }
 }
 
 void tjson_emit_charbuf(struct tjson_WriteBuffer* buf, const char* begin,
                         const char* end) {
-  int count = snprintf(buf->begin, (buf->end - buf->begin), "\"%.*s\"",
-                       (int)(begin - end), begin);
-  buf->begin += count;
+  char* start = buf->begin;
+  int8_t fit = (buf->overflow == 0);
+  append(buf, "\"", 1);
+  tjson_emit_escaped(buf, begin, end);
+  append(buf, "\"", 1);
+
+  // Don't leave part of the string behind if the rest of it didn't fit
+  if (fit && buf->overflow) {
+    buf->overflow += buf->begin - start;
+    buf->begin = start;
+  }
 }
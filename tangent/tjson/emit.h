@@ -1,25 +1,44 @@
 #pragma once
 // Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "tangent/tjson/tjson.h"
 
+#if __cplusplus
+extern "C" {
+#endif
+
 // -----------------------------------------------------------------------------
 //    Output buffer for document generation
 // -----------------------------------------------------------------------------
+// Values are appended at `begin`, which advances toward `end`. Once a value
+// does not fit, neither it nor anything emitted after it is written. Instead
+// their sizes are accumulated in `overflow`, so that the size of a buffer
+// which would hold the whole output is the number of bytes written plus
+// `overflow`.
 
-struct tjson_WriteBuffer {
+typedef struct tjson_WriteBuffer {
   char* begin;
   char* end;
-};
+  uint64_t overflow;  //< number of bytes which did not fit
+} tjson_WriteBuffer;
+
+void tjson_WriteBuffer_init(struct tjson_WriteBuffer* buf, char* begin,
+                            char* end);
 
 // -----------------------------------------------------------------------------
 //    Emit Helpers
 // -----------------------------------------------------------------------------
 // These implement reusable algorithms that are used for multiple different
-// types
+// types. None of them allocate or call into stdio.
+
+// Append `size` bytes verbatim (e.g. punctuation or whitespace)
+void tjson_emit_raw(struct tjson_WriteBuffer* buf, const char* data,
+                    size_t size);
 
+// Integers are formatted two digits at a time from a table of digit pairs
 void tjson_emit_uint64(struct tjson_WriteBuffer* buf, uint64_t value);
 void tjson_emit_uint32(struct tjson_WriteBuffer* buf, uint32_t value);
 void tjson_emit_uint16(struct tjson_WriteBuffer* buf, uint16_t value);
@@ -28,13 +47,31 @@ void tjson_emit_uint8(struct tjson_WriteBuffer* buf, uint8_t value);
 void tjson_emit_int64(struct tjson_WriteBuffer* buf, int64_t value);
 void tjson_emit_int32(struct tjson_WriteBuffer* buf, int32_t value);
 void tjson_emit_int16(struct tjson_WriteBuffer* buf, int16_t value);
-void tjson_emit_int8(struct tjson_WriteBuffer* buf, int8_t valu);
+void tjson_emit_int8(struct tjson_WriteBuffer* buf, int8_t value);
 
+// Emit the shortest decimal (or very nearly, see Grisu2) which parses back to
+// exactly `value`. Values with a decimal exponent in [-5, 15) ([-5, 6) for
+// floats) are written in positional notation, always with a fraction (e.g.
+// `100.0`), others in scientific notation (e.g. `1e+21`). JSON can't
+// represent infinities or NaN so they are emitted as `null`.
 void tjson_emit_double(struct tjson_WriteBuffer* buf, double value);
-void tjson_emit_float(struct tjson_WriteBuffer* buf, double value);
+void tjson_emit_float(struct tjson_WriteBuffer* buf, float value);
 
 void tjson_emit_boolean(struct tjson_WriteBuffer* buf, int8_t value);
+void tjson_emit_null(struct tjson_WriteBuffer* buf);
 
+// Emit a quoted string. Quotes, backslashes and control characters are
+// escaped, everything else (including UTF-8 sequences) is copied verbatim.
 void tjson_emit_string(struct tjson_WriteBuffer* buf, const char* str);
 void tjson_emit_charbuf(struct tjson_WriteBuffer* buf, const char* begin,
                         const char* end);
+
+// Emit the escaped content of a string, without the quotes. Runs of
+// characters which don't need escaping are found 16 or 32 bytes at a time and
+// copied in bulk.
+void tjson_emit_escaped(struct tjson_WriteBuffer* buf, const char* begin,
+                        const char* end);
+
+#if __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,63 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Compare the memory and throughput of tjson_parse() into rich events with
+// tjson_parse_compact() into compact events, and the cost of expanding the
+// compact events back into rich ones, on a synthetic document (100MB by
+// default).
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/tjson.h"
+
+static void report(const char* name, size_t source_size, size_t nevents,
+                   size_t event_size, uint64_t elapsed_ns) {
+  double buffer_mb = nevents * event_size / 1e6;
+  printf("%-16s %3zu B/event %9.1f MB (%5.2fx input) %8.1f MB/s\n", name,
+         event_size, buffer_mb, buffer_mb / (source_size / 1e6),
+         source_size / (elapsed_ns * 1e-9) / 1e6);
+}
+
+int main(int argc, char** argv) {
+  size_t size_mb = 100;
+  if (argc > 1) {
+    size_mb = strtoul(argv[1], nullptr, 10);
+  }
+  std::string document = make_record_list(size_mb * 1000 * 1000);
+  tjson_StringPiece source{document.data(), document.data() + document.size()};
+  tjson_Error error{};
+
+  int nevents = tjson_parse(source, nullptr, 0, &error);
+  if (nevents < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+  printf("%zu bytes, %d events\n", document.size(), nevents);
+
+  std::vector<tjson_Event> events(nevents);
+  uint64_t begin = now_ns();
+  tjson_parse(source, events.data(), events.size(), &error);
+  report("rich", document.size(), nevents, sizeof(tjson_Event),
+         now_ns() - begin);
+
+  std::vector<tjson_CompactEvent> compact(nevents);
+  begin = now_ns();
+  tjson_parse_compact(source, compact.data(), compact.size(), &error);
+  report("compact", document.size(), nevents, sizeof(tjson_CompactEvent),
+         now_ns() - begin);
+
+  // Expand every event, as a consumer walking the whole buffer would
+  uint64_t checksum = 0;
+  begin = now_ns();
+  for (const tjson_CompactEvent& item : compact) {
+    tjson_Event event;
+    tjson_CompactEvent_expand(&item, source, &event);
+    checksum += tjson_StringPiece_size(event.token.spelling);
+  }
+  uint64_t elapsed_ns = now_ns() - begin;
+  printf("expand all       %8.1f Mevents/s (%llu)\n",
+         nevents / (elapsed_ns * 1e-9) / 1e6,
+         static_cast<unsigned long long>(checksum));
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int io_error(struct tjson_Error* error, const char* what) {
+  error->code = TJSON_IO_ERROR;
+  memset(&error->loc, 0, sizeof(error->loc));
+  snprintf(error->msg, sizeof(error->msg), "%s failed: %s", what,
+           strerror(errno));
+  return -1;
+}
+
+// Read everything from `fd` into a buffer which grows as needed
+static int read_all(struct tjson_File* file, int fd,
+                    struct tjson_Error* error) {
+  size_t capacity = 64 * 1024;
+  size_t size = 0;
+  char* buffer = malloc(capacity);
+  if (!buffer) {
+    return io_error(error, "malloc");
+  }
+
+  while (1) {
+    if (size == capacity) {
+      char* grown = realloc(buffer, 2 * capacity);
+      if (!grown) {
+        free(buffer);
+        return io_error(error, "realloc");
+      }
+      buffer = grown;
+      capacity *= 2;
+    }
+    ssize_t nread = read(fd, buffer + size, capacity - size);
+    if (nread < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      free(buffer);
+      return io_error(error, "read");
+    }
+    if (nread == 0) {
+      break;
+    }
+    size += nread;
+  }
+
+  file->_buffer = buffer;
+  file->content.begin = buffer;
+  file->content.end = buffer + size;
+  return 0;
+}
+
+int tjson_File_open_fd(struct tjson_File* file, int fd,
+                       struct tjson_Error* error) {
+  memset(file, 0, sizeof(struct tjson_File));
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    return io_error(error, "fstat");
+  }
+  if (!S_ISREG(info.st_mode) || info.st_size < 1) {
+    // NOTE(josh): some files (e.g. in /proc) report a size of zero but still
+    // have content, so read those too.
+    return read_all(file, fd, error);
+  }
+
+  void* map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    return read_all(file, fd, error);
+  }
+  // NOTE(josh): this is only advice, so failure is not an error
+  (void)madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+  file->_map = map;
+  file->_mapsize = info.st_size;
+  file->content.begin = (const char*)map;
+  file->content.end = (const char*)map + info.st_size;
+  return 0;
+}
+
+int tjson_File_open(struct tjson_File* file, const char* path,
+                    struct tjson_Error* error) {
+  memset(file, 0, sizeof(struct tjson_File));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    io_error(error, "open");
+    size_t len = strlen(error->msg);
+    snprintf(error->msg + len, sizeof(error->msg) - len, " (%s)", path);
+    return -1;
+  }
+  int result = tjson_File_open_fd(file, fd, error);
+  close(fd);
+  return result;
+}
+
+void tjson_File_close(struct tjson_File* file) {
+  if (file->_map) {
+    munmap(file->_map, file->_mapsize);
+  }
+  free(file->_buffer);
+  memset(file, 0, sizeof(struct tjson_File));
+}
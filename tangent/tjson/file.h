@@ -0,0 +1,48 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    File
+// -----------------------------------------------------------------------------
+// The content of an input file, ready to be given to tjson_LexerParser_begin()
+// (or any other function taking the whole source). A regular file is mapped
+// into memory, so that it is neither copied nor scanned for a terminator
+// before parsing, and the kernel is advised that it will be read
+// sequentially. Anything else (e.g. a pipe) is read into a buffer.
+
+typedef struct tjson_File {
+  // The content of the file. Valid until tjson_File_close()
+  struct tjson_StringPiece content;
+
+  // The mapping, if the file is mapped
+  void* _map;
+  size_t _mapsize;
+
+  // The buffer, if the file is read
+  char* _buffer;
+} tjson_File;
+
+// Open and map or read the file at `path`. Return 0 on success, or fill
+// `error` and return -1.
+int tjson_File_open(struct tjson_File* file, const char* path,
+                    struct tjson_Error* error);
+
+// Map or read the content of an open file descriptor (e.g. STDIN_FILENO).
+// The descriptor is not closed, and may be closed as soon as this returns.
+int tjson_File_open_fd(struct tjson_File* file, int fd,
+                       struct tjson_Error* error);
+
+// Release the content of the file
+void tjson_File_close(struct tjson_File* file);
+
+#if __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,292 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure field dispatch while parsing a list of homogeneous records (1M
+// records of 20 keys by default) with the perfect hash lookup that protostruct
+// generates, with and without a key table.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/keytable.h"
+#include "tangent/tjson/parse.h"
+#include "tangent/tjson/tjson.h"
+
+static const char* const kFieldNames[] = {
+    "id",
+    "timestamp",
+    "sensor_id",
+    "sensor_name",
+    "latitude",
+    "longitude",
+    "altitude_meters",
+    "heading_degrees",
+    "ground_speed",
+    "vertical_speed",
+    "battery_voltage",
+    "battery_current",
+    "temperature_celsius",
+    "pressure_pascals",
+    "humidity_percent",
+    "signal_strength_dbm",
+    "sequence_number",
+    "error_count",
+    "firmware_version",
+    "uptime_seconds",
+};
+static const uint32_t kNumFields = sizeof(kFieldNames) / sizeof(kFieldNames[0]);
+
+static std::string make_document(size_t nrecords) {
+  std::string out = "[\n";
+  char buf[64];
+  for (size_t idx = 0; idx < nrecords; idx++) {
+    out += idx ? ",\n  {" : "  {";
+    for (uint32_t field = 0; field < kNumFields; field++) {
+      snprintf(buf, sizeof(buf), "%s\"%s\": %zu", field ? ", " : "",
+               kFieldNames[field], idx * kNumFields + field);
+      out += buf;
+    }
+    out += "}";
+  }
+  out += "\n]\n";
+  return out;
+}
+
+// The minimal perfect hash of the normalized field names, built the same way
+// as get_suci_phash() in protostruct/template_util.py
+struct PerfectHash {
+  std::vector<uint32_t> seeds;
+  std::vector<std::string> keys;  //< normalized key of each slot
+  std::vector<uint32_t> fields;   //< field index of each slot
+  uint32_t maxsize;
+};
+
+static uint32_t normalize(const char* name, std::string* key) {
+  char buf[64];
+  uint32_t hash = 0;
+  int32_t size = tjson_StringPiece_suci_normalize(
+      tjson_StringPiece_fromstr(name), buf, sizeof(buf), &hash);
+  key->assign(buf, size);
+  return hash;
+}
+
+static PerfectHash make_phash() {
+  PerfectHash phash{};
+  uint32_t nslots = kNumFields;
+  uint32_t nbuckets = (nslots + 1) / 2;
+  std::vector<std::vector<uint32_t>> buckets(nbuckets);
+  std::vector<uint32_t> hashes(kNumFields);
+  std::string key;
+  for (uint32_t field = 0; field < kNumFields; field++) {
+    hashes[field] = normalize(kFieldNames[field], &key);
+    buckets[hashes[field] % nbuckets].push_back(field);
+  }
+
+  phash.seeds.resize(nbuckets);
+  phash.keys.resize(nslots);
+  phash.fields.assign(nslots, kNumFields);
+  std::vector<uint32_t> order(nbuckets);
+  for (uint32_t idx = 0; idx < nbuckets; idx++) {
+    order[idx] = idx;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+  for (uint32_t bucket_idx : order) {
+    const std::vector<uint32_t>& bucket = buckets[bucket_idx];
+    for (uint32_t seed = 1; !bucket.empty(); seed++) {
+      std::vector<uint32_t> candidate;
+      for (uint32_t field : bucket) {
+        uint32_t slot = tjson_phash_slot(hashes[field], seed, nslots);
+        bool taken = phash.fields[slot] != kNumFields;
+        for (uint32_t other : candidate) {
+          taken |= (other == slot);
+        }
+        if (taken) {
+          break;
+        }
+        candidate.push_back(slot);
+      }
+      if (candidate.size() == bucket.size()) {
+        phash.seeds[bucket_idx] = seed;
+        for (size_t idx = 0; idx < bucket.size(); idx++) {
+          normalize(kFieldNames[bucket[idx]], &phash.keys[candidate[idx]]);
+          phash.fields[candidate[idx]] = bucket[idx];
+        }
+        break;
+      }
+    }
+  }
+  for (const std::string& slotkey : phash.keys) {
+    phash.maxsize = std::max<uint32_t>(phash.maxsize, slotkey.size());
+  }
+  return phash;
+}
+
+static PerfectHash g_phash = make_phash();
+
+struct Record {
+  int64_t values[kNumFields];
+};
+
+struct Records {
+  Record record;
+  int64_t checksum;
+  uint64_t nkeys;
+};
+
+// Return the field of `fieldname` through the perfect hash, or -1
+static int32_t lookup_field(tjson_StringPiece fieldname) {
+  char key[64];
+  uint32_t hash = 0;
+  int32_t size = tjson_StringPiece_suci_normalize(fieldname, key,
+                                                  g_phash.maxsize, &hash);
+  if (size < 0) {
+    return -1;
+  }
+  uint32_t slot = tjson_phash_slot(
+      hash, g_phash.seeds[hash % g_phash.seeds.size()], kNumFields);
+  if (static_cast<uint32_t>(size) != g_phash.keys[slot].size() ||
+      memcmp(key, g_phash.keys[slot].data(), size) != 0) {
+    return -1;
+  }
+  return static_cast<int32_t>(g_phash.fields[slot]);
+}
+
+static int parse_field(Records* records, tjson_ParseContext ctx,
+                       int32_t field) {
+  records->nkeys++;
+  if (field < 0) {
+    return tjson_sink_value(ctx);
+  }
+  return tjson_parse_int64(ctx, &records->record.values[field]);
+}
+
+static int fielditem(void* userdata, tjson_ParseContext ctx,
+                     tjson_StringPiece fieldname) {
+  return parse_field(static_cast<Records*>(userdata), ctx,
+                     lookup_field(fieldname));
+}
+
+static int keyitem(void* userdata, tjson_ParseContext ctx,
+                   tjson_StringPiece fieldname, uint32_t keyid) {
+  int32_t field = -1;
+  if (!tjson_lookup_key(ctx, &g_phash, keyid, &field)) {
+    field = lookup_field(fieldname);
+    tjson_bind_key(ctx, &g_phash, keyid, field);
+  }
+  return parse_field(static_cast<Records*>(userdata), ctx, field);
+}
+
+static int finish_record(Records* records, int result) {
+  for (uint32_t field = 0; field < kNumFields; field++) {
+    records->checksum += records->record.values[field];
+  }
+  return result;
+}
+
+static int listitem(void* userdata, tjson_ParseContext ctx) {
+  Records* records = static_cast<Records*>(userdata);
+  return finish_record(records, tjson_parse_object(ctx, fielditem, records));
+}
+
+static int listitem_interned(void* userdata, tjson_ParseContext ctx) {
+  Records* records = static_cast<Records*>(userdata);
+  return finish_record(records,
+                       tjson_parse_object_interned(ctx, keyitem, records));
+}
+
+static void run(const char* name, const std::string& document,
+                tjson_KeyTable* table,
+                int (*item)(void*, tjson_ParseContext)) {
+  tjson_Error error{};
+  tjson_LexerParser stream{};
+  tjson_LexerParser_init(&stream, &error);
+  tjson_LexerParser_set_keytable(&stream, table);
+  Records records{};
+
+  uint64_t begin = now_ns();
+  tjson_LexerParser_begin(
+      &stream,
+      tjson_StringPiece{document.data(), document.data() + document.size()},
+      &error);
+  tjson_ParseContext ctx{&stream, &error, nullptr};
+  if (tjson_parse_list(ctx, item, &records)) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+  uint64_t elapsed_ns = now_ns() - begin;
+  printf("%-24s %8.1f MB/s %6.1f ns/key (%lld)\n", name,
+         document.size() / (elapsed_ns * 1e-9) / 1e6,
+         static_cast<double>(elapsed_ns) / records.nkeys,
+         static_cast<long long>(records.checksum));
+}
+
+// Time only the dispatch of the keys of `document`, which are collected from
+// the first few records and then dispatched over and over.
+static void run_dispatch(const std::string& document, size_t nkeys) {
+  std::vector<tjson_StringPiece> keys;
+  const char* cursor = document.data();
+  const char* end = document.data() + document.size();
+  while (keys.size() < 1000 * kNumFields) {
+    const char* open =
+        static_cast<const char*>(memchr(cursor, '"', end - cursor));
+    if (!open) {
+      break;
+    }
+    const char* close =
+        static_cast<const char*>(memchr(open + 1, '"', end - open - 1));
+    keys.push_back(tjson_StringPiece{open + 1, close});
+    cursor = close + 1;
+  }
+
+  int64_t checksum = 0;
+  uint64_t begin = now_ns();
+  for (size_t idx = 0; idx < nkeys; idx++) {
+    checksum += lookup_field(keys[idx % keys.size()]);
+  }
+  uint64_t elapsed_ns = now_ns() - begin;
+  printf("%-24s %6.1f ns/key (%lld)\n", "dispatch, perfect hash",
+         static_cast<double>(elapsed_ns) / nkeys,
+         static_cast<long long>(checksum));
+
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+  checksum = 0;
+  begin = now_ns();
+  for (size_t idx = 0; idx < nkeys; idx++) {
+    tjson_StringPiece key = keys[idx % keys.size()];
+    uint32_t keyid = tjson_KeyTable_intern(table.get(), key);
+    int32_t field = -1;
+    if (!tjson_KeyTable_lookup(table.get(), &g_phash, keyid, &field)) {
+      field = lookup_field(key);
+      tjson_KeyTable_bind(table.get(), &g_phash, keyid, field);
+    }
+    checksum += field;
+  }
+  elapsed_ns = now_ns() - begin;
+  printf("%-24s %6.1f ns/key (%lld)\n", "dispatch, interned",
+         static_cast<double>(elapsed_ns) / nkeys,
+         static_cast<long long>(checksum));
+}
+
+int main(int argc, char** argv) {
+  size_t nrecords = 1000 * 1000;
+  if (argc > 1) {
+    nrecords = strtoul(argv[1], nullptr, 10);
+  }
+  std::string document = make_document(nrecords);
+  printf("%zu records, %u keys each, %zu bytes\n", nrecords, kNumFields,
+         document.size());
+
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+  run("perfect hash", document, nullptr, listitem);
+  run("interned, no key table", document, nullptr, listitem_interned);
+  run("interned", document, table.get(), listitem_interned);
+  run_dispatch(document, nrecords * kNumFields);
+  return 0;
+}
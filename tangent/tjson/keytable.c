@@ -0,0 +1,109 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include "tangent/tjson/keytable.h"
+
+#include <string.h>
+
+#define KEY_MASK (TJSON_KEYTABLE_CAPACITY - 1)
+#define BINDING_MASK (TJSON_KEYTABLE_BINDINGS - 1)
+
+#if (TJSON_KEYTABLE_CAPACITY & KEY_MASK) || \
+    (TJSON_KEYTABLE_BINDINGS & BINDING_MASK)
+#error "Key table sizes must be powers of two"
+#endif
+
+// Load `size` (at most eight) bytes into the low bytes of a word
+static inline uint64_t load_word(const char* ptr, size_t size) {
+  uint64_t word = 0;
+  memcpy(&word, ptr, size);
+  return word;
+}
+
+// Fold all of the bits of `word` into the low bits of the result
+static inline uint32_t mix(uint64_t word) {
+  word ^= word >> 33;
+  word *= 0xff51afd7ed558ccdull;
+  word ^= word >> 33;
+  return (uint32_t)word;
+}
+
+void tjson_KeyTable_init(struct tjson_KeyTable* table) {
+  memset(table, 0, sizeof(*table));
+}
+
+uint32_t tjson_KeyTable_intern(struct tjson_KeyTable* table,
+                               struct tjson_StringPiece key) {
+  uint32_t size = (uint32_t)tjson_StringPiece_size(key);
+  uint64_t prefix = load_word(key.begin, size < 8 ? size : 8);
+  uint64_t suffix = size > 8 ? load_word(key.end - 8, 8) : 0;
+  uint32_t hash = mix(prefix ^ (suffix * 0x9e3779b97f4a7c15ull) ^ size);
+
+  for (uint32_t probe = 0; probe < TJSON_KEYTABLE_PROBE; probe++) {
+    struct tjson_KeyEntry* entry = &table->_slots[(hash + probe) & KEY_MASK];
+    if (entry->id == 0) {
+      // Not seen before, intern it here if there is room
+      uint32_t begin = table->_ends[table->nkeys];
+      if (table->nkeys + 1 >= TJSON_KEYTABLE_CAPACITY ||
+          size > TJSON_KEYTABLE_STORAGE - begin) {
+        return 0;
+      }
+      memcpy(&table->_storage[begin], key.begin, size);
+      table->nkeys++;
+      table->_ends[table->nkeys] = begin + size;
+      entry->prefix = prefix;
+      entry->suffix = suffix;
+      entry->size = size;
+      entry->id = table->nkeys;
+      return entry->id;
+    }
+
+    if (entry->size != size || entry->prefix != prefix ||
+        entry->suffix != suffix) {
+      continue;
+    }
+    // The first and last eight bytes cover any key of up to 16 bytes
+    if (size <= 16 || memcmp(&table->_storage[table->_ends[entry->id - 1] + 8],
+                             key.begin + 8, size - 16) == 0) {
+      return entry->id;
+    }
+  }
+
+  return 0;
+}
+
+struct tjson_StringPiece tjson_KeyTable_get(const struct tjson_KeyTable* table,
+                                            uint32_t id) {
+  struct tjson_StringPiece key = {table->_storage, table->_storage};
+  if (0 < id && id <= table->nkeys) {
+    key.begin = &table->_storage[table->_ends[id - 1]];
+    key.end = &table->_storage[table->_ends[id]];
+  }
+  return key;
+}
+
+static inline uint32_t binding_slot(const void* shape, uint32_t id) {
+  return mix((uint64_t)(uintptr_t)shape ^ (id * 0x9e3779b97f4a7c15ull)) &
+         BINDING_MASK;
+}
+
+int tjson_KeyTable_lookup(const struct tjson_KeyTable* table,
+                          const void* shape, uint32_t id, int32_t* value) {
+  const struct tjson_KeyBinding* binding =
+      &table->_bindings[binding_slot(shape, id)];
+  if (id && binding->id == id && binding->shape == shape) {
+    *value = binding->value;
+    return 1;
+  }
+  return 0;
+}
+
+void tjson_KeyTable_bind(struct tjson_KeyTable* table, const void* shape,
+                         uint32_t id, int32_t value) {
+  if (id == 0) {
+    return;
+  }
+  struct tjson_KeyBinding* binding = &table->_bindings[binding_slot(shape, id)];
+  binding->shape = shape;
+  binding->id = id;
+  binding->value = value;
+}
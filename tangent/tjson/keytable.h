@@ -0,0 +1,101 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Key Table
+// -----------------------------------------------------------------------------
+// Arrays of homogeneous objects repeat the same few keys over and over. A key
+// table interns object keys, assigning each distinct key a small integer ID
+// the first time it is seen. Keys are placed in a direct-mapped table (with a
+// short linear probe) by a hash of their length and their first and last
+// eight bytes. A key which has been seen before is recognized by comparing
+// those three words (and the middle of the key, if it is longer than 16
+// bytes) so that it is not normalized or hashed character by character again.
+//
+// Interned keys are never evicted, so an ID is stable for the lifetime of the
+// table, which may span many documents. Once the table or its key storage is
+// full, new keys are not interned (their ID is zero).
+//
+// The table also caches a "binding" of each ID to a small integer value per
+// object shape, which is how generated parsers remember which field a key
+// dispatched to. A shape is any address unique to the object type (e.g. its
+// static table of field names). Bindings live in a direct-mapped cache and
+// may be evicted by a colliding (shape, ID) pair, in which case they are
+// simply learned again.
+//
+// Use a key table with a LexerParser through
+// tjson_LexerParser_set_keytable() and tjson_parse_object_interned().
+
+// Number of slots in the key table. At most TJSON_KEYTABLE_CAPACITY - 1 keys
+// are interned, IDs are in [1, TJSON_KEYTABLE_CAPACITY).
+#define TJSON_KEYTABLE_CAPACITY 256
+
+// Number of slots probed for a key before giving up on it
+#define TJSON_KEYTABLE_PROBE 4
+
+// Bytes of storage for the spelling of interned keys
+#define TJSON_KEYTABLE_STORAGE 8192
+
+// Number of slots in the binding cache
+#define TJSON_KEYTABLE_BINDINGS 256
+
+typedef struct tjson_KeyEntry {
+  uint64_t prefix;  //< first eight bytes of the key, zero padded
+  uint64_t suffix;  //< last eight bytes of the key, or zero if shorter
+  uint32_t size;    //< length of the key
+  uint32_t id;      //< ID of the key, or zero if the slot is empty
+} tjson_KeyEntry;
+
+typedef struct tjson_KeyBinding {
+  const void* shape;
+  uint32_t id;
+  int32_t value;
+} tjson_KeyBinding;
+
+typedef struct tjson_KeyTable {
+  struct tjson_KeyEntry _slots[TJSON_KEYTABLE_CAPACITY];
+  struct tjson_KeyBinding _bindings[TJSON_KEYTABLE_BINDINGS];
+
+  // Offset of the end of each key in `_storage`, indexed by ID. Keys are
+  // stored in the order they are interned so key `id` begins at the end of
+  // key `id - 1`.
+  uint32_t _ends[TJSON_KEYTABLE_CAPACITY];
+  char _storage[TJSON_KEYTABLE_STORAGE];
+
+  // Number of keys interned
+  uint32_t nkeys;
+} tjson_KeyTable;
+
+// Empty the table
+void tjson_KeyTable_init(struct tjson_KeyTable* table);
+
+// Return the ID of `key`, interning it if it has not been seen before, or
+// zero if it is not yet interned and there is no room left in the table.
+uint32_t tjson_KeyTable_intern(struct tjson_KeyTable* table,
+                               struct tjson_StringPiece key);
+
+// Return the spelling of the key with the given ID, or an empty piece if no
+// key has that ID.
+struct tjson_StringPiece tjson_KeyTable_get(const struct tjson_KeyTable* table,
+                                            uint32_t id);
+
+// If a value is bound to `id` for `shape` then store it in `value` and return
+// 1, otherwise return 0.
+int tjson_KeyTable_lookup(const struct tjson_KeyTable* table,
+                          const void* shape, uint32_t id, int32_t* value);
+
+// Bind `value` to `id` for `shape`. Does nothing if `id` is zero.
+void tjson_KeyTable_bind(struct tjson_KeyTable* table, const void* shape,
+                         uint32_t id, int32_t value);
+
+#if __cplusplus
+}  // extern "C"
+#endif
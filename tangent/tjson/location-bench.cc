@@ -0,0 +1,94 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure the cost of source locations while lexing. Compare lexing with
+// offsets only, lexing while tracking line and column of every byte (which
+// is what the scanner used to do), and lexing while locating every token
+// on demand. Each is run on a document without newlines and on a document
+// with many short lines.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/tjson.h"
+
+static std::string make_document(size_t target_size, const char* newline) {
+  std::string out = "[";
+  char buf[512];
+  for (uint32_t idx = 0; out.size() < target_size; idx++) {
+    snprintf(buf, sizeof(buf),
+             "%s{\"id\": %u, \"name\": \"record number %u\",%s"
+             "\"tags\": [\"alpha\", \"beta\"],%s"
+             "\"description\": \"%s\"}",
+             idx ? "," : "", idx, idx, newline, newline,
+             "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+             "eiusmod tempor incididunt ut labore et dolore magna aliqua.");
+    out += buf;
+    out += newline;
+  }
+  out += "]";
+  return out;
+}
+
+enum Mode { OFFSETS, EAGER, LOCATE };
+
+static uint64_t lex(const std::string& document, Mode mode) {
+  tjson_Scanner scanner;
+  tjson_Error error{};
+  tjson_Scanner_init(&scanner, &error);
+  tjson_Scanner_begin(
+      &scanner,
+      tjson_StringPiece{document.data(), document.data() + document.size()},
+      &error);
+  tjson_Token token;
+  tjson_SourceLocation loc{};  // only used in EAGER mode
+  uint64_t checksum = 0;
+  while (tjson_Scanner_pump(&scanner, &token, &error) == 0) {
+    switch (mode) {
+      case OFFSETS:
+        break;
+      case EAGER:
+        checksum += loc.lineno + loc.colno;
+        for (const char* ptr = token.spelling.begin; ptr < token.spelling.end;
+             ptr++) {
+          if (*ptr == '\n') {
+            loc.lineno++;
+            loc.colno = 0;
+          } else {
+            loc.colno++;
+          }
+        }
+        break;
+      case LOCATE:
+        tjson_Scanner_locate(&scanner, &token.location);
+        checksum += token.location.lineno + token.location.colno;
+        break;
+    }
+  }
+  if (error.code != TJSON_LEX_INPUT_FINISHED) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+  return checksum;
+}
+
+static void run(const char* name, const std::string& document) {
+  const char* kModes[] = {"offsets only", "eager line/col", "locate each"};
+  for (int mode = OFFSETS; mode <= LOCATE; mode++) {
+    uint64_t begin = now_ns();
+    uint64_t checksum = lex(document, static_cast<Mode>(mode));
+    uint64_t elapsed_ns = now_ns() - begin;
+    printf("%-12s %-16s %8.1f MB/s (%llu)\n", name, kModes[mode],
+           document.size() / (elapsed_ns * 1e-9) / 1e6,
+           static_cast<unsigned long long>(checksum));
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t size_mb = 16;
+  if (argc > 1) {
+    size_mb = strtoul(argv[1], nullptr, 10);
+  }
+  run("single-line", make_document(size_mb * 1024 * 1024, " "));
+  run("many-line", make_document(size_mb * 1024 * 1024, "\n"));
+  return 0;
+}
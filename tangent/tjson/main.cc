@@ -1,7 +1,17 @@
 // Copyright 2021 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <thread>
+#include <vector>
 
 #include "argue/argue.h"
+#include "tangent/tjson/file.h"
+#include "tangent/tjson/ndjson.h"
+#include "tangent/tjson/query.h"
+#include "tangent/tjson/structural.h"
 #include "tangent/tjson/tjson.h"
 #include "tangent/util/exception.h"
 
@@ -12,6 +22,16 @@ struct ProgramOpts {
   struct {
     bool omit_template;
   } markup;
+
+  struct {
+    std::vector<std::string> paths;
+  } query;
+
+  struct {
+    int num_threads;
+    bool ordered;
+    bool sweep;
+  } ndjson;
 };
 
 std::ostream& operator<<(std::ostream& out,
@@ -25,18 +45,18 @@ std::ostream& operator<<(std::ostream& out, const tjson_Error& error) {
   return out;
 }
 
-int lex_file(const ProgramOpts& opts, const std::string& content) {
+int lex_file(const ProgramOpts& opts, tjson_StringPiece content) {
   tjson_Error error{};
   tjson_Scanner scanner;
   TANGENT_ASSERT(tjson_Scanner_init(&scanner, &error) == 0)
       << "Failed to initialize scanner: " << error;
-  tjson_StringPiece content_piece = tjson_StringPiece_fromstr(content.c_str());
-  TANGENT_ASSERT(tjson_Scanner_begin(&scanner, content_piece, &error) == 0)
+  TANGENT_ASSERT(tjson_Scanner_begin(&scanner, content, &error) == 0)
       << "Failed to start scanner: " << error;
 
   tjson_Token token;
   uint32_t idx = 0;
   while (tjson_Scanner_pump(&scanner, &token, &error) == 0) {
+    tjson_Scanner_locate(&scanner, &token.location);
     printf("%3d: [%14s](%d:%d) '%.*s'\n", idx++,
            tjson_TokenTypeNo_tostring(token.typeno), token.location.lineno,
            token.location.colno,
@@ -51,22 +71,41 @@ int lex_file(const ProgramOpts& opts, const std::string& content) {
   }
 }
 
-int parse_file(const ProgramOpts& opts, const std::string& content) {
+// Parse the input as it is read, one chunk at a time, so that memory use does
+// not depend on the size of the input.
+int parse_file(const ProgramOpts& opts, std::istream* infile) {
+  std::vector<char> chunk(64 * 1024);
+  std::vector<char> carry(64 * 1024);
   tjson_Error error{};
   tjson_LexerParser parser;
   TANGENT_ASSERT(tjson_LexerParser_init(&parser, &error) == 0)
       << "Failed to initialize parser: " << error;
-  tjson_StringPiece content_piece = tjson_StringPiece_fromstr(content.c_str());
-  TANGENT_ASSERT(tjson_LexerParser_begin(&parser, content_piece, &error) == 0)
+  TANGENT_ASSERT(tjson_LexerParser_begin_stream(&parser, carry.data(),
+                                                carry.size(), &error) == 0)
       << "Failed to start parsing: " << error;
 
   tjson_Event event;
   uint32_t idx = 0;
-  while (tjson_LexerParser_get_next_event(&parser, &event, &error) == 0) {
-    printf("%3d: [%13s] '%.*s'\n", idx++,
-           tjson_EventTypeNo_tostring(event.typeno),
-           static_cast<int>(tjson_StringPiece_size(event.token.spelling)),
-           event.token.spelling.begin);
+  while (true) {
+    if (tjson_LexerParser_get_next_event(&parser, &event, &error) == 0) {
+      printf("%3d: [%13s] '%.*s'\n", idx++,
+             tjson_EventTypeNo_tostring(event.typeno),
+             static_cast<int>(tjson_StringPiece_size(event.token.spelling)),
+             event.token.spelling.begin);
+      continue;
+    }
+    if (error.code != TJSON_LEX_NEED_INPUT) {
+      break;
+    }
+
+    infile->read(chunk.data(), chunk.size());
+    tjson_StringPiece piece{chunk.data(), chunk.data() + infile->gcount()};
+    int result = (infile->gcount() > 0)
+                     ? tjson_LexerParser_feed(&parser, piece, &error)
+                     : tjson_LexerParser_finish(&parser, &error);
+    if (result) {
+      break;
+    }
   }
   if (error.code == TJSON_LEX_INPUT_FINISHED) {
     return 0;
@@ -76,6 +115,126 @@ int parse_file(const ProgramOpts& opts, const std::string& content) {
   }
 }
 
+int query_file(const ProgramOpts& opts, tjson_StringPiece content) {
+  tjson_Error error{};
+  tjson_Query query;
+  tjson_Query_init(&query);
+  if (opts.query.paths.empty()) {
+    std::cerr << "At least one --path is required\n";
+    return 1;
+  }
+  for (const std::string& path : opts.query.paths) {
+    if (tjson_Query_add(&query, path.c_str(), &error) < 0) {
+      std::cerr << error.msg << "\n";
+      return error.code;
+    }
+  }
+
+  std::vector<uint32_t> structurals(tjson_StringPiece_size(content) + 1);
+  int64_t nstructurals = tjson_index_structurals(
+      content, structurals.data(), structurals.size(), &error);
+  if (nstructurals < 0) {
+    std::cerr << error << "\n";
+    return error.code;
+  }
+  std::vector<tjson_Bracket> brackets(nstructurals / 2 + 1);
+  int64_t nbrackets =
+      tjson_index_brackets(content, structurals.data(), nstructurals,
+                           brackets.data(), brackets.size(), &error);
+  if (nbrackets < 0) {
+    std::cerr << error << "\n";
+    return error.code;
+  }
+
+  std::vector<tjson_QueryResult> results(64);
+  int64_t count = 0;
+  while (true) {
+    tjson_LexerParser parser;
+    TANGENT_ASSERT(tjson_LexerParser_init(&parser, &error) == 0)
+        << "Failed to initialize parser: " << error;
+    TANGENT_ASSERT(tjson_LexerParser_begin(&parser, content, &error) == 0)
+        << "Failed to start parsing: " << error;
+    tjson_LexerParser_set_structurals(&parser, structurals.data(),
+                                      nstructurals, &error);
+    tjson_LexerParser_set_brackets(&parser, brackets.data(), nbrackets,
+                                   &error);
+    count = tjson_Query_run(&query, &parser, results.data(), results.size(),
+                            &error);
+    if (count < 0) {
+      std::cerr << error << "\n";
+      return error.code;
+    }
+    if (static_cast<size_t>(count) <= results.size()) {
+      break;
+    }
+    results.resize(count);
+  }
+
+  for (int64_t idx = 0; idx < count; idx++) {
+    const tjson_QueryResult& result = results[idx];
+    printf("%s: %.*s\n", opts.query.paths[result.path].c_str(),
+           static_cast<int>(tjson_StringPiece_size(result.span)),
+           result.span.begin);
+  }
+  return 0;
+}
+
+struct NdjsonCounts {
+  std::atomic<uint64_t> nerrors{0};
+  bool quiet = false;
+};
+
+static int count_ndjson_record(void* context, const tjson_NdjsonRecord* record,
+                               tjson_Error* error) {
+  NdjsonCounts* counts = static_cast<NdjsonCounts*>(context);
+  if (record->error) {
+    counts->nerrors++;
+    if (!counts->quiet) {
+      fprintf(stderr, "%llu:%u: %s\n",
+              static_cast<unsigned long long>(record->lineno),
+              record->error->loc.colno, record->error->msg);
+    }
+  }
+  return 0;
+}
+
+// Parse each line of the content as a separate document, reporting the lines
+// which fail and the throughput. With `--sweep`, repeat for every thread
+// count from one up to `--jobs`.
+int ndjson_file(const ProgramOpts& opts, tjson_StringPiece content) {
+  uint32_t max_threads = opts.ndjson.num_threads;
+  if (max_threads < 1) {
+    max_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  uint64_t nerrors = 0;
+  for (uint32_t nthreads = opts.ndjson.sweep ? 1 : max_threads;
+       nthreads <= max_threads; nthreads++) {
+    tjson_NdjsonOpts ndjson_opts{};
+    ndjson_opts.nthreads = nthreads;
+    ndjson_opts.ordered = opts.ndjson.ordered;
+
+    NdjsonCounts counts;
+    counts.quiet = (nthreads > 1 && opts.ndjson.sweep);
+    tjson_Error error{};
+    auto begin = std::chrono::steady_clock::now();
+    int64_t nrecords = tjson_parse_ndjson(content, &ndjson_opts,
+                                          count_ndjson_record, &counts, &error);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    if (nrecords < 0) {
+      std::cerr << error.msg << "\n";
+      return error.code;
+    }
+    nerrors = counts.nerrors;
+    printf("threads: %2u, records: %lld, errors: %llu, %8.1f MB/s\n",
+           nthreads, static_cast<long long>(nrecords),
+           static_cast<unsigned long long>(nerrors),
+           tjson_StringPiece_size(content) / elapsed.count() / 1e6);
+  }
+  return nerrors ? 1 : 0;
+}
+
 const char* kProlog =
     "Demonstrates the usage of the json library to lex and parse JSON data";
 
@@ -100,8 +259,39 @@ int main(int argc, char** argv) {
       "lex", {.help = "Lex the file and dump token information"});
   auto parse_parser = subparsers->add_parser(
       "parse", {.help = "Parse the file and dump actionable parse events"});
+  auto query_parser = subparsers->add_parser(
+      "query", {.help = "Print the values selected by JSON pointer paths"});
+  auto ndjson_parser = subparsers->add_parser(
+      "ndjson", {.help = "Parse one document per line on multiple threads"});
+  {
+    using argue::keywords::action;
+    using argue::keywords::default_;
+    using argue::keywords::dest;
+    using argue::keywords::help;
+
+    // clang-format off
+    query_parser->add_argument(
+        "-p", "--path", action="append", dest=&opts.query.paths,
+        help="JSON pointer to select, '*' matches any key or index. Can be"
+             " specified multiple times.");
+
+    ndjson_parser->add_argument(
+        "-j", "--jobs", dest=&opts.ndjson.num_threads, default_=0,
+        help="Number of threads used to parse (default: one per core)");
+
+    ndjson_parser->add_argument(
+        "--ordered", action="store_true", dest=&opts.ndjson.ordered,
+        help="Handle the documents in input order");
+
+    ndjson_parser->add_argument(
+        "--sweep", action="store_true", dest=&opts.ndjson.sweep,
+        help="Report the throughput with every number of threads from one up"
+             " to --jobs");
+    // clang-format on
+  }
 
-  for (auto& subparser : {lex_parser, parse_parser}) {
+  for (auto& subparser :
+       {lex_parser, parse_parser, query_parser, ndjson_parser}) {
     argue::KWargs<std::string> kwargs{
         //
         .action = "store",  .nargs = "?",
@@ -133,26 +323,35 @@ int main(int argc, char** argv) {
       break;
   }
 
-  std::istream* infile;
-  std::ifstream open_infile;
-  if (opts.infile == "-") {
-    infile = &std::cin;
-  } else {
-    open_infile.open(opts.infile);
-    infile = &open_infile;
+  if (opts.command == "parse") {
+    std::ifstream open_infile;
+    if (opts.infile != "-") {
+      open_infile.open(opts.infile);
+    }
+    exit(parse_file(opts, (opts.infile == "-") ? &std::cin : &open_infile));
   }
 
-  std::string content;
-  content.reserve(1024 * 1024);
-  content.assign((std::istreambuf_iterator<char>(*infile)),
-                 std::istreambuf_iterator<char>());
+  // Other commands work on the whole content, which is mapped if possible
+  tjson_Error error{};
+  tjson_File file{};
+  int open_result = (opts.infile == "-")
+                        ? tjson_File_open_fd(&file, STDIN_FILENO, &error)
+                        : tjson_File_open(&file, opts.infile.c_str(), &error);
+  if (open_result) {
+    std::cerr << error.msg << "\n";
+    exit(error.code);
+  }
 
+  int result = 0;
   if (opts.command == "lex") {
-    exit(lex_file(opts, content));
-  } else if (opts.command == "parse") {
-    exit(parse_file(opts, content));
+    result = lex_file(opts, file.content);
+  } else if (opts.command == "query") {
+    result = query_file(opts, file.content);
+  } else if (opts.command == "ndjson") {
+    result = ndjson_file(opts, file.content);
   } else {
     printf("Unknown command: %s\n", opts.command.c_str());
   }
-  return 0;
+  tjson_File_close(&file);
+  return result;
 }
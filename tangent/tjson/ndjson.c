@@ -0,0 +1,350 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/ndjson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tangent/tjson/workpool.h"
+
+// A range of whole lines of the source
+struct Chunk {
+  const char* begin;
+  const char* end;  //< one past the newline of the last line, or end of source
+
+  // Number of newlines in the chunk after the counting pass, then the number
+  // of newlines preceding the chunk
+  uint64_t lineno;
+};
+
+// State shared by all workers
+struct Pool {
+  struct tjson_StringPiece source;
+  tjson_ndjson_callback callback;
+  void* context;
+  int8_t ordered;
+
+  struct tjson_WorkPool work;
+  struct Chunk* chunks;
+  uint64_t nrecords;  //< accessed atomically
+};
+
+// A record whose events are buffered until its chunk is delivered
+struct PendingRecord {
+  uint64_t lineno;
+  struct tjson_StringPiece line;
+  uint64_t events_begin;
+  uint32_t nevents;
+  int64_t error;  //< index into Worker::errors, or -1
+};
+
+struct Worker {
+  struct Pool* pool;
+  uint32_t index;
+
+  struct tjson_LexerParser stream;
+
+  // Events of the line being parsed (unordered) or of the whole chunk
+  // (ordered)
+  struct tjson_Event* events;
+  uint64_t nevents;
+  uint64_t events_capacity;
+
+  // Records and errors of the chunk being parsed (ordered)
+  struct PendingRecord* records;
+  uint64_t nrecords;
+  uint64_t records_capacity;
+  struct tjson_Error* errors;
+  uint64_t nerrors;
+  uint64_t errors_capacity;
+};
+
+// -----------------------------------------------------------------------------
+//    Parse
+// -----------------------------------------------------------------------------
+
+// Parse one line, appending its events to the worker's event buffer. Return 0
+// if the line holds a document, 1 if it is blank, -1 if it fails to parse (in
+// which case `error` is filled) or -2 if the event buffer can't be grown.
+static int parse_line(struct Worker* worker, struct tjson_StringPiece line,
+                      uint64_t lineno, struct tjson_Error* error) {
+  struct tjson_LexerParser* stream = &worker->stream;
+  uint64_t begin = worker->nevents;
+  if (tjson_LexerParser_begin(stream, line, error)) {
+    return -1;
+  }
+  while (1) {
+    if (tjson_reserve((void**)&worker->events, &worker->events_capacity,
+                      worker->nevents + 1, sizeof(struct tjson_Event))) {
+      return -2;
+    }
+    if (tjson_LexerParser_get_next_event(stream,
+                                         &worker->events[worker->nevents],
+                                         error) == 0) {
+      worker->nevents++;
+      continue;
+    }
+    if (error->code == TJSON_LEX_INPUT_FINISHED) {
+      if (stream->_parser._group_stack_size == 0) {
+        return (worker->nevents == begin) ? 1 : 0;
+      }
+      error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+      error->loc = stream->_scanner._loc;
+      tjson_LexerParser_locate(stream, &error->loc);
+      snprintf(error->msg, sizeof(error->msg),
+               "Line ends inside of an unterminated %s",
+               stream->_parser._group_stack[stream->_parser._group_stack_size -
+                                            1] == TJSON_OBJECT_BEGIN
+                   ? "object"
+                   : "list");
+    }
+    break;
+  }
+
+  // The stream only saw the one line, so move the location into the source
+  error->loc.lineno = (uint32_t)lineno;
+  error->loc.offset += (uint32_t)(line.begin - worker->pool->source.begin);
+  return -1;
+}
+
+static void deliver(struct Worker* worker, struct tjson_NdjsonRecord* record) {
+  struct Pool* pool = worker->pool;
+  struct tjson_Error error;
+  memset(&error, 0, sizeof(error));
+  if (pool->callback(pool->context, record, &error)) {
+    tjson_WorkPool_stop(&pool->work, &error);
+  }
+}
+
+// Parse every line of the chunk, calling the callback as soon as each is
+// parsed
+static void parse_chunk_unordered(struct Worker* worker,
+                                  const struct Chunk* chunk) {
+  struct Pool* pool = worker->pool;
+  uint64_t lineno = chunk->lineno;
+  uint64_t nrecords = 0;
+  struct tjson_Error error;
+  for (const char* ptr = chunk->begin;
+       ptr < chunk->end && !tjson_WorkPool_stopped(&pool->work); lineno++) {
+    const char* newline = memchr(ptr, '\n', chunk->end - ptr);
+    struct tjson_StringPiece line = {ptr, newline ? newline : chunk->end};
+    ptr = line.end + 1;
+
+    worker->nevents = 0;
+    int result = parse_line(worker, line, lineno, &error);
+    if (result == 1) {
+      continue;
+    }
+    if (result == -2) {
+      tjson_WorkPool_out_of_memory(&worker->pool->work, worker->index);
+      break;
+    }
+
+    struct tjson_NdjsonRecord record;
+    record.lineno = lineno;
+    record.offset = (uint64_t)(line.begin - pool->source.begin);
+    record.line = line;
+    record.events = worker->events;
+    record.nevents = (uint32_t)worker->nevents;
+    record.error = (result == 0) ? NULL : &error;
+    record.worker = worker->index;
+    deliver(worker, &record);
+    nrecords++;
+  }
+  __atomic_fetch_add(&pool->nrecords, nrecords, __ATOMIC_RELAXED);
+}
+
+// Parse every line of the chunk into the worker's buffers, then wait until all
+// preceding chunks are delivered and deliver this one
+static void parse_chunk_ordered(struct Worker* worker,
+                                const struct Chunk* chunk,
+                                uint64_t chunk_index) {
+  struct Pool* pool = worker->pool;
+  worker->nevents = 0;
+  worker->nrecords = 0;
+  worker->nerrors = 0;
+
+  uint64_t lineno = chunk->lineno;
+  for (const char* ptr = chunk->begin;
+       ptr < chunk->end && !tjson_WorkPool_stopped(&pool->work); lineno++) {
+    const char* newline = memchr(ptr, '\n', chunk->end - ptr);
+    struct tjson_StringPiece line = {ptr, newline ? newline : chunk->end};
+    ptr = line.end + 1;
+
+    if (tjson_reserve((void**)&worker->records, &worker->records_capacity,
+                      worker->nrecords + 1, sizeof(struct PendingRecord)) ||
+        tjson_reserve((void**)&worker->errors, &worker->errors_capacity,
+                      worker->nerrors + 1, sizeof(struct tjson_Error))) {
+      tjson_WorkPool_out_of_memory(&worker->pool->work, worker->index);
+      return;
+    }
+
+    uint64_t events_begin = worker->nevents;
+    int result =
+        parse_line(worker, line, lineno, &worker->errors[worker->nerrors]);
+    if (result == 1) {
+      continue;
+    }
+    if (result == -2) {
+      tjson_WorkPool_out_of_memory(&worker->pool->work, worker->index);
+      return;
+    }
+
+    struct PendingRecord* pending = &worker->records[worker->nrecords++];
+    pending->lineno = lineno;
+    pending->line = line;
+    pending->events_begin = events_begin;
+    pending->nevents = (uint32_t)(worker->nevents - events_begin);
+    pending->error = (result == 0) ? -1 : (int64_t)worker->nerrors++;
+  }
+
+  tjson_WorkPool_wait_turn(&pool->work, chunk_index);
+
+  uint64_t nrecords = 0;
+  for (; nrecords < worker->nrecords && !tjson_WorkPool_stopped(&pool->work);
+       nrecords++) {
+    const struct PendingRecord* pending = &worker->records[nrecords];
+    struct tjson_NdjsonRecord record;
+    record.lineno = pending->lineno;
+    record.offset = (uint64_t)(pending->line.begin - pool->source.begin);
+    record.line = pending->line;
+    record.events = worker->events + pending->events_begin;
+    record.nevents = pending->nevents;
+    record.error =
+        (pending->error < 0) ? NULL : &worker->errors[pending->error];
+    record.worker = worker->index;
+    deliver(worker, &record);
+  }
+  __atomic_fetch_add(&pool->nrecords, nrecords, __ATOMIC_RELAXED);
+
+  tjson_WorkPool_end_turn(&pool->work);
+}
+
+// -----------------------------------------------------------------------------
+//    Workers
+// -----------------------------------------------------------------------------
+
+static void* count_lines(void* arg) {
+  struct Worker* worker = arg;
+  struct Pool* pool = worker->pool;
+  uint64_t chunk_index;
+  while (tjson_WorkPool_claim(&pool->work, &chunk_index)) {
+    struct Chunk* chunk = &pool->chunks[chunk_index];
+    uint64_t count = 0;
+    for (const char* ptr = chunk->begin;
+         (ptr = memchr(ptr, '\n', chunk->end - ptr)) != NULL; ptr++) {
+      count++;
+    }
+    chunk->lineno = count;
+  }
+  return NULL;
+}
+
+static void* parse_lines(void* arg) {
+  struct Worker* worker = arg;
+  struct Pool* pool = worker->pool;
+  uint64_t chunk_index;
+  while (tjson_WorkPool_claim(&pool->work, &chunk_index)) {
+    if (pool->ordered) {
+      parse_chunk_ordered(worker, &pool->chunks[chunk_index], chunk_index);
+    } else {
+      parse_chunk_unordered(worker, &pool->chunks[chunk_index]);
+    }
+  }
+  return NULL;
+}
+
+// Split the source into chunks of about `chunk_size` bytes which end at a
+// newline
+static uint64_t split_chunks(struct tjson_StringPiece source,
+                             uint32_t chunk_size, struct Chunk* chunks) {
+  uint64_t nchunks = 0;
+  const char* ptr = source.begin;
+  while (ptr < source.end) {
+    const char* end = ptr + chunk_size;
+    if (end >= source.end) {
+      end = source.end;
+    } else {
+      const char* newline = memchr(end, '\n', source.end - end);
+      end = newline ? newline + 1 : source.end;
+    }
+    chunks[nchunks].begin = ptr;
+    chunks[nchunks].end = end;
+    chunks[nchunks].lineno = 0;
+    nchunks++;
+    ptr = end;
+  }
+  return nchunks;
+}
+
+int64_t tjson_parse_ndjson(struct tjson_StringPiece source,
+                           const struct tjson_NdjsonOpts* opts,
+                           tjson_ndjson_callback callback, void* context,
+                           struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+
+  struct tjson_NdjsonOpts default_opts;
+  memset(&default_opts, 0, sizeof(default_opts));
+  if (!opts) {
+    opts = &default_opts;
+  }
+  uint32_t chunk_size =
+      opts->chunk_size ? opts->chunk_size : TJSON_NDJSON_DEFAULT_CHUNK_SIZE;
+  size_t size = tjson_StringPiece_size(source);
+  uint64_t max_chunks = size / chunk_size + 1;
+  uint32_t nthreads = tjson_WorkPool_get_nthreads(opts->nthreads, max_chunks);
+
+  struct Pool pool;
+  memset(&pool, 0, sizeof(pool));
+  pool.source = source;
+  pool.callback = callback;
+  pool.context = context;
+  pool.ordered = opts->ordered;
+  pool.chunks = malloc(max_chunks * sizeof(struct Chunk));
+  struct Worker* workers = calloc(nthreads, sizeof(struct Worker));
+  if (!pool.chunks || !workers || tjson_WorkPool_init(&pool.work, nthreads)) {
+    free(pool.chunks);
+    free(workers);
+    memset(&error->loc, 0, sizeof(error->loc));
+    error->code = TJSON_PARSE_OOM;
+    snprintf(error->msg, sizeof(error->msg),
+             "Failed to allocate %u workers", nthreads);
+    return -1;
+  }
+  pool.work.nchunks = split_chunks(source, chunk_size, pool.chunks);
+
+  for (uint32_t idx = 0; idx < nthreads; idx++) {
+    workers[idx].pool = &pool;
+    workers[idx].index = idx;
+    tjson_LexerParser_init(&workers[idx].stream, error);
+  }
+
+  int result = tjson_WorkPool_run(&pool.work, count_lines, workers,
+                                  sizeof(struct Worker));
+  if (result == 0) {
+    uint64_t lineno = 0;
+    for (uint64_t idx = 0; idx < pool.work.nchunks; idx++) {
+      uint64_t count = pool.chunks[idx].lineno;
+      pool.chunks[idx].lineno = lineno;
+      lineno += count;
+    }
+    result = tjson_WorkPool_run(&pool.work, parse_lines, workers,
+                                sizeof(struct Worker));
+  }
+  if (result) {
+    *error = pool.work.error;
+  }
+
+  for (uint32_t idx = 0; idx < nthreads; idx++) {
+    free(workers[idx].events);
+    free(workers[idx].records);
+    free(workers[idx].errors);
+  }
+  free(workers);
+  free(pool.chunks);
+  tjson_WorkPool_deinit(&pool.work);
+  return result ? -1 : (int64_t)pool.nrecords;
+}
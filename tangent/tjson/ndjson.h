@@ -0,0 +1,84 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    NDJSON
+// -----------------------------------------------------------------------------
+// Newline delimited JSON (a.k.a. JSON lines): a sequence of documents, one
+// per line. Lines which are empty or contain only whitespace are skipped.
+//
+// The input is split at line boundaries into chunks of roughly
+// `chunk_size` bytes, and the chunks are parsed by a pool of worker threads,
+// each with its own tjson_LexerParser. The events of each document are passed
+// to a callback. Line numbers are resolved in a first pass which counts the
+// newlines of each chunk (also in parallel), so that a record carries its line
+// number regardless of which worker parses it.
+
+#define TJSON_NDJSON_DEFAULT_CHUNK_SIZE (1024 * 1024)
+
+typedef struct tjson_NdjsonOpts {
+  // Number of worker threads. Zero for one per online CPU. With one thread the
+  // input is parsed on the calling thread.
+  uint32_t nthreads;
+
+  // Target size of each chunk in bytes. Zero for the default.
+  uint32_t chunk_size;
+
+  // If nonzero the callback is called in input order, one record at a time.
+  // Workers still parse ahead in parallel, buffering the events of a chunk
+  // until all preceding chunks have been delivered. If zero the callback is
+  // called concurrently from all workers, as soon as each line is parsed.
+  int8_t ordered;
+} tjson_NdjsonOpts;
+
+// A document, or a line which failed to parse
+typedef struct tjson_NdjsonRecord {
+  uint64_t lineno;  //< number of newlines preceding the line
+  uint64_t offset;  //< offset of the beginning of the line in the source
+
+  // Text of the line, without the newline
+  struct tjson_StringPiece line;
+
+  // Events of the document. Valid only for the duration of the callback,
+  // though the tokens refer to the source.
+  const struct tjson_Event* events;
+  uint32_t nevents;
+
+  // If the line failed to parse, this describes why, and `events` holds the
+  // events preceding the error. The location is that of the error within the
+  // whole source. NULL if the line parsed successfully.
+  const struct tjson_Error* error;
+
+  // Index of the worker which parsed the line, less than the number of
+  // threads. Useful for keeping per-thread state in unordered mode.
+  uint32_t worker;
+} tjson_NdjsonRecord;
+
+// Called for each record. Return zero to continue, or fill `error` and return
+// nonzero to stop all workers.
+typedef int (*tjson_ndjson_callback)(void* context,
+                                     const struct tjson_NdjsonRecord* record,
+                                     struct tjson_Error* error);
+
+// Parse every line of `source` and call `callback` with each record. `opts`
+// may be NULL for the defaults. Return the number of records (documents and
+// lines which failed to parse), or -1 if a thread could not be started or the
+// callback stopped the run, in which case `error` is filled. In unordered
+// mode, callbacks already running on other workers are allowed to finish
+// after one of them asks to stop.
+int64_t tjson_parse_ndjson(struct tjson_StringPiece source,
+                           const struct tjson_NdjsonOpts* opts,
+                           tjson_ndjson_callback callback, void* context,
+                           struct tjson_Error* error);
+
+#if __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,113 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Compare number conversion through tjson_Number against the libc routines
+// on a large array of numbers.
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/parse.h"
+#include "tangent/tjson/tjson.h"
+
+static void report(const char* name, size_t count, uint64_t elapsed_ns) {
+  printf("%-24s %8.1f ns/number %8.1f M/s\n", name,
+         static_cast<double>(elapsed_ns) / count,
+         count / (elapsed_ns * 1e-9) / 1e6);
+}
+
+// Lex the whole document and return the numeric tokens
+static std::vector<tjson_Token> lex_numbers(const std::string& document) {
+  tjson_Scanner scanner;
+  tjson_Error error{};
+  tjson_Scanner_init(&scanner, &error);
+  tjson_Scanner_begin(
+      &scanner,
+      tjson_StringPiece{document.data(), document.data() + document.size()},
+      &error);
+  std::vector<tjson_Token> tokens;
+  tjson_Token token;
+  uint64_t begin = now_ns();
+  while (tjson_Scanner_pump(&scanner, &token, &error) == 0) {
+    if (token.typeno == TJSON_NUMERIC_LITERAL) {
+      tokens.push_back(token);
+    }
+  }
+  report("lex", tokens.size(), now_ns() - begin);
+  if (error.code != TJSON_LEX_INPUT_FINISHED) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+  return tokens;
+}
+
+int main(int argc, char** argv) {
+  size_t count = 1000000;
+  if (argc > 1) {
+    count = strtoul(argv[1], nullptr, 10);
+  }
+
+  std::mt19937_64 rng(1234);
+  std::uniform_real_distribution<double> real_dist(-1e6, 1e6);
+  std::uniform_int_distribution<int64_t> int_dist(-1000000000000,
+                                                  1000000000000);
+  char buf[64];
+
+  std::string doubles = "[";
+  std::string integers = "[";
+  for (size_t idx = 0; idx < count; idx++) {
+    snprintf(buf, sizeof(buf), "%s%.17g", idx ? "," : "", real_dist(rng));
+    doubles += buf;
+    snprintf(buf, sizeof(buf), "%s%lld", idx ? "," : "",
+             static_cast<long long>(int_dist(rng)));
+    integers += buf;
+  }
+  doubles += "]";
+  integers += "]";
+
+  tjson_Error error{};
+  std::vector<tjson_Token> tokens = lex_numbers(doubles);
+  double sum = 0;
+  uint64_t begin = now_ns();
+  for (const tjson_Token& token : tokens) {
+    sum += strtod(token.spelling.begin, nullptr);
+  }
+  report("strtod", tokens.size(), now_ns() - begin);
+
+  double check = 0;
+  begin = now_ns();
+  for (const tjson_Token& token : tokens) {
+    double value;
+    tjson_parse_value_double(&token, &value, &error);
+    check += value;
+  }
+  report("tjson_parse_value_double", tokens.size(), now_ns() - begin);
+  if (sum != check) {
+    fprintf(stderr, "sum mismatch: %.17g != %.17g\n", sum, check);
+    return 1;
+  }
+
+  tokens = lex_numbers(integers);
+  int64_t isum = 0;
+  begin = now_ns();
+  for (const tjson_Token& token : tokens) {
+    isum += strtoll(token.spelling.begin, nullptr, 0);
+  }
+  report("strtoll", tokens.size(), now_ns() - begin);
+
+  int64_t icheck = 0;
+  begin = now_ns();
+  for (const tjson_Token& token : tokens) {
+    int64_t value;
+    tjson_parse_value_int64(&token, &value, &error);
+    icheck += value;
+  }
+  report("tjson_parse_value_int64", tokens.size(), now_ns() - begin);
+  if (isum != icheck) {
+    fprintf(stderr, "sum mismatch: %lld != %lld\n",
+            static_cast<long long>(isum), static_cast<long long>(icheck));
+    return 1;
+  }
+  return 0;
+}
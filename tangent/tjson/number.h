@@ -0,0 +1,87 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Number
+// -----------------------------------------------------------------------------
+// A JSON number literal decomposed into its parts. The grammar is the one
+// from RFC 8259:
+//
+//   number = [ "-" ] int [ frac ] [ exp ]
+//   int = "0" / ( digit1-9 *DIGIT )
+//   frac = "." 1*DIGIT
+//   exp = ( "e" / "E" ) [ "-" / "+" ] 1*DIGIT
+//
+// The value of the number is `mantissa * 10^exponent` (negated if `negative`)
+// unless `truncated` is set, in which case the literal has more than 19
+// significant digits and `mantissa` holds only the first 19 of them.
+
+typedef struct tjson_Number {
+  struct tjson_StringPiece integer;   //< digits of the integer part
+  struct tjson_StringPiece fraction;  //< digits after the '.', maybe empty
+  struct tjson_StringPiece exponent_digits;  //< digits after the 'e', maybe
+                                             //  empty
+
+  uint64_t mantissa;  //< significant decimal digits (at most 19)
+  int64_t exponent;   //< decimal exponent of the least significant digit
+  int8_t negative;    //< literal begins with '-'
+  int8_t truncated;   //< there were more than 19 significant digits
+} tjson_Number;
+
+// Match a JSON number literal at the beginning of `source` and return a
+// pointer to the first character after it. Return NULL if `source` does not
+// begin with a valid number. This only validates the grammar, it does not
+// compute the value.
+const char* tjson_match_number(struct tjson_StringPiece source);
+
+// Match a number as tjson_match_number() does, and also store the offsets
+// from `source.begin` where its integer part and its fraction end. The
+// scanner records these on the token.
+const char* tjson_match_number_parts(struct tjson_StringPiece source,
+                                     uint32_t* int_end, uint32_t* frac_end);
+
+// Match a JSON number literal at the beginning of `source`, record the spans
+// of its components in `number` and accumulate its decimal mantissa and
+// exponent, all in a single pass. Return a pointer to the first character
+// after the number, or NULL if `source` does not begin with a valid number.
+const char* tjson_parse_number(struct tjson_StringPiece source,
+                               struct tjson_Number* number);
+
+// Decompose a numeric token. If the scanner recorded the parts of the number
+// on the token, the grammar was already validated when it was lexed and the
+// digits are only accumulated. Otherwise the spelling is parsed with
+// tjson_parse_number(). Return 0 on success, or -1 if the token is not a
+// valid number.
+int tjson_Number_from_token(const struct tjson_Token* token,
+                            struct tjson_Number* number);
+
+// Convert the number to the nearest double (or float), rounding ties to
+// even. This is exact: the Clinger fast path is used when the mantissa and
+// exponent are small enough, otherwise the Eisel-Lemire algorithm, and in
+// the rare case that neither can decide the rounding it compares all of the
+// digits with the halfway point using big integer arithmetic. The conversion
+// does not depend on the locale and does not allocate. Values too large for
+// the type are converted to infinity.
+double tjson_Number_to_double(const struct tjson_Number* number);
+float tjson_Number_to_float(const struct tjson_Number* number);
+
+// Convert the number to an integer. Numbers with a fraction or exponent are
+// accepted if their value is integral. Return 0 on success, or fill `error`
+// and return -1 if the number is not integral or is out of range for the
+// type.
+int tjson_Number_to_uint64(const struct tjson_Number* number, uint64_t* value,
+                           struct tjson_Error* error);
+int tjson_Number_to_int64(const struct tjson_Number* number, int64_t* value,
+                          struct tjson_Error* error);
+
+#if __cplusplus
+}  // extern "C"
+#endif
@@ -1,13 +1,19 @@
 #pragma once
 // Copyright 2021 Josh Bialkowski <josh.bialkowski@gmail.com>
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <list>
 #include <sstream>
 #include <vector>
 
+#include "tangent/tjson/emit.h"
 #include "tangent/tjson/tjson.h"
 #include "tangent/util/exception.h"
 #include "tangent/util/fallthrough.h"
@@ -17,37 +23,125 @@ namespace tjson {
 enum StackTypeNo { OBJECT = 0, LIST, FIELD };
 
 struct StackElement {
+  StackElement() : typeno{OBJECT}, child_count{0} {}
   explicit StackElement(StackTypeNo typeno) : typeno{typeno}, child_count{0} {}
 
   StackTypeNo typeno;
   int child_count;
 };
 
+// Each open group takes one stack element, and so does each field whose value
+// is being written, so this is enough for any document that the parser will
+// accept.
+#define TJSON_OSTREAM_STACK_CAPACITY (2 * TJSON_GROUP_STACK_CAPACITY)
+
+// Size of the staging buffer used when writing through to a std::ostream
+#define TJSON_OSTREAM_STAGE_SIZE 4096
+
+// Usage errors (e.g. a value where a fieldname is expected) are only checked
+// in debug builds. Those which would index outside of the stack (exceeding its
+// capacity, or writing or closing a value when nothing is open) are always
+// checked.
+#ifdef NDEBUG
+#define TJSON_OSTREAM_ASSERT(...) \
+  while (false) TANGENT_ASSERT(__VA_ARGS__)
+#else
+#define TJSON_OSTREAM_ASSERT(...) TANGENT_ASSERT(__VA_ARGS__)
+#endif
+
+// Writes JSON text one event at a time. The text is formatted with the
+// tjson_emit_* functions directly into a contiguous buffer which is one of:
+//
+//  * a staging buffer which is passed to a std::ostream whenever it fills,
+//    when the root value is closed, and on destruction
+//  * an internal buffer which grows as needed, and whose content is available
+//    with data()/size()/str() or can be written to a file descriptor with
+//    flush()
+//  * a caller-supplied tjson_WriteBuffer, in which case nothing is allocated.
+//    Output which doesn't fit is dropped and counted in its `overflow`.
 class OStream {
  public:
   OStream(std::ostream* out, const tjson_SerializeOpts& opts)
-      : out_{out}, opts_{opts} {}
+      : out_{out}, opts_{opts}, storage_(TJSON_OSTREAM_STAGE_SIZE) {
+    init_separators();
+    reset_storage();
+  }
+
+  explicit OStream(const tjson_SerializeOpts& opts = tjson_DefaultOpts)
+      : out_{nullptr}, opts_{opts}, storage_(TJSON_OSTREAM_STAGE_SIZE) {
+    init_separators();
+    reset_storage();
+  }
+
+  OStream(tjson_WriteBuffer* buf, const tjson_SerializeOpts& opts)
+      : out_{nullptr}, opts_{opts}, buf_{buf}, base_{buf->begin} {
+    init_separators();
+  }
+
+  OStream(const OStream&) = delete;
+  OStream& operator=(const OStream&) = delete;
+
+  ~OStream() {
+    drain();
+  }
+
+  // Content written so far (and not yet flushed, or passed to the ostream)
+  const char* data() const {
+    return base_;
+  }
+
+  size_t size() const {
+    return buf_->begin - base_;
+  }
+
+  std::string str() const {
+    return std::string(base_, size());
+  }
+
+  // Write the buffered content to `fd`, typically with a single write, and
+  // empty the buffer. Return zero on success, or -1 if the write failed, in
+  // which case errno is set and the buffer holds only the content which was
+  // not written, so that a retry continues where this one stopped.
+  int flush(int fd) {
+    const char* ptr = base_;
+    int result = 0;
+    while (ptr < buf_->begin) {
+      ssize_t nwritten = ::write(fd, ptr, buf_->begin - ptr);
+      if (nwritten < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        result = -1;
+        break;
+      }
+      ptr += nwritten;
+    }
+    size_t unwritten = buf_->begin - ptr;
+    memmove(base_, ptr, unwritten);
+    buf_->begin = base_ + unwritten;
+    return result;
+  }
 
   void endif_field() {
-    if (event_stack_.size() && event_stack_.back().typeno == FIELD) {
-      event_stack_.pop_back();
+    if (depth_ && stack_[depth_ - 1].typeno == FIELD) {
+      depth_--;
     }
   }
 
   void begin(StackTypeNo typeno) {
-    TANGENT_ASSERT(!event_stack_.size() || event_stack_.back().typeno != OBJECT)
+    TJSON_OSTREAM_ASSERT(!depth_ || stack_[depth_ - 1].typeno != OBJECT)
         << "Attempt to write a JSON value (type " << typeno
         << ") but a fieldname is expected";
-    if (event_stack_.size()) {
+    if (depth_) {
       preprocess_value(false);
     }
-    event_stack_.emplace_back(typeno);
+    push(typeno);
     switch (typeno) {
       case OBJECT:
-        (*out_) << "{";
+        put('{');
         break;
       case LIST:
-        (*out_) << "[";
+        put('[');
         break;
       default:
         break;
@@ -55,27 +149,27 @@ class OStream {
   }
 
   void end(StackTypeNo typeno) {
-    TANGENT_ASSERT(event_stack_.size())
-        << "Attempt to close a JSON value of type " << typeno
-        << " but there isn't anything open";
+    if (__builtin_expect(!depth_, 0)) {
+      TANGENT_THROW() << "Attempt to close a JSON value of type " << typeno
+                      << " but there isn't anything open";
+    }
 
-    TANGENT_ASSERT(event_stack_.back().typeno == typeno)
+    TJSON_OSTREAM_ASSERT(stack_[depth_ - 1].typeno == typeno)
         << "Attempt to close a JSON value of type " << typeno
-        << " but the current value is of type " << event_stack_.back().typeno;
+        << " but the current value is of type " << stack_[depth_ - 1].typeno;
 
-    auto child_count = event_stack_.back().child_count;
-    event_stack_.pop_back();
+    auto child_count = stack_[depth_ - 1].child_count;
+    depth_--;
     if (child_count > 0 && opts_.indent) {
-      (*out_) << "\n";
-      write_indent(/*fudge=*/0);
+      write_newline_indent(/*fudge=*/0);
     }
 
     switch (typeno) {
       case OBJECT:
-        (*out_) << "}";
+        put('}');
         break;
       case LIST:
-        (*out_) << "]";
+        put(']');
         break;
       default:
         break;
@@ -83,46 +177,57 @@ class OStream {
     // we just finished writing an object or list which was the value of a
     // field, so we are also finished with that field
     endif_field();
-    if (event_stack_.size()) {
-      event_stack_.back().child_count++;
+    if (depth_) {
+      stack_[depth_ - 1].child_count++;
     } else {
       // this is the terminal of the root object, so let's add a newline to
       // the end of the "document".
-      (*out_) << "\n";
+      put('\n');
+      drain();
     }
   }
 
   void write_indent(int fudge = 1) {
-    for (size_t idx = 0; idx < opts_.indent * (event_stack_.size() + fudge);
-         idx++) {
-      (*out_) << ' ';
+    size_t size = opts_.indent * (depth_ + fudge);
+    char* ptr = reserve(size);
+    if (ptr) {
+      memset(ptr, ' ', size);
+    }
+  }
+
+  // Newline and indent are reserved together and written with one memset
+  void write_newline_indent(int fudge = 1) {
+    size_t size = opts_.indent * (depth_ + fudge);
+    char* ptr = reserve(size + 1);
+    if (ptr) {
+      ptr[0] = '\n';
+      memset(ptr + 1, ' ', size);
     }
   }
 
   void preprocess_value(bool is_string = false) {
-    TANGENT_ASSERT(event_stack_.size())
-        << "Emit value but there is no open object";
-    switch (event_stack_.back().typeno) {
+    if (__builtin_expect(!depth_, 0)) {
+      TANGENT_THROW() << "Emit value but there is no open object";
+    }
+    StackElement& top = stack_[depth_ - 1];
+    switch (top.typeno) {
       case OBJECT:
-        TANGENT_ASSERT(is_string) << "Emit value but expected a fieldname";
+        TJSON_OSTREAM_ASSERT(is_string)
+            << "Emit value but expected a fieldname";
         // this is a field name
         TANGENT_FALLTHROUGH
 
       case LIST:
         // this is a string value in a list
-        if (event_stack_.back().child_count > 0) {
-          (*out_) << opts_.separators[1];
-          if (opts_.indent) {
-            (*out_) << "\n";
-          } else {
-            (*out_) << " ";
-          }
-        } else {
-          if (opts_.indent) {
-            (*out_) << "\n";
+        if (top.child_count > 0) {
+          put(opts_.separators[1], separator_size_[1]);
+          if (!opts_.indent) {
+            put(' ');
           }
         }
-        write_indent();
+        if (opts_.indent) {
+          write_newline_indent();
+        }
         break;
 
       case FIELD:
@@ -131,60 +236,202 @@ class OStream {
     }
   }
 
-  void write_string(const char* value) {
+  template <class StringT>
+  void write_string(const StringT& value) {
     preprocess_value(true);
-    (*out_) << '"' << value << '"';
+    emit(value);
 
-    if (event_stack_.back().typeno == OBJECT) {
-      (*out_) << opts_.separators[0];
-      event_stack_.emplace_back(FIELD);
+    if (stack_[depth_ - 1].typeno == OBJECT) {
+      put(opts_.separators[0], separator_size_[0]);
+      push(FIELD);
     } else {
       endif_field();
-      event_stack_.back().child_count++;
+      stack_[depth_ - 1].child_count++;
     }
   }
 
-  void write_string(const std::string& value) {
-    write_string(value.c_str());
-  }
-
   template <class T>
   void write_numeric(T value) {
     preprocess_value();
-    (*out_) << value;
+    emit(value);
     endif_field();
-    event_stack_.back().child_count++;
-  }
-
-  void write_numeric(int8_t value) {
-    write_numeric(static_cast<int>(value));
-  }
-
-  void write_numeric(uint8_t value) {
-    write_numeric(static_cast<unsigned int>(value));
+    stack_[depth_ - 1].child_count++;
   }
 
   void write_boolean(bool value) {
     preprocess_value();
     if (value) {
-      (*out_) << "true";
+      put("true", 4);
     } else {
-      (*out_) << "false";
+      put("false", 5);
     }
     endif_field();
-    event_stack_.back().child_count++;
+    stack_[depth_ - 1].child_count++;
   }
 
   void write_null() {
     preprocess_value();
-    (*out_) << "null";
+    put("null", 4);
     endif_field();
+    stack_[depth_ - 1].child_count++;
   }
 
  protected:
+  void init_separators() {
+    for (int idx = 0; idx < 2; idx++) {
+      separator_size_[idx] = strnlen(opts_.separators[idx], 3);
+    }
+  }
+
+  void reset_storage() {
+    tjson_WriteBuffer_init(&stage_, storage_.data(),
+                           storage_.data() + storage_.size());
+    buf_ = &stage_;
+    base_ = stage_.begin;
+  }
+
+  void push(StackTypeNo typeno) {
+    TANGENT_ASSERT(depth_ < TJSON_OSTREAM_STACK_CAPACITY)
+        << "JSON output is nested too deeply";
+    stack_[depth_++] = StackElement{typeno};
+  }
+
+  // Pass staged content to the ostream, if there is one
+  void drain() {
+    if (out_ && buf_->begin > base_) {
+      out_->write(base_, buf_->begin - base_);
+      buf_->begin = base_;
+    }
+  }
+
+  // Return `size` contiguous bytes at the end of the buffer. If the output
+  // is going to a tjson_WriteBuffer which is too full, count them as overflow
+  // and return NULL.
+  char* reserve(size_t size) {
+    if (__builtin_expect(
+            !buf_->overflow &&
+                static_cast<size_t>(buf_->end - buf_->begin) >= size,
+            1)) {
+      char* ptr = buf_->begin;
+      buf_->begin += size;
+      return ptr;
+    }
+    if (!make_room(size)) {
+      buf_->overflow += size;
+      return nullptr;
+    }
+    char* ptr = buf_->begin;
+    buf_->begin += size;
+    return ptr;
+  }
+
+  // Ensure at least `size` free bytes, either by draining the stage to the
+  // ostream or by growing the internal buffer. Return false if the output is
+  // going to a fixed tjson_WriteBuffer.
+  bool make_room(size_t size) {
+    if (buf_ != &stage_) {
+      return false;
+    }
+    drain();
+    size_t used = stage_.begin - base_;
+    if (static_cast<size_t>(stage_.end - stage_.begin) >= size) {
+      return true;
+    }
+    storage_.resize(std::max(2 * storage_.size(), used + size));
+    reset_storage();
+    stage_.begin += used;
+    return true;
+  }
+
+  void put(char value) {
+    char* ptr = reserve(1);
+    if (ptr) {
+      *ptr = value;
+    }
+  }
+
+  void put(const char* data, size_t size) {
+    char* ptr = reserve(size);
+    if (ptr) {
+      memcpy(ptr, data, size);
+    }
+  }
+
+  // The tjson_emit_* functions write a value entirely or not at all, so when
+  // a value doesn't fit we can make room for `overflow` bytes and try again.
+  template <class T>
+  void emit(const T& value) {
+    emit_value(buf_, value);
+    if (__builtin_expect(buf_->overflow != 0, 0) && buf_ == &stage_) {
+      size_t size = stage_.overflow;
+      stage_.overflow = 0;
+      make_room(size);
+      emit_value(buf_, value);
+    }
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, const char* value) {
+    tjson_emit_string(buf, value);
+  }
+
+  template <class Traits, class Allocator>
+  static void emit_value(
+      tjson_WriteBuffer* buf,
+      const std::basic_string<char, Traits, Allocator>& value) {
+    tjson_emit_charbuf(buf, value.data(), value.data() + value.size());
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, uint8_t value) {
+    tjson_emit_uint8(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, uint16_t value) {
+    tjson_emit_uint16(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, uint32_t value) {
+    tjson_emit_uint32(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, uint64_t value) {
+    tjson_emit_uint64(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, int8_t value) {
+    tjson_emit_int8(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, int16_t value) {
+    tjson_emit_int16(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, int32_t value) {
+    tjson_emit_int32(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, int64_t value) {
+    tjson_emit_int64(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, float value) {
+    tjson_emit_float(buf, value);
+  }
+
+  static void emit_value(tjson_WriteBuffer* buf, double value) {
+    tjson_emit_double(buf, value);
+  }
+
   std::ostream* out_;
   tjson_SerializeOpts opts_;
-  std::vector<StackElement> event_stack_;
+  size_t separator_size_[2];
+
+  std::vector<char> storage_;
+  tjson_WriteBuffer stage_;
+  tjson_WriteBuffer* buf_;  //< either &stage_ or the caller's buffer
+  char* base_;              //< where the output begins in *buf_
+
+  StackElement stack_[TJSON_OSTREAM_STACK_CAPACITY];
+  uint32_t depth_{0};
 };
 
 class Guard {
@@ -207,7 +454,9 @@ inline OStream& operator<<(OStream& out, const char* str) {
   return out;
 }
 
-inline OStream& operator<<(OStream& out, const std::string& str) {
+template <class Traits, class Allocator>
+inline OStream& operator<<(
+    OStream& out, const std::basic_string<char, Traits, Allocator>& str) {
   out.write_string(str);
   return out;
 }
@@ -315,22 +564,11 @@ class OFStream : public OFStreamBase, public OStream {
   }
 };
 
-class OSStreamBase {
- public:
-  OSStreamBase() : real_strm_{} {}
-
- protected:
-  std::stringstream real_strm_{};
-};
-
-class OSStream : public OSStreamBase, public OStream {
+// Serialize to a string. This is just an OStream on its internal buffer.
+class OSStream : public OStream {
  public:
   explicit OSStream(const tjson_SerializeOpts& opts = tjson_DefaultOpts)
-      : OStream{&real_strm_, opts} {}
-
-  std::string str() {
-    return real_strm_.str();
-  }
+      : OStream{opts} {}
 };
 
 }  // namespace tjson
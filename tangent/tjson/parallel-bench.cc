@@ -0,0 +1,71 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure parsing a synthetic document holding one large list of records on
+// every number of threads from one up to the number of cores, and compare
+// against a sequential parse.
+//
+//   parallel-bench [size_mb [max_threads]]
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/parallel.h"
+#include "tangent/tjson/tjson.h"
+
+// Nested lists of objects give the chunk boundary guesses something to get
+// wrong
+static const char kChildren[] = ", \"children\": [{\"a\": 1}, {\"b\": 2}]";
+
+static int count_events(void* context, const tjson_ArrayItem* item,
+                        tjson_Error* /*error*/) {
+  *static_cast<uint64_t*>(context) += item->nevents;
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  size_t size_mb = 64;
+  if (argc > 1) {
+    size_mb = strtoul(argv[1], nullptr, 10);
+  }
+  uint32_t max_threads = std::max(1U, std::thread::hardware_concurrency());
+  if (argc > 2) {
+    max_threads = strtoul(argv[2], nullptr, 10);
+  }
+  std::string document = make_record_list(size_mb * 1024 * 1024, kChildren);
+  tjson_StringPiece source{document.data(), document.data() + document.size()};
+
+  tjson_Error error{};
+  uint64_t begin = now_ns();
+  int nevents = tjson_parse(source, nullptr, 0, &error);
+  report_throughput("sequential", document.size(), now_ns() - begin);
+  if (nevents < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+
+  for (uint32_t nthreads = 1; nthreads <= max_threads; nthreads++) {
+    tjson_ParallelOpts opts{};
+    opts.nthreads = nthreads;
+    uint64_t count = 0;
+    begin = now_ns();
+    int64_t nitems = tjson_parse_array_parallel(source, &opts, count_events,
+                                                &count, &error);
+    uint64_t elapsed_ns = now_ns() - begin;
+    if (nitems < 0) {
+      fprintf(stderr, "%s\n", error.msg);
+      return 1;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "parallel x%u", nthreads);
+    report_throughput(name, document.size(), elapsed_ns);
+    if (count + 2 != static_cast<uint64_t>(nevents)) {
+      fprintf(stderr, "Expected %d events but got %llu\n", nevents - 2,
+              static_cast<unsigned long long>(count));
+      return 1;
+    }
+  }
+  printf("%zu bytes, %d events\n", document.size(), nevents);
+  return 0;
+}
@@ -0,0 +1,467 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tangent/tjson/workpool.h"
+
+// A range of the list body which is parsed by one worker
+struct Chunk {
+  const char* begin;  //< guessed beginning of the first item
+  const char* limit;  //< guessed beginning of the next chunk, or end of body
+};
+
+// State shared by all workers
+struct Pool {
+  struct tjson_StringPiece source;
+  const char* body_end;  //< the closing bracket of the root list
+  tjson_array_callback callback;
+  void* context;
+
+  struct tjson_WorkPool work;
+  struct Chunk* chunks;
+
+  // Only accessed by the worker whose turn it is to deliver
+  const char* expected;  //< true beginning of the next item, or `body_end`
+  uint64_t nitems;       //< number of items delivered
+};
+
+// An item whose events are buffered until its chunk is delivered
+struct PendingItem {
+  struct tjson_StringPiece span;
+  uint64_t events_begin;
+  uint32_t nevents;
+};
+
+struct Worker {
+  struct Pool* pool;
+  uint32_t index;
+  struct tjson_LexerParser stream;
+
+  struct tjson_Event* events;
+  uint64_t nevents;
+  uint64_t events_capacity;
+
+  struct PendingItem* items;
+  uint64_t nitems;
+  uint64_t items_capacity;
+};
+
+static inline int8_t is_whitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char* skip_whitespace(const char* ptr, const char* end) {
+  while (ptr < end && is_whitespace(*ptr)) {
+    ptr++;
+  }
+  return ptr;
+}
+
+// Fill the line and column of `ptr` within the source
+static void locate(struct tjson_StringPiece source, const char* ptr,
+                   struct tjson_SourceLocation* loc) {
+  const char* line = source.begin;
+  uint32_t lineno = 0;
+  for (const char* newline;
+       (newline = memchr(line, '\n', ptr - line)) != NULL;
+       line = newline + 1) {
+    lineno++;
+  }
+  loc->lineno = lineno;
+  loc->colno = (uint32_t)(ptr - line);
+  loc->offset = (uint32_t)(ptr - source.begin);
+}
+
+// -----------------------------------------------------------------------------
+//    Split
+// -----------------------------------------------------------------------------
+
+// Return true if `c` can begin an item of the same kind as one beginning with
+// `first`
+static int8_t looks_like_begin(char c, char first) {
+  switch (first) {
+    case '{':
+    case '[':
+    case '"':
+      return c == first;
+    case 't':
+    case 'f':
+    case 'n':
+      return c == 't' || c == 'f' || c == 'n';
+    default:
+      return c == '-' || ('0' <= c && c <= '9');
+  }
+}
+
+// Return true if `c` can end an item of the same kind as one beginning with
+// `first`
+static int8_t looks_like_end(char c, char first) {
+  switch (first) {
+    case '{':
+      return c == '}';
+    case '[':
+      return c == ']';
+    case '"':
+      return c == '"';
+    case 't':
+    case 'f':
+    case 'n':
+      return c == 'e' || c == 'l';
+    default:
+      return '0' <= c && c <= '9';
+  }
+}
+
+// Guess the beginning of an item in [begin, end): the first comma between a
+// value which looks like the end of an item and one which looks like the
+// beginning of an item. Return NULL if there is no such comma.
+static const char* guess_boundary(const char* body_begin,
+                                  const char* body_end, const char* begin,
+                                  const char* end, char first) {
+  for (const char* comma = begin;
+       (comma = memchr(comma, ',', end - comma)) != NULL; comma++) {
+    const char* prev = comma - 1;
+    while (prev > body_begin && is_whitespace(*prev)) {
+      prev--;
+    }
+    const char* next = skip_whitespace(comma + 1, body_end);
+    if (next < body_end && looks_like_end(*prev, first) &&
+        looks_like_begin(*next, first)) {
+      return next;
+    }
+  }
+  return NULL;
+}
+
+// Cut the body of the list into chunks, each beginning at a guessed item
+// boundary. Return the number of chunks.
+static uint64_t split_chunks(const char* first, const char* body_end,
+                             uint32_t chunk_size, struct Chunk* chunks) {
+  if (first >= body_end) {
+    return 0;
+  }
+  uint64_t nchunks = 0;
+  chunks[nchunks++].begin = first;
+  for (const char* cut = first + chunk_size; cut < body_end;
+       cut += chunk_size) {
+    const char* end =
+        (body_end - cut > chunk_size) ? cut + chunk_size : body_end;
+    const char* guess = guess_boundary(first, body_end, cut, end, *first);
+    if (guess) {
+      chunks[nchunks++].begin = guess;
+    }
+  }
+  for (uint64_t idx = 0; idx + 1 < nchunks; idx++) {
+    chunks[idx].limit = chunks[idx + 1].begin;
+  }
+  chunks[nchunks - 1].limit = body_end;
+  return nchunks;
+}
+
+// -----------------------------------------------------------------------------
+//    Parse
+// -----------------------------------------------------------------------------
+
+// Parse the item at `begin`, appending its events to the worker's event
+// buffer. Fill `span` with the text of the item and `next` with the
+// beginning of the following item (or the end of the body). Return 0 on
+// success, -1 if the item fails to parse (in which case `error` is filled) or
+// -2 if the event buffer can't be grown.
+static int parse_item(struct Worker* worker, const char* begin,
+                      struct tjson_StringPiece* span, const char** next,
+                      struct tjson_Error* error) {
+  struct Pool* pool = worker->pool;
+  struct tjson_LexerParser* stream = &worker->stream;
+  struct tjson_StringPiece rest = {begin, pool->body_end};
+  if (tjson_LexerParser_begin(stream, rest, error)) {
+    return -1;
+  }
+
+  int32_t depth = 0;
+  do {
+    if (tjson_reserve((void**)&worker->events, &worker->events_capacity,
+                      worker->nevents + 1, sizeof(struct tjson_Event))) {
+      return -2;
+    }
+    struct tjson_Event* event = &worker->events[worker->nevents];
+    if (tjson_LexerParser_get_next_event(stream, event, error)) {
+      const char* error_ptr = begin + error->loc.offset;
+      if (error->code == TJSON_LEX_INPUT_FINISHED) {
+        error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+        snprintf(error->msg, sizeof(error->msg),
+                 "The list ends inside of an item");
+        error_ptr = pool->body_end;
+      }
+      locate(pool->source, error_ptr, &error->loc);
+      return -1;
+    }
+    worker->nevents++;
+    switch (event->typeno) {
+      case TJSON_OBJECT_BEGIN:
+      case TJSON_LIST_BEGIN:
+        depth++;
+        break;
+      case TJSON_OBJECT_END:
+      case TJSON_LIST_END:
+        depth--;
+        break;
+      default:
+        break;
+    }
+  } while (depth > 0);
+
+  span->begin = begin;
+  span->end = worker->events[worker->nevents - 1].token.spelling.end;
+
+  const char* ptr = skip_whitespace(span->end, pool->body_end);
+  if (ptr < pool->body_end) {
+    if (*ptr != ',') {
+      error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+      snprintf(error->msg, sizeof(error->msg),
+               "Expected ',' or ']' after a list item but got '%c'", *ptr);
+      locate(pool->source, ptr, &error->loc);
+      return -1;
+    }
+    ptr = skip_whitespace(ptr + 1, pool->body_end);
+    if (ptr == pool->body_end) {
+      error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+      snprintf(error->msg, sizeof(error->msg),
+               "Expected a list item after ',' but got ']'");
+      locate(pool->source, ptr, &error->loc);
+      return -1;
+    }
+  }
+  *next = ptr;
+  return 0;
+}
+
+static int deliver(struct Pool* pool, struct tjson_StringPiece span,
+                   const struct tjson_Event* events, uint32_t nevents) {
+  struct tjson_ArrayItem item;
+  item.index = pool->nitems++;
+  item.span = span;
+  item.events = events;
+  item.nevents = nevents;
+
+  struct tjson_Error error;
+  memset(&error, 0, sizeof(error));
+  if (pool->callback(pool->context, &item, &error)) {
+    tjson_WorkPool_stop(&pool->work, &error);
+    return -1;
+  }
+  return 0;
+}
+
+// Parse and deliver items from the true boundary `pool->expected` until
+// reaching the limit of the chunk
+static void parse_sequential(struct Worker* worker, const struct Chunk* chunk) {
+  struct Pool* pool = worker->pool;
+  const char* ptr = pool->expected;
+  struct tjson_Error error;
+  while (ptr < chunk->limit && !tjson_WorkPool_stopped(&pool->work)) {
+    worker->nevents = 0;
+    struct tjson_StringPiece span;
+    const char* next = NULL;
+    int result = parse_item(worker, ptr, &span, &next, &error);
+    if (result == -2) {
+      tjson_WorkPool_out_of_memory(&pool->work, worker->index);
+      return;
+    }
+    if (result) {
+      tjson_WorkPool_stop(&pool->work, &error);
+      return;
+    }
+    if (deliver(pool, span, worker->events, (uint32_t)worker->nevents)) {
+      return;
+    }
+    ptr = next;
+  }
+  pool->expected = ptr;
+}
+
+// Speculatively parse every item of the chunk into the worker's buffers, then
+// wait until all preceding chunks are delivered and either deliver the
+// buffered items, if the chunk began where the preceding one ended, or parse
+// the chunk again from where it ended. If the preceding chunks are already
+// delivered, parse and deliver the items as we go.
+static void parse_chunk(struct Worker* worker, const struct Chunk* chunk,
+                        uint64_t chunk_index) {
+  struct Pool* pool = worker->pool;
+  worker->nevents = 0;
+  worker->nitems = 0;
+
+  // If it is already this chunk's turn there is nothing to speculate about
+  int8_t is_turn = tjson_WorkPool_is_turn(&pool->work, chunk_index);
+
+  struct tjson_Error error;
+  int8_t failed = 0;
+  const char* ptr = chunk->begin;
+  while (!is_turn && ptr < chunk->limit &&
+         !tjson_WorkPool_stopped(&pool->work)) {
+    if (tjson_reserve((void**)&worker->items, &worker->items_capacity,
+                      worker->nitems + 1, sizeof(struct PendingItem))) {
+      tjson_WorkPool_out_of_memory(&pool->work, worker->index);
+      return;
+    }
+    struct PendingItem* item = &worker->items[worker->nitems];
+    item->events_begin = worker->nevents;
+    const char* next = NULL;
+    int result = parse_item(worker, ptr, &item->span, &next, &error);
+    if (result == -2) {
+      tjson_WorkPool_out_of_memory(&pool->work, worker->index);
+      return;
+    }
+    if (result) {
+      failed = 1;
+      break;
+    }
+    item->nevents = (uint32_t)(worker->nevents - item->events_begin);
+    worker->nitems++;
+    ptr = next;
+  }
+
+  tjson_WorkPool_wait_turn(&pool->work, chunk_index);
+  if (tjson_WorkPool_stopped(&pool->work)) {
+    return;
+  }
+
+  if (pool->expected == chunk->begin && !is_turn) {
+    for (uint64_t idx = 0; idx < worker->nitems; idx++) {
+      const struct PendingItem* item = &worker->items[idx];
+      if (deliver(pool, item->span, worker->events + item->events_begin,
+                  item->nevents)) {
+        return;
+      }
+    }
+    if (failed) {
+      // The chunk began at a true boundary so the error is real
+      tjson_WorkPool_stop(&pool->work, &error);
+      return;
+    }
+    pool->expected = ptr;
+  } else {
+    parse_sequential(worker, chunk);
+    if (tjson_WorkPool_stopped(&pool->work)) {
+      return;
+    }
+  }
+
+  tjson_WorkPool_end_turn(&pool->work);
+}
+
+// -----------------------------------------------------------------------------
+//    Workers
+// -----------------------------------------------------------------------------
+
+static void* run_worker(void* arg) {
+  struct Worker* worker = arg;
+  struct Pool* pool = worker->pool;
+  uint64_t chunk_index;
+  while (tjson_WorkPool_claim(&pool->work, &chunk_index)) {
+    parse_chunk(worker, &pool->chunks[chunk_index], chunk_index);
+  }
+  return NULL;
+}
+
+// Return the closing bracket of the root list, or fill `error` and return
+// NULL if the source is not a list
+static const char* find_body(struct tjson_StringPiece source,
+                             const char** body_begin,
+                             struct tjson_Error* error) {
+  const char* begin = skip_whitespace(source.begin, source.end);
+  const char* end = source.end;
+  while (end > begin && is_whitespace(end[-1])) {
+    end--;
+  }
+  if (begin == end || *begin != '[') {
+    error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+    snprintf(error->msg, sizeof(error->msg), "The document is not a list");
+    locate(source, begin, &error->loc);
+    return NULL;
+  }
+  if (end - begin < 2 || end[-1] != ']') {
+    error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+    snprintf(error->msg, sizeof(error->msg),
+             "The document does not end with ']'");
+    locate(source, end, &error->loc);
+    return NULL;
+  }
+  *body_begin = begin + 1;
+  return end - 1;
+}
+
+int64_t tjson_parse_array_parallel(struct tjson_StringPiece source,
+                                   const struct tjson_ParallelOpts* opts,
+                                   tjson_array_callback callback,
+                                   void* context, struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+
+  struct tjson_ParallelOpts default_opts;
+  memset(&default_opts, 0, sizeof(default_opts));
+  if (!opts) {
+    opts = &default_opts;
+  }
+  uint32_t chunk_size =
+      opts->chunk_size ? opts->chunk_size : TJSON_PARALLEL_DEFAULT_CHUNK_SIZE;
+  const char* body_begin = NULL;
+  const char* body_end = find_body(source, &body_begin, error);
+  if (!body_end) {
+    return -1;
+  }
+  const char* first = skip_whitespace(body_begin, body_end);
+
+  struct Pool pool;
+  memset(&pool, 0, sizeof(pool));
+  pool.source = source;
+  pool.body_end = body_end;
+  pool.callback = callback;
+  pool.context = context;
+  pool.expected = first;
+
+  uint64_t max_chunks = (uint64_t)(body_end - first) / chunk_size + 1;
+  uint32_t nthreads = tjson_WorkPool_get_nthreads(opts->nthreads, max_chunks);
+  pool.chunks = malloc(max_chunks * sizeof(struct Chunk));
+  struct Worker* workers = calloc(nthreads, sizeof(struct Worker));
+  if (!pool.chunks || !workers || tjson_WorkPool_init(&pool.work, nthreads)) {
+    free(pool.chunks);
+    free(workers);
+    memset(&error->loc, 0, sizeof(error->loc));
+    error->code = TJSON_PARSE_OOM;
+    snprintf(error->msg, sizeof(error->msg), "Failed to allocate %u workers",
+             nthreads);
+    return -1;
+  }
+  if (nthreads > 1) {
+    pool.work.nchunks = split_chunks(first, body_end, chunk_size, pool.chunks);
+  } else if (first < body_end) {
+    pool.chunks[0].begin = first;
+    pool.chunks[0].limit = body_end;
+    pool.work.nchunks = 1;
+  }
+
+  for (uint32_t idx = 0; idx < nthreads; idx++) {
+    workers[idx].pool = &pool;
+    workers[idx].index = idx;
+    tjson_LexerParser_init(&workers[idx].stream, error);
+  }
+
+  int failed = tjson_WorkPool_run(&pool.work, run_worker, workers,
+                                  sizeof(struct Worker));
+  if (failed) {
+    *error = pool.work.error;
+  }
+  for (uint32_t idx = 0; idx < nthreads; idx++) {
+    free(workers[idx].events);
+    free(workers[idx].items);
+  }
+  free(workers);
+  free(pool.chunks);
+  tjson_WorkPool_deinit(&pool.work);
+  return failed ? -1 : (int64_t)pool.nitems;
+}
@@ -0,0 +1,68 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Parallel Array
+// -----------------------------------------------------------------------------
+// Parse a document whose root is a large list on multiple threads.
+//
+// The body of the list is cut into chunks of roughly `chunk_size` bytes. The
+// beginning of each chunk is a guess: the first comma after the cut which
+// separates two values that look like the first item (e.g. `}, {` when the
+// first item is an object). Each chunk is then parsed on a pool of worker
+// threads, one item at a time, each worker with its own tjson_LexerParser.
+//
+// The chunks are delivered in order. When a chunk's turn comes, the guess is
+// checked against where the parse of the preceding chunk actually ended. If
+// the guess was wrong (e.g. the comma was inside a nested list or a string)
+// the speculative result of the chunk is discarded and the chunk is parsed
+// again, sequentially, from the true boundary.
+
+// `nthreads` and `chunk_size` are as in tjson_NdjsonOpts (see ndjson.h)
+typedef struct tjson_ParallelOpts {
+  uint32_t nthreads;
+  uint32_t chunk_size;
+} tjson_ParallelOpts;
+
+#define TJSON_PARALLEL_DEFAULT_CHUNK_SIZE (1024 * 1024)
+
+// An item of the root list
+typedef struct tjson_ArrayItem {
+  uint64_t index;  //< position of the item in the list
+
+  // Source text of the item
+  struct tjson_StringPiece span;
+
+  // Events of the item. Valid only for the duration of the callback, though
+  // the tokens refer to the source.
+  const struct tjson_Event* events;
+  uint32_t nevents;
+} tjson_ArrayItem;
+
+// Called for each item in order. Return zero to continue, or fill `error` and
+// return nonzero to stop.
+typedef int (*tjson_array_callback)(void* context,
+                                    const struct tjson_ArrayItem* item,
+                                    struct tjson_Error* error);
+
+// Parse `source`, which must hold a single list, and call `callback` with
+// each of its items in order. `opts` may be NULL for the defaults. Return the
+// number of items, or fill `error` and return -1 if the source fails to parse
+// or the callback stops. On a parse error only the items preceding the error
+// have been delivered.
+int64_t tjson_parse_array_parallel(struct tjson_StringPiece source,
+                                   const struct tjson_ParallelOpts* opts,
+                                   tjson_array_callback callback,
+                                   void* context, struct tjson_Error* error);
+
+#if __cplusplus
+}  // extern "C"
+#endif
@@ -1,8 +1,17 @@
 // Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
 #include "tangent/tjson/parse.h"
+#include "tangent/tjson/emit.h"
+#include "tangent/tjson/keytable.h"
+#include "tangent/tjson/number.h"
+#include "tangent/tjson/structural.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 // -----------------------------------------------------------------------------
 //    Util
@@ -16,110 +25,195 @@
 //              : stringhash(ptr + 1, ((hashv << 5) ^ (hashv >> 27)) ^ *ptr);
 // }
 
-/// Return true if the given character is a control code
-static int32_t is_control_code(char code) {
-  return ('\x00' <= code && code <= '\x1f');
-}
-
-struct CodePair {
-  char key;
-  char value;
-};
-
-/// Map control codes that have a JSON shortcode to their shortcode
-static const struct CodePair kEscapeMap[] = {
-    // clang-format off
-    {'"', '"'},
-    {'\\', '\\'},
-    {'\b', 'b'},
-    {'\f', 'f'},
-    {'\n', 'n'},
-    {'\r', 'r'},
-    {'\t', 't'},
-    {0, 0}
-    // clang-format on
-};
-
-static const struct CodePair* map_find_key(const struct CodePair* map,
-                                           char key) {
-  for (; map->key; map++) {
-    if (map->key == key) {
-      return map;
-    }
+ssize_t tjson_escape(const struct tjson_StringPiece input, char* begin,
+                     char* end) {
+  // NOTE(josh): leave room for a null terminator
+  struct tjson_WriteBuffer buf;
+  tjson_WriteBuffer_init(&buf, begin, begin < end ? end - 1 : begin);
+  tjson_emit_escaped(&buf, input.begin, input.end);
+  if (buf.overflow) {
+    return -1;
   }
-  return NULL;
+  return buf.begin - begin;
 }
 
-static const struct CodePair* map_find_value(const struct CodePair* map,
-                                             char value) {
-  for (; map->value; map++) {
-    if (map->value == value) {
-      return map;
+// Return the first backslash in [ptr, end), or `end`
+static const char* find_backslash(const char* ptr, const char* end) {
+#if defined(__AVX2__)
+  const __m256i backslash32 = _mm256_set1_epi8('\\');
+  for (; end - ptr >= 32; ptr += 32) {
+    __m256i chars = _mm256_loadu_si256((const __m256i*)ptr);
+    uint32_t mask =
+        (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, backslash32));
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
     }
   }
-  return NULL;
-}
-
-// adapted from: https://stackoverflow.com/a/33799784/141023
-ssize_t tjson_escape(const struct tjson_StringPiece input, char* begin,
-                     char* end) {
-  char* out = begin;
-  for (const char* ptr = input.begin; ptr != input.end; ptr++) {
-    const struct CodePair* pair = map_find_key(kEscapeMap, *ptr);
-    if (pair) {
-      if (out + 2 >= end) {
-        return -1;
-      }
-      (*out++) = '\\';
-      (*out++) = pair->value;
-    } else if (is_control_code(*ptr)) {
-      if (out + 6 >= end) {
-        return -1;
-      }
-      if (snprintf(out, end - out, "\\u%04x", (int)(*ptr)) != 6) {
-        return -1;
-      }
+#endif
+#if defined(__SSE2__)
+  const __m128i backslash = _mm_set1_epi8('\\');
+  for (; end - ptr >= 16; ptr += 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*)ptr);
+    uint32_t mask =
+        (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, backslash));
+    if (mask) {
+      return ptr + __builtin_ctz(mask);
+    }
+  }
+#endif
+  const char* found = memchr(ptr, '\\', end - ptr);
+  return found ? found : end;
+}
+
+// Parse the four hex digits of a `\uXXXX` escape at `ptr`. Return the code
+// unit, or -1 if they aren't all hex digits.
+static int32_t parse_hex4(const char* ptr) {
+  int32_t value = 0;
+  for (size_t idx = 0; idx < 4; idx++) {
+    char c = ptr[idx];
+    value <<= 4;
+    if ('0' <= c && c <= '9') {
+      value |= c - '0';
+    } else if ('a' <= c && c <= 'f') {
+      value |= c - 'a' + 10;
+    } else if ('A' <= c && c <= 'F') {
+      value |= c - 'A' + 10;
     } else {
-      if (out + 1 >= end) {
-        return -1;
-      }
-      (*out++) = *ptr;
+      return -1;
     }
   }
-
-  return 0;
+  return value;
+}
+
+// Write the UTF-8 encoding of `code` (at most U+10FFFF) to `out` and return
+// the number of bytes written
+static size_t encode_utf8(uint32_t code, char* out) {
+  if (code < 0x80) {
+    out[0] = (char)code;
+    return 1;
+  }
+  if (code < 0x800) {
+    out[0] = (char)(0xc0 | (code >> 6));
+    out[1] = (char)(0x80 | (code & 0x3f));
+    return 2;
+  }
+  if (code < 0x10000) {
+    out[0] = (char)(0xe0 | (code >> 12));
+    out[1] = (char)(0x80 | ((code >> 6) & 0x3f));
+    out[2] = (char)(0x80 | (code & 0x3f));
+    return 3;
+  }
+  out[0] = (char)(0xf0 | (code >> 18));
+  out[1] = (char)(0x80 | ((code >> 12) & 0x3f));
+  out[2] = (char)(0x80 | ((code >> 6) & 0x3f));
+  out[3] = (char)(0x80 | (code & 0x3f));
+  return 4;
+}
+
+// Decode the `\uXXXX` escape (and, for a surrogate pair, the one following
+// it) at `ptr` into the code point at `code`. Return the number of input
+// bytes consumed, or zero if the escape is malformed. An unpaired surrogate
+// decodes to U+FFFD.
+static size_t decode_unicode_escape(const char* ptr, const char* end,
+                                    uint32_t* code) {
+  if (end - ptr < 6) {
+    return 0;
+  }
+  int32_t unit = parse_hex4(ptr + 2);
+  if (unit < 0) {
+    return 0;
+  }
+  if (unit < 0xd800 || unit > 0xdfff) {
+    *code = (uint32_t)unit;
+    return 6;
+  }
+  if (unit < 0xdc00 && end - ptr >= 12 && ptr[6] == '\\' && ptr[7] == 'u') {
+    int32_t low = parse_hex4(ptr + 8);
+    if (0xdc00 <= low && low <= 0xdfff) {
+      *code = 0x10000 + (((uint32_t)unit - 0xd800) << 10) +
+              ((uint32_t)low - 0xdc00);
+      return 12;
+    }
+  }
+  *code = 0xfffd;
+  return 6;
 }
 
+// Runs of characters without a backslash are found 16 or 32 bytes at a time
+// and copied in bulk. Escapes other than those in the JSON grammar are copied
+// verbatim. The output is never longer than the input.
 ssize_t tjson_unescape(const struct tjson_StringPiece input, char* begin,
                        char* end) {
+  // NOTE(josh): leave room for a null terminator
+  if (begin >= end) {
+    return -1;
+  }
   char* out = begin;
-  for (const char* ptr = input.begin; ptr != input.end; ++ptr) {
-    if (out + 1 >= end) {
+  char* out_end = end - 1;
+  const char* ptr = input.begin;
+  while (ptr < input.end) {
+    const char* escape = find_backslash(ptr, input.end);
+    size_t run = escape - ptr;
+    if ((size_t)(out_end - out) < run) {
       return -1;
     }
-    if (ptr + 1 == input.end) {
-      (*out++) = *ptr;
-      continue;
+    memcpy(out, ptr, run);
+    out += run;
+    if (escape == input.end) {
+      break;
     }
-    if (ptr[0] == '\\') {
-      const struct CodePair* pair = map_find_value(kEscapeMap, ptr[1]);
-      if (pair) {
-        (*out++) = pair->key;
-        ptr++;
-      } else if (ptr[1] == 'u' && ptr + 5 < input.end) {
-        char buffer[5];
-        for (size_t idx = 0; idx < 4; idx++) {
-          buffer[idx] = ptr[idx + 2];
+
+    char decoded[4];
+    size_t ndecoded = 1;
+    size_t nconsumed = 2;
+    switch (escape + 1 < input.end ? escape[1] : '\0') {
+      case '"':
+        decoded[0] = '"';
+        break;
+      case '\\':
+        decoded[0] = '\\';
+        break;
+      case '/':
+        decoded[0] = '/';
+        break;
+      case 'b':
+        decoded[0] = '\b';
+        break;
+      case 'f':
+        decoded[0] = '\f';
+        break;
+      case 'n':
+        decoded[0] = '\n';
+        break;
+      case 'r':
+        decoded[0] = '\r';
+        break;
+      case 't':
+        decoded[0] = '\t';
+        break;
+      case 'u': {
+        uint32_t code = 0;
+        nconsumed = decode_unicode_escape(escape, input.end, &code);
+        if (nconsumed) {
+          ndecoded = encode_utf8(code, decoded);
+        } else {
+          decoded[0] = '\\';
+          nconsumed = 1;
         }
-        buffer[4] = '\0';
-        (*out++) = (char)strtol(buffer, NULL, 16);
-        ptr += 5;
-      } else {
-        (*out++) = *ptr;
+        break;
       }
-    } else {
-      (*out++) = *ptr;
+      default:
+        // Not a valid escape, keep the backslash and carry on after it
+        decoded[0] = '\\';
+        nconsumed = 1;
+        break;
+    }
+    if ((size_t)(out_end - out) < ndecoded) {
+      return -1;
     }
+    memcpy(out, decoded, ndecoded);
+    out += ndecoded;
+    ptr = escape + nconsumed;
   }
   return out - begin;
 }
@@ -141,107 +235,159 @@ static inline int assert_numeric(const struct tjson_Token* token,
   return 0;
 }
 
-int tjson_parse_value_uint64(const struct tjson_Token* token, uint64_t* value,
-                             struct tjson_Error* error) {
+// Decompose a numeric token into its parts, reusing the parts recorded by the
+// lexer. This only fails for a token of the wrong type, or one that was not
+// produced by the lexer.
+static int parse_number_token(const struct tjson_Token* token,
+                              struct tjson_Number* number,
+                              struct tjson_Error* error) {
   if (assert_numeric(token, error)) {
     return -1;
   }
+  if (tjson_Number_from_token(token, number)) {
+    error->code = TJSON_PARSE_SEMANTIC;
+    error->loc = token->location;
+    snprintf(error->msg, sizeof(error->msg), "Malformed number %.*s",
+             (int)tjson_StringPiece_size(token->spelling),
+             token->spelling.begin);
+    return -1;
+  }
+  return 0;
+}
+
+static int parse_unsigned(const struct tjson_Token* token, uint64_t max_value,
+                          uint64_t* value, struct tjson_Error* error) {
+  struct tjson_Number number;
+  if (parse_number_token(token, &number, error)) {
+    return -1;
+  }
+  if (tjson_Number_to_uint64(&number, value, error)) {
+    error->loc = token->location;
+    return -1;
+  }
+  if (*value > max_value) {
+    error->code = TJSON_PARSE_OVERFLOW;
+    error->loc = token->location;
+    snprintf(error->msg, sizeof(error->msg),
+             "%.*s is larger than the maximum value %llu",
+             (int)tjson_StringPiece_size(token->spelling),
+             token->spelling.begin, (unsigned long long)max_value);
+    return -1;
+  }
+  return 0;
+}
 
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = strtoull(token->spelling.begin, NULL, 0);
+static int parse_signed(const struct tjson_Token* token, int64_t min_value,
+                        int64_t max_value, int64_t* value,
+                        struct tjson_Error* error) {
+  struct tjson_Number number;
+  if (parse_number_token(token, &number, error)) {
+    return -1;
+  }
+  if (tjson_Number_to_int64(&number, value, error)) {
+    error->loc = token->location;
+    return -1;
+  }
+  if (*value < min_value || *value > max_value) {
+    error->code = TJSON_PARSE_OVERFLOW;
+    error->loc = token->location;
+    snprintf(error->msg, sizeof(error->msg),
+             "%.*s is outside of the range [%lld, %lld]",
+             (int)tjson_StringPiece_size(token->spelling),
+             token->spelling.begin, (long long)min_value,
+             (long long)max_value);
+    return -1;
+  }
   return 0;
 }
 
+int tjson_parse_value_uint64(const struct tjson_Token* token, uint64_t* value,
+                             struct tjson_Error* error) {
+  return parse_unsigned(token, UINT64_MAX, value, error);
+}
+
 int tjson_parse_value_uint32(const struct tjson_Token* token, uint32_t* value,
                              struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
+  uint64_t wide = 0;
+  if (parse_unsigned(token, UINT32_MAX, &wide, error)) {
     return -1;
   }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = strtoul(token->spelling.begin, NULL, 0);
+  *value = (uint32_t)wide;
   return 0;
 }
+
 int tjson_parse_value_uint16(const struct tjson_Token* token, uint16_t* value,
                              struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
+  uint64_t wide = 0;
+  if (parse_unsigned(token, UINT16_MAX, &wide, error)) {
     return -1;
   }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = (uint16_t)strtoul(token->spelling.begin, NULL, 0);
+  *value = (uint16_t)wide;
   return 0;
 }
+
 int tjson_parse_value_uint8(const struct tjson_Token* token, uint8_t* value,
                             struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
+  uint64_t wide = 0;
+  if (parse_unsigned(token, UINT8_MAX, &wide, error)) {
     return -1;
   }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = (uint8_t)strtoul(token->spelling.begin, NULL, 0);
+  *value = (uint8_t)wide;
   return 0;
 }
 
 int tjson_parse_value_int64(const struct tjson_Token* token, int64_t* value,
                             struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
-    return -1;
-  }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = strtoll(token->spelling.begin, NULL, 0);
-  return 0;
+  return parse_signed(token, INT64_MIN, INT64_MAX, value, error);
 }
 
 int tjson_parse_value_int32(const struct tjson_Token* token, int32_t* value,
                             struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
+  int64_t wide = 0;
+  if (parse_signed(token, INT32_MIN, INT32_MAX, &wide, error)) {
     return -1;
   }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = strtol(token->spelling.begin, NULL, 0);
+  *value = (int32_t)wide;
   return 0;
 }
+
 int tjson_parse_value_int16(const struct tjson_Token* token, int16_t* value,
                             struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
+  int64_t wide = 0;
+  if (parse_signed(token, INT16_MIN, INT16_MAX, &wide, error)) {
     return -1;
   }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = (int16_t)strtol(token->spelling.begin, NULL, 0);
+  *value = (int16_t)wide;
   return 0;
 }
+
 int tjson_parse_value_int8(const struct tjson_Token* token, int8_t* value,
                            struct tjson_Error* error) {
-  if (assert_numeric(token, error)) {
+  int64_t wide = 0;
+  if (parse_signed(token, INT8_MIN, INT8_MAX, &wide, error)) {
     return -1;
   }
-
-  // NOTE(josh): all well-formed json will have a valid terminating character,
-  // and we wouldn't have gotten to this point if it didn't.
-  *value = (int8_t)strtol(token->spelling.begin, NULL, 0);
+  *value = (int8_t)wide;
   return 0;
 }
 
 int tjson_parse_value_double(const struct tjson_Token* token, double* value,
                              struct tjson_Error* error) {
-  *value = strtod(token->spelling.begin, NULL);
+  struct tjson_Number number;
+  if (parse_number_token(token, &number, error)) {
+    return -1;
+  }
+  *value = tjson_Number_to_double(&number);
   return 0;
 }
 
 int tjson_parse_value_float(const struct tjson_Token* token, float* value,
                             struct tjson_Error* error) {
-  *value = strtof(token->spelling.begin, NULL);
+  struct tjson_Number number;
+  if (parse_number_token(token, &number, error)) {
+    return -1;
+  }
+  *value = tjson_Number_to_float(&number);
   return 0;
 }
 
@@ -336,12 +482,22 @@ int tjson_parse_value_string(const struct tjson_Token* token, char* buf,
 //    Value Parsers
 // -----------------------------------------------------------------------------
 
+// Tokens only carry their byte offset. If `result` indicates an error then
+// compute the line and column of the error location.
+static int locate_error(tjson_ParseContext ctx, int result) {
+  if (result < 0) {
+    tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
+  }
+  return result;
+}
+
 int tjson_parse_uint64(tjson_ParseContext ctx, uint64_t* value) {
   struct tjson_Event event;
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_uint64(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_uint64(&event.token, value, ctx.error));
 }
 
 int tjson_parse_uint32(tjson_ParseContext ctx, uint32_t* value) {
@@ -349,7 +505,8 @@ int tjson_parse_uint32(tjson_ParseContext ctx, uint32_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_uint32(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_uint32(&event.token, value, ctx.error));
 }
 
 int tjson_parse_uint16(tjson_ParseContext ctx, uint16_t* value) {
@@ -357,7 +514,8 @@ int tjson_parse_uint16(tjson_ParseContext ctx, uint16_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_uint16(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_uint16(&event.token, value, ctx.error));
 }
 
 int tjson_parse_uint8(tjson_ParseContext ctx, uint8_t* value) {
@@ -365,7 +523,8 @@ int tjson_parse_uint8(tjson_ParseContext ctx, uint8_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_uint8(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_uint8(&event.token, value, ctx.error));
 }
 
 int tjson_parse_int64(tjson_ParseContext ctx, int64_t* value) {
@@ -373,7 +532,8 @@ int tjson_parse_int64(tjson_ParseContext ctx, int64_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_int64(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_int64(&event.token, value, ctx.error));
 }
 
 int tjson_parse_int32(tjson_ParseContext ctx, int32_t* value) {
@@ -381,7 +541,8 @@ int tjson_parse_int32(tjson_ParseContext ctx, int32_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_int32(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_int32(&event.token, value, ctx.error));
 }
 
 int tjson_parse_int16(tjson_ParseContext ctx, int16_t* value) {
@@ -389,7 +550,8 @@ int tjson_parse_int16(tjson_ParseContext ctx, int16_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_int16(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_int16(&event.token, value, ctx.error));
 }
 
 int tjson_parse_int8(tjson_ParseContext ctx, int8_t* value) {
@@ -397,7 +559,8 @@ int tjson_parse_int8(tjson_ParseContext ctx, int8_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_int8(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_int8(&event.token, value, ctx.error));
 }
 
 int tjson_parse_double(tjson_ParseContext ctx, double* value) {
@@ -405,7 +568,8 @@ int tjson_parse_double(tjson_ParseContext ctx, double* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_double(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_double(&event.token, value, ctx.error));
 }
 
 int tjson_parse_float(tjson_ParseContext ctx, float* value) {
@@ -413,7 +577,8 @@ int tjson_parse_float(tjson_ParseContext ctx, float* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_float(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_float(&event.token, value, ctx.error));
 }
 
 int tjson_parse_boolean(tjson_ParseContext ctx, int8_t* value) {
@@ -421,7 +586,8 @@ int tjson_parse_boolean(tjson_ParseContext ctx, int8_t* value) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_boolean(&event.token, value, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_boolean(&event.token, value, ctx.error));
 }
 
 int tjson_parse_string(tjson_ParseContext ctx, char* buf, size_t buflen) {
@@ -429,7 +595,8 @@ int tjson_parse_string(tjson_ParseContext ctx, char* buf, size_t buflen) {
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
     return -1;
   }
-  return tjson_parse_value_string(&event.token, buf, buflen, ctx.error);
+  return locate_error(
+      ctx, tjson_parse_value_string(&event.token, buf, buflen, ctx.error));
 }
 
 // -----------------------------------------------------------------------------
@@ -447,11 +614,12 @@ int tjson_sink_event(tjson_ParseContext ctx, const struct tjson_Event* event) {
     default:
       ctx.error->code = TJSON_PARSE_UNEXPECTED_EVENT;
       ctx.error->loc = event->token.location;
+      tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
       snprintf(ctx.error->msg, sizeof(ctx.error->msg),
                "%s:%d Unexpected %s (%d) event at %d:%d", __PRETTY_FUNCTION__,
                __LINE__, tjson_EventTypeNo_tostring(event->typeno),
-               (int)event->typeno, (int)event->token.location.lineno,
-               (int)event->token.location.colno);
+               (int)event->typeno, (int)ctx.error->loc.lineno,
+               (int)ctx.error->loc.colno);
       return -1;
   }
   return 1;
@@ -477,15 +645,22 @@ int tjson_sink_object(tjson_ParseContext ctx, int8_t already_open) {
     if (event.typeno != TJSON_OBJECT_BEGIN) {
       ctx.error->code = TJSON_PARSE_UNEXPECTED_EVENT;
       ctx.error->loc = event.token.location;
+      tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
       snprintf(ctx.error->msg, sizeof(ctx.error->msg),
                "%s:%d Unexpected %s (%d) event at %d:%d", __PRETTY_FUNCTION__,
                __LINE__, tjson_EventTypeNo_tostring(event.typeno),
-               (int)event.typeno, (int)event.token.location.lineno,
-               (int)event.token.location.colno);
+               (int)event.typeno, (int)ctx.error->loc.lineno,
+               (int)ctx.error->loc.colno);
       return 1;
     }
   }
 
+  // With a bracket index the contents are skipped and only the closing
+  // bracket remains to be consumed below.
+  if (tjson_LexerParser_skip_group(ctx.stream, ctx.error) < 0) {
+    return -1;
+  }
+
   uint32_t object_count = 1;
   while (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error) == 0) {
     switch (event.typeno) {
@@ -518,15 +693,22 @@ int tjson_sink_list(tjson_ParseContext ctx, int8_t already_open) {
     if (event.typeno != TJSON_LIST_BEGIN) {
       ctx.error->code = TJSON_PARSE_UNEXPECTED_EVENT;
       ctx.error->loc = event.token.location;
+      tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
       snprintf(ctx.error->msg, sizeof(ctx.error->msg),
                "%s:%d Unexpected %s (%d) event at %d:%d", __PRETTY_FUNCTION__,
                __LINE__, tjson_EventTypeNo_tostring(event.typeno),
-               (int)event.typeno, (int)event.token.location.lineno,
-               (int)event.token.location.colno);
+               (int)event.typeno, (int)ctx.error->loc.lineno,
+               (int)ctx.error->loc.colno);
       return -1;
     }
   }
 
+  // With a bracket index the contents are skipped and only the closing
+  // bracket remains to be consumed below.
+  if (tjson_LexerParser_skip_group(ctx.stream, ctx.error) < 0) {
+    return -1;
+  }
+
   uint32_t list_count = 1;
   while (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error) == 0) {
     switch (event.typeno) {
@@ -552,10 +734,12 @@ int tjson_sink_list(tjson_ParseContext ctx, int8_t already_open) {
 //    Aggregate parsers
 // -----------------------------------------------------------------------------
 
-int tjson_parse_object(tjson_ParseContext ctx,
-                       int (*fielditem_callback)(void*, tjson_ParseContext,
-                                                 tjson_StringPiece),
-                       void* userdata) {
+// Shared implementation of tjson_parse_object() and
+// tjson_parse_object_interned(), exactly one of the callbacks is non-null.
+static int parse_object(tjson_ParseContext ctx,
+                        tjson_fielditem_callback fielditem_callback,
+                        tjson_keyitem_callback keyitem_callback,
+                        void* userdata) {
   struct tjson_Event event;
 
   if (tjson_LexerParser_get_next_event(ctx.stream, &event, ctx.error)) {
@@ -571,11 +755,12 @@ int tjson_parse_object(tjson_ParseContext ctx,
   if (event.typeno != TJSON_OBJECT_BEGIN) {
     ctx.error->code = TJSON_PARSE_UNEXPECTED_EVENT;
     ctx.error->loc = event.token.location;
+    tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
     snprintf(ctx.error->msg, sizeof(ctx.error->msg),
              "%s:%d (%s) Unexpected %s (%d) event at %d:%d", __FILE__, __LINE__,
              __PRETTY_FUNCTION__, tjson_EventTypeNo_tostring(event.typeno),
-             (int)event.typeno, (int)event.token.location.lineno,
-             (int)event.token.location.colno);
+             (int)event.typeno, (int)ctx.error->loc.lineno,
+             (int)ctx.error->loc.colno);
     return -1;
   }
 
@@ -587,19 +772,31 @@ int tjson_parse_object(tjson_ParseContext ctx,
     if (event.typeno != TJSON_OBJECT_KEY) {
       ctx.error->code = TJSON_PARSE_UNEXPECTED_EVENT;
       ctx.error->loc = event.token.location;
+      tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
       snprintf(
           ctx.error->msg, sizeof(ctx.error->msg),
           "%s:%d (%s) Unexpected %s (%d) event, wanted OBJECT_KEY at %d:%d",
           __FILE__, __LINE__, __PRETTY_FUNCTION__,
           tjson_EventTypeNo_tostring(event.typeno), (int)event.typeno,
-          (int)event.token.location.lineno, (int)event.token.location.colno);
+          (int)ctx.error->loc.lineno, (int)ctx.error->loc.colno);
       return -1;
     }
 
     // strip quotes
     struct tjson_StringPiece key =
         tjson_StringPiece_substr(event.token.spelling, 1, -1);
-    if (fielditem_callback(userdata, ctx, key)) {
+    if (fielditem_callback) {
+      if (fielditem_callback(userdata, ctx, key)) {
+        return -1;
+      }
+      continue;
+    }
+
+    uint32_t keyid = 0;
+    if (ctx.stream->_keys) {
+      keyid = tjson_KeyTable_intern(ctx.stream->_keys, key);
+    }
+    if (keyitem_callback(userdata, ctx, key, keyid)) {
       return -1;
     }
   }
@@ -607,6 +804,32 @@ int tjson_parse_object(tjson_ParseContext ctx,
   return 0;
 }
 
+int tjson_parse_object(tjson_ParseContext ctx,
+                       int (*fielditem_callback)(void*, tjson_ParseContext,
+                                                 tjson_StringPiece),
+                       void* userdata) {
+  return parse_object(ctx, fielditem_callback, NULL, userdata);
+}
+
+int tjson_parse_object_interned(tjson_ParseContext ctx,
+                                tjson_keyitem_callback keyitem_callback,
+                                void* userdata) {
+  return parse_object(ctx, NULL, keyitem_callback, userdata);
+}
+
+int tjson_lookup_key(tjson_ParseContext ctx, const void* shape, uint32_t keyid,
+                     int32_t* value) {
+  return keyid && ctx.stream->_keys &&
+         tjson_KeyTable_lookup(ctx.stream->_keys, shape, keyid, value);
+}
+
+void tjson_bind_key(tjson_ParseContext ctx, const void* shape, uint32_t keyid,
+                    int32_t value) {
+  if (ctx.stream->_keys) {
+    tjson_KeyTable_bind(ctx.stream->_keys, shape, keyid, value);
+  }
+}
+
 int tjson_parse_list(tjson_ParseContext ctx,
                      int (*listitem_callback)(void*, tjson_ParseContext),
                      void* userdata) {
@@ -619,11 +842,12 @@ int tjson_parse_list(tjson_ParseContext ctx,
   if (event.typeno != TJSON_LIST_BEGIN) {
     ctx.error->code = TJSON_PARSE_UNEXPECTED_EVENT;
     ctx.error->loc = event.token.location;
+    tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
     snprintf(ctx.error->msg, sizeof(ctx.error->msg),
              "%s:%d Unexpected %s (%d) event at %d:%d", __PRETTY_FUNCTION__,
              __LINE__, tjson_EventTypeNo_tostring(event.typeno),
-             (int)event.typeno, (int)event.token.location.lineno,
-             (int)event.token.location.colno);
+             (int)event.typeno, (int)ctx.error->loc.lineno,
+             (int)ctx.error->loc.colno);
     return -1;
   }
 
@@ -644,8 +868,49 @@ static int count_onlistitem(void* userdata, tjson_ParseContext ctx) {
   return tjson_sink_value(ctx);
 }
 
+int tjson_list_overflow(tjson_ParseContext ctx, const char* name,
+                        size_t capacity) {
+  struct tjson_Event event;
+  if (tjson_LexerParser_peek_next_event(ctx.stream, &event, ctx.error)) {
+    return -1;
+  }
+  ctx.error->code = TJSON_PARSE_OVERFLOW;
+  ctx.error->loc = event.token.location;
+  tjson_LexerParser_locate(ctx.stream, &ctx.error->loc);
+  snprintf(ctx.error->msg, sizeof(ctx.error->msg),
+           "Too many items for %s, capacity is %zu at %d:%d", name, capacity,
+           (int)ctx.error->loc.lineno, (int)ctx.error->loc.colno);
+  return -1;
+}
+
+int tjson_find_list_count(tjson_ParseContext ctx, size_t* count) {
+  struct tjson_Event event;
+  if (!ctx.stream->_brackets) {
+    return 0;
+  }
+  if (tjson_LexerParser_peek_next_event(ctx.stream, &event, ctx.error)) {
+    return -1;
+  }
+  if (event.typeno != TJSON_LIST_BEGIN) {
+    return 0;
+  }
+  const struct tjson_Bracket* bracket =
+      tjson_LexerParser_find_bracket(ctx.stream, event.token.location.offset);
+  if (!bracket) {
+    return 0;
+  }
+  *count = bracket->count;
+  return 1;
+}
+
 int tjson_count_list(tjson_ParseContext ctx, size_t* count) {
-  // copy state
+  // With a bracket index the count is a lookup
+  int found = tjson_find_list_count(ctx, count);
+  if (found) {
+    return found < 0 ? -1 : 0;
+  }
+
+  // otherwise copy state and parse the list
   tjson_LexerParser stream = *ctx.stream;
   ctx.stream = &stream;
 
@@ -15,13 +15,18 @@ typedef struct tjson_ParseContext {
   void* userdata;
 } tjson_ParseContext;
 
-/// Escape any control codes to json shortcode,
+/// Escape quotes, backslashes and control codes to json shortcode (or \u00XX)
+/// into the character buffer pointed to by (begin,end). Return the number of
+/// characters in the output, leaving room for a null terminator, or -1 if the
+/// buffer is too small.
 ssize_t tjson_escape(const struct tjson_StringPiece input, char* begin,
                      char* end);
 
 /// Unescape any JSON encoded control codes, reconstruct the original string
 /// in the character buffer pointed to by (begin,end). Return the number of
-/// characters in the output (not including the null terminator).
+/// characters in the output (not including the null terminator), or -1 if the
+/// buffer is too small. `\uXXXX` escapes, including surrogate pairs, are
+/// encoded as UTF-8. An unpaired surrogate is replaced by U+FFFD.
 ssize_t tjson_unescape(const struct tjson_StringPiece input, char* begin,
                        char* end);
 
@@ -92,10 +97,12 @@ int tjson_sink_event(tjson_ParseContext ctx, const struct tjson_Event* event);
 
 int tjson_sink_value(tjson_ParseContext ctx);
 
-// Consume an object, ignoring it's contents
+// Consume an object, ignoring it's contents. If the stream has a bracket
+// index the contents are skipped without being lexed.
 int tjson_sink_object(tjson_ParseContext ctx, int8_t already_open);
 
-// Consume a list, ignoring it's contents
+// Consume a list, ignoring it's contents. If the stream has a bracket index
+// the contents are skipped without being lexed.
 int tjson_sink_list(tjson_ParseContext ctx, int8_t already_open);
 
 // -----------------------------------------------------------------------------
@@ -110,12 +117,49 @@ int tjson_parse_object(tjson_ParseContext ctx,
                                                  tjson_StringPiece),
                        void* userdata);
 
+typedef int (*tjson_keyitem_callback)(void*, tjson_ParseContext,
+                                      tjson_StringPiece, uint32_t);
+
+// Same as tjson_parse_object() but each key is also passed to the callback by
+// its ID in the key table of the stream (see tjson_LexerParser_set_keytable).
+// The ID is zero if the stream has no key table or the key could not be
+// interned.
+int tjson_parse_object_interned(tjson_ParseContext ctx,
+                                tjson_keyitem_callback keyitem_callback,
+                                void* userdata);
+
+// If `keyid` is non-zero and a value is bound to it for `shape` in the key
+// table of the stream, store the value in `value` and return 1. Otherwise
+// return 0. See tjson_KeyTable_lookup().
+int tjson_lookup_key(tjson_ParseContext ctx, const void* shape, uint32_t keyid,
+                     int32_t* value);
+
+// Bind `value` to `keyid` for `shape` in the key table of the stream, if
+// there is one and `keyid` is non-zero. See tjson_KeyTable_bind().
+void tjson_bind_key(tjson_ParseContext ctx, const void* shape, uint32_t keyid,
+                    int32_t value);
+
 typedef int (*tjson_listitem_callback)(void*, tjson_ParseContext);
 
 int tjson_parse_list(tjson_ParseContext ctx,
                      int (*listitem_callback)(void*, tjson_ParseContext),
                      void* userdata);
 
+// Fill `ctx.error` for a list item which does not fit in a fixed array of
+// `capacity` items (e.g. the field `name` of a generated C struct) and return
+// -1. The error is located at the item, which is next in the stream.
+int tjson_list_overflow(tjson_ParseContext ctx, const char* name,
+                        size_t capacity);
+
+// If the stream has a bracket index (see tjson_LexerParser_set_brackets) and
+// the next event opens a list, store the number of items of the list in
+// `count` and return 1. Otherwise return 0, without parsing anything beyond
+// the next event. Return -1 on error.
+int tjson_find_list_count(tjson_ParseContext ctx, size_t* count);
+
+// Count the items of the list which is next in the stream, without consuming
+// it. If the stream has a bracket index this is a lookup, otherwise the list
+// is parsed from a copy of the stream.
 int tjson_count_list(tjson_ParseContext ctx, size_t* count);
 
 #if __cplusplus
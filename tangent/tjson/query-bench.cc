@@ -0,0 +1,122 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Measure tjson_Query over a synthetic multi-megabyte document. The early-exit
+// case selects a field which appears before the bulk of the document, the
+// full-scan case selects a field of every record, and the skip case selects a
+// field which appears after the bulk of the document.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/query.h"
+#include "tangent/tjson/structural.h"
+#include "tangent/tjson/tjson.h"
+
+static std::string make_document(size_t target_size) {
+  std::string out = "{\n  \"version\": 3,\n  \"records\": [\n";
+  append_records(&out, target_size, "    ");
+  out += "    {\"id\": 0}\n  ],\n  \"checksum\": 12345\n}\n";
+  return out;
+}
+
+static void report(const char* name, size_t nbytes, uint64_t elapsed_ns,
+                   int64_t nmatches = -1) {
+  printf("%-24s %12.1f MB/s", name, nbytes / (elapsed_ns * 1e-9) / 1e6);
+  if (nmatches >= 0) {
+    printf(" %8lld matches", static_cast<long long>(nmatches));
+  }
+  printf("\n");
+}
+
+struct Index {
+  std::vector<uint32_t> structurals;
+  std::vector<tjson_Bracket> brackets;
+  int64_t nstructurals;
+  int64_t nbrackets;
+};
+
+static int run_query(const char* name, tjson_StringPiece source,
+                     const char* path, const Index* index,
+                     std::vector<tjson_QueryResult>* results) {
+  tjson_Error error{};
+  tjson_Query query;
+  tjson_Query_init(&query);
+  if (tjson_Query_add(&query, path, &error) < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return -1;
+  }
+
+  uint64_t begin = now_ns();
+  tjson_LexerParser stream;
+  tjson_LexerParser_init(&stream, &error);
+  tjson_LexerParser_begin(&stream, source, &error);
+  if (index) {
+    tjson_LexerParser_set_structurals(&stream, index->structurals.data(),
+                                      index->nstructurals, &error);
+    tjson_LexerParser_set_brackets(&stream, index->brackets.data(),
+                                   index->nbrackets, &error);
+  }
+  int64_t count = tjson_Query_run(&query, &stream, results->data(),
+                                  results->size(), &error);
+  uint64_t elapsed_ns = now_ns() - begin;
+  if (count < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return -1;
+  }
+  report(name, tjson_StringPiece_size(source), elapsed_ns, count);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  size_t size_mb = 16;
+  if (argc > 1) {
+    size_mb = strtoul(argv[1], nullptr, 10);
+  }
+  std::string document = make_document(size_mb * 1024 * 1024);
+  tjson_StringPiece source{document.data(), document.data() + document.size()};
+  std::vector<tjson_QueryResult> results(document.size() / 64);
+
+  tjson_Error error{};
+  uint64_t begin = now_ns();
+  int nevents = tjson_parse(source, nullptr, 0, &error);
+  report("stream events", document.size(), now_ns() - begin);
+  if (nevents < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+
+  if (run_query("early exit", source, "/version", nullptr, &results) ||
+      run_query("full scan", source, "/records/*/value", nullptr, &results) ||
+      run_query("skip records", source, "/checksum", nullptr, &results)) {
+    return 1;
+  }
+
+  Index index;
+  index.structurals.resize(document.size() + 1);
+  begin = now_ns();
+  index.nstructurals =
+      tjson_index_structurals(source, &index.structurals[0],
+                              index.structurals.size(), &error);
+  if (index.nstructurals < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+  index.brackets.resize(index.nstructurals / 2 + 1);
+  index.nbrackets = tjson_index_brackets(
+      source, index.structurals.data(), index.nstructurals,
+      &index.brackets[0], index.brackets.size(), &error);
+  if (index.nbrackets < 0) {
+    fprintf(stderr, "%s\n", error.msg);
+    return 1;
+  }
+  report("build index", document.size(), now_ns() - begin);
+
+  if (run_query("full scan (indexed)", source, "/records/*/value", &index,
+                &results) ||
+      run_query("skip records (indexed)", source, "/checksum", &index,
+                &results)) {
+    return 1;
+  }
+  return 0;
+}
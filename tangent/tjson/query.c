@@ -0,0 +1,322 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/query.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tangent/tjson/parse.h"
+
+// -----------------------------------------------------------------------------
+//    Compile
+// -----------------------------------------------------------------------------
+
+void tjson_Query_init(struct tjson_Query* query) {
+  query->_path_begin[0] = 0;
+  query->_npaths = 0;
+  query->_storage_size = 0;
+}
+
+// Return the value of a segment which is a non-negative decimal integer
+// without leading zeros, or UINT32_MAX if it is not one.
+static uint32_t parse_index(struct tjson_StringPiece key) {
+  size_t size = tjson_StringPiece_size(key);
+  if (size < 1 || size > 9 || (size > 1 && key.begin[0] == '0')) {
+    return UINT32_MAX;
+  }
+  uint32_t value = 0;
+  for (const char* ptr = key.begin; ptr < key.end; ptr++) {
+    if (*ptr < '0' || '9' < *ptr) {
+      return UINT32_MAX;
+    }
+    value = 10 * value + (uint32_t)(*ptr - '0');
+  }
+  return value;
+}
+
+int tjson_Query_add(struct tjson_Query* query, const char* path,
+                    struct tjson_Error* error) {
+  memset(&error->loc, 0, sizeof(error->loc));
+  if (query->_npaths >= TJSON_QUERY_MAX_PATHS) {
+    error->code = TJSON_PARSE_OVERFLOW;
+    snprintf(error->msg, sizeof(error->msg),
+             "A query can hold at most %d paths", TJSON_QUERY_MAX_PATHS);
+    return -1;
+  }
+  if (path[0] != '\0' && path[0] != '/') {
+    error->code = TJSON_PARSE_SEMANTIC;
+    snprintf(error->msg, sizeof(error->msg),
+             "Path '%s' must be empty or begin with '/'", path);
+    return -1;
+  }
+
+  uint32_t path_begin = query->_path_begin[query->_npaths];
+  uint32_t nsegments = path_begin;
+  uint32_t storage_size = query->_storage_size;
+  uint32_t literal_prefix = UINT32_MAX;
+
+  const char* ptr = path;
+  while (*ptr == '/') {
+    ptr++;
+    if (nsegments >= TJSON_QUERY_MAX_SEGMENTS) {
+      error->code = TJSON_PARSE_OVERFLOW;
+      snprintf(error->msg, sizeof(error->msg),
+               "A query can hold at most %d path segments",
+               TJSON_QUERY_MAX_SEGMENTS);
+      return -1;
+    }
+
+    struct tjson_QuerySegment* segment = &query->_segments[nsegments];
+    const char* begin = ptr;
+    segment->key.begin = query->_storage + storage_size;
+    while (*ptr != '\0' && *ptr != '/') {
+      char c = *ptr++;
+      if (c == '~') {
+        if (*ptr == '0') {
+          c = '~';
+        } else if (*ptr == '1') {
+          c = '/';
+        } else {
+          error->code = TJSON_PARSE_SEMANTIC;
+          snprintf(error->msg, sizeof(error->msg),
+                   "Invalid escape '~%c' in path '%s'", *ptr, path);
+          return -1;
+        }
+        ptr++;
+      }
+      if (storage_size >= TJSON_QUERY_STORAGE) {
+        error->code = TJSON_PARSE_OVERFLOW;
+        snprintf(error->msg, sizeof(error->msg),
+                 "A query can hold at most %d bytes of keys",
+                 TJSON_QUERY_STORAGE);
+        return -1;
+      }
+      query->_storage[storage_size++] = c;
+    }
+    segment->key.end = query->_storage + storage_size;
+    segment->index = parse_index(segment->key);
+    segment->wildcard = (ptr - begin == 1 && *begin == '*');
+    if (segment->wildcard && literal_prefix == UINT32_MAX) {
+      literal_prefix = nsegments - path_begin;
+    }
+    nsegments++;
+  }
+
+  uint32_t idx = query->_npaths++;
+  query->_path_begin[idx + 1] = nsegments;
+  query->_literal_prefix[idx] =
+      (literal_prefix == UINT32_MAX) ? nsegments - path_begin : literal_prefix;
+  query->_storage_size = storage_size;
+  return (int)idx;
+}
+
+// -----------------------------------------------------------------------------
+//    Run
+// -----------------------------------------------------------------------------
+
+enum VisitResult {
+  VISIT_ERROR = -1,
+  VISIT_CONTINUE = 0,
+  VISIT_STOP = 1,
+};
+
+struct Runner {
+  const struct tjson_Query* query;
+  struct tjson_LexerParser* stream;
+  struct tjson_QueryResult* buf;
+  uint64_t n;
+  uint64_t count;
+
+  uint64_t all;   //< bit set of all paths
+  uint64_t done;  //< bit set of paths which can not match anything more
+  struct tjson_Error* error;
+};
+
+static inline uint32_t path_size(const struct tjson_Query* query,
+                                 uint32_t path) {
+  return query->_path_begin[path + 1] - query->_path_begin[path];
+}
+
+static inline const struct tjson_QuerySegment* path_segment(
+    const struct tjson_Query* query, uint32_t path, uint32_t depth) {
+  return &query->_segments[query->_path_begin[path] + depth];
+}
+
+// Compare a segment key to the content of a key token (without the quotes)
+static int8_t key_equals(struct tjson_StringPiece segment,
+                         struct tjson_StringPiece key) {
+  size_t size = tjson_StringPiece_size(key);
+  if (!memchr(key.begin, '\\', size)) {
+    return size == tjson_StringPiece_size(segment) &&
+           memcmp(key.begin, segment.begin, size) == 0;
+  }
+
+  // NOTE(josh): a key which does not fit can't match, since every segment
+  // fits in the query storage
+  char buf[TJSON_QUERY_STORAGE + 1];
+  ssize_t unescaped_size = tjson_unescape(key, buf, buf + sizeof(buf));
+  return unescaped_size >= 0 &&
+         (size_t)unescaped_size == tjson_StringPiece_size(segment) &&
+         memcmp(buf, segment.begin, unescaped_size) == 0;
+}
+
+// Consume the rest of the group which was just opened and return its closing
+// event in `close`
+static int finish_group(struct Runner* runner, struct tjson_Event* close) {
+  if (tjson_LexerParser_skip_group(runner->stream, runner->error) < 0) {
+    return -1;
+  }
+  uint32_t depth = 1;
+  while (tjson_LexerParser_get_next_event(runner->stream, close,
+                                          runner->error) == 0) {
+    switch (close->typeno) {
+      case TJSON_OBJECT_BEGIN:
+      case TJSON_LIST_BEGIN:
+        depth++;
+        break;
+      case TJSON_OBJECT_END:
+      case TJSON_LIST_END:
+        if (--depth == 0) {
+          return 0;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return -1;
+}
+
+// Bit set of paths in `candidates` for which the segment at `depth` selects
+// the child with the given key (if `key` is not NULL) or list index
+static uint64_t select_child(const struct tjson_Query* query,
+                             uint64_t candidates, uint32_t depth,
+                             const struct tjson_StringPiece* key,
+                             uint32_t index) {
+  uint64_t selected = 0;
+  for (uint64_t bits = candidates; bits; bits &= bits - 1) {
+    uint32_t path = (uint32_t)__builtin_ctzll(bits);
+    const struct tjson_QuerySegment* segment = path_segment(query, path, depth);
+    if (segment->wildcard ||
+        (key ? key_equals(segment->key, *key) : segment->index == index)) {
+      selected |= (1ull << path);
+    }
+  }
+  return selected;
+}
+
+// Visit the value which begins with `event` at `depth`. `mask` is the set of
+// paths whose first `depth` segments select this value.
+static int visit(struct Runner* runner, const struct tjson_Event* event,
+                 uint32_t depth, uint64_t mask) {
+  const struct tjson_Query* query = runner->query;
+  uint64_t matched = 0;
+  uint64_t candidates = 0;
+  uint64_t closed = 0;
+  for (uint64_t bits = mask; bits; bits &= bits - 1) {
+    uint32_t path = (uint32_t)__builtin_ctzll(bits);
+    uint32_t size = path_size(query, path);
+    if (size == depth) {
+      matched |= (1ull << path);
+    } else {
+      candidates |= (1ull << path);
+    }
+    // This is the only value which can contain matches for the path if
+    // all the segments leading to it are literal
+    if (query->_literal_prefix[path] == depth) {
+      closed |= (1ull << path);
+    }
+  }
+
+  uint64_t first = runner->count;
+  for (uint64_t bits = matched; bits; bits &= bits - 1) {
+    if (runner->count < runner->n) {
+      struct tjson_QueryResult* result = &runner->buf[runner->count];
+      result->path = (uint32_t)__builtin_ctzll(bits);
+      result->span = event->token.spelling;
+    }
+    runner->count++;
+  }
+
+  if (event->typeno == TJSON_OBJECT_BEGIN ||
+      event->typeno == TJSON_LIST_BEGIN) {
+    struct tjson_Event close;
+    if (!candidates) {
+      if (finish_group(runner, &close)) {
+        return VISIT_ERROR;
+      }
+    } else {
+      uint32_t index = 0;
+      while (1) {
+        struct tjson_Event child;
+        if (tjson_LexerParser_get_next_event(runner->stream, &child,
+                                             runner->error)) {
+          return VISIT_ERROR;
+        }
+        if (child.typeno == TJSON_OBJECT_END ||
+            child.typeno == TJSON_LIST_END) {
+          close = child;
+          break;
+        }
+
+        uint64_t selected = 0;
+        candidates &= ~runner->done;
+        if (child.typeno == TJSON_OBJECT_KEY) {
+          struct tjson_StringPiece key =
+              tjson_StringPiece_substr(child.token.spelling, 1, -1);
+          selected = select_child(query, candidates, depth, &key, 0);
+          if (tjson_LexerParser_get_next_event(runner->stream, &child,
+                                               runner->error)) {
+            return VISIT_ERROR;
+          }
+        } else {
+          selected = select_child(query, candidates, depth, NULL, index++);
+        }
+
+        int result = visit(runner, &child, depth + 1, selected);
+        if (result != VISIT_CONTINUE) {
+          return result;
+        }
+      }
+    }
+
+    uint64_t last = first + (uint64_t)__builtin_popcountll(matched);
+    for (uint64_t idx = first; idx < last && idx < runner->n; idx++) {
+      runner->buf[idx].span.end = close.token.spelling.end;
+    }
+  }
+
+  runner->done |= closed;
+  return (runner->done == runner->all) ? VISIT_STOP : VISIT_CONTINUE;
+}
+
+int64_t tjson_Query_run(const struct tjson_Query* query,
+                        struct tjson_LexerParser* stream,
+                        struct tjson_QueryResult* buf, uint64_t n,
+                        struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+
+  struct Runner runner;
+  runner.query = query;
+  runner.stream = stream;
+  runner.buf = buf;
+  runner.n = buf ? n : 0;
+  runner.count = 0;
+  runner.all = (query->_npaths < 64) ? (1ull << query->_npaths) - 1 : ~0ull;
+  runner.done = 0;
+  runner.error = error;
+  if (!query->_npaths) {
+    return 0;
+  }
+
+  struct tjson_Event event;
+  if (tjson_LexerParser_get_next_event(stream, &event, error)) {
+    return -1;
+  }
+  if (visit(&runner, &event, 0, runner.all) == VISIT_ERROR) {
+    return -1;
+  }
+  return (int64_t)runner.count;
+}
@@ -0,0 +1,81 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Query
+// -----------------------------------------------------------------------------
+// A compiled set of paths which are matched against the event stream of a
+// LexerParser. Paths use JSON Pointer syntax (RFC 6901), e.g. "/foo/0/bar",
+// with `~0` and `~1` escaping `~` and `/`. In addition a segment consisting of
+// only `*` matches any key of an object or any item of a list. The empty path
+// matches the whole document.
+//
+// While running, subtrees which can not contain a match are skipped (in O(1)
+// if the stream has a bracket index, see tjson_LexerParser_set_brackets), and
+// the run stops as soon as every path is known to have no more matches: when
+// a path without wildcards has matched, or when the container that holds all
+// the candidates of a wildcard path has closed.
+
+#define TJSON_QUERY_MAX_PATHS 64
+#define TJSON_QUERY_MAX_SEGMENTS 256
+#define TJSON_QUERY_STORAGE 4096
+
+typedef struct tjson_QuerySegment {
+  struct tjson_StringPiece key;  //< unescaped key, points into `_storage`
+  uint32_t index;                //< list index, UINT32_MAX if not a number
+  int8_t wildcard;               //< segment is `*`
+} tjson_QuerySegment;
+
+typedef struct tjson_Query {
+  // Segments of all paths, concatenated. Path `i` is made up of the segments
+  // [_path_begin[i], _path_begin[i+1]).
+  struct tjson_QuerySegment _segments[TJSON_QUERY_MAX_SEGMENTS];
+  uint32_t _path_begin[TJSON_QUERY_MAX_PATHS + 1];
+
+  // Number of leading segments of each path before the first wildcard
+  uint32_t _literal_prefix[TJSON_QUERY_MAX_PATHS];
+  uint32_t _npaths;
+
+  // Unescaped keys of all segments
+  char _storage[TJSON_QUERY_STORAGE];
+  uint32_t _storage_size;
+} tjson_Query;
+
+// A value which matched one of the paths
+typedef struct tjson_QueryResult {
+  uint32_t path;  //< index of the path, in the order they were added
+
+  // Source text of the value. For a string this includes the quotes, for an
+  // object or list it spans from the opening to the closing bracket.
+  struct tjson_StringPiece span;
+} tjson_QueryResult;
+
+// Initialize an empty query
+void tjson_Query_init(struct tjson_Query* query);
+
+// Compile `path` and add it to the query. Return the index of the path, or
+// fill `error` and return -1 if the path is malformed or the query is full.
+int tjson_Query_add(struct tjson_Query* query, const char* path,
+                    struct tjson_Error* error);
+
+// Run the query over the stream, which must be positioned at the beginning
+// of a value. Matches are stored in `buf` in order of their beginning. Return
+// the number of matches (which may be greater than `n`, in which case only the
+// first `n` are stored), or -1 on error. If the run stops early the stream is
+// left in the middle of the value.
+int64_t tjson_Query_run(const struct tjson_Query* query,
+                        struct tjson_LexerParser* stream,
+                        struct tjson_QueryResult* buf, uint64_t n,
+                        struct tjson_Error* error);
+
+#if __cplusplus
+}  // extern "C"
+#endif
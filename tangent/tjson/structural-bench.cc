@@ -0,0 +1,146 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+// Compare lexing throughput with and without the structural index on a
+// synthetic multi-megabyte document, and counting and skipping the document
+// with and without the bracket index.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "tangent/tjson/bench.h"
+#include "tangent/tjson/parse.h"
+#include "tangent/tjson/structural.h"
+#include "tangent/tjson/tjson.h"
+
+static std::string make_document(size_t target_size) {
+  std::string out = "[\n";
+  char buf[512];
+  for (uint32_t idx = 0; out.size() < target_size; idx++) {
+    snprintf(buf, sizeof(buf),
+             "  {\n"
+             "    \"id\": %u,\n"
+             "    \"name\": \"record number %u with a \\\"quoted\\\" name\",\n"
+             "    \"tags\": [\"alpha\", \"beta\", \"gamma\"],\n"
+             "    \"value\": %u.%03u,\n"
+             "    \"enabled\": %s,\n"
+             "    \"description\": \"%s\"\n"
+             "  },\n",
+             idx, idx, idx * 7, idx % 1000, (idx % 2) ? "true" : "false",
+             "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+             "eiusmod tempor incididunt ut labore et dolore magna aliqua.");
+    out += buf;
+  }
+  out += "  {}\n]\n";
+  return out;
+}
+
+static int lex(tjson_StringPiece source, const std::vector<uint32_t>* index) {
+  tjson_Scanner scanner;
+  tjson_Error error{};
+  tjson_Scanner_init(&scanner, &error);
+  tjson_Scanner_begin(&scanner, source, &error);
+  if (index) {
+    tjson_Scanner_set_structurals(&scanner, index->data(), index->size(),
+                                  &error);
+  }
+  tjson_Token token;
+  int ntokens = 0;
+  while (tjson_Scanner_pump(&scanner, &token, &error) == 0) {
+    ntokens++;
+  }
+  if (error.code != TJSON_LEX_INPUT_FINISHED) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+  return ntokens;
+}
+
+// Count and then skip the top-level list
+static size_t count_and_sink(tjson_StringPiece source,
+                             const std::vector<tjson_Bracket>* brackets) {
+  tjson_LexerParser stream;
+  tjson_Error error{};
+  tjson_LexerParser_init(&stream, &error);
+  tjson_LexerParser_begin(&stream, source, &error);
+  if (brackets) {
+    tjson_LexerParser_set_brackets(&stream, brackets->data(), brackets->size(),
+                                   &error);
+  }
+  tjson_ParseContext ctx{&stream, &error, nullptr};
+  size_t count = 0;
+  if (tjson_count_list(ctx, &count) || tjson_sink_list(ctx, 0)) {
+    fprintf(stderr, "%s\n", error.msg);
+    exit(1);
+  }
+  return count;
+}
+
+int main(int argc, char** argv) {
+  size_t size_mb = 16;
+  if (argc > 1) {
+    size_mb = strtoul(argv[1], nullptr, 10);
+  }
+  std::string document = make_document(size_mb * 1024 * 1024);
+  tjson_StringPiece source{document.data(), document.data() + document.size()};
+
+  uint64_t begin = now_ns();
+  int ntokens = lex(source, nullptr);
+  report_throughput("lex", document.size(), now_ns() - begin);
+
+  tjson_Error error{};
+  std::vector<uint32_t> index(document.size() / 2);
+  begin = now_ns();
+  int64_t count =
+      tjson_index_structurals(source, &index[0], index.size(), &error);
+  uint64_t index_ns = now_ns() - begin;
+  if (count < 0 || static_cast<size_t>(count) > index.size()) {
+    fprintf(stderr, "index failed: %s\n", error.msg);
+    return 1;
+  }
+  index.resize(count);
+  report_throughput("index", document.size(), index_ns);
+
+  begin = now_ns();
+  count = tjson_index_structurals_scalar(source, &index[0], index.size(),
+                                         &error);
+  report_throughput("index (scalar)", document.size(), now_ns() - begin);
+
+  begin = now_ns();
+  int ntokens_indexed = lex(source, &index);
+  uint64_t lex_ns = now_ns() - begin;
+  report_throughput("lex with index", document.size(), lex_ns);
+  report_throughput("index + lex", document.size(), index_ns + lex_ns);
+
+  std::vector<tjson_Bracket> brackets(index.size());
+  begin = now_ns();
+  count = tjson_index_brackets(source, index.data(), index.size(),
+                               &brackets[0], brackets.size(), &error);
+  report_throughput("brackets", document.size(), now_ns() - begin);
+  if (count < 0) {
+    fprintf(stderr, "bracket index failed: %s\n", error.msg);
+    return 1;
+  }
+  brackets.resize(count);
+
+  begin = now_ns();
+  size_t nitems = count_and_sink(source, nullptr);
+  report_throughput("count + sink", document.size(), now_ns() - begin);
+
+  begin = now_ns();
+  size_t nitems_indexed = count_and_sink(source, &brackets);
+  report_throughput("count + sink (index)", document.size(), now_ns() - begin);
+  if (nitems != nitems_indexed) {
+    fprintf(stderr, "item count mismatch: %zu != %zu\n", nitems,
+            nitems_indexed);
+    return 1;
+  }
+
+  if (ntokens != ntokens_indexed) {
+    fprintf(stderr, "token count mismatch: %d != %d\n", ntokens,
+            ntokens_indexed);
+    return 1;
+  }
+  printf("%zu bytes, %d tokens, %zu structurals\n", document.size(), ntokens,
+         index.size());
+  return 0;
+}
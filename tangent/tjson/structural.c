@@ -0,0 +1,429 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/structural.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__PCLMUL__)
+#include <immintrin.h>
+#endif
+
+// -----------------------------------------------------------------------------
+//    Classification
+// -----------------------------------------------------------------------------
+
+// Bitmasks for one 64-byte block of input. Bit `i` corresponds to byte `i` of
+// the block.
+struct BlockMasks {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t punctuation;
+  uint64_t whitespace;
+};
+
+static void classify_scalar(const char* block, struct BlockMasks* masks) {
+  memset(masks, 0, sizeof(struct BlockMasks));
+  for (uint32_t idx = 0; idx < 64; idx++) {
+    uint64_t bit = 1ull << idx;
+    switch (block[idx]) {
+      case '"':
+        masks->quote |= bit;
+        break;
+      case '\\':
+        masks->backslash |= bit;
+        break;
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+      case ',':
+        masks->punctuation |= bit;
+        break;
+      case ' ':
+      case '\t':
+      case '\n':
+      case '\r':
+        masks->whitespace |= bit;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+#if defined(__AVX2__)
+
+static inline uint64_t movemask32(__m256i value) {
+  return (uint32_t)_mm256_movemask_epi8(value);
+}
+
+static void classify_simd(const char* block, struct BlockMasks* masks) {
+  memset(masks, 0, sizeof(struct BlockMasks));
+  for (uint32_t idx = 0; idx < 64; idx += 32) {
+    __m256i chars = _mm256_loadu_si256((const __m256i*)(block + idx));
+    // '{' | 0x20 == '{' and '[' | 0x20 == '{', same for the closures
+    __m256i folded = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    __m256i punctuation = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                        _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(':')),
+                        _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(','))));
+    __m256i whitespace = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r'))));
+    masks->quote |=
+        movemask32(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"'))) << idx;
+    masks->backslash |=
+        movemask32(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\\'))) << idx;
+    masks->punctuation |= movemask32(punctuation) << idx;
+    masks->whitespace |= movemask32(whitespace) << idx;
+  }
+}
+
+#elif defined(__SSE2__)
+
+static inline uint64_t movemask16(__m128i value) {
+  return (uint16_t)_mm_movemask_epi8(value);
+}
+
+static void classify_simd(const char* block, struct BlockMasks* masks) {
+  memset(masks, 0, sizeof(struct BlockMasks));
+  for (uint32_t idx = 0; idx < 64; idx += 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*)(block + idx));
+    // '{' | 0x20 == '{' and '[' | 0x20 == '{', same for the closures
+    __m128i folded = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i punctuation = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                     _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(':')),
+                     _mm_cmpeq_epi8(chars, _mm_set1_epi8(','))));
+    __m128i whitespace = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r'))));
+    masks->quote |= movemask16(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"')))
+                    << idx;
+    masks->backslash |=
+        movemask16(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))) << idx;
+    masks->punctuation |= movemask16(punctuation) << idx;
+    masks->whitespace |= movemask16(whitespace) << idx;
+  }
+}
+
+#else
+
+static void classify_simd(const char* block, struct BlockMasks* masks) {
+  classify_scalar(block, masks);
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+//    Bit Manipulation
+// -----------------------------------------------------------------------------
+
+// Return a mask where bit `i` is the xor of bits `0..i` of `bits`. Given the
+// mask of (unescaped) quotes this yields the mask of bytes which are inside
+// of a string, including the opening quote and excluding the closing quote.
+static inline uint64_t prefix_xor(uint64_t bits) {
+#if defined(__PCLMUL__)
+  __m128i all_ones = _mm_set1_epi8((char)0xff);
+  __m128i result = _mm_clmulepi64_si128(_mm_set_epi64x(0, (int64_t)bits),
+                                        all_ones, 0);
+  return (uint64_t)_mm_cvtsi128_si64(result);
+#else
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+#endif
+}
+
+// Return the mask of bytes which are escaped by a backslash. A backslash
+// escapes the following byte unless it is itself escaped, so only the odd
+// numbered backslash of a run is an escape. `next_escaped` carries whether
+// the first byte of the next block is escaped.
+static inline uint64_t find_escaped(uint64_t backslash,
+                                    uint64_t* next_escaped) {
+  const uint64_t kOddBits = 0xAAAAAAAAAAAAAAAAull;
+  if (!backslash) {
+    uint64_t escaped = *next_escaped;
+    *next_escaped = 0;
+    return escaped;
+  }
+
+  // A backslash which is escaped by the last byte of the previous block is
+  // not an escape.
+  uint64_t potential_escape = backslash & ~(*next_escaped);
+
+  // Subtracting the backslash runs from the odd bits leaves, for each run,
+  // alternating bits that start from the beginning of the run rather than
+  // from an odd position. Xor'ing with the odd bits again then leaves a one
+  // for each escape in the run and for the byte that terminates the run if
+  // it is escaped.
+  uint64_t maybe_escaped = potential_escape << 1;
+  uint64_t escape_and_terminal =
+      ((maybe_escaped | kOddBits) - potential_escape) ^ kOddBits;
+  uint64_t escaped = escape_and_terminal ^ (backslash | *next_escaped);
+  uint64_t escape = escape_and_terminal & backslash;
+  *next_escaped = escape >> 63;
+  return escaped;
+}
+
+// -----------------------------------------------------------------------------
+//    Indexing
+// -----------------------------------------------------------------------------
+
+struct IndexState {
+  uint64_t next_escaped;    //< 1 if the first byte of the next block is escaped
+  uint64_t prev_in_string;  //< all ones if the last block ended in a string
+  uint64_t prev_scalar;     //< 1 if the last block ended in a literal
+  uint64_t last_open;       //< offset of the most recent opening quote
+  uint32_t* buf;
+  uint64_t n;
+  uint64_t count;
+};
+
+static inline void flatten_bits(struct IndexState* state, uint64_t offset,
+                                uint64_t bits) {
+  if (state->count + 64 <= state->n) {
+    uint32_t* out = state->buf + state->count;
+    state->count += __builtin_popcountll(bits);
+    while (bits) {
+      *out++ = (uint32_t)(offset + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+    return;
+  }
+
+  while (bits) {
+    if (state->count < state->n) {
+      state->buf[state->count] = (uint32_t)(offset + __builtin_ctzll(bits));
+    }
+    state->count++;
+    bits &= bits - 1;
+  }
+}
+
+static inline void process_block(struct IndexState* state,
+                                 const struct BlockMasks* masks,
+                                 uint64_t offset) {
+  uint64_t escaped = find_escaped(masks->backslash, &state->next_escaped);
+  uint64_t quote = masks->quote & ~escaped;
+  uint64_t in_string = prefix_xor(quote) ^ state->prev_in_string;
+  state->prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+  uint64_t open_quote = quote & in_string;
+  if (open_quote) {
+    state->last_open = offset + 63 - __builtin_clzll(open_quote);
+  }
+
+  // Anything that is not punctuation, whitespace, or part of a string is part
+  // of a literal. Only the first byte of each run is a structural.
+  uint64_t scalar =
+      ~(masks->punctuation | masks->whitespace | quote | in_string);
+  uint64_t scalar_start = scalar & ~((scalar << 1) | state->prev_scalar);
+  state->prev_scalar = scalar >> 63;
+
+  flatten_bits(state, offset,
+               (masks->punctuation & ~in_string) | open_quote | scalar_start);
+}
+
+// Fill `loc` with the line and column of `offset` within `source`. This is
+// only used for error reporting.
+static void locate_offset(struct tjson_StringPiece source, uint32_t offset,
+                          struct tjson_SourceLocation* loc) {
+  loc->lineno = 0;
+  loc->colno = 0;
+  loc->offset = offset;
+  for (uint32_t idx = 0; idx < offset; idx++) {
+    if (source.begin[idx] == '\n') {
+      loc->lineno++;
+      loc->colno = 0;
+    } else {
+      loc->colno++;
+    }
+  }
+}
+
+static int64_t index_structurals(struct tjson_StringPiece source,
+                                 uint32_t* buf, uint64_t n,
+                                 struct tjson_Error* error,
+                                 void (*classify)(const char*,
+                                                  struct BlockMasks*)) {
+  uint64_t size = tjson_StringPiece_size(source);
+  if (size > UINT32_MAX) {
+    error->code = TJSON_PARSE_OVERFLOW;
+    error->loc.lineno = 0;
+    error->loc.colno = 0;
+    error->loc.offset = 0;
+    snprintf(error->msg, sizeof(error->msg),
+             "Source of %llu bytes is too large for a 32-bit index",
+             (unsigned long long)size);
+    return -1;
+  }
+
+  struct IndexState state;
+  memset(&state, 0, sizeof(state));
+  state.buf = buf;
+  state.n = buf ? n : 0;
+
+  struct BlockMasks masks;
+  uint64_t offset = 0;
+  for (; offset + 64 <= size; offset += 64) {
+    classify(source.begin + offset, &masks);
+    process_block(&state, &masks, offset);
+  }
+
+  if (offset < size) {
+    // Pad the tail with whitespace, which is never structural
+    char block[64];
+    memset(block, ' ', sizeof(block));
+    memcpy(block, source.begin + offset, size - offset);
+    classify(block, &masks);
+    process_block(&state, &masks, offset);
+  }
+
+  if (state.prev_in_string) {
+    error->code = TJSON_LEX_INVALID_TOKEN;
+    locate_offset(source, (uint32_t)state.last_open, &error->loc);
+    snprintf(error->msg, sizeof(error->msg),
+             "Unterminated string literal starting at %d:%d",
+             (int)error->loc.lineno, (int)error->loc.colno);
+    return -1;
+  }
+
+  return (int64_t)state.count;
+}
+
+int64_t tjson_index_structurals(struct tjson_StringPiece source, uint32_t* buf,
+                                uint64_t n, struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  return index_structurals(source, buf, n, error, classify_simd);
+}
+
+int64_t tjson_index_structurals_scalar(struct tjson_StringPiece source,
+                                       uint32_t* buf, uint64_t n,
+                                       struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  return index_structurals(source, buf, n, error, classify_scalar);
+}
+
+// -----------------------------------------------------------------------------
+//    Bracket Index
+// -----------------------------------------------------------------------------
+
+// An open group while matching brackets
+struct OpenBracket {
+  uint32_t idx;       //< index of the group in the output
+  uint32_t offset;    //< offset of the opening bracket
+  uint32_t ncommas;   //< number of commas directly within the group
+  char close;         //< the bracket which closes this group
+  int8_t nonempty;    //< the group contains at least one element
+};
+
+int64_t tjson_index_brackets(struct tjson_StringPiece source,
+                             const uint32_t* structurals, uint32_t nstructurals,
+                             struct tjson_Bracket* buf, uint64_t n,
+                             struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  if (!buf) {
+    n = 0;
+  }
+
+  // NOTE(josh): the depth limit is the same as that of the parser
+  struct OpenBracket stack[TJSON_GROUP_STACK_CAPACITY];
+  const uint32_t max_depth = TJSON_GROUP_STACK_CAPACITY;
+  uint32_t depth = 0;
+  uint32_t nbrackets = 0;
+
+  for (uint32_t idx = 0; idx < nstructurals; idx++) {
+    uint32_t offset = structurals[idx];
+    char c = source.begin[offset];
+    struct OpenBracket* top = depth ? &stack[depth - 1] : NULL;
+    switch (c) {
+      case '{':
+      case '[':
+        if (top) {
+          top->nonempty = 1;
+        }
+        if (depth == max_depth) {
+          error->code = TJSON_PARSE_OVERFLOW;
+          locate_offset(source, offset, &error->loc);
+          snprintf(error->msg, sizeof(error->msg),
+                   "Groups are nested more than %d deep at %d:%d",
+                   (int)max_depth, (int)error->loc.lineno,
+                   (int)error->loc.colno);
+          return -1;
+        }
+        if (nbrackets < n) {
+          buf[nbrackets].open = offset;
+        }
+        top = &stack[depth++];
+        top->idx = nbrackets++;
+        top->offset = offset;
+        top->ncommas = 0;
+        top->close = (c == '{') ? '}' : ']';
+        top->nonempty = 0;
+        break;
+
+      case '}':
+      case ']':
+        if (!top || top->close != c) {
+          error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+          locate_offset(source, offset, &error->loc);
+          snprintf(error->msg, sizeof(error->msg),
+                   "Unmatched '%c' at %d:%d", c, (int)error->loc.lineno,
+                   (int)error->loc.colno);
+          return -1;
+        }
+        if (top->idx < n) {
+          buf[top->idx].close = offset;
+          buf[top->idx].close_idx = idx;
+          buf[top->idx].count = top->nonempty ? top->ncommas + 1 : 0;
+        }
+        depth--;
+        break;
+
+      case ',':
+        if (top) {
+          top->ncommas++;
+        }
+        break;
+
+      default:
+        if (top) {
+          top->nonempty = 1;
+        }
+        break;
+    }
+  }
+
+  if (depth) {
+    error->code = TJSON_PARSE_UNEXPECTED_TOKEN;
+    locate_offset(source, stack[depth - 1].offset, &error->loc);
+    snprintf(error->msg, sizeof(error->msg),
+             "Unclosed '%c' starting at %d:%d",
+             stack[depth - 1].close == '}' ? '{' : '[',
+             (int)error->loc.lineno, (int)error->loc.colno);
+    return -1;
+  }
+
+  return nbrackets;
+}
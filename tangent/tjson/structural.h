@@ -0,0 +1,76 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Structural Index
+// -----------------------------------------------------------------------------
+// A vectorized pre-pass over the source which finds the byte offset of every
+// "structural" character. A structural is any one of:
+//
+//   * punctuation outside of a string literal: `{`, `}`, `[`, `]`, `:`, `,`
+//   * the opening quote of a string literal
+//   * the first character of any other literal (number, true, false, null) or
+//     of a run of garbage outside of a string literal
+//
+// The source is classified in 64-byte blocks into bitmasks of quotes,
+// backslashes, punctuation and whitespace. Escaped quotes are removed and the
+// in-string regions are then resolved with a prefix-xor (carry-less multiply
+// where available). Everything between two consecutive structurals is either
+// the body of a literal or whitespace, so a scanner which is given the index
+// can skip over string literals and whitespace runs without looking at each
+// byte.
+//
+// SSE2 or AVX2 are used when the compiler targets them (i.e. `__SSE2__` or
+// `__AVX2__` are defined), otherwise a portable scalar classifier is used. The
+// resulting index is identical in all cases.
+
+// Compute the structural index of `source` and store the offsets (relative to
+// `source.begin`) in `buf`. Return the number of structurals in the source
+// (which may be greater than `n`, in which case only the first `n` are
+// stored), or -1 on error. The only error is a string literal which is not
+// terminated before the end of the source.
+int64_t tjson_index_structurals(struct tjson_StringPiece source, uint32_t* buf,
+                                uint64_t n, struct tjson_Error* error);
+
+// Same as above but always use the scalar (non-vectorized) classifier. This
+// is used to validate the vectorized kernels.
+int64_t tjson_index_structurals_scalar(struct tjson_StringPiece source,
+                                       uint32_t* buf, uint64_t n,
+                                       struct tjson_Error* error);
+
+// -----------------------------------------------------------------------------
+//    Bracket Index
+// -----------------------------------------------------------------------------
+// Built from the structural index, the bracket index maps each `{` or `[` to
+// its matching close and records the number of elements in the group. With
+// the bracket index a LexerParser can skip over a group or count the items
+// of a list without lexing its contents (see tjson_LexerParser_set_brackets).
+
+typedef struct tjson_Bracket {
+  uint32_t open;       //< offset of the `{` or `[`
+  uint32_t close;      //< offset of the matching `}` or `]`
+  uint32_t close_idx;  //< index of `close` within the structural index
+  uint32_t count;      //< number of list items or object fields
+} tjson_Bracket;
+
+// Match the brackets of `source` given its structural index, and store one
+// entry per group in `buf`, in order of their opening bracket. Return the
+// number of groups in the source (which may be greater than `n`, in which case
+// only the first `n` are stored), or -1 if the brackets are not balanced or
+// are nested deeper than the parser allows.
+int64_t tjson_index_brackets(struct tjson_StringPiece source,
+                             const uint32_t* structurals, uint32_t nstructurals,
+                             struct tjson_Bracket* buf, uint64_t n,
+                             struct tjson_Error* error);
+
+#if __cplusplus
+}  // extern "C"
+#endif
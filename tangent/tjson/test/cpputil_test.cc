@@ -0,0 +1,207 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <array>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/cpputil.h"
+#include "tangent/tjson/ostream.h"
+
+TEST(ArenaTest, AllocatesInOrderFromOneBlock) {
+  tjson::Arena arena{1024};
+  EXPECT_EQ(1024u, arena.capacity());
+  void* first = arena.allocate(10, 1);
+  void* second = arena.allocate(8, 8);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(second) % 8);
+  EXPECT_LT(first, second);
+  EXPECT_EQ(static_cast<char*>(second) + 8,
+            static_cast<char*>(first) + arena.used());
+
+  // The most recent allocation is given back, others are not
+  arena.deallocate(second, 8, 8);
+  EXPECT_EQ(second, arena.allocate(8, 8));
+  arena.deallocate(first, 10, 1);
+  EXPECT_LT(second, arena.allocate(1, 1));
+  EXPECT_EQ(0u, arena.overflow());
+}
+
+TEST(ArenaTest, OverflowsToUpstream) {
+  tjson::Arena arena{64};
+  EXPECT_NE(nullptr, arena.allocate(48, 8));
+  EXPECT_EQ(0u, arena.overflow());
+  EXPECT_NE(nullptr, arena.allocate(48, 8));
+  EXPECT_LE(64u, arena.overflow());
+  EXPECT_NE(nullptr, arena.allocate(256, 8));
+  EXPECT_LE(64u + 256u, arena.overflow());
+}
+
+TEST(ArenaTest, ParsesIntoMeasuredArena) {
+  std::string source =
+      "[[\"a string which is too long for the small string optimization\", "
+      "\"b\"], [], [\"c\", \"d\", \"e\", \"f\", \"g\"]]";
+  tjson::Arena arena{
+      tjson_StringPiece{source.data(), source.data() + source.size()}};
+  using Lists = std::pmr::vector<std::pmr::vector<std::pmr::string>>;
+  Lists* lists = tjson::parse_json<Lists>(
+      tjson_StringPiece{source.data(), source.data() + source.size()}, &arena,
+      source);
+  ASSERT_EQ(3u, lists->size());
+  EXPECT_EQ("a string which is too long for the small string optimization",
+            (*lists)[0][0]);
+  EXPECT_EQ(5u, (*lists)[2].size());
+  EXPECT_EQ("g", (*lists)[2][4]);
+  EXPECT_EQ(&arena, (*lists)[2].get_allocator().resource());
+  EXPECT_EQ(&arena, (*lists)[0][0].get_allocator().resource());
+  EXPECT_LT(0u, arena.used());
+  EXPECT_EQ(0u, arena.overflow());
+}
+
+TEST(CppUtilTest, ParsesStandardTypes) {
+  struct {
+    std::array<int32_t, 3> array;
+    std::map<std::string, std::vector<double>> map;
+    std::unordered_map<std::string, std::optional<std::string>> umap;
+    std::string_view view;
+  } value;
+
+  tjson::parse_json("[1, 2, 3]", &value.array);
+  EXPECT_EQ((std::array<int32_t, 3>{1, 2, 3}), value.array);
+  tjson::parse_json("[4]", &value.array);
+  EXPECT_EQ((std::array<int32_t, 3>{4, 0, 0}), value.array);
+  EXPECT_THROW(tjson::parse_json("[1, 2, 3, 4]", &value.array),
+               std::exception);
+
+  tjson::parse_json("{\"b\": [1.5], \"a\": [], \"c\": [2, 3]}", &value.map);
+  EXPECT_EQ((std::map<std::string, std::vector<double>>{
+                {"a", {}}, {"b", {1.5}}, {"c", {2, 3}}}),
+            value.map);
+  tjson::parse_json("{\"d\": [4]}", &value.map);
+  EXPECT_EQ((std::map<std::string, std::vector<double>>{{"d", {4}}}),
+            value.map);
+
+  tjson::parse_json("{\"x\": \"foo\", \"y\": null}", &value.umap);
+  ASSERT_EQ(2u, value.umap.size());
+  EXPECT_EQ("foo", value.umap["x"].value());
+  EXPECT_FALSE(value.umap["y"].has_value());
+
+  std::string source = "\"some text\"";
+  tjson::parse_json(source, &value.view);
+  EXPECT_EQ("some text", value.view);
+  EXPECT_EQ(source.data() + 1, value.view.data());
+  EXPECT_THROW(tjson::parse_json("\"escaped\\n\"", &value.view),
+               std::exception);
+  EXPECT_THROW(tjson::parse_json("12", &value.view), std::exception);
+}
+
+TEST(CppUtilTest, ParsesEscapedStrings) {
+  std::string value;
+  tjson::parse_json(R"("say \"hi\"\\ \u00e9\t")", &value);
+  EXPECT_EQ("say \"hi\"\\ \xc3\xa9\t", value);
+
+  // Strings written by the OStream parse back to the same bytes
+  std::vector<std::string> original = {"say \"hi\"\\ \xc3\xa9",
+                                       "a\xc3\xa9\n", "plain", ""};
+  std::stringstream strm;
+  {
+    tjson::OStream out{&strm, tjson_DefaultOpts};
+    out << original;
+  }
+  std::vector<std::string> parsed = {"stale contents of a previous document"};
+  tjson::parse_json(strm.str(), &parsed);
+  EXPECT_EQ(original, parsed) << strm.str();
+
+  std::pmr::vector<std::pmr::string> list;
+  tjson::Parser parser;
+  parser.parse_into(R"(["a\u00e9\n", "\ud83d\ude00", "b"])", &list);
+  EXPECT_EQ((std::pmr::vector<std::pmr::string>{"a\xc3\xa9\n",
+                                                "\xf0\x9f\x98\x80", "b"}),
+            list);
+}
+
+// Memory resource which counts its allocations
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  size_t nallocs = 0;
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    nallocs++;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST(CppUtilTest, ParseIntoReusesStorage) {
+  using Lists = std::pmr::vector<std::pmr::vector<std::pmr::string>>;
+  CountingResource resource;
+  Lists lists{&resource};
+  tjson::Parser parser;
+
+  parser.parse_into(
+      "[[\"a string which is too long for the small string optimization\"],"
+      " [\"b\", \"c\", \"d\"], []]",
+      &lists);
+  ASSERT_EQ(3u, lists.size());
+  EXPECT_EQ(3u, lists[1].size());
+  size_t nallocs = resource.nallocs;
+  const void* data = lists.data();
+
+  // A document of the same shape (or a smaller one) doesn't allocate
+  parser.parse_into(
+      "[[\"another string which is too long for the small string opt\"],"
+      " [\"e\", \"f\", \"g\"], []]",
+      &lists);
+  parser.parse_into("[[\"short\"], [\"h\"]]", &lists);
+  EXPECT_EQ(nallocs, resource.nallocs);
+  EXPECT_EQ(data, lists.data());
+  ASSERT_EQ(2u, lists.size());
+  EXPECT_EQ("short", lists[0][0]);
+  EXPECT_EQ((std::pmr::vector<std::pmr::string>{"h"}), lists[1]);
+}
+
+TEST(CppUtilTest, ParseIntoReusesMapEntries) {
+  using Map = std::pmr::map<std::pmr::string, std::pmr::vector<double>>;
+  CountingResource resource;
+  Map map{&resource};
+  tjson::Parser parser;
+
+  parser.parse_into("{\"a\": [1, 2, 3], \"b\": [4]}", &map);
+  size_t nallocs = resource.nallocs;
+  parser.parse_into("{\"b\": [5], \"a\": [6, 7, 8]}", &map);
+  EXPECT_EQ(nallocs, resource.nallocs);
+  EXPECT_EQ((Map{{"a", {6, 7, 8}}, {"b", {5}}}), map);
+
+  // Entries which are not in the object are erased, and repeated keys are
+  // parsed into the same entry.
+  parser.parse_into("{\"c\": [9], \"c\": [10, 11]}", &map);
+  EXPECT_EQ((Map{{"c", {10, 11}}}), map);
+}
+
+TEST(CppUtilTest, IndexedParseReservesLists) {
+  tjson::Parser parser{tjson::Parser::Options{true, true}};
+  std::vector<std::vector<uint32_t>> lists;
+  parser.parse_into("[[1, 2, 3, 4, 5], [6, 7, 8], [9]]", &lists);
+  ASSERT_EQ(3u, lists.size());
+  EXPECT_EQ(3u, lists.capacity());
+  EXPECT_EQ(5u, lists[0].capacity());
+  EXPECT_EQ(3u, lists[1].capacity());
+  EXPECT_EQ((std::vector<uint32_t>{6, 7, 8}), lists[1]);
+
+  // The index storage is reused for the next document, which is larger
+  parser.parse_into("[[1, 2], [3, 4, 5, 6, 7, 8, 9, 10], [11], [12]]", &lists);
+  ASSERT_EQ(4u, lists.size());
+  EXPECT_EQ(8u, lists[1].capacity());
+  EXPECT_EQ(12u, lists[3][0]);
+}
@@ -0,0 +1,143 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/document.h"
+
+static tjson_StringPiece to_piece(const std::string& str) {
+  return tjson_StringPiece{str.data(), str.data() + str.size()};
+}
+
+static std::string to_string(tjson_StringPiece piece) {
+  return std::string(piece.begin, piece.end);
+}
+
+static tjson_Node field(tjson_Node node, const char* key) {
+  tjson_Node value{};
+  EXPECT_EQ(0, tjson_Node_find_field(node, tjson_StringPiece_fromstr(key),
+                                     &value))
+      << key;
+  return value;
+}
+
+TEST(DocumentTest, Navigate) {
+  std::string source =
+      "{\n"
+      "  \"name\": \"tape \\\"test\\\"\\n\",\n"
+      "  \"ints\": [1, -2, 18446744073709551615, 1e2],\n"
+      "  \"nested\": {\"a\": {\"b\": [[], {}, [null]]}, \"c\": true},\n"
+      "  \"pi\": 3.25,\n"
+      "  \"off\": false\n"
+      "}";
+  tjson_Document doc;
+  tjson_Error error{};
+  ASSERT_EQ(0, tjson_Document_parse(&doc, to_piece(source), &error))
+      << error.msg;
+
+  tjson_Node root = tjson_Document_root(&doc);
+  ASSERT_EQ(TJSON_NODE_OBJECT, tjson_Node_type(root));
+  EXPECT_EQ(5u, tjson_Node_size(root));
+
+  tjson_StringPiece name;
+  ASSERT_EQ(0, tjson_Node_get_string(field(root, "name"), &name));
+  EXPECT_EQ("tape \"test\"\n", to_string(name));
+  EXPECT_EQ('\0', *name.end);
+
+  tjson_Node ints = field(root, "ints");
+  ASSERT_EQ(TJSON_NODE_LIST, tjson_Node_type(ints));
+  EXPECT_EQ(4u, tjson_Node_size(ints));
+  const tjson_NodeTypeNo expect_types[] = {TJSON_NODE_INT64, TJSON_NODE_INT64,
+                                           TJSON_NODE_UINT64,
+                                           TJSON_NODE_DOUBLE};
+  tjson_Node end = tjson_Node_end(ints);
+  uint32_t idx = 0;
+  for (tjson_Node item = tjson_Node_begin(ints); item.idx != end.idx;
+       item = tjson_Node_next(item), idx++) {
+    ASSERT_LT(idx, 4u);
+    EXPECT_EQ(expect_types[idx], tjson_Node_type(item)) << idx;
+  }
+  EXPECT_EQ(4u, idx);
+
+  tjson_Node item;
+  int64_t ivalue = 0;
+  uint64_t uvalue = 0;
+  ASSERT_EQ(0, tjson_Node_at(ints, 1, &item));
+  EXPECT_EQ(0, tjson_Node_get_int64(item, &ivalue));
+  EXPECT_EQ(-2, ivalue);
+  EXPECT_EQ(-1, tjson_Node_get_uint64(item, &uvalue));
+  ASSERT_EQ(0, tjson_Node_at(ints, 2, &item));
+  EXPECT_EQ(0, tjson_Node_get_uint64(item, &uvalue));
+  EXPECT_EQ(UINT64_MAX, uvalue);
+  EXPECT_EQ(-1, tjson_Node_get_int64(item, &ivalue));
+  ASSERT_EQ(0, tjson_Node_at(ints, 3, &item));
+  EXPECT_EQ(0, tjson_Node_get_int64(item, &ivalue));
+  EXPECT_EQ(100, ivalue);
+  EXPECT_EQ(-1, tjson_Node_at(ints, 4, &item));
+
+  tjson_Node b = field(field(field(root, "nested"), "a"), "b");
+  EXPECT_EQ(3u, tjson_Node_size(b));
+  ASSERT_EQ(0, tjson_Node_at(b, 0, &item));
+  EXPECT_EQ(0u, tjson_Node_size(item));
+  ASSERT_EQ(0, tjson_Node_at(b, 1, &item));
+  EXPECT_EQ(TJSON_NODE_OBJECT, tjson_Node_type(item));
+  ASSERT_EQ(0, tjson_Node_at(b, 2, &item));
+  ASSERT_EQ(0, tjson_Node_at(item, 0, &item));
+  EXPECT_EQ(TJSON_NODE_NULL, tjson_Node_type(item));
+
+  int8_t flag = 0;
+  EXPECT_EQ(0, tjson_Node_get_boolean(field(field(root, "nested"), "c"),
+                                      &flag));
+  EXPECT_EQ(1, flag);
+  EXPECT_EQ(0, tjson_Node_get_boolean(field(root, "off"), &flag));
+  EXPECT_EQ(0, flag);
+
+  double dvalue = 0;
+  EXPECT_EQ(0, tjson_Node_get_double(field(root, "pi"), &dvalue));
+  EXPECT_EQ(3.25, dvalue);
+  EXPECT_EQ(-1, tjson_Node_get_int64(field(root, "pi"), &ivalue));
+  EXPECT_EQ(-1, tjson_Node_find_field(root, tjson_StringPiece_fromstr("nope"),
+                                      &item));
+
+  tjson_Document_free(&doc);
+}
+
+TEST(DocumentTest, ScalarRoot) {
+  for (const char* source : {"12", " \"x\" ", "null", "-1.5e3"}) {
+    tjson_Document doc;
+    tjson_Error error{};
+    ASSERT_EQ(0, tjson_Document_parse(&doc, tjson_StringPiece_fromstr(source),
+                                      &error))
+        << source << ": " << error.msg;
+    EXPECT_EQ(0u, tjson_Node_size(tjson_Document_root(&doc)));
+    tjson_Document_free(&doc);
+  }
+}
+
+TEST(DocumentTest, LargeCount) {
+  // More items than fit in the count field of the tape entry
+  std::string source = "[";
+  for (uint32_t idx = 0; idx < 0x1000001; idx++) {
+    source += idx ? ",0" : "0";
+  }
+  source += "]";
+  tjson_Document doc;
+  tjson_Error error{};
+  ASSERT_EQ(0, tjson_Document_parse(&doc, to_piece(source), &error))
+      << error.msg;
+  EXPECT_EQ(0x1000001u, tjson_Node_size(tjson_Document_root(&doc)));
+  tjson_Document_free(&doc);
+}
+
+TEST(DocumentTest, Errors) {
+  for (const char* source : {"", "   ", "[1, 2", "{\"a\": }", "[1 2]", "{1: 2}",
+                             "[1, 2]]", "\"unterminated"}) {
+    tjson_Document doc;
+    tjson_Error error{};
+    EXPECT_EQ(-1, tjson_Document_parse(&doc, tjson_StringPiece_fromstr(source),
+                                       &error))
+        << source;
+    EXPECT_NE(TJSON_NOERROR, error.code) << source;
+    EXPECT_EQ(nullptr, doc._block) << source;
+  }
+}
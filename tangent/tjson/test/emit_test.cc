@@ -0,0 +1,205 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/emit.h"
+
+template <class T, class Emit>
+static std::string emit(Emit fn, T value) {
+  char text[64];
+  tjson_WriteBuffer buf;
+  tjson_WriteBuffer_init(&buf, text, text + sizeof(text));
+  fn(&buf, value);
+  EXPECT_EQ(0u, buf.overflow);
+  return std::string(text, buf.begin);
+}
+
+static std::string emit_string(const std::string& value) {
+  char text[256];
+  tjson_WriteBuffer buf;
+  tjson_WriteBuffer_init(&buf, text, text + sizeof(text));
+  tjson_emit_charbuf(&buf, value.data(), value.data() + value.size());
+  EXPECT_EQ(0u, buf.overflow);
+  return std::string(text, buf.begin);
+}
+
+TEST(EmitTest, Integers) {
+  EXPECT_EQ("0", emit(tjson_emit_uint64, 0ull));
+  EXPECT_EQ("7", emit(tjson_emit_uint64, 7ull));
+  EXPECT_EQ("10", emit(tjson_emit_uint64, 10ull));
+  EXPECT_EQ("100", emit(tjson_emit_uint64, 100ull));
+  EXPECT_EQ("18446744073709551615",
+            emit(tjson_emit_uint64, std::numeric_limits<uint64_t>::max()));
+  EXPECT_EQ("4294967295", emit(tjson_emit_uint32, UINT32_MAX));
+  EXPECT_EQ("65535", emit(tjson_emit_uint16, uint16_t(UINT16_MAX)));
+  EXPECT_EQ("255", emit(tjson_emit_uint8, uint8_t(UINT8_MAX)));
+
+  EXPECT_EQ("-1", emit(tjson_emit_int64, int64_t(-1)));
+  EXPECT_EQ("-9223372036854775808",
+            emit(tjson_emit_int64, std::numeric_limits<int64_t>::min()));
+  EXPECT_EQ("9223372036854775807",
+            emit(tjson_emit_int64, std::numeric_limits<int64_t>::max()));
+  EXPECT_EQ("-2147483648", emit(tjson_emit_int32, INT32_MIN));
+  EXPECT_EQ("-32768", emit(tjson_emit_int16, int16_t(INT16_MIN)));
+  EXPECT_EQ("-128", emit(tjson_emit_int8, int8_t(INT8_MIN)));
+
+  std::mt19937_64 rng(1234);
+  char expect[32];
+  for (int idx = 0; idx < 10000; idx++) {
+    int64_t value = static_cast<int64_t>(rng()) >> (rng() % 64);
+    snprintf(expect, sizeof(expect), "%lld", static_cast<long long>(value));
+    ASSERT_EQ(expect, emit(tjson_emit_int64, value));
+  }
+}
+
+TEST(EmitTest, Doubles) {
+  EXPECT_EQ("0.0", emit(tjson_emit_double, 0.0));
+  EXPECT_EQ("-0.0", emit(tjson_emit_double, -0.0));
+  EXPECT_EQ("1.0", emit(tjson_emit_double, 1.0));
+  EXPECT_EQ("0.1", emit(tjson_emit_double, 0.1));
+  EXPECT_EQ("0.3", emit(tjson_emit_double, 0.3));
+  EXPECT_EQ("0.30000000000000004", emit(tjson_emit_double, 0.1 + 0.2));
+  EXPECT_EQ("-123.456", emit(tjson_emit_double, -123.456));
+  EXPECT_EQ("100.0", emit(tjson_emit_double, 100.0));
+  EXPECT_EQ("0.0001", emit(tjson_emit_double, 1e-4));
+  EXPECT_EQ("1e-05", emit(tjson_emit_double, 1e-5));
+  EXPECT_EQ("100000000000000.0", emit(tjson_emit_double, 1e14));
+  EXPECT_EQ("1e+15", emit(tjson_emit_double, 1e15));
+  EXPECT_EQ("1.5e+300", emit(tjson_emit_double, 1.5e300));
+  EXPECT_EQ("1.7976931348623157e+308",
+            emit(tjson_emit_double, std::numeric_limits<double>::max()));
+  EXPECT_EQ("5e-324",
+            emit(tjson_emit_double, std::numeric_limits<double>::denorm_min()));
+  EXPECT_EQ("2.2250738585072014e-308",
+            emit(tjson_emit_double, std::numeric_limits<double>::min()));
+  EXPECT_EQ("null", emit(tjson_emit_double, std::nan("")));
+  EXPECT_EQ("null",
+            emit(tjson_emit_double, std::numeric_limits<double>::infinity()));
+
+  EXPECT_EQ("0.1", emit(tjson_emit_float, 0.1f));
+  EXPECT_EQ("3.4028235e+38",
+            emit(tjson_emit_float, std::numeric_limits<float>::max()));
+  EXPECT_EQ("1e-45",
+            emit(tjson_emit_float, std::numeric_limits<float>::denorm_min()));
+  EXPECT_EQ("123456.0", emit(tjson_emit_float, 123456.0f));
+  EXPECT_EQ("1.234567e+06", emit(tjson_emit_float, 1234567.0f));
+}
+
+TEST(EmitTest, DoublesRoundTrip) {
+  std::mt19937_64 rng(5678);
+  int nlonger = 0;
+  int nsamples = 0;
+  for (int idx = 0; idx < 100000; idx++) {
+    uint64_t bits = rng();
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    std::string text = emit(tjson_emit_double, value);
+    double parsed = strtod(text.c_str(), nullptr);
+    ASSERT_EQ(0, memcmp(&value, &parsed, sizeof(value))) << text;
+
+    // Compare the number of significant digits to the shortest round-trip
+    // %e. Positional notation may add zeros, so only check scientific.
+    if (text.find('e') == std::string::npos) {
+      continue;
+    }
+    char shortest[32];
+    int nshortest = 1;
+    for (; nshortest < 17; nshortest++) {
+      snprintf(shortest, sizeof(shortest), "%.*e", nshortest - 1, value);
+      if (strtod(shortest, nullptr) == value) {
+        break;
+      }
+    }
+    int ndigits = 0;
+    for (char c : text.substr(0, text.find('e'))) {
+      ndigits += ('0' <= c && c <= '9');
+    }
+    ASSERT_LE(nshortest, ndigits);
+    nlonger += (ndigits > nshortest);
+    nsamples++;
+  }
+  // Grisu2 is shortest for all but about 0.1% of values
+  EXPECT_LT(nlonger, nsamples / 500);
+
+  for (int idx = 0; idx < 100000; idx++) {
+    uint32_t bits = static_cast<uint32_t>(rng());
+    float value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    std::string text = emit(tjson_emit_float, value);
+    float parsed = strtof(text.c_str(), nullptr);
+    ASSERT_EQ(0, memcmp(&value, &parsed, sizeof(value))) << text;
+  }
+}
+
+TEST(EmitTest, Literals) {
+  EXPECT_EQ("true", emit(tjson_emit_boolean, int8_t(1)));
+  EXPECT_EQ("false", emit(tjson_emit_boolean, int8_t(0)));
+}
+
+TEST(EmitTest, Strings) {
+  EXPECT_EQ("\"\"", emit_string(""));
+  EXPECT_EQ("\"hello\"", emit_string("hello"));
+  EXPECT_EQ("\"a\\\"b\\\\c\"", emit_string("a\"b\\c"));
+  EXPECT_EQ("\"\\b\\f\\n\\r\\t\\u0001\\u001f\"",
+            emit_string("\b\f\n\r\t\x01\x1f"));
+  EXPECT_EQ("\"caf\xc3\xa9 \x7f\"", emit_string("caf\xc3\xa9 \x7f"));
+  std::string nul("a\0b", 3);
+  EXPECT_EQ("\"a\\u0000b\"", emit_string(nul));
+
+  // Escapes at every position of a vector
+  for (size_t idx = 0; idx < 70; idx++) {
+    std::string value(70, 'x');
+    value[idx] = '\n';
+    std::string expect = "\"" + std::string(idx, 'x') + "\\n" +
+                         std::string(69 - idx, 'x') + "\"";
+    ASSERT_EQ(expect, emit_string(value)) << idx;
+  }
+
+  char text[16];
+  tjson_WriteBuffer buf;
+  tjson_WriteBuffer_init(&buf, text, text + sizeof(text));
+  tjson_emit_string(&buf, "nul");
+  EXPECT_EQ("\"nul\"", std::string(text, buf.begin));
+}
+
+TEST(EmitTest, Overflow) {
+  char text[8];
+  tjson_WriteBuffer buf;
+  tjson_WriteBuffer_init(&buf, text, text + sizeof(text));
+  tjson_emit_uint32(&buf, 1234);
+  tjson_emit_raw(&buf, ",", 1);
+  EXPECT_EQ(0u, buf.overflow);
+  EXPECT_EQ("1234,", std::string(text, buf.begin));
+
+  // Doesn't fit, so nothing more is written even if it would fit
+  tjson_emit_string(&buf, "hello");
+  tjson_emit_raw(&buf, ",", 1);
+  tjson_emit_double(&buf, 0.5);
+  EXPECT_EQ("1234,", std::string(text, buf.begin));
+  EXPECT_EQ(7u + 1u + 3u, buf.overflow);
+
+  // The bytes written plus the overflow are what is needed
+  size_t needed = (buf.begin - text) + buf.overflow;
+  std::string big(needed, '\0');
+  tjson_WriteBuffer_init(&buf, &big[0], &big[0] + big.size());
+  tjson_emit_uint32(&buf, 1234);
+  tjson_emit_raw(&buf, ",", 1);
+  tjson_emit_string(&buf, "hello");
+  tjson_emit_raw(&buf, ",", 1);
+  tjson_emit_double(&buf, 0.5);
+  EXPECT_EQ(0u, buf.overflow);
+  EXPECT_EQ("1234,\"hello\",0.5", big);
+}
@@ -0,0 +1,105 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/cpputil.h"
+#include "tangent/tjson/file.h"
+
+// Write `content` to a new temporary file and return its path
+static std::string write_temp(const std::string& content) {
+  char path[] = "/tmp/tjson_file_test.XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_LE(0, fd);
+  EXPECT_EQ(static_cast<ssize_t>(content.size()),
+            write(fd, content.data(), content.size()));
+  close(fd);
+  return path;
+}
+
+static std::string to_string(tjson_StringPiece piece) {
+  return std::string(piece.begin, piece.end);
+}
+
+TEST(FileTest, MapsRegularFile) {
+  std::string content = "{\"a\": [1, 2, 3]}\n";
+  std::string path = write_temp(content);
+  tjson_File file;
+  tjson_Error error{};
+  ASSERT_EQ(0, tjson_File_open(&file, path.c_str(), &error)) << error.msg;
+  EXPECT_NE(nullptr, file._map);
+  EXPECT_EQ(content, to_string(file.content));
+  EXPECT_EQ(0, tjson_verify_parse_piece(file.content, &error)) << error.msg;
+  tjson_File_close(&file);
+  EXPECT_EQ(nullptr, file.content.begin);
+
+  // An empty file has nothing to map
+  std::string empty_path = write_temp("");
+  ASSERT_EQ(0, tjson_File_open(&file, empty_path.c_str(), &error))
+      << error.msg;
+  EXPECT_EQ(0u, tjson_StringPiece_size(file.content));
+  tjson_File_close(&file);
+
+  unlink(path.c_str());
+  unlink(empty_path.c_str());
+}
+
+TEST(FileTest, ReadsPipe) {
+  // More than fits in the pipe, or in the initial read buffer
+  std::string content = "[";
+  for (int idx = 0; idx < 100000; idx++) {
+    content += idx ? ", 12345" : "12345";
+  }
+  content += "]";
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  std::thread writer([&]() {
+    size_t offset = 0;
+    while (offset < content.size()) {
+      ssize_t nwritten =
+          write(fds[1], content.data() + offset, content.size() - offset);
+      ASSERT_LT(0, nwritten);
+      offset += nwritten;
+    }
+    close(fds[1]);
+  });
+
+  tjson_File file;
+  tjson_Error error{};
+  int result = tjson_File_open_fd(&file, fds[0], &error);
+  writer.join();
+  close(fds[0]);
+  ASSERT_EQ(0, result) << error.msg;
+  EXPECT_EQ(nullptr, file._map);
+  EXPECT_EQ(content, to_string(file.content));
+  tjson_File_close(&file);
+}
+
+TEST(FileTest, Errors) {
+  tjson_File file;
+  tjson_Error error{};
+  EXPECT_EQ(-1, tjson_File_open(&file, "/nonexistent/file.json", &error));
+  EXPECT_EQ(TJSON_IO_ERROR, error.code);
+  EXPECT_NE(std::string::npos,
+            std::string(error.msg).find("/nonexistent/file.json"));
+}
+
+TEST(FileTest, ParseJsonFile) {
+  std::string path = write_temp("[1, 2, 3]");
+  std::vector<int32_t> value;
+  tjson::parse_json_file(path, &value);
+  EXPECT_EQ((std::vector<int32_t>{1, 2, 3}), value);
+  unlink(path.c_str());
+
+  path = write_temp("[1, 2,");
+  value.clear();
+  EXPECT_ANY_THROW(tjson::parse_json_file(path, &value));
+  unlink(path.c_str());
+  EXPECT_ANY_THROW(tjson::parse_json_file("/nonexistent/file.json", &value));
+}
@@ -0,0 +1,136 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/keytable.h"
+#include "tangent/tjson/parse.h"
+#include "tangent/tjson/tjson.h"
+
+static std::string to_string(tjson_StringPiece str) {
+  return std::string(str.begin, str.end);
+}
+
+TEST(KeyTableTest, InternAssignsStableIds) {
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+
+  // Keys which share their first and last eight bytes, or are prefixes of
+  // each other, are still distinct.
+  std::vector<std::string> keys = {
+      "",
+      "a",
+      "abcdefgh",
+      "abcdefghi",
+      "a_long_key_which_is_0123456789",
+      "a_long_key_which_Is_0123456789",
+      "a_long_key_which_is_00123456789",
+  };
+  std::vector<uint32_t> ids;
+  for (const std::string& key : keys) {
+    ids.push_back(tjson_KeyTable_intern(
+        table.get(), tjson_StringPiece_fromstr(key.c_str())));
+    EXPECT_EQ(ids.size(), ids.back()) << key;
+  }
+  EXPECT_EQ(keys.size(), table->nkeys);
+
+  for (size_t idx = 0; idx < keys.size(); idx++) {
+    EXPECT_EQ(ids[idx], tjson_KeyTable_intern(table.get(),
+                                              tjson_StringPiece_fromstr(
+                                                  keys[idx].c_str())));
+    EXPECT_EQ(keys[idx], to_string(tjson_KeyTable_get(table.get(), ids[idx])));
+  }
+  EXPECT_EQ(keys.size(), table->nkeys);
+  EXPECT_EQ("", to_string(tjson_KeyTable_get(table.get(), 0)));
+  EXPECT_EQ("", to_string(tjson_KeyTable_get(table.get(), 100)));
+}
+
+TEST(KeyTableTest, StopsInterningWhenFull) {
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+
+  uint32_t ninterned = 0;
+  for (int idx = 0; idx < 2 * TJSON_KEYTABLE_CAPACITY; idx++) {
+    std::string key = "key" + std::to_string(idx);
+    uint32_t id = tjson_KeyTable_intern(table.get(),
+                                        tjson_StringPiece_fromstr(key.c_str()));
+    if (id) {
+      ninterned++;
+      EXPECT_EQ(key, to_string(tjson_KeyTable_get(table.get(), id)));
+    }
+  }
+  EXPECT_EQ(ninterned, table->nkeys);
+  EXPECT_LT(table->nkeys, static_cast<uint32_t>(TJSON_KEYTABLE_CAPACITY));
+  EXPECT_LT(TJSON_KEYTABLE_CAPACITY / 2, table->nkeys);
+}
+
+TEST(KeyTableTest, BindingsAreKeyedByShape) {
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+  int shape_a = 0;
+  int shape_b = 0;
+
+  int32_t value = -1;
+  EXPECT_EQ(0, tjson_KeyTable_lookup(table.get(), &shape_a, 1, &value));
+  tjson_KeyTable_bind(table.get(), &shape_a, 1, 7);
+  tjson_KeyTable_bind(table.get(), &shape_b, 1, 8);
+  tjson_KeyTable_bind(table.get(), &shape_a, 0, 9);
+  ASSERT_EQ(1, tjson_KeyTable_lookup(table.get(), &shape_a, 1, &value));
+  EXPECT_EQ(7, value);
+  ASSERT_EQ(1, tjson_KeyTable_lookup(table.get(), &shape_b, 1, &value));
+  EXPECT_EQ(8, value);
+  EXPECT_EQ(0, tjson_KeyTable_lookup(table.get(), &shape_a, 0, &value));
+  EXPECT_EQ(0, tjson_KeyTable_lookup(table.get(), &shape_a, 2, &value));
+}
+
+struct Record {
+  std::vector<uint32_t> keyids;
+  std::vector<std::string> keys;
+};
+
+static int record_keyitem(void* userdata, tjson_ParseContext ctx,
+                          tjson_StringPiece key, uint32_t keyid) {
+  Record* record = static_cast<Record*>(userdata);
+  record->keys.push_back(to_string(key));
+  record->keyids.push_back(keyid);
+  return tjson_sink_value(ctx);
+}
+
+TEST(KeyTableTest, ParseObjectInterned) {
+  std::unique_ptr<tjson_KeyTable> table{new tjson_KeyTable};
+  tjson_KeyTable_init(table.get());
+  tjson_Error error{};
+  tjson_LexerParser stream{};
+  ASSERT_EQ(0, tjson_LexerParser_init(&stream, &error)) << error.msg;
+
+  // Without a table every ID is zero
+  Record record;
+  tjson_ParseContext ctx{&stream, &error, nullptr};
+  ASSERT_EQ(0, tjson_LexerParser_begin(
+                   &stream, tjson_StringPiece_fromstr("{\"x\": 1, \"y\": 2}"),
+                   &error));
+  ASSERT_EQ(0, tjson_parse_object_interned(ctx, record_keyitem, &record))
+      << error.msg;
+  EXPECT_EQ((std::vector<uint32_t>{0, 0}), record.keyids);
+
+  // The table is kept across documents
+  tjson_LexerParser_set_keytable(&stream, table.get());
+  for (const char* source :
+       {"{\"x\": 1, \"y\": [2, 3]}", "{\"y\": {\"x\": 4}, \"z\": 5}"}) {
+    ASSERT_EQ(0, tjson_LexerParser_begin(
+                     &stream, tjson_StringPiece_fromstr(source), &error));
+    ASSERT_EQ(0, tjson_parse_object_interned(ctx, record_keyitem, &record))
+        << error.msg;
+  }
+  EXPECT_EQ((std::vector<std::string>{"x", "y", "x", "y", "y", "z"}),
+            record.keys);
+  EXPECT_EQ((std::vector<uint32_t>{0, 0, 1, 2, 2, 3}), record.keyids);
+
+  int32_t value = 0;
+  tjson_bind_key(ctx, table.get(), 3, 12);
+  ASSERT_EQ(1, tjson_lookup_key(ctx, table.get(), 3, &value));
+  EXPECT_EQ(12, value);
+  EXPECT_EQ(0, tjson_lookup_key(ctx, table.get(), 0, &value));
+}
@@ -273,3 +273,64 @@ TEST(LexerTest, ErrorOnMalformed) {
   EXPECT_EQ(11, error.loc.colno);
   EXPECT_EQ(24, error.loc.offset);
 }
+
+TEST(LexerTest, LocateOnDemand) {
+  std::string source =
+      "{\n"
+      "  \"foo\" : \"multi\\nline\",\n"
+      "\n"
+      "  \"bar\": [1, 2,\r\n"
+      "    3]}\n";
+  tjson_StringPiece piece{source.data(), source.data() + source.size()};
+
+  tjson_Error error{};
+  tjson_Scanner scanner;
+  ASSERT_EQ(0, tjson_Scanner_init(&scanner, &error));
+  ASSERT_EQ(0, tjson_Scanner_begin(&scanner, piece, &error));
+
+  std::vector<tjson_Token> tokens;
+  tjson_Token token;
+  while (tjson_Scanner_pump(&scanner, &token, &error) == 0) {
+    // Only the offset is computed while scanning
+    EXPECT_EQ(0u, token.location.lineno);
+    EXPECT_EQ(0u, token.location.colno);
+    tokens.push_back(token);
+  }
+  ASSERT_EQ(TJSON_LEX_INPUT_FINISHED, error.code);
+
+  // Reference line and column by counting from the beginning
+  auto expect_location = [&](const tjson_SourceLocation& loc) {
+    uint32_t lineno = 0;
+    uint32_t colno = 0;
+    for (uint32_t idx = 0; idx < loc.offset; idx++) {
+      if (source[idx] == '\n') {
+        lineno++;
+        colno = 0;
+      } else {
+        colno++;
+      }
+    }
+    EXPECT_EQ(lineno, loc.lineno) << "offset " << loc.offset;
+    EXPECT_EQ(colno, loc.colno) << "offset " << loc.offset;
+  };
+
+  // In order, in reverse, and then in order again
+  for (tjson_Token& tok : tokens) {
+    tjson_Scanner_locate(&scanner, &tok.location);
+    expect_location(tok.location);
+  }
+  for (size_t idx = tokens.size(); idx > 0; idx--) {
+    tjson_Scanner_locate(&scanner, &tokens[idx - 1].location);
+    expect_location(tokens[idx - 1].location);
+  }
+  for (tjson_Token& tok : tokens) {
+    tjson_Scanner_locate(&scanner, &tok.location);
+    expect_location(tok.location);
+  }
+
+  tjson_SourceLocation loc{};
+  loc.offset = source.size();
+  tjson_Scanner_locate(&scanner, &loc);
+  EXPECT_EQ(5u, loc.lineno);
+  EXPECT_EQ(0u, loc.colno);
+}
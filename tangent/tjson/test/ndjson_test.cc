@@ -0,0 +1,169 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/ndjson.h"
+
+struct Seen {
+  uint64_t lineno;
+  std::string line;
+  uint32_t nevents;
+  tjson_ErrorCode code;
+  uint32_t colno;
+};
+
+struct Collector {
+  std::mutex mutex;
+  std::vector<Seen> seen;
+  uint64_t stop_at = UINT64_MAX;
+};
+
+static int collect(void* context, const tjson_NdjsonRecord* record,
+                   tjson_Error* error) {
+  Collector* collector = static_cast<Collector*>(context);
+  std::lock_guard<std::mutex> lock(collector->mutex);
+  collector->seen.push_back(
+      {record->lineno, std::string(record->line.begin, record->line.end),
+       record->nevents, record->error ? record->error->code : TJSON_NOERROR,
+       record->error ? record->error->loc.colno : 0});
+  if (record->lineno >= collector->stop_at) {
+    error->code = TJSON_PARSE_SEMANTIC;
+    snprintf(error->msg, sizeof(error->msg), "stop");
+    return -1;
+  }
+  return 0;
+}
+
+static std::string make_lines(uint32_t count) {
+  std::string out;
+  for (uint32_t idx = 0; idx < count; idx++) {
+    out += "{\"id\": " + std::to_string(idx) + ", \"tags\": [\"a\", \"b\"]}\n";
+  }
+  return out;
+}
+
+static tjson_StringPiece piece(const std::string& str) {
+  return tjson_StringPiece{str.data(), str.data() + str.size()};
+}
+
+TEST(NdjsonTest, SingleThread) {
+  std::string source = "{\"a\": 1}\n\n  \n[1, 2]\r\n\"x\"";
+  Collector collector;
+  tjson_Error error{};
+  tjson_NdjsonOpts opts{};
+  opts.nthreads = 1;
+  ASSERT_EQ(3, tjson_parse_ndjson(piece(source), &opts, collect, &collector,
+                                  &error))
+      << error.msg;
+  ASSERT_EQ(3u, collector.seen.size());
+  EXPECT_EQ(0u, collector.seen[0].lineno);
+  EXPECT_EQ("{\"a\": 1}", collector.seen[0].line);
+  EXPECT_EQ(4u, collector.seen[0].nevents);
+  EXPECT_EQ(3u, collector.seen[1].lineno);
+  EXPECT_EQ(4u, collector.seen[1].nevents);
+  EXPECT_EQ(4u, collector.seen[2].lineno);
+  EXPECT_EQ(1u, collector.seen[2].nevents);
+}
+
+TEST(NdjsonTest, Ordered) {
+  std::string source = make_lines(20000);
+  for (uint32_t nthreads : {1, 2, 4, 8}) {
+    Collector collector;
+    tjson_Error error{};
+    tjson_NdjsonOpts opts{};
+    opts.nthreads = nthreads;
+    opts.chunk_size = 4096;
+    opts.ordered = 1;
+    ASSERT_EQ(20000, tjson_parse_ndjson(piece(source), &opts, collect,
+                                        &collector, &error))
+        << error.msg;
+    ASSERT_EQ(20000u, collector.seen.size());
+    for (uint64_t idx = 0; idx < collector.seen.size(); idx++) {
+      ASSERT_EQ(idx, collector.seen[idx].lineno) << nthreads;
+      ASSERT_EQ(9u, collector.seen[idx].nevents);
+    }
+  }
+}
+
+TEST(NdjsonTest, Unordered) {
+  std::string source = make_lines(20000);
+  Collector collector;
+  tjson_Error error{};
+  tjson_NdjsonOpts opts{};
+  opts.nthreads = 4;
+  opts.chunk_size = 4096;
+  ASSERT_EQ(20000, tjson_parse_ndjson(piece(source), &opts, collect,
+                                      &collector, &error))
+      << error.msg;
+  std::vector<bool> found(20000);
+  for (const Seen& seen : collector.seen) {
+    ASSERT_LT(seen.lineno, found.size());
+    EXPECT_FALSE(found[seen.lineno]);
+    found[seen.lineno] = true;
+    EXPECT_EQ("{\"id\": " + std::to_string(seen.lineno) +
+                  ", \"tags\": [\"a\", \"b\"]}",
+              seen.line);
+  }
+}
+
+TEST(NdjsonTest, LineErrors) {
+  std::string source = make_lines(1000);
+  // Replace whole lines so the line numbers are easy to predict
+  source += "{\"a\": [1, 2\n";
+  source += make_lines(10);
+  source += "[1 2]\n";
+  source += "tru\n";
+
+  for (int8_t ordered : {0, 1}) {
+    Collector collector;
+    tjson_Error error{};
+    tjson_NdjsonOpts opts{};
+    opts.nthreads = 4;
+    opts.chunk_size = 1024;
+    opts.ordered = ordered;
+    ASSERT_EQ(1013, tjson_parse_ndjson(piece(source), &opts, collect,
+                                       &collector, &error))
+        << error.msg;
+    std::vector<Seen> failed;
+    for (const Seen& seen : collector.seen) {
+      if (seen.code != TJSON_NOERROR) {
+        failed.push_back(seen);
+      }
+    }
+    ASSERT_EQ(3u, failed.size());
+    std::sort(failed.begin(), failed.end(),
+              [](const Seen& a, const Seen& b) { return a.lineno < b.lineno; });
+    EXPECT_EQ(1000u, failed[0].lineno);
+    EXPECT_EQ(TJSON_PARSE_UNEXPECTED_TOKEN, failed[0].code);
+    EXPECT_EQ(1011u, failed[1].lineno);
+    EXPECT_EQ(TJSON_PARSE_UNEXPECTED_TOKEN, failed[1].code);
+    EXPECT_EQ(3u, failed[1].colno);
+    EXPECT_EQ(1012u, failed[2].lineno);
+    EXPECT_EQ(TJSON_LEX_INVALID_TOKEN, failed[2].code);
+  }
+}
+
+TEST(NdjsonTest, CallbackStops) {
+  std::string source = make_lines(20000);
+  for (int8_t ordered : {0, 1}) {
+    Collector collector;
+    collector.stop_at = 100;
+    tjson_Error error{};
+    tjson_NdjsonOpts opts{};
+    opts.nthreads = 4;
+    opts.chunk_size = 4096;
+    opts.ordered = ordered;
+    EXPECT_EQ(-1, tjson_parse_ndjson(piece(source), &opts, collect,
+                                     &collector, &error));
+    EXPECT_EQ(TJSON_PARSE_SEMANTIC, error.code);
+    EXPECT_STREQ("stop", error.msg);
+    EXPECT_LT(collector.seen.size(), 20000u);
+    if (ordered) {
+      EXPECT_EQ(101u, collector.seen.size());
+    }
+  }
+}
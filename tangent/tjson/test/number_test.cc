@@ -0,0 +1,418 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <clocale>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/number.h"
+#include "tangent/tjson/parse.h"
+
+static tjson_StringPiece to_piece(const std::string& str) {
+  return tjson_StringPiece{str.data(), str.data() + str.size()};
+}
+
+static std::string to_string(tjson_StringPiece piece) {
+  return std::string(piece.begin, piece.end);
+}
+
+TEST(NumberTest, Grammar) {
+  for (const char* valid :
+       {"0", "-0", "1", "-1", "10", "0.5", "-0.5", "1.25e10", "1E+2", "1e-2",
+        "123456789012345678901234567890", "0e0", "1.0000000000000000000001"}) {
+    std::string source = valid;
+    EXPECT_EQ(source.data() + source.size(),
+              tjson_match_number(to_piece(source)))
+        << valid;
+  }
+
+  for (const char* invalid : {"", "-", "+1", ".5", "1.", "1.e5", "1e", "1e+",
+                              "-a", "inf", "nan", "0x10", "e5"}) {
+    std::string source = invalid;
+    const char* end = tjson_match_number(to_piece(source));
+    EXPECT_TRUE(end == nullptr || end < source.data() + source.size())
+        << invalid;
+  }
+
+  // A number stops at the first character that can't continue it
+  std::string source = "012";
+  EXPECT_EQ(source.data() + 1, tjson_match_number(to_piece(source)));
+  source = "12.3x4";
+  EXPECT_EQ(source.data() + 4, tjson_match_number(to_piece(source)));
+  source = "-7]";
+  EXPECT_EQ(source.data() + 2, tjson_match_number(to_piece(source)));
+}
+
+TEST(NumberTest, Spans) {
+  std::string source = "-12.0340e-7,";
+  tjson_Number number;
+  ASSERT_EQ(source.data() + 11, tjson_parse_number(to_piece(source), &number));
+  EXPECT_TRUE(number.negative);
+  EXPECT_EQ("12", to_string(number.integer));
+  EXPECT_EQ("0340", to_string(number.fraction));
+  EXPECT_EQ("7", to_string(number.exponent_digits));
+  EXPECT_EQ(120340u, number.mantissa);
+  EXPECT_EQ(-11, number.exponent);
+  EXPECT_FALSE(number.truncated);
+
+  source = "0.000125";
+  ASSERT_NE(nullptr, tjson_parse_number(to_piece(source), &number));
+  EXPECT_EQ(125u, number.mantissa);
+  EXPECT_EQ(-6, number.exponent);
+
+  source = "12345678901234567890123";
+  ASSERT_NE(nullptr, tjson_parse_number(to_piece(source), &number));
+  EXPECT_EQ(1234567890123456789u, number.mantissa);
+  EXPECT_EQ(4, number.exponent);
+  EXPECT_TRUE(number.truncated);
+
+  source = "10000000000000000000000";
+  ASSERT_NE(nullptr, tjson_parse_number(to_piece(source), &number));
+  EXPECT_FALSE(number.truncated);
+}
+
+static void expect_same_number(const tjson_Number& expect,
+                               const tjson_Number& actual,
+                               const std::string& source) {
+  EXPECT_EQ(to_string(expect.integer), to_string(actual.integer)) << source;
+  EXPECT_EQ(expect.integer.begin, actual.integer.begin) << source;
+  EXPECT_EQ(to_string(expect.fraction), to_string(actual.fraction)) << source;
+  EXPECT_EQ(to_string(expect.exponent_digits),
+            to_string(actual.exponent_digits))
+      << source;
+  EXPECT_EQ(expect.mantissa, actual.mantissa) << source;
+  EXPECT_EQ(expect.exponent, actual.exponent) << source;
+  EXPECT_EQ(expect.negative, actual.negative) << source;
+  EXPECT_EQ(expect.truncated, actual.truncated) << source;
+}
+
+// The parts recorded by the lexer decompose the same as the spelling does
+TEST(NumberTest, FromToken) {
+  std::string long_fraction = "0." + std::string(70000, '1');
+  for (const std::string& source :
+       {std::string{"0"}, std::string{"-0"}, std::string{"-12.0340e-7"},
+        std::string{"0.000125"}, std::string{"1E+2"}, std::string{"7e0"},
+        std::string{"12345678901234567890123"},
+        std::string{"-0.000000000000000000001234567890123456789012e-30"},
+        std::string{"10000000000000000000000.5"}, long_fraction}) {
+    tjson_Number expect;
+    ASSERT_EQ(source.data() + source.size(),
+              tjson_parse_number(to_piece(source), &expect));
+
+    tjson_Token tokens[2];
+    tjson_Error error{};
+    ASSERT_EQ(1, tjson_lex(to_piece(source), tokens, 2, &error)) << error.msg;
+    ASSERT_EQ(TJSON_NUMERIC_LITERAL, tokens[0].typeno);
+    EXPECT_EQ(source.size() <= 65535, tokens[0].int_end != 0) << source.size();
+
+    tjson_Number actual;
+    ASSERT_EQ(0, tjson_Number_from_token(&tokens[0], &actual)) << source;
+    expect_same_number(expect, actual, source);
+
+    // Without the parts the spelling is parsed
+    tokens[0].int_end = tokens[0].frac_end = 0;
+    ASSERT_EQ(0, tjson_Number_from_token(&tokens[0], &actual)) << source;
+    expect_same_number(expect, actual, source);
+  }
+
+  std::string source = "1.5x";
+  tjson_Token token{TJSON_NUMERIC_LITERAL, to_piece(source), {}, 0, 0};
+  tjson_Number number;
+  EXPECT_EQ(-1, tjson_Number_from_token(&token, &number));
+}
+
+static double to_double(const std::string& source) {
+  tjson_Number number;
+  EXPECT_EQ(source.data() + source.size(),
+            tjson_parse_number(to_piece(source), &number))
+      << source;
+  return tjson_Number_to_double(&number);
+}
+
+static float to_float(const std::string& source) {
+  tjson_Number number;
+  EXPECT_EQ(source.data() + source.size(),
+            tjson_parse_number(to_piece(source), &number))
+      << source;
+  return tjson_Number_to_float(&number);
+}
+
+static uint64_t bits_of(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static uint32_t bits_of(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+TEST(NumberTest, KnownDoubles) {
+  for (const char* literal : {
+           "0",
+           "-0",
+           "0.1",
+           "1e23",
+           "9007199254740993",
+           "9007199254740992.5",
+           "2.2250738585072011e-308",
+           "2.2250738585072014e-308",
+           "4.9e-324",
+           "2.4703282292062327e-324",
+           "2.4703282292062328e-324",
+           "1e-400",
+           "1.7976931348623157e308",
+           "1.7976931348623158e308",
+           "1.7976931348623159e308",
+           "1e400",
+           "8.98846567431158e307",
+           "7.2057594037927933e16",
+           "0.30000000000000004",
+           "123456789012345678901234567890",
+           "1.00000000000000011102230246251565404236316680908203125",
+           "1.00000000000000011102230246251565404236316680908203124",
+           "1.00000000000000011102230246251565404236316680908203126",
+           "-3.14159265358979323846264338327950288",
+       }) {
+    EXPECT_EQ(bits_of(strtod(literal, nullptr)), bits_of(to_double(literal)))
+        << literal;
+    EXPECT_EQ(bits_of(strtof(literal, nullptr)), bits_of(to_float(literal)))
+        << literal;
+  }
+}
+
+TEST(NumberTest, MatchesStrtod) {
+  std::mt19937_64 rng(5678);
+  std::uniform_int_distribution<int> ndigits_dist(1, 24);
+  std::uniform_int_distribution<int> digit_dist(0, 9);
+  std::uniform_int_distribution<int> exponent_dist(-350, 330);
+  std::uniform_int_distribution<int> point_dist(0, 25);
+
+  for (uint32_t trial = 0; trial < 200000; trial++) {
+    std::string literal;
+    if (trial % 2) {
+      literal += '-';
+    }
+    int ndigits = ndigits_dist(rng);
+    int point = point_dist(rng);
+    literal += static_cast<char>('1' + digit_dist(rng) % 9);
+    for (int idx = 1; idx < ndigits; idx++) {
+      if (idx == point) {
+        literal += '.';
+      }
+      literal += static_cast<char>('0' + digit_dist(rng));
+    }
+    if (trial % 3) {
+      literal += 'e' + std::to_string(exponent_dist(rng));
+    }
+    ASSERT_EQ(bits_of(strtod(literal.c_str(), nullptr)),
+              bits_of(to_double(literal)))
+        << literal;
+    ASSERT_EQ(bits_of(strtof(literal.c_str(), nullptr)),
+              bits_of(to_float(literal)))
+        << literal;
+  }
+
+  // Random doubles printed with 17 significant digits must round trip
+  std::uniform_int_distribution<uint64_t> bits_dist;
+  char buf[64];
+  for (uint32_t trial = 0; trial < 200000; trial++) {
+    uint64_t bits = bits_dist(rng);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    snprintf(buf, sizeof(buf), "%.17g", value);
+    ASSERT_EQ(bits, bits_of(to_double(buf))) << buf;
+  }
+}
+
+// Return the literal `exact` (as printed by "%e") with its mantissa digits
+// modified: "+" appends a one after `pad` zeros, "-" subtracts one from the
+// last significant digit and appends `pad` nines.
+static std::string perturb(const std::string& exact, char direction,
+                           int pad) {
+  size_t epos = exact.find('e');
+  std::string digits = exact.substr(0, epos);
+  while (digits.back() == '0') {
+    digits.pop_back();
+  }
+  if (direction == '+') {
+    digits += std::string(pad, '0') + "1";
+  } else if (direction == '-') {
+    digits.back()--;
+    digits += std::string(pad, '9');
+  }
+  return digits + exact.substr(epos);
+}
+
+// Literals at, just above and just below the point halfway between two
+// adjacent floats can only be rounded by comparing all of their digits.
+TEST(NumberTest, NearHalfway) {
+  if (std::numeric_limits<long double>::digits < 54) {
+    GTEST_SKIP() << "long double can't represent the halfway points";
+  }
+  std::mt19937_64 rng(9012);
+  std::uniform_int_distribution<uint64_t> bits_dist;
+  char buf[1200];
+  for (uint32_t trial = 0; trial < 4000; trial++) {
+    uint64_t lower_bits = bits_dist(rng) >> 1;
+    if (trial % 4 == 0) {
+      // subnormal
+      lower_bits >>= 12;
+    }
+    double lower;
+    memcpy(&lower, &lower_bits, sizeof(lower));
+    double upper = std::nextafter(lower, INFINITY);
+    if (!std::isfinite(upper)) {
+      continue;
+    }
+    long double halfway =
+        (static_cast<long double>(lower) + static_cast<long double>(upper)) / 2;
+    snprintf(buf, sizeof(buf), "%.1100Le", halfway);
+    std::string exact = buf;
+    double even = (lower_bits & 1) ? upper : lower;
+    ASSERT_EQ(bits_of(even), bits_of(to_double(exact))) << exact;
+    for (int pad : {30, 900}) {
+      ASSERT_EQ(bits_of(upper), bits_of(to_double(perturb(exact, '+', pad))))
+          << perturb(exact, '+', pad);
+      ASSERT_EQ(bits_of(lower), bits_of(to_double(perturb(exact, '-', pad))))
+          << perturb(exact, '-', pad);
+    }
+  }
+
+  for (uint32_t trial = 0; trial < 4000; trial++) {
+    uint32_t lower_bits = static_cast<uint32_t>(bits_dist(rng) >> 33);
+    if (trial % 4 == 0) {
+      lower_bits >>= 9;
+    }
+    float lower;
+    memcpy(&lower, &lower_bits, sizeof(lower));
+    float upper = std::nextafter(lower, static_cast<float>(INFINITY));
+    if (!std::isfinite(upper)) {
+      continue;
+    }
+    double halfway =
+        (static_cast<double>(lower) + static_cast<double>(upper)) / 2;
+    snprintf(buf, sizeof(buf), "%.200e", halfway);
+    std::string exact = buf;
+    float even = (lower_bits & 1) ? upper : lower;
+    ASSERT_EQ(bits_of(even), bits_of(to_float(exact))) << exact;
+    ASSERT_EQ(bits_of(upper), bits_of(to_float(perturb(exact, '+', 30))))
+        << perturb(exact, '+', 30);
+    ASSERT_EQ(bits_of(lower), bits_of(to_float(perturb(exact, '-', 30))))
+        << perturb(exact, '-', 30);
+  }
+}
+
+TEST(NumberTest, IndependentOfLocale) {
+  const char* literals[] = {
+      "7.2057594037927933e16",
+      "1.00000000000000011102230246251565404236316680908203126",
+      "2.47032822920623272088284396434110686182529901307162382212792841250337"
+      "7536351043759326499181808179961898982823477228588654633283551779698981"
+      "99e-324",
+  };
+  std::vector<double> expect;
+  for (const char* literal : literals) {
+    expect.push_back(strtod(literal, nullptr));
+  }
+
+  std::string previous = setlocale(LC_NUMERIC, nullptr);
+  const char* comma_locale = nullptr;
+  for (const char* name : {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE", "fr_FR"}) {
+    if (setlocale(LC_NUMERIC, name)) {
+      comma_locale = name;
+      break;
+    }
+  }
+  if (!comma_locale) {
+    GTEST_SKIP() << "No locale with a comma decimal point is installed";
+  }
+  for (size_t idx = 0; idx < expect.size(); idx++) {
+    EXPECT_EQ(bits_of(expect[idx]), bits_of(to_double(literals[idx])))
+        << literals[idx] << " in " << comma_locale;
+  }
+  setlocale(LC_NUMERIC, previous.c_str());
+}
+
+static int to_uint64(const std::string& source, uint64_t* value) {
+  tjson_Number number;
+  tjson_Error error{};
+  EXPECT_NE(nullptr, tjson_parse_number(to_piece(source), &number));
+  return tjson_Number_to_uint64(&number, value, &error);
+}
+
+static int to_int64(const std::string& source, int64_t* value) {
+  tjson_Number number;
+  tjson_Error error{};
+  EXPECT_NE(nullptr, tjson_parse_number(to_piece(source), &number));
+  return tjson_Number_to_int64(&number, value, &error);
+}
+
+TEST(NumberTest, Integers) {
+  uint64_t uvalue = 0;
+  EXPECT_EQ(0, to_uint64("18446744073709551615", &uvalue));
+  EXPECT_EQ(UINT64_MAX, uvalue);
+  EXPECT_EQ(-1, to_uint64("18446744073709551616", &uvalue));
+  EXPECT_EQ(-1, to_uint64("-1", &uvalue));
+  EXPECT_EQ(0, to_uint64("-0", &uvalue));
+  EXPECT_EQ(0u, uvalue);
+  EXPECT_EQ(0, to_uint64("1e3", &uvalue));
+  EXPECT_EQ(1000u, uvalue);
+  EXPECT_EQ(0, to_uint64("1.50e1", &uvalue));
+  EXPECT_EQ(15u, uvalue);
+  EXPECT_EQ(0, to_uint64("100e-2", &uvalue));
+  EXPECT_EQ(1u, uvalue);
+  EXPECT_EQ(0, to_uint64("0.0e-5", &uvalue));
+  EXPECT_EQ(0u, uvalue);
+  EXPECT_EQ(0, to_uint64("0e400", &uvalue));
+  EXPECT_EQ(0u, uvalue);
+  EXPECT_EQ(-1, to_uint64("1.5", &uvalue));
+  EXPECT_EQ(-1, to_uint64("15e-1", &uvalue));
+  EXPECT_EQ(-1, to_uint64("1e20", &uvalue));
+
+  int64_t value = 0;
+  EXPECT_EQ(0, to_int64("-9223372036854775808", &value));
+  EXPECT_EQ(INT64_MIN, value);
+  EXPECT_EQ(0, to_int64("9223372036854775807", &value));
+  EXPECT_EQ(INT64_MAX, value);
+  EXPECT_EQ(-1, to_int64("9223372036854775808", &value));
+  EXPECT_EQ(-1, to_int64("-9223372036854775809", &value));
+  EXPECT_EQ(0, to_int64("-12.0", &value));
+  EXPECT_EQ(-12, value);
+}
+
+TEST(NumberTest, ParseValue) {
+  tjson_Error error{};
+  std::string source = "300";
+  tjson_Token token{TJSON_NUMERIC_LITERAL, to_piece(source), {}, 0, 0};
+
+  uint8_t u8 = 7;
+  EXPECT_EQ(-1, tjson_parse_value_uint8(&token, &u8, &error));
+  EXPECT_EQ(TJSON_PARSE_OVERFLOW, error.code);
+  EXPECT_EQ(7, u8);
+
+  int16_t i16 = 0;
+  EXPECT_EQ(0, tjson_parse_value_int16(&token, &i16, &error)) << error.msg;
+  EXPECT_EQ(300, i16);
+
+  double dvalue = 0;
+  source = "-2.5e-3";
+  token.spelling = to_piece(source);
+  EXPECT_EQ(0, tjson_parse_value_double(&token, &dvalue, &error));
+  EXPECT_EQ(-2.5e-3, dvalue);
+
+  source = "\"1.5\"";
+  token.typeno = TJSON_STRING_LITERAL;
+  token.spelling = to_piece(source);
+  EXPECT_EQ(-1, tjson_parse_value_double(&token, &dvalue, &error));
+  EXPECT_EQ(TJSON_WRONG_PRIMITIVE, error.code);
+}
@@ -1,4 +1,6 @@
 // Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <fcntl.h>
+
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -166,3 +168,135 @@ TEST(OStream, ObjectsAndListsIncreaseItemCount) {
 ]
 )");
 }
+
+TEST(OStream, BufferedMatchesStreamOutput) {
+  auto write_doc = [](tjson::OStream* ostrm) {
+    tjson::Guard guard{ostrm, tjson::OBJECT};
+    (*ostrm) << "fieldA" << std::vector<int>{1, 2, 3};
+    (*ostrm) << "fieldB" << 0.25;
+    (*ostrm) << "fieldC" << nullptr;
+  };
+
+  std::stringstream strm{};
+  {
+    tjson::OStream ostrm{&strm, tjson_DefaultOpts};
+    write_doc(&ostrm);
+  }
+
+  tjson::OSStream sstrm{};
+  write_doc(&sstrm);
+  EXPECT_EQ(sstrm.str(), strm.str());
+}
+
+TEST(OStream, NullCountsAsAnItem) {
+  tjson::OSStream ostrm{};
+  {
+    tjson::Guard guard{&ostrm, tjson::LIST};
+    ostrm << nullptr << nullptr;
+  }
+  EXPECT_EQ(ostrm.str(), "[\n    null,\n    null\n]\n");
+}
+
+TEST(OStream, StringsAreEscaped) {
+  tjson::OSStream ostrm{tjson_CompactOpts};
+  {
+    tjson::Guard guard{&ostrm, tjson::OBJECT};
+    ostrm << "a\"b" << std::string{"line\nbreak"};
+  }
+  EXPECT_EQ(ostrm.str(), "{\"a\\\"b\":\"line\\nbreak\"}\n");
+}
+
+TEST(OStream, BufferGrowsAsNeeded) {
+  tjson::OSStream ostrm{tjson_CompactOpts};
+  const std::string value(10000, 'x');
+  {
+    tjson::Guard guard{&ostrm, tjson::LIST};
+    for (int idx = 0; idx < 10; idx++) {
+      ostrm << value;
+    }
+  }
+  // ten quoted strings, nine ", " separators, the brackets and a newline
+  EXPECT_EQ(ostrm.size(), 10 * (value.size() + 2) + 9 * 2 + 3);
+  EXPECT_EQ(ostrm.str().substr(0, 4), "[\"xx");
+}
+
+TEST(OStream, FixedBufferCountsOverflow) {
+  char storage[16];
+  tjson_WriteBuffer buf{};
+  tjson_WriteBuffer_init(&buf, storage, storage + sizeof(storage));
+  {
+    tjson::OStream ostrm{&buf, tjson_CompactOpts};
+    tjson::Guard guard{&ostrm, tjson::LIST};
+    ostrm << 1234 << 5678 << "abcdefgh";
+  }
+  // `[1234, 5678, ` fits, the string and everything after it do not
+  EXPECT_EQ(std::string(storage, buf.begin), "[1234, 5678, ");
+  EXPECT_EQ(buf.overflow, strlen("\"abcdefgh\"]\n"));
+}
+
+TEST(OStream, FlushWritesToFileDescriptor) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  tjson::OSStream ostrm{tjson_CompactOpts};
+  {
+    tjson::Guard guard{&ostrm, tjson::OBJECT};
+    ostrm << "field" << 1;
+  }
+  ASSERT_EQ(ostrm.flush(fds[1]), 0);
+  EXPECT_EQ(ostrm.size(), 0);
+  close(fds[1]);
+
+  char readback[64];
+  ssize_t nread = read(fds[0], readback, sizeof(readback));
+  close(fds[0]);
+  ASSERT_GT(nread, 0);
+  EXPECT_EQ(std::string(readback, nread), "{\"field\":1}\n");
+}
+
+TEST(OStream, FlushKeepsUnwrittenContent) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_EQ(fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+
+  // Larger than the pipe capacity, so the write fails with EAGAIN once the
+  // pipe is full
+  tjson::OSStream ostrm{tjson_CompactOpts};
+  const std::string value(1000, 'x');
+  {
+    tjson::Guard guard{&ostrm, tjson::LIST};
+    for (int idx = 0; idx < 1000; idx++) {
+      ostrm << value;
+    }
+  }
+  std::string expect = ostrm.str();
+
+  std::string readback;
+  char chunk[4096];
+  while (ostrm.flush(fds[1])) {
+    ASSERT_EQ(errno, EAGAIN);
+    ASSERT_LT(ostrm.size(), expect.size());
+    ssize_t nread = read(fds[0], chunk, sizeof(chunk));
+    ASSERT_GT(nread, 0);
+    readback.append(chunk, nread);
+  }
+  EXPECT_EQ(ostrm.size(), 0);
+  close(fds[1]);
+
+  ssize_t nread = 0;
+  while ((nread = read(fds[0], chunk, sizeof(chunk))) > 0) {
+    readback.append(chunk, nread);
+  }
+  close(fds[0]);
+  EXPECT_EQ(readback, expect);
+}
+
+// These would index outside of the stack, so they are checked in release
+// builds too
+TEST(OStream, MisuseOutsideOfAGroupThrows) {
+  tjson::OSStream ostrm{tjson_CompactOpts};
+  EXPECT_THROW(ostrm << 1, std::exception);
+  EXPECT_THROW(ostrm << "value", std::exception);
+  EXPECT_THROW(ostrm.end(tjson::LIST), std::exception);
+  EXPECT_EQ(ostrm.size(), 0);
+}
@@ -0,0 +1,160 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/parallel.h"
+
+struct Collector {
+  std::vector<tjson_Event> events;
+  std::vector<std::string> items;
+  uint64_t stop_at = UINT64_MAX;
+};
+
+static int collect(void* context, const tjson_ArrayItem* item,
+                   tjson_Error* error) {
+  Collector* collector = static_cast<Collector*>(context);
+  EXPECT_EQ(collector->items.size(), item->index);
+  collector->items.emplace_back(item->span.begin, item->span.end);
+  collector->events.insert(collector->events.end(), item->events,
+                           item->events + item->nevents);
+  if (item->index >= collector->stop_at) {
+    error->code = TJSON_PARSE_SEMANTIC;
+    snprintf(error->msg, sizeof(error->msg), "stop");
+    return -1;
+  }
+  return 0;
+}
+
+static tjson_StringPiece piece(const std::string& str) {
+  return tjson_StringPiece{str.data(), str.data() + str.size()};
+}
+
+// Parse `source` in parallel and check that the events are the same as
+// those of a sequential parse
+static void check_matches_sequential(const std::string& source,
+                                     uint32_t nthreads, uint32_t chunk_size) {
+  tjson_Error error{};
+  std::vector<tjson_Event> expect(source.size());
+  int nevents =
+      tjson_parse(piece(source), expect.data(), expect.size(), &error);
+  ASSERT_LE(2, nevents) << error.msg;
+
+  Collector collector;
+  tjson_ParallelOpts opts{};
+  opts.nthreads = nthreads;
+  opts.chunk_size = chunk_size;
+  int64_t nitems = tjson_parse_array_parallel(piece(source), &opts, collect,
+                                              &collector, &error);
+  ASSERT_LE(0, nitems) << error.msg;
+  EXPECT_EQ(collector.items.size(), static_cast<size_t>(nitems));
+
+  // The sequential parse also has the events of the root list
+  ASSERT_EQ(static_cast<size_t>(nevents - 2), collector.events.size())
+      << "threads: " << nthreads << ", chunk size: " << chunk_size;
+  for (size_t idx = 0; idx < collector.events.size(); idx++) {
+    ASSERT_EQ(expect[idx + 1].typeno, collector.events[idx].typeno) << idx;
+    ASSERT_EQ(expect[idx + 1].token.spelling.begin,
+              collector.events[idx].token.spelling.begin)
+        << idx;
+  }
+}
+
+TEST(ParallelTest, MatchesSequential) {
+  std::string records = "[\n";
+  std::string scalars = "[";
+  for (int idx = 0; idx < 2000; idx++) {
+    if (idx) {
+      records += ",\n";
+      scalars += ", ";
+    }
+    // Nested lists of objects and strings which look like item boundaries
+    // make some of the guessed chunk boundaries wrong
+    records += "  {\"id\": " + std::to_string(idx) +
+               ", \"text\": \"}, {\\\"\", \"children\": [{\"a\": 1},"
+               " {\"b\": [{}, {}]}]}";
+    scalars += (idx % 3 == 0)   ? std::to_string(idx)
+               : (idx % 3 == 1) ? "\"a, b\""
+                                : "true";
+  }
+  records += "\n]\n";
+  scalars += "]";
+
+  for (uint32_t nthreads : {1, 2, 4, 8}) {
+    for (uint32_t chunk_size : {16, 100, 4096, 1 << 20}) {
+      check_matches_sequential(records, nthreads, chunk_size);
+      check_matches_sequential(scalars, nthreads, chunk_size);
+    }
+  }
+  check_matches_sequential("[[1, 2], [3, [4, 5]], []]", 2, 1);
+}
+
+TEST(ParallelTest, EmptyList) {
+  Collector collector;
+  tjson_Error error{};
+  EXPECT_EQ(0, tjson_parse_array_parallel(piece(" [ \n ] "), nullptr, collect,
+                                          &collector, &error))
+      << error.msg;
+  EXPECT_EQ(0, tjson_parse_array_parallel(piece("[]"), nullptr, collect,
+                                          &collector, &error))
+      << error.msg;
+}
+
+TEST(ParallelTest, Errors) {
+  struct TestCase {
+    std::string source;
+    tjson_ErrorCode code;
+    uint32_t lineno;
+    size_t nitems;  //< number of items delivered before the error
+  };
+  std::string items;
+  for (int idx = 0; idx < 500; idx++) {
+    items += "{\"a\": [1, 2]},\n";
+  }
+  std::vector<TestCase> cases = {
+      {"{\"a\": 1}", TJSON_PARSE_UNEXPECTED_TOKEN, 0, 0},
+      {"[1, 2", TJSON_PARSE_UNEXPECTED_TOKEN, 0, 0},
+      {"[1, 2,]", TJSON_PARSE_UNEXPECTED_TOKEN, 0, 1},
+      {"[1 2]", TJSON_PARSE_UNEXPECTED_TOKEN, 0, 0},
+      {"[[1, 2]", TJSON_PARSE_UNEXPECTED_TOKEN, 0, 0},
+      {"[" + items + "{\"a\": [1, tru]}]", TJSON_LEX_INVALID_TOKEN, 500, 500},
+      {"[" + items + "{\"a\": [1, 2}]", TJSON_PARSE_UNEXPECTED_TOKEN, 500,
+       500},
+  };
+
+  for (const TestCase& test : cases) {
+    for (uint32_t nthreads : {1, 4}) {
+      Collector collector;
+      tjson_Error error{};
+      tjson_ParallelOpts opts{};
+      opts.nthreads = nthreads;
+      opts.chunk_size = 64;
+      EXPECT_EQ(-1, tjson_parse_array_parallel(piece(test.source), &opts,
+                                               collect, &collector, &error))
+          << test.source;
+      EXPECT_EQ(test.code, error.code) << test.source << ": " << error.msg;
+      EXPECT_EQ(test.lineno, error.loc.lineno) << test.source;
+      EXPECT_EQ(test.nitems, collector.items.size()) << test.source;
+    }
+  }
+}
+
+TEST(ParallelTest, CallbackStops) {
+  std::string source = "[";
+  for (int idx = 0; idx < 10000; idx++) {
+    source += idx ? ", [1, 2]" : "[1, 2]";
+  }
+  source += "]";
+
+  Collector collector;
+  collector.stop_at = 100;
+  tjson_Error error{};
+  tjson_ParallelOpts opts{};
+  opts.nthreads = 4;
+  opts.chunk_size = 256;
+  EXPECT_EQ(-1, tjson_parse_array_parallel(piece(source), &opts, collect,
+                                           &collector, &error));
+  EXPECT_EQ(TJSON_PARSE_SEMANTIC, error.code);
+  EXPECT_EQ(101u, collector.items.size());
+}
@@ -1,8 +1,12 @@
 // Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <algorithm>
 #include <array>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "tangent/tjson/parse.h"
 #include "tangent/tjson/tjson.h"
 
 std::array<tjson_Token, 255> g_token_store_;
@@ -33,3 +37,286 @@ TEST(ParserTest, TestKnownParsings) {
   ASSERT_EQ(TJSON_OBJECT_END, g_event_store_[14].typeno);
   ASSERT_EQ(TJSON_OBJECT_END, g_event_store_[15].typeno);
 }
+
+TEST(ParserTest, ErrorLocation) {
+  tjson_Error error{};
+  // The second key is not a string
+  tjson_StringPiece source =
+      tjson_StringPiece_fromstr("{\n  \"foo\": 1,\n  2: 2\n}");
+  ASSERT_GT(0, tjson_parse(source, NULL, 0, &error));
+  EXPECT_EQ(TJSON_PARSE_UNEXPECTED_TOKEN, error.code) << error.msg;
+  EXPECT_EQ(2u, error.loc.lineno);
+  EXPECT_EQ(2u, error.loc.colno);
+  EXPECT_EQ(16u, error.loc.offset);
+}
+
+static int sum_listitem(void* userdata, tjson_ParseContext ctx) {
+  int64_t value = 0;
+  if (tjson_parse_int64(ctx, &value)) {
+    return -1;
+  }
+  *static_cast<int64_t*>(userdata) += value;
+  return 0;
+}
+
+TEST(ParserTest, PeekDoesNotRelex) {
+  tjson_StringPiece source =
+      tjson_StringPiece_fromstr("[1, 2, 3, 4, 5, 6, 7, 8, 9, 10]");
+  tjson_Error error{};
+  int ntokens = tjson_lex(source, NULL, 0, &error);
+  ASSERT_LT(0, ntokens) << error.msg;
+
+  tjson_LexerParser stream;
+  ASSERT_EQ(0, tjson_LexerParser_init(&stream, &error));
+  ASSERT_EQ(0, tjson_LexerParser_begin(&stream, source, &error));
+  tjson_ParseContext ctx{&stream, &error, nullptr};
+  int64_t sum = 0;
+  ASSERT_EQ(0, tjson_parse_list(ctx, sum_listitem, &sum)) << error.msg;
+  EXPECT_EQ(55, sum);
+  EXPECT_EQ(static_cast<uint64_t>(ntokens), stream._scanner._nlexed);
+}
+
+TEST(ParserTest, PeekAhead) {
+  tjson_StringPiece source =
+      tjson_StringPiece_fromstr("{\"a\": [1], \"b\": 2}");
+  tjson_Error error{};
+  tjson_LexerParser stream;
+  ASSERT_EQ(0, tjson_LexerParser_init(&stream, &error));
+  ASSERT_EQ(0, tjson_LexerParser_begin(&stream, source, &error));
+
+  const tjson_EventTypeNo expect[] = {
+      TJSON_OBJECT_BEGIN,  TJSON_OBJECT_KEY, TJSON_LIST_BEGIN,
+      TJSON_VALUE_LITERAL, TJSON_LIST_END,   TJSON_OBJECT_KEY,
+      TJSON_VALUE_LITERAL, TJSON_OBJECT_END,
+  };
+  const size_t nexpect = sizeof(expect) / sizeof(expect[0]);
+
+  tjson_Event event;
+  for (size_t idx = 0; idx < nexpect; idx++) {
+    // Peek as far ahead as possible, then consume one event
+    for (uint32_t n = 0; n < TJSON_LOOKAHEAD_CAPACITY; n++) {
+      if (idx + n >= nexpect) {
+        EXPECT_EQ(-1,
+                  tjson_LexerParser_peek_nth_event(&stream, n, &event, &error));
+        EXPECT_EQ(TJSON_LEX_INPUT_FINISHED, error.code);
+        break;
+      }
+      ASSERT_EQ(0, tjson_LexerParser_peek_nth_event(&stream, n, &event, &error))
+          << error.msg;
+      EXPECT_EQ(expect[idx + n], event.typeno) << idx << "+" << n;
+    }
+    ASSERT_EQ(0, tjson_LexerParser_get_next_event(&stream, &event, &error));
+    EXPECT_EQ(expect[idx], event.typeno) << idx;
+  }
+  EXPECT_EQ(-1, tjson_LexerParser_peek_nth_event(
+                    &stream, TJSON_LOOKAHEAD_CAPACITY, &event, &error));
+  EXPECT_EQ(TJSON_PARSE_OVERFLOW, error.code);
+}
+
+static std::string describe(const tjson_Event& event) {
+  return std::string(tjson_EventTypeNo_tostring(event.typeno)) + ":" +
+         std::string(event.token.spelling.begin, event.token.spelling.end) +
+         "@" + std::to_string(event.token.location.offset);
+}
+
+// Parse `source` by feeding it in chunks of `chunk_size` bytes through a
+// single buffer which is overwritten for each chunk. Return a description of
+// each event, and the error which ended the stream in `error`.
+static std::vector<std::string> parse_chunked(const std::string& source,
+                                              size_t chunk_size,
+                                              size_t carry_size,
+                                              tjson_Error* error) {
+  std::vector<char> chunk(chunk_size);
+  std::vector<char> carry(carry_size);
+  tjson_LexerParser stream;
+  EXPECT_EQ(0, tjson_LexerParser_init(&stream, error));
+  EXPECT_EQ(0, tjson_LexerParser_begin_stream(&stream, carry.data(),
+                                              carry.size(), error));
+
+  std::vector<std::string> out;
+  size_t offset = 0;
+  tjson_Event event;
+  while (true) {
+    if (tjson_LexerParser_get_next_event(&stream, &event, error) == 0) {
+      out.push_back(describe(event));
+      continue;
+    }
+    if (error->code != TJSON_LEX_NEED_INPUT) {
+      break;
+    }
+    if (offset < source.size()) {
+      size_t size = std::min(chunk_size, source.size() - offset);
+      std::copy(source.begin() + offset, source.begin() + offset + size,
+                chunk.begin());
+      offset += size;
+      if (tjson_LexerParser_feed(&stream,
+                                 {chunk.data(), chunk.data() + size}, error)) {
+        break;
+      }
+    } else if (tjson_LexerParser_finish(&stream, error)) {
+      break;
+    }
+  }
+  if (error->code != TJSON_LEX_INPUT_FINISHED) {
+    tjson_LexerParser_locate(&stream, &error->loc);
+  }
+  return out;
+}
+
+TEST(ParserTest, StreamedChunks) {
+  std::string source =
+      "{\"name\": \"split \\\"quoted\\\" \\\\\", \"values\": [-12.5e+3, 7,\n"
+      "  true, false, null, \"\", 0],\n"
+      "  \"nested\": {\"a\": [[], {}], \"b\": 123456789}}\n";
+  tjson_Error error{};
+  int nevents = tjson_parse(
+      {source.data(), source.data() + source.size()}, &g_event_store_[0],
+      g_event_store_.size(), &error);
+  ASSERT_LT(0, nevents) << error.msg;
+  std::vector<std::string> expect;
+  for (int idx = 0; idx < nevents; idx++) {
+    expect.push_back(describe(g_event_store_[idx]));
+  }
+
+  for (size_t chunk_size = 1; chunk_size < 20; chunk_size++) {
+    tjson_Error error{};
+    EXPECT_EQ(expect, parse_chunked(source, chunk_size, 32, &error))
+        << "chunk size " << chunk_size;
+    EXPECT_EQ(TJSON_LEX_INPUT_FINISHED, error.code) << error.msg;
+  }
+
+  // A value at the end of the stream is only complete once it is finished
+  for (const char* value : {"12", "true", "\"abc\""}) {
+    tjson_Error error{};
+    std::vector<std::string> events = parse_chunked(value, 1, 8, &error);
+    ASSERT_EQ(1u, events.size()) << value;
+    EXPECT_EQ(std::string("VALUE_LITERAL:") + value + "@0", events[0]);
+  }
+}
+
+TEST(ParserTest, StreamedErrors) {
+  // Errors are reported at the same location as for the whole document
+  for (const char* source :
+       {"{\n  \"foo\": 1,\n  2: 2\n}", "{\n\"foo\" : 1,\n\"bar\": 12.3x4}",
+        "[1, 2, \"unterminated", "[1, 2, tru"}) {
+    tjson_Error expect{};
+    ASSERT_GT(0, tjson_parse(tjson_StringPiece_fromstr(source), NULL, 0,
+                             &expect));
+    for (size_t chunk_size = 1; chunk_size < 8; chunk_size++) {
+      tjson_Error error{};
+      parse_chunked(source, chunk_size, 16, &error);
+      EXPECT_EQ(expect.code, error.code) << source << ": " << error.msg;
+      EXPECT_EQ(expect.loc.offset, error.loc.offset) << source;
+      EXPECT_EQ(expect.loc.lineno, error.loc.lineno) << source;
+      EXPECT_EQ(expect.loc.colno, error.loc.colno) << source;
+    }
+  }
+
+  // A token which spans chunks must fit in the carry buffer
+  std::string source = "[\"" + std::string(100, 'x') + "\"]";
+  tjson_Error error{};
+  parse_chunked(source, 8, 16, &error);
+  EXPECT_EQ(TJSON_PARSE_OVERFLOW, error.code);
+  EXPECT_EQ(1u, error.loc.offset);
+  parse_chunked(source, 8, 128, &error);
+  EXPECT_EQ(TJSON_LEX_INPUT_FINISHED, error.code);
+
+  // The previous chunk must be consumed before the next is fed
+  tjson_LexerParser stream;
+  ASSERT_EQ(0, tjson_LexerParser_init(&stream, &error));
+  ASSERT_EQ(0, tjson_LexerParser_begin_stream(&stream, nullptr, 0, &error));
+  ASSERT_EQ(0, tjson_LexerParser_feed(
+                   &stream, tjson_StringPiece_fromstr("[1, 2"), &error));
+  EXPECT_EQ(-1, tjson_LexerParser_feed(
+                    &stream, tjson_StringPiece_fromstr(", 3]"), &error));
+  EXPECT_EQ(TJSON_LEX_BAD_STATE, error.code);
+
+  // A peeked event in the carry is not overwritten by the next carried token
+  char carry[8];
+  tjson_Event event;
+  ASSERT_EQ(0, tjson_LexerParser_begin_stream(&stream, carry, sizeof(carry),
+                                              &error));
+  ASSERT_EQ(0, tjson_LexerParser_feed(
+                   &stream, tjson_StringPiece_fromstr("[\"a"), &error));
+  ASSERT_EQ(0, tjson_LexerParser_get_next_event(&stream, &event, &error));
+  EXPECT_EQ(-1, tjson_LexerParser_peek_next_event(&stream, &event, &error));
+  EXPECT_EQ(TJSON_LEX_NEED_INPUT, error.code);
+  ASSERT_EQ(0, tjson_LexerParser_feed(
+                   &stream, tjson_StringPiece_fromstr("b\", \"c"), &error));
+  ASSERT_EQ(0, tjson_LexerParser_peek_next_event(&stream, &event, &error));
+  EXPECT_EQ(-1,
+            tjson_LexerParser_peek_nth_event(&stream, 1, &event, &error));
+  EXPECT_EQ(TJSON_PARSE_BAD_STATE, error.code);
+  ASSERT_EQ(0, tjson_LexerParser_get_next_event(&stream, &event, &error));
+  EXPECT_EQ("VALUE_LITERAL:\"ab\"@1", describe(event));
+  EXPECT_EQ(-1, tjson_LexerParser_get_next_event(&stream, &event, &error));
+  EXPECT_EQ(TJSON_LEX_NEED_INPUT, error.code);
+  ASSERT_EQ(0, tjson_LexerParser_feed(
+                   &stream, tjson_StringPiece_fromstr("d\"]"), &error));
+  ASSERT_EQ(0, tjson_LexerParser_get_next_event(&stream, &event, &error));
+  EXPECT_EQ("VALUE_LITERAL:\"cd\"@7", describe(event));
+}
+
+TEST(ParserTest, CompactEvents) {
+  static_assert(sizeof(tjson_CompactEvent) == 16,
+                "Compact events should stay small");
+  tjson_Error error{};
+  tjson_StringPiece source = tjson_StringPiece_fromstr(
+      "{\"foo\":{\"bar\":1,\n\"baz\":[\"a\",1,12.3,true,false,null]}}");
+
+  std::array<tjson_CompactEvent, 255> compact;
+  int nevents =
+      tjson_parse_compact(source, compact.data(), compact.size(), &error);
+  ASSERT_EQ(16, nevents) << error.msg;
+  ASSERT_EQ(nevents, tjson_parse(source, &g_event_store_[0],
+                                 g_event_store_.size(), &error));
+
+  tjson_Scanner scanner;
+  ASSERT_EQ(0, tjson_Scanner_init(&scanner, &error));
+  ASSERT_EQ(0, tjson_Scanner_begin(&scanner, source, &error));
+  for (int idx = 0; idx < nevents; idx++) {
+    const tjson_Event& expect = g_event_store_[idx];
+    tjson_Event event;
+    tjson_CompactEvent_expand(&compact[idx], source, &event);
+    EXPECT_EQ(expect.typeno, event.typeno);
+    EXPECT_EQ(expect.token.typeno, event.token.typeno);
+    EXPECT_EQ(expect.token.spelling.begin, event.token.spelling.begin);
+    EXPECT_EQ(expect.token.spelling.end, event.token.spelling.end);
+    EXPECT_EQ(expect.token.location.offset, event.token.location.offset);
+
+    tjson_CompactEvent roundtrip;
+    tjson_CompactEvent_compact(&event, source, &roundtrip);
+    EXPECT_EQ(compact[idx].offset, roundtrip.offset);
+    EXPECT_EQ(compact[idx].size, roundtrip.size);
+  }
+
+  // Line and column are recovered on demand from the source
+  tjson_Event event;
+  tjson_CompactEvent_expand(&compact[5], source, &event);
+  EXPECT_EQ("\"baz\"", std::string(event.token.spelling.begin,
+                                   event.token.spelling.end));
+  tjson_Scanner_locate(&scanner, &event.token.location);
+  EXPECT_EQ(1u, event.token.location.lineno);
+  EXPECT_EQ(0u, event.token.location.colno);
+}
+
+TEST(ParserTest, Measure) {
+  tjson_Error error{};
+  tjson_Measure measure{};
+  ASSERT_EQ(0, tjson_measure(tjson_StringPiece_fromstr(
+                                 "{\"foo\": {\"bar\": 1, \"baz\": [\"a\\n\", "
+                                 "12.3, true, false, null]}, \"q\": []}"),
+                             &measure, &error))
+      << error.msg;
+  EXPECT_EQ(4u, measure.ngroups);
+  EXPECT_EQ(4u, measure.nkeys);
+  EXPECT_EQ(5u, measure.nstrings);
+  EXPECT_EQ(2u, measure.nnumbers);
+  EXPECT_EQ(3u, measure.nliterals);
+  // foo, bar, baz, a\n (escaped) and q, each null terminated
+  EXPECT_EQ(4u + 4u + 4u + 4u + 2u, measure.string_bytes);
+
+  EXPECT_EQ(-1, tjson_measure(tjson_StringPiece_fromstr("[1, @]"), &measure,
+                              &error));
+  EXPECT_EQ(TJSON_LEX_INVALID_TOKEN, error.code);
+}
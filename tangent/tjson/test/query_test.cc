@@ -0,0 +1,162 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/query.h"
+#include "tangent/tjson/structural.h"
+
+static tjson_StringPiece to_piece(const std::string& str) {
+  return tjson_StringPiece{str.data(), str.data() + str.size()};
+}
+
+struct Match {
+  uint32_t path;
+  std::string value;
+
+  bool operator==(const Match& other) const {
+    return path == other.path && value == other.value;
+  }
+};
+
+std::ostream& operator<<(std::ostream& out, const Match& match) {
+  return out << match.path << ":" << match.value;
+}
+
+// Run the query and return the matches, and the number of tokens that were
+// lexed in `nlexed`
+static std::vector<Match> run(const std::string& source,
+                              const std::vector<const char*>& paths,
+                              bool use_index = false,
+                              uint64_t* nlexed = nullptr) {
+  tjson_Error error{};
+  tjson_Query query;
+  tjson_Query_init(&query);
+  for (const char* path : paths) {
+    EXPECT_LE(0, tjson_Query_add(&query, path, &error)) << error.msg;
+  }
+
+  std::vector<uint32_t> structurals(source.size() + 1);
+  std::vector<tjson_Bracket> brackets(source.size() + 1);
+  tjson_LexerParser stream;
+  EXPECT_EQ(0, tjson_LexerParser_init(&stream, &error));
+  EXPECT_EQ(0, tjson_LexerParser_begin(&stream, to_piece(source), &error));
+  if (use_index) {
+    int64_t count = tjson_index_structurals(to_piece(source), &structurals[0],
+                                            structurals.size(), &error);
+    EXPECT_LE(0, count) << error.msg;
+    int64_t nbrackets =
+        tjson_index_brackets(to_piece(source), structurals.data(), count,
+                             &brackets[0], brackets.size(), &error);
+    EXPECT_LE(0, nbrackets) << error.msg;
+    tjson_LexerParser_set_structurals(&stream, structurals.data(), count,
+                                      &error);
+    tjson_LexerParser_set_brackets(&stream, brackets.data(), nbrackets,
+                                   &error);
+  }
+
+  std::vector<tjson_QueryResult> results(16);
+  int64_t count = tjson_Query_run(&query, &stream, &results[0],
+                                  results.size(), &error);
+  EXPECT_LE(0, count) << error.msg;
+  std::vector<Match> out;
+  for (int64_t idx = 0; idx < count && idx < 16; idx++) {
+    out.push_back(Match{results[idx].path,
+                        std::string(results[idx].span.begin,
+                                    results[idx].span.end)});
+  }
+  if (nlexed) {
+    *nlexed = stream._scanner._nlexed;
+  }
+  return out;
+}
+
+static const char* kSource =
+    "{\n"
+    "  \"name\": \"widget\",\n"
+    "  \"a/b\": 1, \"m~n\": 2, \"esc\\\"aped\": 3,\n"
+    "  \"parts\": [\n"
+    "    {\"id\": 10, \"tags\": [\"x\", \"y\"]},\n"
+    "    {\"id\": 11, \"tags\": []},\n"
+    "    {\"id\": 12}\n"
+    "  ],\n"
+    "  \"meta\": {\"owner\": {\"name\": \"josh\"}, \"count\": 3}\n"
+    "}";
+
+TEST(QueryTest, Pointers) {
+  for (bool use_index : {false, true}) {
+    std::vector<Match> expect = {{0, "\"widget\""}, {1, "11"}};
+    EXPECT_EQ(expect, run(kSource, {"/name", "/parts/1/id"}, use_index));
+
+    expect = {{0, "1"}, {1, "2"}, {2, "3"}};
+    EXPECT_EQ(expect, run(kSource, {"/a~1b", "/m~0n", "/esc\"aped"},
+                          use_index));
+
+    expect = {{0, "{\"owner\": {\"name\": \"josh\"}, \"count\": 3}"},
+              {1, "\"josh\""}};
+    EXPECT_EQ(expect, run(kSource, {"/meta", "/meta/owner/name"}, use_index));
+
+    expect = {{0, kSource}};
+    EXPECT_EQ(expect, run(kSource, {""}, use_index));
+
+    expect = {};
+    EXPECT_EQ(expect,
+              run(kSource, {"/nope", "/parts/3", "/name/0", "/parts/01"},
+                  use_index));
+  }
+}
+
+TEST(QueryTest, Wildcards) {
+  for (bool use_index : {false, true}) {
+    std::vector<Match> expect = {{0, "10"}, {0, "11"}, {0, "12"}};
+    EXPECT_EQ(expect, run(kSource, {"/parts/*/id"}, use_index));
+
+    expect = {{1, "[\"x\", \"y\"]"}, {0, "\"y\""}, {1, "[]"}};
+    EXPECT_EQ(expect, run(kSource, {"/parts/*/tags/1", "/*/*/tags"},
+                          use_index));
+  }
+}
+
+TEST(QueryTest, StopsEarly) {
+  std::string source = "{\"first\": 1, \"second\": [";
+  for (int idx = 0; idx < 1000; idx++) {
+    source += idx ? ", [1, 2, 3]" : "[1, 2, 3]";
+  }
+  source += "], \"last\": 2}";
+
+  uint64_t nlexed_first = 0;
+  uint64_t nlexed_last = 0;
+  uint64_t nlexed_indexed = 0;
+  std::vector<Match> expect = {{0, "1"}};
+  EXPECT_EQ(expect, run(source, {"/first"}, false, &nlexed_first));
+  EXPECT_GT(10u, nlexed_first);
+
+  expect = {{0, "2"}};
+  EXPECT_EQ(expect, run(source, {"/last"}, false, &nlexed_last));
+  EXPECT_LT(1000u, nlexed_last);
+  EXPECT_EQ(expect, run(source, {"/last"}, true, &nlexed_indexed));
+  EXPECT_GT(20u, nlexed_indexed);
+
+  // Once the list holding all candidates is closed the query stops
+  expect = {{0, "[1, 2, 3]"}, {0, "[1, 2, 3]"}};
+  source = "{\"a\": [[1, 2, 3], [1, 2, 3]], \"b\": [0";
+  for (int idx = 0; idx < 100; idx++) {
+    source += ", 0";
+  }
+  source += "]}";
+  EXPECT_EQ(expect, run(source, {"/a/*"}, false, &nlexed_first));
+  EXPECT_GT(30u, nlexed_first);
+}
+
+TEST(QueryTest, InvalidPaths) {
+  tjson_Query query;
+  tjson_Query_init(&query);
+  tjson_Error error{};
+  EXPECT_EQ(-1, tjson_Query_add(&query, "foo", &error));
+  EXPECT_EQ(TJSON_PARSE_SEMANTIC, error.code);
+  EXPECT_EQ(-1, tjson_Query_add(&query, "/foo~2", &error));
+  EXPECT_EQ(TJSON_PARSE_SEMANTIC, error.code);
+  EXPECT_EQ(0, tjson_Query_add(&query, "/foo", &error));
+  EXPECT_EQ(1, tjson_Query_add(&query, "/bar", &error));
+}
@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 
+#include "tangent/tjson/parse.h"
 #include "tangent/tjson/tjson.h"
 
 TEST(ParserTest, Test_streq) {
@@ -11,3 +12,107 @@ TEST(ParserTest, Test_streq) {
   ASSERT_TRUE(
       tjson_StringPiece_streq(tjson_StringPiece_fromstr(teststr), teststr));
 }
+
+static std::string unescape(const std::string& input) {
+  char buf[1024];
+  ssize_t size = tjson_unescape(
+      tjson_StringPiece{input.data(), input.data() + input.size()}, buf,
+      buf + sizeof(buf));
+  EXPECT_GE(size, 0);
+  return std::string(buf, size < 0 ? 0 : size);
+}
+
+static std::string escape(const std::string& input) {
+  char buf[1024];
+  ssize_t size = tjson_escape(
+      tjson_StringPiece{input.data(), input.data() + input.size()}, buf,
+      buf + sizeof(buf));
+  EXPECT_GE(size, 0);
+  return std::string(buf, size < 0 ? 0 : size);
+}
+
+TEST(StringTest, UnescapeShortcodes) {
+  EXPECT_EQ(unescape("hello world"), "hello world");
+  EXPECT_EQ(unescape(R"(a\"b\\c\/d\b\f\n\r\t)"), "a\"b\\c/d\b\f\n\r\t");
+  // Not an escape in the JSON grammar, kept as-is
+  EXPECT_EQ(unescape(R"(\q)"), R"(\q)");
+  EXPECT_EQ(unescape(R"(trailing\)"), R"(trailing\)");
+}
+
+TEST(StringTest, UnescapeUnicodeToUtf8) {
+  EXPECT_EQ(unescape(R"(\u0041)"), "A");
+  EXPECT_EQ(unescape(R"(\u00e9)"), "\xc3\xa9");
+  EXPECT_EQ(unescape(R"(\u20AC)"), "\xe2\x82\xac");
+  // U+1F600 as a surrogate pair
+  EXPECT_EQ(unescape(R"(\ud83d\ude00!)"), "\xf0\x9f\x98\x80!");
+  // Unpaired surrogates become U+FFFD
+  EXPECT_EQ(unescape(R"(\ud83dx)"), "\xef\xbf\xbdx");
+  EXPECT_EQ(unescape(R"(\ude00)"), "\xef\xbf\xbd");
+  // Malformed
+  EXPECT_EQ(unescape(R"(\u12g4)"), R"(\u12g4)");
+  EXPECT_EQ(unescape(R"(\u12)"), R"(\u12)");
+}
+
+TEST(StringTest, UnescapeLongRuns) {
+  // Escapes on either side of the 16 and 32 byte blocks
+  for (size_t offset = 0; offset < 70; offset++) {
+    std::string input(offset, 'x');
+    input += R"(\n)";
+    input += std::string(70 - offset, 'y');
+    input += R"(\u00e9)";
+    std::string expect(offset, 'x');
+    expect += "\n";
+    expect += std::string(70 - offset, 'y');
+    expect += "\xc3\xa9";
+    EXPECT_EQ(unescape(input), expect) << "offset " << offset;
+  }
+}
+
+TEST(StringTest, UnescapeLeavesRoomForTerminator) {
+  const std::string input = R"(abc\n)";
+  tjson_StringPiece piece{input.data(), input.data() + input.size()};
+  char buf[5];
+  EXPECT_EQ(tjson_unescape(piece, buf, buf + 4), -1);
+  EXPECT_EQ(tjson_unescape(piece, buf, buf + 5), 4);
+  EXPECT_EQ(std::string(buf, 4), "abc\n");
+}
+
+TEST(StringTest, EscapeRoundTrip) {
+  EXPECT_EQ(escape("a\"b\\c\n\x01"), R"(a\"b\\c\n\u0001)");
+  std::string input;
+  for (int c = 1; c < 128; c++) {
+    input += static_cast<char>(c);
+  }
+  input += "\xc3\xa9";
+  EXPECT_EQ(unescape(escape(input)), input);
+}
+
+TEST(StringTest, EscapeOverflow) {
+  const std::string input = "ab\n";
+  tjson_StringPiece piece{input.data(), input.data() + input.size()};
+  char buf[5];
+  EXPECT_EQ(tjson_escape(piece, buf, buf + 4), -1);
+  EXPECT_EQ(tjson_escape(piece, buf, buf + 5), 4);
+}
+
+TEST(StringTest, SuciNormalize) {
+  char buf[8];
+  uint32_t hash = 0;
+  uint32_t other_hash = 0;
+  EXPECT_EQ(tjson_StringPiece_suci_normalize(
+                tjson_StringPiece_fromstr("Field_A"), buf, sizeof(buf), &hash),
+            6);
+  EXPECT_EQ(std::string(buf, 6), "fielda");
+  EXPECT_EQ(tjson_StringPiece_suci_normalize(
+                tjson_StringPiece_fromstr("fieldA"), buf, sizeof(buf),
+                &other_hash),
+            6);
+  EXPECT_EQ(hash, other_hash);
+  // FNV-1a of "fielda", as computed by protostruct at generation time
+  EXPECT_EQ(hash, 0xf8404f72u);
+
+  EXPECT_EQ(tjson_StringPiece_suci_normalize(
+                tjson_StringPiece_fromstr("a_much_longer_key"), buf,
+                sizeof(buf), &hash),
+            -1);
+}
@@ -0,0 +1,337 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/tjson/parse.h"
+#include "tangent/tjson/structural.h"
+#include "tangent/tjson/tjson.h"
+
+// Byte-at-a-time definition of the structural index. Return false if the
+// source ends inside of a string. Note that a backslash outside of a string
+// is invalid JSON, but for the purpose of the index it still escapes a quote
+// that follows it.
+static bool reference_structurals(const std::string& source,
+                                  std::vector<uint32_t>* out) {
+  bool in_string = false;
+  bool escaped = false;
+  bool in_scalar = false;
+  for (uint32_t idx = 0; idx < source.size(); idx++) {
+    char c = source[idx];
+    bool is_quote = (c == '"' && !escaped);
+    escaped = (c == '\\' && !escaped);
+    if (in_string) {
+      in_string = !is_quote;
+      continue;
+    }
+
+    switch (c) {
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+      case ',':
+        in_scalar = false;
+        out->push_back(idx);
+        break;
+      case ' ':
+      case '\t':
+      case '\n':
+      case '\r':
+        in_scalar = false;
+        break;
+      default:
+        if (is_quote) {
+          in_string = true;
+          in_scalar = false;
+          out->push_back(idx);
+          break;
+        }
+        if (!in_scalar) {
+          out->push_back(idx);
+        }
+        in_scalar = true;
+        break;
+    }
+  }
+  return !in_string;
+}
+
+static tjson_StringPiece to_piece(const std::string& str) {
+  return tjson_StringPiece{str.data(), str.data() + str.size()};
+}
+
+TEST(StructuralTest, KnownOffsets) {
+  std::string source = "{\"foo\" : [1, true,\"b\\\"a,r\"], \"x\":null}";
+  std::vector<uint32_t> expect = {0, 1, 7, 9, 10, 11, 13, 17, 18, 26, 27, 29,
+                                  32, 33, 37};
+  std::vector<uint32_t> actual(64);
+  tjson_Error error{};
+  int64_t count =
+      tjson_index_structurals(to_piece(source), &actual[0], 64, &error);
+  ASSERT_EQ(expect.size(), count) << error.msg;
+  actual.resize(count);
+  EXPECT_EQ(expect, actual);
+}
+
+TEST(StructuralTest, MatchesReference) {
+  // Random strings from a small alphabet, heavy on quotes and backslashes so
+  // that runs of backslashes and strings cross block boundaries often.
+  const char kAlphabet[] = "\"\\\\\\{}[]:, \n\taz01";
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<size_t> pick(0, sizeof(kAlphabet) - 2);
+  std::uniform_int_distribution<size_t> length(0, 300);
+
+  uint32_t nchecked = 0;
+  for (uint32_t trial = 0; trial < 20000; trial++) {
+    std::string source(length(rng), ' ');
+    for (char& c : source) {
+      c = kAlphabet[pick(rng)];
+    }
+
+    std::vector<uint32_t> expect;
+    bool terminated = reference_structurals(source, &expect);
+
+    std::vector<uint32_t> simd(source.size() + 1);
+    std::vector<uint32_t> scalar(source.size() + 1);
+    tjson_Error error{};
+    int64_t simd_count = tjson_index_structurals(to_piece(source), &simd[0],
+                                                 simd.size(), &error);
+    int64_t scalar_count = tjson_index_structurals_scalar(
+        to_piece(source), &scalar[0], scalar.size(), &error);
+    if (!terminated) {
+      EXPECT_EQ(-1, simd_count) << source;
+      EXPECT_EQ(-1, scalar_count) << source;
+      continue;
+    }
+
+    ASSERT_EQ(expect.size(), simd_count) << source;
+    ASSERT_EQ(expect.size(), scalar_count) << source;
+    simd.resize(simd_count);
+    scalar.resize(scalar_count);
+    ASSERT_EQ(expect, simd) << source;
+    ASSERT_EQ(expect, scalar) << source;
+    nchecked++;
+  }
+  EXPECT_LT(1000, nchecked);
+}
+
+TEST(StructuralTest, ReportsRequiredSize) {
+  std::string source = "[1,2,3,4,5,6,7,8,9]";
+  uint32_t buf[4];
+  tjson_Error error{};
+  EXPECT_EQ(19, tjson_index_structurals(to_piece(source), buf, 4, &error));
+  EXPECT_EQ(19, tjson_index_structurals(to_piece(source), nullptr, 0, &error));
+  EXPECT_EQ(0u, buf[0]);
+  EXPECT_EQ(3u, buf[3]);
+}
+
+TEST(StructuralTest, UnterminatedString) {
+  std::string source = "{\"foo\": 1,\n \"bar\": \"baz\\\"}";
+  tjson_Error error{};
+  EXPECT_EQ(-1,
+            tjson_index_structurals(to_piece(source), nullptr, 0, &error));
+  EXPECT_EQ(TJSON_LEX_INVALID_TOKEN, error.code);
+  EXPECT_EQ(1, error.loc.lineno);
+  EXPECT_EQ(8, error.loc.colno);
+  EXPECT_EQ(19, error.loc.offset);
+}
+
+static std::vector<tjson_Token> lex_all(const std::string& source,
+                                        const std::vector<uint32_t>* index) {
+  tjson_Scanner scanner;
+  tjson_Error error{};
+  std::vector<tjson_Token> tokens;
+  EXPECT_EQ(0, tjson_Scanner_init(&scanner, &error));
+  EXPECT_EQ(0, tjson_Scanner_begin(&scanner, to_piece(source), &error));
+  if (index) {
+    EXPECT_EQ(0, tjson_Scanner_set_structurals(&scanner, index->data(),
+                                               index->size(), &error));
+  }
+  tjson_Token token;
+  while (tjson_Scanner_pump(&scanner, &token, &error) == 0) {
+    tokens.push_back(token);
+  }
+  EXPECT_EQ(TJSON_LEX_INPUT_FINISHED, error.code) << error.msg;
+  return tokens;
+}
+
+TEST(StructuralTest, ScannerUsesIndex) {
+  std::string source =
+      "{\n"
+      "  \"a long key which spans more than one block of sixty four bytes\":"
+      " \"and a long value \\\\\\\" with escapes \\\\\",\n"
+      "  \"list\"  :  [1, -2.5e+3 ,true,false,   null, \"\", {}],\n"
+      "  \"\\u00e9\": {\"x\":[[[]]]}\t\r\n"
+      "}  ";
+  std::vector<uint32_t> index(source.size());
+  tjson_Error error{};
+  int64_t count = tjson_index_structurals(to_piece(source), &index[0],
+                                          index.size(), &error);
+  ASSERT_LT(0, count) << error.msg;
+  index.resize(count);
+
+  std::vector<tjson_Token> expect = lex_all(source, nullptr);
+  std::vector<tjson_Token> actual = lex_all(source, &index);
+  ASSERT_EQ(expect.size(), actual.size());
+  for (size_t idx = 0; idx < expect.size(); idx++) {
+    EXPECT_EQ(expect[idx].typeno, actual[idx].typeno) << "token " << idx;
+    EXPECT_EQ(expect[idx].spelling.begin, actual[idx].spelling.begin)
+        << "token " << idx;
+    EXPECT_EQ(expect[idx].spelling.end, actual[idx].spelling.end)
+        << "token " << idx;
+    EXPECT_EQ(expect[idx].location.offset, actual[idx].location.offset)
+        << "token " << idx;
+  }
+}
+
+TEST(StructuralTest, ScannerRejectsInvalidWithIndex) {
+  std::string source = "{\n\"foo\" : 1,\n\"bar\": 12.3x4}";
+  std::vector<uint32_t> index(source.size());
+  tjson_Error error{};
+  int64_t count = tjson_index_structurals(to_piece(source), &index[0],
+                                          index.size(), &error);
+  ASSERT_LT(0, count) << error.msg;
+
+  tjson_LexerParser parser;
+  ASSERT_EQ(0, tjson_LexerParser_init(&parser, &error));
+  ASSERT_EQ(0, tjson_LexerParser_begin(&parser, to_piece(source), &error));
+  ASSERT_EQ(0, tjson_LexerParser_set_structurals(&parser, index.data(), count,
+                                                 &error));
+  tjson_Event event;
+  while (tjson_LexerParser_get_next_event(&parser, &event, &error) == 0) {
+  }
+  EXPECT_EQ(TJSON_LEX_INVALID_TOKEN, error.code);
+  EXPECT_EQ(2, error.loc.lineno);
+  EXPECT_EQ(11, error.loc.colno);
+}
+
+static std::vector<tjson_Bracket> index_brackets(
+    const std::string& source,
+    std::vector<uint32_t>* structurals_out = nullptr) {
+  std::vector<uint32_t> structurals(source.size() + 1);
+  tjson_Error error{};
+  int64_t count = tjson_index_structurals(to_piece(source), &structurals[0],
+                                          structurals.size(), &error);
+  EXPECT_LE(0, count) << error.msg;
+  std::vector<tjson_Bracket> brackets(source.size() + 1);
+  int64_t nbrackets =
+      tjson_index_brackets(to_piece(source), structurals.data(), count,
+                           &brackets[0], brackets.size(), &error);
+  EXPECT_LE(0, nbrackets) << error.msg;
+  brackets.resize(nbrackets < 0 ? 0 : nbrackets);
+  if (structurals_out) {
+    structurals.resize(count < 0 ? 0 : count);
+    *structurals_out = structurals;
+  }
+  return brackets;
+}
+
+TEST(StructuralTest, KnownBrackets) {
+  std::string source = "{\"a\": [1, [], [2, {}]], \"b\": {\"c\": \"[}\"}}";
+  std::vector<tjson_Bracket> brackets = index_brackets(source);
+  ASSERT_EQ(6u, brackets.size());
+
+  struct Expect {
+    uint32_t open;
+    uint32_t close;
+    uint32_t count;
+  };
+  const Expect expect[] = {
+      {0, 40, 2}, {6, 21, 3}, {10, 11, 0},
+      {14, 20, 2}, {18, 19, 0}, {29, 39, 1},
+  };
+  for (size_t idx = 0; idx < brackets.size(); idx++) {
+    EXPECT_EQ(expect[idx].open, brackets[idx].open) << idx;
+    EXPECT_EQ(expect[idx].close, brackets[idx].close) << idx;
+    EXPECT_EQ(expect[idx].count, brackets[idx].count) << idx;
+  }
+}
+
+TEST(StructuralTest, UnbalancedBrackets) {
+  for (const char* invalid : {"[1, 2", "[1, 2}", "{\"a\": [}", "]", "[[]]]"}) {
+    std::string source = invalid;
+    std::vector<uint32_t> structurals(source.size() + 1);
+    tjson_Error error{};
+    int64_t count = tjson_index_structurals(to_piece(source), &structurals[0],
+                                            structurals.size(), &error);
+    ASSERT_LE(0, count) << error.msg;
+    EXPECT_EQ(-1, tjson_index_brackets(to_piece(source), structurals.data(),
+                                       count, nullptr, 0, &error))
+        << invalid;
+    EXPECT_EQ(TJSON_PARSE_UNEXPECTED_TOKEN, error.code) << invalid;
+  }
+
+  std::string source(100, '[');
+  source += std::string(100, ']');
+  std::vector<uint32_t> structurals(source.size());
+  tjson_Error error{};
+  int64_t count = tjson_index_structurals(to_piece(source), &structurals[0],
+                                          structurals.size(), &error);
+  EXPECT_EQ(-1, tjson_index_brackets(to_piece(source), structurals.data(),
+                                     count, nullptr, 0, &error));
+  EXPECT_EQ(TJSON_PARSE_OVERFLOW, error.code);
+}
+
+// Skip every value of the top-level object. Return the number of items in the
+// "keep" list, which is counted before it is skipped.
+static size_t count_kept(const std::string& source,
+                         const std::vector<tjson_Bracket>* brackets,
+                         const std::vector<uint32_t>* structurals,
+                         uint64_t* nlexed) {
+  tjson_LexerParser stream;
+  tjson_Error error{};
+  EXPECT_EQ(0, tjson_LexerParser_init(&stream, &error));
+  EXPECT_EQ(0, tjson_LexerParser_begin(&stream, to_piece(source), &error));
+  if (brackets) {
+    EXPECT_EQ(0, tjson_LexerParser_set_brackets(&stream, brackets->data(),
+                                                brackets->size(), &error));
+  }
+  if (structurals) {
+    EXPECT_EQ(0,
+              tjson_LexerParser_set_structurals(
+                  &stream, structurals->data(), structurals->size(), &error));
+  }
+  tjson_ParseContext ctx{&stream, &error, nullptr};
+
+  size_t count = 0;
+  tjson_Event event;
+  EXPECT_EQ(0, tjson_LexerParser_get_next_event(&stream, &event, &error));
+  while (tjson_LexerParser_get_next_event(&stream, &event, &error) == 0 &&
+         event.typeno == TJSON_OBJECT_KEY) {
+    if (!tjson_StringPiece_streq(event.token.spelling, "\"keep\"")) {
+      EXPECT_EQ(0, tjson_sink_value(ctx)) << error.msg;
+      continue;
+    }
+    EXPECT_EQ(0, tjson_count_list(ctx, &count)) << error.msg;
+    EXPECT_EQ(0, tjson_sink_list(ctx, /*already_open=*/0));
+  }
+  EXPECT_EQ(TJSON_OBJECT_END, event.typeno) << error.msg;
+  *nlexed = stream._scanner._nlexed;
+  return count;
+}
+
+TEST(StructuralTest, SkipWithBrackets) {
+  std::string source = "{\"skip\": {\"a\": [1, 2, {\"b\": null}]}";
+  for (int idx = 0; idx < 100; idx++) {
+    source +=
+        ", \"more\": [[1, 2], [3, [4, 5, 6]], \"]\", {\"x\": \"}\"},"
+        " [7, 8, 9]]";
+  }
+  source += ", \"keep\": [1, 2, 3, [4, 5], {\"c\": []}], \"last\": [true]}";
+  std::vector<uint32_t> structurals;
+  std::vector<tjson_Bracket> brackets = index_brackets(source, &structurals);
+
+  uint64_t nlexed_slow = 0;
+  uint64_t nlexed_fast = 0;
+  uint64_t nlexed_indexed = 0;
+  EXPECT_EQ(5u, count_kept(source, nullptr, nullptr, &nlexed_slow));
+  EXPECT_EQ(5u, count_kept(source, &brackets, nullptr, &nlexed_fast));
+  EXPECT_EQ(5u, count_kept(source, &brackets, &structurals, &nlexed_indexed));
+  // Only the key and the brackets of each skipped value are lexed
+  EXPECT_LT(nlexed_fast * 5, nlexed_slow);
+  EXPECT_EQ(nlexed_fast, nlexed_indexed);
+}
@@ -1,6 +1,9 @@
 @PACKAGE_INIT@
 set(_bindir @PACKAGE_CMAKE_INSTALL_BINDIR@)
 
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+
 include(${CMAKE_CURRENT_LIST_DIR}/tjson-targets.cmake)
 check_required_components(tjson)
 
@@ -1,5 +1,7 @@
 // Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
 #include "tangent/tjson/tjson.h"
+#include "tangent/tjson/number.h"
+#include "tangent/tjson/structural.h"
 #include "tangent/util/fallthrough.h"
 
 #include <ctype.h>
@@ -111,6 +113,28 @@ uint64_t tjson_StringPiece_suci_digest(tjson_StringPiece str) {
   return digest;
 }
 
+int32_t tjson_StringPiece_suci_normalize(tjson_StringPiece str, char* buf,
+                                         uint32_t capacity, uint32_t* hash) {
+  uint32_t hashv = 2166136261u;
+  uint32_t size = 0;
+  for (const char* ptr = str.begin; ptr < str.end; ptr++) {
+    char c = *ptr;
+    if (c == '_') {
+      continue;
+    }
+    if ('A' <= c && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    if (size == capacity) {
+      return -1;
+    }
+    buf[size++] = c;
+    hashv = (hashv ^ (uint8_t)c) * 16777619u;
+  }
+  *hash = hashv;
+  return (int32_t)size;
+}
+
 // -----------------------------------------------------------------------------
 //    Token
 // -----------------------------------------------------------------------------
@@ -146,6 +170,8 @@ const char* kErrorCodeToString[] = {
     "PARSE_OVERFLOW",          //
     "PARSE_SEMANTIC",          //
     "WRONG_PRIMITIVE",         //
+    "LEX_NEED_INPUT",          //
+    "IO_ERROR",                //
 };
 
 const char* tjson_ErrorCode_tostring(enum tjson_ErrorCode no) {
@@ -209,21 +235,93 @@ int tjson_Scanner_begin(struct tjson_Scanner* scanner,
 
   scanner->_numeric_storage = 0;
   scanner->_string_storage = 0;
+  scanner->_nlexed = 0;
   scanner->_piece = content;
+  scanner->_line_cursor = 0;
+  scanner->_line_count = 0;
+  scanner->_line_begin = 0;
+  scanner->_structurals = NULL;
+  scanner->_nstructurals = 0;
+  scanner->_structural_idx = 0;
+  scanner->_streaming = 0;
+  scanner->_input_finished = 0;
+  scanner->_held = 0;
+  scanner->_carry_pinned = 0;
+  scanner->_carry = NULL;
+  scanner->_carry_capacity = 0;
+  scanner->_carry_split = NULL;
+  scanner->_chunk.begin = NULL;
+  scanner->_chunk.end = NULL;
+  scanner->_window_offset = 0;
   return 0;
 }
 
-static inline void advance_location(struct tjson_StringPiece str,
-                                    struct tjson_SourceLocation* loc) {
-  for (size_t idx = 0; idx < tjson_StringPiece_size(str); ++idx) {
-    if (tjson_StringPiece_get(str, idx) == '\n') {
-      loc->lineno++;
-      loc->colno = 0;
+int tjson_Scanner_set_structurals(struct tjson_Scanner* scanner,
+                                  const uint32_t* offsets, uint32_t n,
+                                  struct tjson_Error* error) {
+  if (scanner->_streaming) {
+    error->code = TJSON_LEX_BAD_STATE;
+    error->loc = scanner->_loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "A structural index can not be used with streamed input");
+    return -1;
+  }
+  if (scanner->_loc.offset > 0) {
+    error->code = TJSON_LEX_BAD_STATE;
+    error->loc = scanner->_loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "The structural index must be set before scanning begins");
+    return -1;
+  }
+  scanner->_structurals = offsets;
+  scanner->_nstructurals = n;
+  scanner->_structural_idx = 0;
+  return 0;
+}
+
+void tjson_Scanner_locate(struct tjson_Scanner* scanner,
+                          struct tjson_SourceLocation* loc) {
+  // NOTE(josh): only `begin` of the piece advances during scanning, so the
+  // content given to tjson_Scanner_begin() is [base, _piece.end)
+  const char* base = scanner->_piece.begin - scanner->_loc.offset;
+  const char* target = base + loc->offset;
+  if (target > scanner->_piece.end) {
+    target = scanner->_piece.end;
+  }
+
+  if (loc->offset < scanner->_line_begin) {
+    if (scanner->_streaming) {
+      // The content before the cursor may be gone, so this is as close as
+      // we can get.
+      target = base + scanner->_line_begin;
     } else {
-      loc->colno++;
+      // The offset is on an earlier line than the cursor, we have to start
+      // counting over again.
+      scanner->_line_cursor = 0;
+      scanner->_line_count = 0;
+      scanner->_line_begin = 0;
     }
-    loc->offset++;
   }
+  if (target < base + scanner->_window_offset) {
+    target = base + scanner->_window_offset;
+  }
+
+  const char* cursor = base + scanner->_line_cursor;
+  while (cursor < target) {
+    const char* newline = memchr(cursor, '\n', target - cursor);
+    if (!newline) {
+      break;
+    }
+    cursor = newline + 1;
+    scanner->_line_count++;
+    scanner->_line_begin = cursor - base;
+  }
+  if (scanner->_line_cursor < target - base) {
+    scanner->_line_cursor = target - base;
+  }
+
+  loc->lineno = scanner->_line_count;
+  loc->colno = (target - base) - scanner->_line_begin;
 }
 
 static inline int8_t is_punctuation(char c) {
@@ -346,20 +444,237 @@ static void consume_token(struct tjson_StringPiece piece,
   }
 
   // TJSON_NUMERIC_LITERAL
+  uint32_t int_end = 0;
+  uint32_t frac_end = 0;
   tok->spelling.begin = piece.begin;
-  double value = strtod(piece.begin, (char**)&tok->spelling.end);
+  tok->spelling.end = tjson_match_number_parts(piece, &int_end, &frac_end);
   tok->typeno = TJSON_NUMERIC_LITERAL;
-  if (value == 0 && tjson_StringPiece_size(tok->spelling) == 0) {
+  if (!tok->spelling.end) {
+    tok->spelling.end = piece.begin;
     tok->typeno = TJSON_INVALID_TOKEN;
     return;
   }
+  // Record the parts so that the number isn't matched again when it is
+  // converted
+  if (frac_end <= UINT16_MAX) {
+    tok->int_end = (uint16_t)int_end;
+    tok->frac_end = (uint16_t)frac_end;
+  } else {
+    tok->int_end = tok->frac_end = 0;
+  }
   return;
 }
 
+// Match the next token using the structural index. Return 1 if a token was
+// matched, or 0 if the token must be matched by consume_token(). The only
+// tokens matched here are punctuation, string literals, and whitespace. Other
+// literals are short and are left to consume_token() which validates them.
+static int8_t consume_token_indexed(struct tjson_Scanner* scanner,
+                                    struct tjson_Token* tok) {
+  struct tjson_StringPiece piece = scanner->_piece;
+  const char* base = piece.begin - scanner->_loc.offset;
+  const uint32_t* structurals = scanner->_structurals;
+  uint32_t idx = scanner->_structural_idx;
+  while (idx < scanner->_nstructurals &&
+         structurals[idx] < scanner->_loc.offset) {
+    idx++;
+  }
+  scanner->_structural_idx = idx;
+
+  const char* next =
+      (idx < scanner->_nstructurals) ? base + structurals[idx] : piece.end;
+  if (piece.begin < next) {
+    // Everything from whitespace up to the next structural is whitespace.
+    // Otherwise we are in the remainder of a literal that consume_token()
+    // did not accept, and it will report it.
+    if (!is_whitespace(*piece.begin)) {
+      return 0;
+    }
+    tok->typeno = TJSON_WHITESPACE;
+    tok->spelling.begin = piece.begin;
+    tok->spelling.end = next;
+    return 1;
+  }
+
+  if (*piece.begin == '"') {
+    // The string ends at the closing quote, which is followed only by
+    // whitespace up to the next structural.
+    const char* end = (idx + 1 < scanner->_nstructurals)
+                          ? base + structurals[idx + 1]
+                          : piece.end;
+    while (end > piece.begin + 1 && is_whitespace(end[-1])) {
+      end--;
+    }
+    tok->typeno = TJSON_STRING_LITERAL;
+    tok->spelling.begin = piece.begin;
+    tok->spelling.end = end;
+    return 1;
+  }
+
+  if (is_punctuation(*piece.begin)) {
+    tok->typeno = TJSON_PUNCTUATION;
+    tok->spelling.begin = piece.begin;
+    tok->spelling.end = piece.begin + 1;
+    return 1;
+  }
+
+  return 0;
+}
+
+// Count the newlines up to the current location, so that locating offsets
+// within the next chunk of a stream doesn't need the content before it.
+static void sync_lines(struct tjson_Scanner* scanner) {
+  struct tjson_SourceLocation loc = scanner->_loc;
+  tjson_Scanner_locate(scanner, &loc);
+}
+
+// Advance the scanner past a token matched by tjson_Scanner_peek()
+static void advance_past(struct tjson_Scanner* scanner,
+                         const struct tjson_Token* tok) {
+  scanner->_loc.offset += tjson_StringPiece_size(tok->spelling);
+  scanner->_piece.begin = tok->spelling.end;
+  if (scanner->_carry_split && tok->spelling.end >= scanner->_carry_split) {
+    // The token which spanned chunks is finished, continue in the chunk.
+    sync_lines(scanner);
+    scanner->_piece.begin =
+        scanner->_chunk.begin + (tok->spelling.end - scanner->_carry_split);
+    scanner->_piece.end = scanner->_chunk.end;
+    scanner->_carry_split = NULL;
+    scanner->_window_offset = scanner->_loc.offset;
+  }
+
+  switch (tok->typeno) {
+    case TJSON_NUMERIC_LITERAL:
+      scanner->_numeric_storage += sizeof(uint64_t);
+      break;
+    case TJSON_STRING_LITERAL:
+      scanner->_string_storage += tjson_StringPiece_size(tok->spelling) + 1;
+      break;
+    default:
+      break;
+  }
+}
+
+// Return 1 if `piece` is a proper prefix of `keyword`
+static int8_t is_keyword_prefix(struct tjson_StringPiece piece,
+                                const char* keyword) {
+  size_t size = tjson_StringPiece_size(piece);
+  return size < strlen(keyword) && memcmp(piece.begin, keyword, size) == 0;
+}
+
+// Return 1 if the string literal ends with an unescaped quote
+static int8_t is_string_terminated(struct tjson_StringPiece spelling) {
+  if (tjson_StringPiece_size(spelling) < 2 || spelling.end[-1] != '"') {
+    return 0;
+  }
+  const char* ptr = spelling.end - 1;
+  while (ptr - 1 > spelling.begin && ptr[-1] == '\\') {
+    ptr--;
+  }
+  return ((spelling.end - 1 - ptr) % 2) == 0;
+}
+
+static inline int8_t is_number_char(char c) {
+  return ('0' <= c && c <= '9') || c == '-' || c == '+' || c == '.' ||
+         c == 'e' || c == 'E';
+}
+
+// Return 1 if `tok`, which was matched at the start of `piece`, may be the
+// beginning of a longer token that continues in the next chunk of a stream.
+static int8_t token_may_continue(struct tjson_StringPiece piece,
+                                 const struct tjson_Token* tok) {
+  switch (tok->typeno) {
+    case TJSON_STRING_LITERAL:
+      return tok->spelling.end == piece.end &&
+             !is_string_terminated(tok->spelling);
+    case TJSON_COMMENT:
+      return tok->spelling.end == piece.end;
+    case TJSON_NUMERIC_LITERAL:
+    case TJSON_INVALID_TOKEN:
+      break;
+    default:
+      return 0;
+  }
+
+  if (is_keyword_prefix(piece, "true") || is_keyword_prefix(piece, "false") ||
+      is_keyword_prefix(piece, "null") || is_keyword_prefix(piece, "//")) {
+    return 1;
+  }
+  if (!is_number_char(*piece.begin)) {
+    return 0;
+  }
+  // A number continues if nothing but number characters follow it
+  const char* ptr = (tok->typeno == TJSON_NUMERIC_LITERAL) ? tok->spelling.end
+                                                          : piece.begin;
+  while (ptr < piece.end && is_number_char(*ptr)) {
+    ptr++;
+  }
+  return ptr == piece.end;
+}
+
+// Move the rest of the input, which is the start of a token, to the carry
+// and hold it back until the next chunk of the stream is fed. The chunk is
+// then no longer needed.
+static int hold_for_input(struct tjson_Scanner* scanner,
+                          struct tjson_Error* error) {
+  size_t pending = tjson_StringPiece_size(scanner->_piece);
+  // If the carry already holds a copy of the head of the chunk, then all of
+  // the chunk must have fit behind the token. The copy ends with the piece,
+  // so it is never negative in size.
+  size_t copied = 0;
+  if (scanner->_carry_split && scanner->_piece.end > scanner->_carry_split) {
+    copied = (size_t)(scanner->_piece.end - scanner->_carry_split);
+  }
+  if (pending > scanner->_carry_capacity ||
+      (scanner->_carry_split &&
+       copied < tjson_StringPiece_size(scanner->_chunk))) {
+    // The token doesn't fit in the carry
+    error->code = TJSON_PARSE_OVERFLOW;
+    error->loc = scanner->_loc;
+    tjson_Scanner_locate(scanner, &error->loc);
+    snprintf(error->msg, sizeof(error->msg),
+             "The token at %d:%d is longer than the carry buffer (%d bytes)",
+             (int)error->loc.lineno, (int)error->loc.colno,
+             (int)scanner->_carry_capacity);
+    return -1;
+  }
+
+  if (pending > 0 && scanner->_piece.begin != scanner->_carry &&
+      scanner->_carry_pinned) {
+    error->code = TJSON_PARSE_BAD_STATE;
+    error->loc = scanner->_loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "Can not carry the token at offset %d while a peeked event "
+             "still refers to the carry buffer",
+             (int)scanner->_loc.offset);
+    return -1;
+  }
+
+  // Nothing before the current location is addressable after this
+  sync_lines(scanner);
+  scanner->_window_offset = scanner->_loc.offset;
+  if (pending > 0 && scanner->_piece.begin != scanner->_carry) {
+    memmove(scanner->_carry, scanner->_piece.begin, pending);
+    scanner->_piece.begin = scanner->_carry;
+    scanner->_piece.end = scanner->_carry + pending;
+  }
+  scanner->_carry_split = NULL;
+  scanner->_held = 1;
+  error->code = TJSON_LEX_NEED_INPUT;
+  error->loc = scanner->_loc;
+  snprintf(error->msg, sizeof(error->msg),
+           "The current chunk is consumed, feed the next chunk of the stream "
+           "or finish it.");
+  return -1;
+}
+
 int tjson_Scanner_pump_impl(struct tjson_Scanner* scanner,
                             struct tjson_Token* tok, struct tjson_Error* error,
                             int8_t peek) {
   if (tjson_StringPiece_size(scanner->_piece) < 1) {
+    if (scanner->_streaming && !scanner->_input_finished) {
+      return hold_for_input(scanner, error);
+    }
     error->code = TJSON_LEX_INPUT_FINISHED;
     error->loc = scanner->_loc;
     snprintf(error->msg, sizeof(error->msg),
@@ -368,7 +683,15 @@ int tjson_Scanner_pump_impl(struct tjson_Scanner* scanner,
     return -1;
   }
 
-  consume_token(scanner->_piece, tok);
+  if (!scanner->_structurals || scanner->_allow_comments ||
+      !consume_token_indexed(scanner, tok)) {
+    consume_token(scanner->_piece, tok);
+  }
+  scanner->_nlexed++;
+  if (scanner->_streaming && !scanner->_input_finished &&
+      token_may_continue(scanner->_piece, tok)) {
+    return hold_for_input(scanner, error);
+  }
   if (tok->typeno == TJSON_STRING_LITERAL &&
       !tjson_StringPiece_endswith(tok->spelling, "\"")) {
     tok->typeno = TJSON_INVALID_TOKEN;
@@ -381,11 +704,12 @@ int tjson_Scanner_pump_impl(struct tjson_Scanner* scanner,
   if (tok->typeno == TJSON_INVALID_TOKEN) {
     error->code = TJSON_LEX_INVALID_TOKEN;
     error->loc = scanner->_loc;
+    tjson_Scanner_locate(scanner, &error->loc);
     snprintf(
         error->msg, sizeof(error->msg),
         "An invalid input token was encountered. Source is not valid json. "
         "At %d:%d",
-        (int)scanner->_loc.lineno, (int)scanner->_loc.colno);
+        (int)error->loc.lineno, (int)error->loc.colno);
     return -1;
   }
 
@@ -394,20 +718,7 @@ int tjson_Scanner_pump_impl(struct tjson_Scanner* scanner,
     return 0;
   }
 
-  advance_location(tok->spelling, &(scanner->_loc));
-  scanner->_piece.begin = tok->spelling.end;
-
-  switch (tok->typeno) {
-    case TJSON_NUMERIC_LITERAL:
-      scanner->_numeric_storage += sizeof(uint32_t);
-      break;
-    case TJSON_STRING_LITERAL:
-      scanner->_string_storage += tjson_StringPiece_size(tok->spelling) + 1;
-      break;
-    default:
-      break;
-  }
-
+  advance_past(scanner, tok);
   return 0;
 }
 
@@ -421,6 +732,68 @@ int tjson_Scanner_peek(struct tjson_Scanner* scanner, struct tjson_Token* tok,
   return tjson_Scanner_pump_impl(scanner, tok, error, /*peek=*/1);
 }
 
+int tjson_Scanner_begin_stream(struct tjson_Scanner* scanner, char* carry,
+                               uint32_t capacity, struct tjson_Error* error) {
+  struct tjson_StringPiece empty = {carry, carry};
+  if (tjson_Scanner_begin(scanner, empty, error)) {
+    return -1;
+  }
+  scanner->_streaming = 1;
+  scanner->_held = 1;
+  scanner->_carry = carry;
+  scanner->_carry_capacity = capacity;
+  return 0;
+}
+
+int tjson_Scanner_feed(struct tjson_Scanner* scanner,
+                       struct tjson_StringPiece chunk,
+                       struct tjson_Error* error) {
+  size_t pending = tjson_StringPiece_size(scanner->_piece);
+  if (!scanner->_streaming || scanner->_input_finished ||
+      !scanner->_held) {
+    error->code = TJSON_LEX_BAD_STATE;
+    error->loc = scanner->_loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "Input can only be fed to an unfinished stream once the previous "
+             "chunk is consumed");
+    return -1;
+  }
+  scanner->_held = 0;
+  if (!pending) {
+    scanner->_piece = chunk;
+    return 0;
+  }
+
+  // The held back token is at the start of the carry, follow it with as much
+  // of the chunk as fits. Once the token is matched we switch to the chunk
+  // (see advance_past()).
+  size_t ncopy = scanner->_carry_capacity - pending;
+  if (ncopy > tjson_StringPiece_size(chunk)) {
+    ncopy = tjson_StringPiece_size(chunk);
+  }
+  memcpy(scanner->_carry + pending, chunk.begin, ncopy);
+  scanner->_piece.end = scanner->_carry + pending + ncopy;
+  scanner->_carry_split = scanner->_carry + pending;
+  scanner->_chunk = chunk;
+  return 0;
+}
+
+int tjson_Scanner_finish(struct tjson_Scanner* scanner,
+                         struct tjson_Error* error) {
+  if (!scanner->_streaming ||
+      (tjson_StringPiece_size(scanner->_piece) > 0 && !scanner->_held)) {
+    error->code = TJSON_LEX_BAD_STATE;
+    error->loc = scanner->_loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "A stream can only be finished once the previous chunk is "
+             "consumed");
+    return -1;
+  }
+  scanner->_input_finished = 1;
+  scanner->_held = 0;
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 //   High Level Lex Functions
 // -----------------------------------------------------------------------------
@@ -492,8 +865,10 @@ static enum tjson_EventTypeNo groupstack_back(struct tjson_Parser* parser) {
 }
 
 static void groupstack_push(struct tjson_Parser* parser,
-                            enum tjson_EventTypeNo event_typeno) {
+                            enum tjson_EventTypeNo event_typeno,
+                            uint32_t offset) {
   parser->_group_stack[parser->_group_stack_size] = event_typeno;
+  parser->_group_offset[parser->_group_stack_size] = offset;
   parser->_group_stack_size++;
 }
 
@@ -504,8 +879,8 @@ static int groupstack_check_overflow(struct tjson_Parser* parser,
       sizeof(parser->_group_stack) / sizeof(parser->_group_stack[0])) {
     error->code = TJSON_INTERNAL_ERROR;
     error->loc = loc;
-    snprintf(error->msg, sizeof(error->msg), "Group stack overflow at %d:%d",
-             (int)loc.lineno, (int)loc.colno);
+    snprintf(error->msg, sizeof(error->msg),
+             "Group stack overflow at offset %d", (int)loc.offset);
     return -1;
   }
   return 0;
@@ -562,7 +937,7 @@ int tjson_Parser_handle_token(struct tjson_Parser* parser,
           if (groupstack_check_overflow(parser, token->location, error)) {
             return -1;
           }
-          groupstack_push(parser, TJSON_OBJECT_BEGIN);
+          groupstack_push(parser, TJSON_OBJECT_BEGIN, token->location.offset);
           parser->_state = TJSON_PARSING_OBJECT_OPEN;
         } else {
           event->typeno = TJSON_LIST_BEGIN;
@@ -572,7 +947,7 @@ int tjson_Parser_handle_token(struct tjson_Parser* parser,
           if (groupstack_check_overflow(parser, token->location, error)) {
             return -1;
           }
-          groupstack_push(parser, TJSON_LIST_BEGIN);
+          groupstack_push(parser, TJSON_LIST_BEGIN, token->location.offset);
           parser->_state = TJSON_PARSING_LIST_OPEN;
         }
         return 1;
@@ -780,6 +1155,7 @@ int tjson_Parser_handle_token(struct tjson_Parser* parser,
 
 int tjson_LexerParser_init(struct tjson_LexerParser* lexerparser,
                            struct tjson_Error* error) {
+  lexerparser->_keys = NULL;
   return tjson_Scanner_init(&(lexerparser->_scanner), error);
 }
 
@@ -787,16 +1163,133 @@ int tjson_LexerParser_begin(struct tjson_LexerParser* lexerparser,
                             struct tjson_StringPiece string,
                             struct tjson_Error* error) {
   tjson_Parser_reset(&lexerparser->_parser);
+  lexerparser->_lookahead_begin = 0;
+  lexerparser->_lookahead_size = 0;
+  lexerparser->_brackets = NULL;
+  lexerparser->_nbrackets = 0;
   return tjson_Scanner_begin(&lexerparser->_scanner, string, error);
 }
 
-int tjson_LexerParser_get_next_event(struct tjson_LexerParser* lexerparser,
-                                     struct tjson_Event* event,
-                                     struct tjson_Error* error) {
+int tjson_LexerParser_begin_stream(struct tjson_LexerParser* lexerparser,
+                                   char* carry, uint32_t capacity,
+                                   struct tjson_Error* error) {
+  tjson_Parser_reset(&lexerparser->_parser);
+  lexerparser->_lookahead_begin = 0;
+  lexerparser->_lookahead_size = 0;
+  lexerparser->_brackets = NULL;
+  lexerparser->_nbrackets = 0;
+  return tjson_Scanner_begin_stream(&lexerparser->_scanner, carry, capacity,
+                                    error);
+}
+
+int tjson_LexerParser_feed(struct tjson_LexerParser* lexerparser,
+                           struct tjson_StringPiece chunk,
+                           struct tjson_Error* error) {
+  return tjson_Scanner_feed(&lexerparser->_scanner, chunk, error);
+}
+
+int tjson_LexerParser_finish(struct tjson_LexerParser* lexerparser,
+                             struct tjson_Error* error) {
+  return tjson_Scanner_finish(&lexerparser->_scanner, error);
+}
+
+int tjson_LexerParser_set_structurals(struct tjson_LexerParser* lexerparser,
+                                      const uint32_t* offsets, uint32_t n,
+                                      struct tjson_Error* error) {
+  return tjson_Scanner_set_structurals(&lexerparser->_scanner, offsets, n,
+                                       error);
+}
+
+int tjson_LexerParser_set_brackets(struct tjson_LexerParser* lexerparser,
+                                   const struct tjson_Bracket* brackets,
+                                   uint32_t n, struct tjson_Error* error) {
+  if (lexerparser->_scanner._streaming) {
+    error->code = TJSON_LEX_BAD_STATE;
+    error->loc = lexerparser->_scanner._loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "A bracket index can not be used with streamed input");
+    return -1;
+  }
+  lexerparser->_brackets = brackets;
+  lexerparser->_nbrackets = n;
+  return 0;
+}
+
+void tjson_LexerParser_set_keytable(struct tjson_LexerParser* lexerparser,
+                                    struct tjson_KeyTable* table) {
+  lexerparser->_keys = table;
+}
+
+const struct tjson_Bracket* tjson_LexerParser_find_bracket(
+    const struct tjson_LexerParser* lexerparser, uint32_t offset) {
+  // Brackets are sorted by their opening offset
+  uint32_t lo = 0;
+  uint32_t hi = lexerparser->_nbrackets;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (lexerparser->_brackets[mid].open < offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < lexerparser->_nbrackets &&
+      lexerparser->_brackets[lo].open == offset) {
+    return &lexerparser->_brackets[lo];
+  }
+  return NULL;
+}
+
+int tjson_LexerParser_skip_group(struct tjson_LexerParser* lexerparser,
+                                 struct tjson_Error* error) {
+  struct tjson_Parser* parser = &lexerparser->_parser;
+  struct tjson_Scanner* scanner = &lexerparser->_scanner;
+  if (!lexerparser->_brackets || lexerparser->_lookahead_size > 0 ||
+      parser->_group_stack_size < 1) {
+    return 0;
+  }
+
+  uint32_t open = parser->_group_offset[parser->_group_stack_size - 1];
+  const struct tjson_Bracket* bracket =
+      tjson_LexerParser_find_bracket(lexerparser, open);
+  if (!bracket || bracket->close < scanner->_loc.offset) {
+    error->code = TJSON_PARSE_BAD_STATE;
+    error->loc = scanner->_loc;
+    error->loc.offset = open;
+    tjson_Scanner_locate(scanner, &error->loc);
+    snprintf(error->msg, sizeof(error->msg),
+             "The bracket index does not match the group opened at %d:%d",
+             (int)error->loc.lineno, (int)error->loc.colno);
+    return -1;
+  }
+
+  // Jump to the closing bracket, which the parser will accept as the end of
+  // the current group.
+  const char* base = scanner->_piece.begin - scanner->_loc.offset;
+  scanner->_piece.begin = base + bracket->close;
+  scanner->_loc.offset = bracket->close;
+  if (scanner->_structurals) {
+    scanner->_structural_idx = bracket->close_idx;
+  }
+  parser->_state = TJSON_PARSING_CLOSURE;
+  return 1;
+}
+
+void tjson_LexerParser_locate(struct tjson_LexerParser* lexerparser,
+                              struct tjson_SourceLocation* loc) {
+  tjson_Scanner_locate(&lexerparser->_scanner, loc);
+}
+
+// Lex and parse tokens until the next semantic event. The scanner is only
+// advanced past a token once the parser has accepted it, so on error the
+// stream is left at the offending token.
+static int lex_next_event(struct tjson_LexerParser* lexerparser,
+                          struct tjson_Event* event,
+                          struct tjson_Error* error) {
   int result = 0;
   while (result == 0) {
     result =
-        tjson_Scanner_pump(&lexerparser->_scanner, &lexerparser->_token, error);
+        tjson_Scanner_peek(&lexerparser->_scanner, &lexerparser->_token, error);
     if (result < 0) {
       return result;
     }
@@ -805,44 +1298,82 @@ int tjson_LexerParser_get_next_event(struct tjson_LexerParser* lexerparser,
         tjson_Parser_handle_token(&lexerparser->_parser, &lexerparser->_token,
                                   event, error, /*dry_run=*/0);
     if (result < 0) {
+      tjson_Scanner_locate(&lexerparser->_scanner, &error->loc);
       return result;
     }
-    if (result > 0) {
-      return 0;
-    }
+    advance_past(&lexerparser->_scanner, &lexerparser->_token);
     // If result == 0 then the token did not instigate an event
   }
-  return result;
+  return 0;
+}
+
+// Return 1 if the token of any event in the lookahead is in the carry buffer
+// of a streaming scanner
+static int8_t lookahead_in_carry(const struct tjson_LexerParser* lexerparser) {
+  const struct tjson_Scanner* scanner = &lexerparser->_scanner;
+  if (!scanner->_carry) {
+    return 0;
+  }
+  for (uint32_t idx = 0; idx < lexerparser->_lookahead_size; idx++) {
+    const char* begin =
+        lexerparser->_lookahead[(lexerparser->_lookahead_begin + idx) %
+                                TJSON_LOOKAHEAD_CAPACITY]
+            .token.spelling.begin;
+    if (scanner->_carry <= begin &&
+        begin < scanner->_carry + scanner->_carry_capacity) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int tjson_LexerParser_get_next_event(struct tjson_LexerParser* lexerparser,
+                                     struct tjson_Event* event,
+                                     struct tjson_Error* error) {
+  if (lexerparser->_lookahead_size > 0) {
+    *event = lexerparser->_lookahead[lexerparser->_lookahead_begin];
+    lexerparser->_lookahead_begin =
+        (lexerparser->_lookahead_begin + 1) % TJSON_LOOKAHEAD_CAPACITY;
+    lexerparser->_lookahead_size--;
+    return 0;
+  }
+  return lex_next_event(lexerparser, event, error);
 }
 
 int tjson_LexerParser_peek_next_event(struct tjson_LexerParser* lexerparser,
                                       struct tjson_Event* event,
                                       struct tjson_Error* error) {
-  int result = 0;
-  while (result == 0) {
-    result =
-        tjson_Scanner_peek(&lexerparser->_scanner, &lexerparser->_token, error);
-    if (result < 0) {
-      return result;
-    }
+  return tjson_LexerParser_peek_nth_event(lexerparser, 0, event, error);
+}
 
-    result =
-        tjson_Parser_handle_token(&lexerparser->_parser, &lexerparser->_token,
-                                  event, error, /*dry_run=*/1);
-    if (result < 0) {
-      return result;
-    }
-    if (result > 0) {
-      return 0;
-    }
+int tjson_LexerParser_peek_nth_event(struct tjson_LexerParser* lexerparser,
+                                     uint32_t n, struct tjson_Event* event,
+                                     struct tjson_Error* error) {
+  if (n >= TJSON_LOOKAHEAD_CAPACITY) {
+    error->code = TJSON_PARSE_OVERFLOW;
+    error->loc = lexerparser->_scanner._loc;
+    snprintf(error->msg, sizeof(error->msg),
+             "Cannot peek %d events ahead, the lookahead capacity is %d",
+             (int)n, TJSON_LOOKAHEAD_CAPACITY);
+    return -1;
+  }
 
-    // If result == 0 then the token did not instigate an event. Since it was
-    // non-event producing, we can advance the stream.
-    result =
-        tjson_Scanner_pump(&lexerparser->_scanner, &lexerparser->_token, error);
-    tjson_Parser_handle_token(&lexerparser->_parser, &lexerparser->_token,
-                              event, error, /*dry_run=*/0);
+  while (lexerparser->_lookahead_size <= n) {
+    uint32_t idx =
+        (lexerparser->_lookahead_begin + lexerparser->_lookahead_size) %
+        TJSON_LOOKAHEAD_CAPACITY;
+    lexerparser->_scanner._carry_pinned = lookahead_in_carry(lexerparser);
+    int result =
+        lex_next_event(lexerparser, &lexerparser->_lookahead[idx], error);
+    lexerparser->_scanner._carry_pinned = 0;
+    if (result) {
+      return -1;
+    }
+    lexerparser->_lookahead_size++;
   }
+
+  *event = lexerparser->_lookahead[(lexerparser->_lookahead_begin + n) %
+                                   TJSON_LOOKAHEAD_CAPACITY];
   return 0;
 }
 
@@ -850,8 +1381,35 @@ int tjson_LexerParser_peek_next_event(struct tjson_LexerParser* lexerparser,
 //    High Level Parse Functinos
 // -----------------------------------------------------------------------------
 
-int tjson_parse(struct tjson_StringPiece source, struct tjson_Event* buf,
-                uint32_t n, struct tjson_Error* error) {
+void tjson_CompactEvent_expand(const struct tjson_CompactEvent* compact,
+                               struct tjson_StringPiece source,
+                               struct tjson_Event* event) {
+  event->typeno = compact->typeno;
+  event->token.typeno = compact->token_typeno;
+  event->token.spelling.begin = source.begin + compact->offset;
+  event->token.spelling.end = event->token.spelling.begin + compact->size;
+  event->token.location.lineno = 0;
+  event->token.location.colno = 0;
+  event->token.location.offset = compact->offset;
+  event->token.int_end = 0;
+  event->token.frac_end = 0;
+}
+
+void tjson_CompactEvent_compact(const struct tjson_Event* event,
+                                struct tjson_StringPiece source,
+                                struct tjson_CompactEvent* compact) {
+  compact->typeno = event->typeno;
+  compact->token_typeno = event->token.typeno;
+  compact->offset = (uint32_t)(event->token.spelling.begin - source.begin);
+  compact->size = (uint32_t)tjson_StringPiece_size(event->token.spelling);
+}
+
+// Parse all of `source`, storing up to `n` events in `buf` or, if `compact`
+// is not NULL, in compact form in `compact`.
+static int parse_events(struct tjson_StringPiece source,
+                        struct tjson_Event* buf,
+                        struct tjson_CompactEvent* compact, uint32_t n,
+                        struct tjson_Error* error) {
   struct tjson_LexerParser parser;
 
   if (tjson_LexerParser_init(&parser, error)) {
@@ -867,9 +1425,10 @@ int tjson_parse(struct tjson_StringPiece source, struct tjson_Event* buf,
   }
 
   size_t nevents = 0;
+  struct tjson_Event local_event;
   for (; nevents < n; ++nevents) {
-    int result =
-        tjson_LexerParser_get_next_event(&parser, &buf[nevents], error);
+    struct tjson_Event* event = compact ? &local_event : &buf[nevents];
+    int result = tjson_LexerParser_get_next_event(&parser, event, error);
     if (result < 0) {
       if (error->code == TJSON_LEX_INPUT_FINISHED) {
         return nevents;
@@ -877,9 +1436,11 @@ int tjson_parse(struct tjson_StringPiece source, struct tjson_Event* buf,
         return -3;
       }
     }
+    if (compact) {
+      tjson_CompactEvent_compact(event, source, &compact[nevents]);
+    }
   }
 
-  struct tjson_Event local_event;
   for (; 1; ++nevents) {
     int result = tjson_LexerParser_get_next_event(&parser, &local_event, error);
     if (result < 0) {
@@ -892,6 +1453,79 @@ int tjson_parse(struct tjson_StringPiece source, struct tjson_Event* buf,
   }
 }
 
+int tjson_parse(struct tjson_StringPiece source, struct tjson_Event* buf,
+                uint32_t n, struct tjson_Error* error) {
+  return parse_events(source, buf, NULL, n, error);
+}
+
+int tjson_parse_compact(struct tjson_StringPiece source,
+                        struct tjson_CompactEvent* buf, uint32_t n,
+                        struct tjson_Error* error) {
+  if (tjson_StringPiece_size(source) > UINT32_MAX) {
+    if (error) {
+      error->code = TJSON_PARSE_OVERFLOW;
+      snprintf(error->msg, sizeof(error->msg),
+               "Source of %zu bytes is too large for compact events",
+               tjson_StringPiece_size(source));
+    }
+    return -1;
+  }
+  return parse_events(source, NULL, buf, n, error);
+}
+
+int tjson_measure(struct tjson_StringPiece source,
+                  struct tjson_Measure* measure, struct tjson_Error* error) {
+  struct tjson_Error local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  memset(measure, 0, sizeof(*measure));
+
+  struct tjson_Scanner scanner;
+  if (tjson_Scanner_init(&scanner, error) < 0 ||
+      tjson_Scanner_begin(&scanner, source, error) < 0) {
+    return -1;
+  }
+
+  struct tjson_Token token;
+  while (tjson_Scanner_pump(&scanner, &token, error) == 0) {
+    switch (token.typeno) {
+      case TJSON_PUNCTUATION:
+        switch (*token.spelling.begin) {
+          case '{':
+          case '[':
+            measure->ngroups++;
+            break;
+          case ':':
+            // The string before a colon is an object key
+            measure->nkeys++;
+            break;
+          default:
+            break;
+        }
+        break;
+      case TJSON_STRING_LITERAL:
+        measure->nstrings++;
+        break;
+      case TJSON_BOOLEAN_LITERAL:
+      case TJSON_NULL_LITERAL:
+        measure->nliterals++;
+        break;
+      default:
+        break;
+    }
+  }
+  if (error->code != TJSON_LEX_INPUT_FINISHED) {
+    return -1;
+  }
+
+  // The scanner counts the storage of each string as its spelling (with
+  // quotes) plus a terminator, which is two more bytes than we need.
+  measure->nnumbers = scanner._numeric_storage / sizeof(uint64_t);
+  measure->string_bytes = scanner._string_storage - 2 * measure->nstrings;
+  return 0;
+}
+
 int tjson_verify_parse_piece(struct tjson_StringPiece source,
                              struct tjson_Error* error) {
   if (tjson_parse(source, NULL, 0, error) >= 0) {
@@ -910,5 +1544,5 @@ const struct tjson_SerializeOpts tjson_DefaultOpts = {
     .separators = {": ", ","},
 };
 
-const struct tjson_SerializeOpts tjson_jCompactOpts = {
+const struct tjson_SerializeOpts tjson_CompactOpts = {
     .indent = 0, .separators = {":", ","}};
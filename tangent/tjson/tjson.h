@@ -46,6 +46,28 @@ uint64_t tjson_StringPiece_digest(tjson_StringPiece str);
 // "stripped-underscore, case-insensitive" version of tangent::hash().
 uint64_t tjson_StringPiece_suci_digest(tjson_StringPiece str);
 
+// Write the stripped-underscore, lower-case form of `str` to `buf` and its
+// 32-bit FNV-1a hash to `hash`, in a single pass over `str`. Return the size
+// of the normalized string, or -1 as soon as it exceeds `capacity`.
+//
+// This is the lookup key of the minimal perfect hash tables which protostruct
+// generates for field dispatch. See tjson_phash_slot().
+int32_t tjson_StringPiece_suci_normalize(tjson_StringPiece str, char* buf,
+                                         uint32_t capacity, uint32_t* hash);
+
+// Return the slot of a key in a minimal perfect hash table with `n` slots.
+// `hash` is the FNV-1a hash of the key and `seed` is the displacement of the
+// key's bucket, which is `hash % nbuckets`. The seeds are chosen at generation
+// time (see get_suci_phash() in protostruct/template_util.py) so that every
+// key of the table lands in a distinct slot. Any other key must be verified
+// against the key stored in its slot.
+static inline uint32_t tjson_phash_slot(uint32_t hash, uint32_t seed,
+                                        uint32_t n) {
+  uint32_t mixed = (hash ^ seed) * 0x9e3779b1u;
+  mixed ^= mixed >> 15;
+  return (uint32_t)(((uint64_t)mixed * n) >> 32);
+}
+
 // -----------------------------------------------------------------------------
 //    SourceLocation
 // -----------------------------------------------------------------------------
@@ -80,7 +102,18 @@ const char* tjson_TokenTypeNo_tostring(enum tjson_TokenTypeNo no);
 typedef struct tjson_Token {
   enum tjson_TokenTypeNo typeno;
   struct tjson_StringPiece spelling;
+
+  // Only `offset` is filled by the scanner. Use tjson_Scanner_locate() to
+  // compute the line and column number.
   struct tjson_SourceLocation location;
+
+  // For a TJSON_NUMERIC_LITERAL from the scanner, the offsets within the
+  // spelling where the integer part and the fraction end, so that the number
+  // can be decomposed without matching it again (see
+  // tjson_Number_from_token()). Zero if they were not recorded, e.g. for a
+  // token expanded from a tjson_CompactEvent or a literal longer than 64KiB.
+  uint16_t int_end;
+  uint16_t frac_end;
 } tjson_Token;
 
 // -----------------------------------------------------------------------------
@@ -109,6 +142,29 @@ typedef struct tjson_Event {
   struct tjson_Token token;       //< the token for the event
 } tjson_Event;
 
+// Compact (16 byte) form of a tjson_Event, about a third of the size. The
+// token spelling is stored as an offset and length within the source, so the
+// source must be smaller than 4GiB and must outlive the event. Pointers are
+// rebuilt from the source by tjson_CompactEvent_expand(), and the line and
+// column numbers can be computed on demand with tjson_Scanner_locate().
+typedef struct tjson_CompactEvent {
+  enum tjson_EventTypeNo typeno;        //< What kind of event this is
+  enum tjson_TokenTypeNo token_typeno;  //< the type of the token
+  uint32_t offset;                      //< of the token from source.begin
+  uint32_t size;                        //< of the token spelling
+} tjson_CompactEvent;
+
+// Fill `event` from the compact form of an event parsed from `source`. As
+// with events from the scanner, only `event->token.location.offset` is filled.
+void tjson_CompactEvent_expand(const struct tjson_CompactEvent* compact,
+                               struct tjson_StringPiece source,
+                               struct tjson_Event* event);
+
+// Fill `compact` from an event whose token spelling is within `source`
+void tjson_CompactEvent_compact(const struct tjson_Event* event,
+                                struct tjson_StringPiece source,
+                                struct tjson_CompactEvent* compact);
+
 // -----------------------------------------------------------------------------
 //    Error
 // -----------------------------------------------------------------------------
@@ -126,6 +182,8 @@ typedef enum tjson_ErrorCode {
   TJSON_PARSE_OVERFLOW,          //< would overflow
   TJSON_PARSE_SEMANTIC,          //< failed to parse a semantic value
   TJSON_WRONG_PRIMITIVE,         //< Attempt to parse from wrong primitive type
+  TJSON_LEX_NEED_INPUT,          //< lexer needs the next chunk of a stream
+  TJSON_IO_ERROR,                //< failed to read the input
 } tjson_ErrorCode;
 
 const char* tjson_ErrorCode_tostring(enum tjson_ErrorCode value);
@@ -161,6 +219,11 @@ struct tjson_Scanner {
   // Total bytes required to store the contents of all string values
   uint64_t _string_storage;
 
+  // Number of tokens matched so far, including those matched by
+  // tjson_Scanner_peek(). When this exceeds the number of tokens in the
+  // content then some tokens were lexed more than once.
+  uint64_t _nlexed;
+
   union {
     uint32_t _options;
     struct {
@@ -168,8 +231,41 @@ struct tjson_Scanner {
     };
   };
 
-  // Current location of the input stream
+  // Current location of the input stream. Only the offset is maintained
+  // while scanning, line and column numbers are computed on demand.
   struct tjson_SourceLocation _loc;
+
+  // Newlines before `_line_cursor` have been counted, there are
+  // `_line_count` of them and the last one is just before `_line_begin`.
+  // Locating an offset at or after the cursor counts newlines from the cursor
+  // to that offset and then advances the cursor.
+  uint32_t _line_cursor;
+  uint32_t _line_count;
+  uint32_t _line_begin;
+
+  // Optional structural index of the content (see structural.h), and the
+  // position of the first structural at or after the current location
+  const uint32_t* _structurals;
+  uint32_t _nstructurals;
+  uint32_t _structural_idx;
+
+  // Streamed input (see tjson_Scanner_begin_stream()). `_piece` is the
+  // unconsumed part of the current chunk, or of `_carry` while a token which
+  // spans chunks is being matched. In that case `_carry` holds the start of
+  // the token followed by a copy of the first bytes of `_chunk`, which begin
+  // at `_carry_split`.
+  int8_t _streaming;
+  int8_t _input_finished;
+  int8_t _held;          //< waiting for the next chunk, `_piece` is held back
+  int8_t _carry_pinned;  //< the carry holds a token which is still needed
+  char* _carry;
+  uint32_t _carry_capacity;
+  const char* _carry_split;
+  struct tjson_StringPiece _chunk;
+
+  // Offset of the first byte of the content which is still addressable
+  // through `_piece`. Always zero unless the input is streamed.
+  uint32_t _window_offset;
 };
 
 // Initialize internal constants, etc.
@@ -184,9 +280,56 @@ int tjson_Scanner_begin(struct tjson_Scanner* scanner,
                         struct tjson_StringPiece content,
                         struct tjson_Error* error);
 
+// Provide the structural index (see structural.h) of the content given to
+// tjson_Scanner_begin(). The scanner will then skip string literals and
+// whitespace runs using the index instead of examining each byte. `offsets`
+// must hold every structural of the content and must remain valid until
+// scanning is finished. The index is discarded by the next call to
+// tjson_Scanner_begin() and is not used if comments are allowed. Streamed
+// input can not be indexed.
+int tjson_Scanner_set_structurals(struct tjson_Scanner* scanner,
+                                  const uint32_t* offsets, uint32_t n,
+                                  struct tjson_Error* error);
+
+// Compute the line and column number of `loc->offset` within the content
+// given to tjson_Scanner_begin(). Locating offsets in increasing order costs
+// a single pass over the content, in total. For streamed input, earlier
+// chunks are no longer available and an offset before the current chunk (or
+// before the most recently located line) is reported at that boundary.
+void tjson_Scanner_locate(struct tjson_Scanner* scanner,
+                          struct tjson_SourceLocation* loc);
+
+// Begin scanning a stream whose content is provided in successive chunks by
+// tjson_Scanner_feed(). A token which spans chunks is copied into `carry`,
+// which must be large enough to hold the longest such token, and must remain
+// valid until scanning is finished. Memory use is bounded by the chunk size
+// and `capacity`.
+int tjson_Scanner_begin_stream(struct tjson_Scanner* scanner, char* carry,
+                               uint32_t capacity, struct tjson_Error* error);
+
+// Provide the next chunk of a stream. Call this only once the previous chunk
+// is consumed, i.e. after tjson_Scanner_pump() has failed with
+// TJSON_LEX_NEED_INPUT, at which point the start of a token which reaches
+// the end of the previous chunk has been copied to the carry buffer. The
+// chunk itself only needs to remain valid for as long as the caller uses
+// tokens matched from it. The spelling of a token which spans chunks points
+// into the carry buffer and is valid until the scanner next reports
+// TJSON_LEX_NEED_INPUT.
+int tjson_Scanner_feed(struct tjson_Scanner* scanner,
+                       struct tjson_StringPiece chunk,
+                       struct tjson_Error* error);
+
+// Signal the end of a stream, instead of feeding the next chunk. A token
+// which is held back in the carry is then matched as-is, after which the
+// scanner reports TJSON_LEX_INPUT_FINISHED.
+int tjson_Scanner_finish(struct tjson_Scanner* scanner,
+                         struct tjson_Error* error);
+
 // Match and return the next token. Return 0 on success and -1 on error.
 // if err is not NULL and an error occurs, will be set to a string
-// describing the error message.
+// describing the error message. When streaming, a token which reaches the end
+// of the current chunk is held back and the error is TJSON_LEX_NEED_INPUT
+// until the next chunk is fed.
 int tjson_Scanner_pump(struct tjson_Scanner* scanner, struct tjson_Token* tok,
                        struct tjson_Error* error);
 
@@ -223,12 +366,18 @@ enum tjson_ParserState {
   TJSON_PARSING_ERROR,
 };
 
+// Maximum nesting depth of objects and lists
+#define TJSON_GROUP_STACK_CAPACITY 64
+
 // Manages the state machine for parsing JSON structure from a stream of
 // tokens
 typedef struct tjson_Parser {
   enum tjson_ParserState _state;
-  enum tjson_EventTypeNo _group_stack[64];
+  enum tjson_EventTypeNo _group_stack[TJSON_GROUP_STACK_CAPACITY];
   uint32_t _group_stack_size;
+
+  // Offset of the token which opened each group in the group stack
+  uint32_t _group_offset[TJSON_GROUP_STACK_CAPACITY];
 } tjson_Parser;
 
 // Reset internal state
@@ -250,12 +399,32 @@ int tjson_Parser_handle_token(struct tjson_Parser* parser,
 //    LexerParser
 // -----------------------------------------------------------------------------
 
+struct tjson_Bracket;
+struct tjson_KeyTable;
+
+// Maximum number of events that can be peeked ahead of the stream
+#define TJSON_LOOKAHEAD_CAPACITY 4
+
 // A combined lexer/parser. Manages the incremental state of both
 // simultaniously
 typedef struct tjson_LexerParser {
   struct tjson_Scanner _scanner;
   struct tjson_Parser _parser;
   struct tjson_Token _token;
+
+  // Ring of events which have been lexed and parsed by a peek but not yet
+  // returned by get_next_event(). The parser state is already advanced past
+  // these events.
+  struct tjson_Event _lookahead[TJSON_LOOKAHEAD_CAPACITY];
+  uint32_t _lookahead_begin;
+  uint32_t _lookahead_size;
+
+  // Optional bracket index of the content (see structural.h)
+  const struct tjson_Bracket* _brackets;
+  uint32_t _nbrackets;
+
+  // Optional table of interned object keys (see keytable.h)
+  struct tjson_KeyTable* _keys;
 } tjson_LexerParser;
 
 int tjson_LexerParser_init(struct tjson_LexerParser* lexerparser,
@@ -265,25 +434,124 @@ int tjson_LexerParser_begin(struct tjson_LexerParser* lexerparser,
                             struct tjson_StringPiece string,
                             struct tjson_Error* error);
 
+// Begin parsing a stream provided in chunks. See
+// tjson_Scanner_begin_stream().
+int tjson_LexerParser_begin_stream(struct tjson_LexerParser* lexerparser,
+                                   char* carry, uint32_t capacity,
+                                   struct tjson_Error* error);
+
+// Provide the next chunk of a stream, once getting or peeking an event has
+// failed with TJSON_LEX_NEED_INPUT. See tjson_Scanner_feed(). Events held in
+// the lookahead still refer to earlier chunks, so those chunks must remain
+// valid until the events are consumed. A peek fails with
+// TJSON_PARSE_BAD_STATE if it would need to carry a token while the
+// lookahead holds an event whose token is in the carry buffer.
+int tjson_LexerParser_feed(struct tjson_LexerParser* lexerparser,
+                           struct tjson_StringPiece chunk,
+                           struct tjson_Error* error);
+
+// Signal the end of a stream. See tjson_Scanner_finish().
+int tjson_LexerParser_finish(struct tjson_LexerParser* lexerparser,
+                             struct tjson_Error* error);
+
+// Provide the structural index of the content given to
+// tjson_LexerParser_begin(). See tjson_Scanner_set_structurals().
+int tjson_LexerParser_set_structurals(struct tjson_LexerParser* lexerparser,
+                                      const uint32_t* offsets, uint32_t n,
+                                      struct tjson_Error* error);
+
+// Provide the bracket index (see structural.h) of the content given to
+// tjson_LexerParser_begin(). The index must cover every group of the content
+// and must remain valid until parsing is finished. With the index,
+// tjson_LexerParser_skip_group() and the sink and count functions of parse.h
+// jump over the contents of a group instead of lexing them. Skipped content
+// is not validated beyond the matching of its brackets. Streamed input can
+// not be indexed.
+int tjson_LexerParser_set_brackets(struct tjson_LexerParser* lexerparser,
+                                   const struct tjson_Bracket* brackets,
+                                   uint32_t n, struct tjson_Error* error);
+
+// Intern object keys in `table` (see keytable.h) so that they are passed to
+// the callbacks of tjson_parse_object_interned() by ID. The table is kept
+// across calls to tjson_LexerParser_begin(), so that keys interned in one
+// document are recognized in the next, and must outlive the LexerParser. Pass
+// NULL to stop interning keys.
+void tjson_LexerParser_set_keytable(struct tjson_LexerParser* lexerparser,
+                                    struct tjson_KeyTable* table);
+
+// Return the bracket index entry of the group opened at `offset`, or NULL if
+// there is no bracket index or no group opens at `offset`.
+const struct tjson_Bracket* tjson_LexerParser_find_bracket(
+    const struct tjson_LexerParser* lexerparser, uint32_t offset);
+
+// Skip the remaining contents of the innermost open object or list, leaving
+// the stream at its closing bracket, which is the next event. Return 1 if the
+// contents were skipped, 0 if they could not be (no bracket index, or events
+// are already buffered in the lookahead), or -1 on error.
+int tjson_LexerParser_skip_group(struct tjson_LexerParser* lexerparser,
+                                 struct tjson_Error* error);
+
+// Compute the line and column number of `loc->offset`. See
+// tjson_Scanner_locate().
+void tjson_LexerParser_locate(struct tjson_LexerParser* lexerparser,
+                              struct tjson_SourceLocation* loc);
+
 // Consume tokens until the next semantic event. Return that event in `event`.
 // Advance the token stream past the token that emitted that event.
 int tjson_LexerParser_get_next_event(struct tjson_LexerParser* lexerparser,
                                      struct tjson_Event* event,
                                      struct tjson_Error* error);
 
-// Consume tokens until the next semantic event. Return that event in `event`.
-// Advance the token stream up to but not past the token that generated the
-// `event`. The next call to `get_next_event` will return the same event.
+// Return the next semantic event in `event` without consuming it. The next
+// call to `get_next_event` will return the same event. The event is held in
+// the lookahead ring so that it is not lexed or parsed a second time.
 int tjson_LexerParser_peek_next_event(struct tjson_LexerParser* lexerparser,
                                       struct tjson_Event* event,
                                       struct tjson_Error* error);
 
+// Return the `n`-th upcoming semantic event (zero-based) without consuming
+// it. `n` must be less than TJSON_LOOKAHEAD_CAPACITY. Note that any lex or
+// parse error among the first `n` events is reported here, before the events
+// preceding it are consumed.
+int tjson_LexerParser_peek_nth_event(struct tjson_LexerParser* lexerparser,
+                                     uint32_t n, struct tjson_Event* event,
+                                     struct tjson_Error* error);
+
 // Scan/Tokenize and Parse the source string until completion; Store the
 // parser events in `buf`. Return the number of events that were parsed (which
 // may be greater than `n`)  or -1 on error.
 int tjson_parse(struct tjson_StringPiece source, struct tjson_Event* buf,
                 uint32_t n, struct tjson_Error* error);
 
+// Same as tjson_parse() but store the parser events in compact form. The
+// source must be smaller than 4GiB (see tjson_CompactEvent).
+int tjson_parse_compact(struct tjson_StringPiece source,
+                        struct tjson_CompactEvent* buf, uint32_t n,
+                        struct tjson_Error* error);
+
+// Sizes of the values of a document, measured by tjson_measure()
+typedef struct tjson_Measure {
+  uint64_t ngroups;    //< objects and lists
+  uint64_t nkeys;      //< object keys
+  uint64_t nstrings;   //< string literals, including keys
+  uint64_t nnumbers;   //< numeric literals
+  uint64_t nliterals;  //< boolean and null literals
+
+  // Bytes to store all strings (including keys) unescaped and null
+  // terminated. Escapes only ever shrink a string so this is exact for
+  // strings without escapes and an upper bound otherwise.
+  uint64_t string_bytes;
+} tjson_Measure;
+
+// Lex (but do not parse) all of `source` and fill `measure` from the storage
+// counters of the scanner. This is meant as the first pass of a two pass
+// parse: measure, allocate everything at once, and then parse into that
+// allocation (see tjson_Document_parse()). Return 0 on success or fill `error`
+// and return -1 if the source fails to lex. Note that the source may still
+// fail to parse.
+int tjson_measure(struct tjson_StringPiece source,
+                  struct tjson_Measure* measure, struct tjson_Error* error);
+
 // Lex and Parse the entire source and return 0 if no errors are encountered.
 // Return -1 and fill `error` if any problems are encountered.
 int tjson_verify_parse_piece(struct tjson_StringPiece source,
@@ -0,0 +1,137 @@
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/tjson/workpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+uint32_t tjson_WorkPool_get_nthreads(uint32_t nthreads, uint64_t max_chunks) {
+  if (!nthreads) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpus > 0) ? (uint32_t)ncpus : 1;
+  }
+  if (nthreads > max_chunks) {
+    nthreads = (uint32_t)max_chunks;
+  }
+  return nthreads;
+}
+
+int tjson_WorkPool_init(struct tjson_WorkPool* pool, uint32_t nthreads) {
+  memset(pool, 0, sizeof(struct tjson_WorkPool));
+  pool->threads = calloc(nthreads, sizeof(pthread_t));
+  if (!pool->threads) {
+    return -1;
+  }
+  pool->nthreads = nthreads;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->turn, NULL);
+  return 0;
+}
+
+void tjson_WorkPool_deinit(struct tjson_WorkPool* pool) {
+  if (!pool->threads) {
+    return;
+  }
+  free(pool->threads);
+  pool->threads = NULL;
+  pthread_cond_destroy(&pool->turn);
+  pthread_mutex_destroy(&pool->mutex);
+}
+
+int tjson_WorkPool_run(struct tjson_WorkPool* pool, void* (*run)(void*),
+                       void* workers, size_t worker_size) {
+  char* worker_bytes = workers;
+  pool->next_chunk = 0;
+
+  uint32_t nstarted = 1;
+  for (; nstarted < pool->nthreads; nstarted++) {
+    if (pthread_create(&pool->threads[nstarted], NULL, run,
+                       worker_bytes + nstarted * worker_size)) {
+      struct tjson_Error error;
+      memset(&error, 0, sizeof(error));
+      error.code = TJSON_INTERNAL_ERROR;
+      snprintf(error.msg, sizeof(error.msg),
+               "Failed to start worker thread %u", nstarted);
+      tjson_WorkPool_stop(pool, &error);
+      break;
+    }
+  }
+  run(worker_bytes);
+  for (uint32_t idx = 1; idx < nstarted; idx++) {
+    pthread_join(pool->threads[idx], NULL);
+  }
+  return tjson_WorkPool_stopped(pool) ? -1 : 0;
+}
+
+int8_t tjson_WorkPool_claim(struct tjson_WorkPool* pool,
+                            uint64_t* chunk_index) {
+  if (tjson_WorkPool_stopped(pool)) {
+    return 0;
+  }
+  *chunk_index = __atomic_fetch_add(&pool->next_chunk, 1, __ATOMIC_RELAXED);
+  return *chunk_index < pool->nchunks;
+}
+
+int8_t tjson_WorkPool_is_turn(struct tjson_WorkPool* pool,
+                              uint64_t chunk_index) {
+  pthread_mutex_lock(&pool->mutex);
+  int8_t is_turn = (pool->next_delivery == chunk_index);
+  pthread_mutex_unlock(&pool->mutex);
+  return is_turn;
+}
+
+void tjson_WorkPool_wait_turn(struct tjson_WorkPool* pool,
+                              uint64_t chunk_index) {
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->next_delivery != chunk_index && !tjson_WorkPool_stopped(pool)) {
+    pthread_cond_wait(&pool->turn, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+void tjson_WorkPool_end_turn(struct tjson_WorkPool* pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->next_delivery++;
+  pthread_cond_broadcast(&pool->turn);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+void tjson_WorkPool_stop(struct tjson_WorkPool* pool,
+                         const struct tjson_Error* error) {
+  pthread_mutex_lock(&pool->mutex);
+  if (!__atomic_load_n(&pool->stop, __ATOMIC_RELAXED)) {
+    pool->error = *error;
+    __atomic_store_n(&pool->stop, 1, __ATOMIC_RELAXED);
+  }
+  pthread_cond_broadcast(&pool->turn);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+void tjson_WorkPool_out_of_memory(struct tjson_WorkPool* pool,
+                                  uint32_t worker) {
+  struct tjson_Error error;
+  memset(&error, 0, sizeof(error));
+  error.code = TJSON_PARSE_OOM;
+  snprintf(error.msg, sizeof(error.msg),
+           "Failed to allocate event storage for worker %u", worker);
+  tjson_WorkPool_stop(pool, &error);
+}
+
+int tjson_reserve(void** buf, uint64_t* capacity, uint64_t size,
+                  size_t elemsize) {
+  if (size <= *capacity) {
+    return 0;
+  }
+  uint64_t grown = *capacity ? 2 * *capacity : 64;
+  while (grown < size) {
+    grown *= 2;
+  }
+  void* resized = realloc(*buf, grown * elemsize);
+  if (!resized) {
+    return -1;
+  }
+  *buf = resized;
+  *capacity = grown;
+  return 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+// Copyright 2018-2020 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tangent/tjson/tjson.h"
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+//    Work Pool
+// -----------------------------------------------------------------------------
+// Internal to the threaded drivers (ndjson.c and parallel.c), not installed.
+//
+// The drivers cut the source into chunks which are claimed, in order, by a
+// pool of worker threads. Results may be delivered in chunk order by waiting
+// for the chunk's turn. The first error stops every worker, which check
+// tjson_WorkPool_stopped() between units of work.
+
+typedef struct tjson_WorkPool {
+  uint64_t nchunks;
+  pthread_t* threads;
+  uint32_t nthreads;
+
+  // Accessed atomically
+  uint64_t next_chunk;  //< index of the next chunk to be claimed by a worker
+  int8_t stop;
+
+  // Guards the remaining members
+  pthread_mutex_t mutex;
+  pthread_cond_t turn;       //< signaled when `next_delivery` changes
+  uint64_t next_delivery;    //< index of the next chunk to deliver in order
+  struct tjson_Error error;  //< the first error which stopped the run
+} tjson_WorkPool;
+
+// Return the number of threads to run for the `nthreads` option, which is
+// zero for one per online CPU, but at most `max_chunks`.
+uint32_t tjson_WorkPool_get_nthreads(uint32_t nthreads, uint64_t max_chunks);
+
+// Initialize the pool for `nthreads` workers. Return -1 if the thread handles
+// can't be allocated.
+int tjson_WorkPool_init(struct tjson_WorkPool* pool, uint32_t nthreads);
+void tjson_WorkPool_deinit(struct tjson_WorkPool* pool);
+
+// Run `run` on every worker, where `workers` is an array of `nthreads`
+// elements of `worker_size` bytes. The first worker runs on the calling
+// thread. Chunks are claimed from the beginning. Return -1 if the pool was
+// stopped, including because a thread could not be started.
+int tjson_WorkPool_run(struct tjson_WorkPool* pool, void* (*run)(void*),
+                       void* workers, size_t worker_size);
+
+// Claim the next chunk. Return 0 if there are none left or the pool is
+// stopped.
+int8_t tjson_WorkPool_claim(struct tjson_WorkPool* pool,
+                            uint64_t* chunk_index);
+
+// Return true if all chunks preceding `chunk_index` are delivered
+int8_t tjson_WorkPool_is_turn(struct tjson_WorkPool* pool,
+                              uint64_t chunk_index);
+
+// Wait until all chunks preceding `chunk_index` are delivered, or the pool
+// is stopped
+void tjson_WorkPool_wait_turn(struct tjson_WorkPool* pool,
+                              uint64_t chunk_index);
+
+// Mark the chunk whose turn it is as delivered
+void tjson_WorkPool_end_turn(struct tjson_WorkPool* pool);
+
+// Record the first error and tell every worker to stop
+void tjson_WorkPool_stop(struct tjson_WorkPool* pool,
+                         const struct tjson_Error* error);
+
+// Stop the pool because `worker` failed to grow its storage
+void tjson_WorkPool_out_of_memory(struct tjson_WorkPool* pool,
+                                  uint32_t worker);
+
+static inline int8_t tjson_WorkPool_stopped(struct tjson_WorkPool* pool) {
+  return __atomic_load_n(&pool->stop, __ATOMIC_RELAXED);
+}
+
+// Grow `*buf` so that it can hold at least `size` elements of `elemsize`
+// bytes
+int tjson_reserve(void** buf, uint64_t* capacity, uint64_t size,
+                  size_t elemsize);
+
+#if __cplusplus
+}  // extern "C"
+#endif